@@ -49,6 +49,38 @@ typedef gpointer gstamppointer;
         |((gulong)(G_STAMP_POINTER_GET_POINTER(p)))))
 #define G_STAMP_POINTER_GET_LINK(p)    ((IrisLink*)G_STAMP_POINTER_GET_POINTER(p))
 
+/* #GStampPair is the ABA-safe replacement for #gstamppointer.  The stamp
+ * is a full machine word stored next to the pointer and both are swapped
+ * together with a double-width compare-and-swap (cmpxchg16b on x86_64,
+ * cmpxchg8b on i586), see iris_atomics_compare_and_exchange_pair().  The
+ * stamp is bumped on every successful swap, so a stale pointer can only
+ * match again after 2^32 (or 2^64) swaps of the same location.
+ *
+ * The pair must be aligned to 2 * sizeof(gpointer).  GSlice allocations
+ * provide this, so embed pairs at the start of slice allocated structures
+ * or allocate them directly with g_slice_new0().
+ *
+ * The two words are read separately with G_STAMP_PAIR_LOAD().  A torn read
+ * is harmless since the compare-and-swap that follows checks both words,
+ * but it means every pointer stored in a pair must stay dereferenceable
+ * for the lifetime of the structure (which is what #IrisFreeList is for).
+ */
+typedef struct _GStampPair GStampPair;
+
+struct _GStampPair
+{
+	gpointer pointer;
+	gsize    stamp;
+};
+
+#define G_STAMP_PAIR_LOAD(pair,out) G_STMT_START {                       \
+	(out)->stamp = ((volatile GStampPair*)(pair))->stamp;            \
+	(out)->pointer = ((volatile GStampPair*)(pair))->pointer;        \
+} G_STMT_END
+#define G_STAMP_PAIR_EQUAL(pair,old)                                     \
+	(((volatile GStampPair*)(pair))->pointer == (old)->pointer &&    \
+	 ((volatile GStampPair*)(pair))->stamp == (old)->stamp)
+
 G_END_DECLS
 
 #endif /* __G_STAMP_POINTER_H__ */
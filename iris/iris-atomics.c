@@ -18,6 +18,7 @@
  * 02110-1301 USA
  */
 
+#include "gstamppointer.h"
 #include "iris-atomics.h"
 
 #if DARWIN
@@ -37,3 +38,64 @@ iris_atomics_fetch_and_inc (volatile void *ptr)
 	return __sync_fetch_and_add ((gint*)ptr, 1);
 #endif
 }
+
+/* The fallback for targets without a double-width compare-and-swap.  All
+ * pairs share one lock.  Plain stores are only ever made to pairs of links
+ * that are privately owned, so they cannot race a successful exchange.
+ */
+#if !(GLIB_SIZEOF_VOID_P == 8 && defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)) && \
+    !(GLIB_SIZEOF_VOID_P == 4 && defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8))
+static GStaticMutex pair_mutex = G_STATIC_MUTEX_INIT;
+#endif
+
+/**
+ * iris_atomics_compare_and_exchange_pair:
+ * @pair: A #GStampPair aligned to 2 * sizeof(gpointer)
+ * @old_pointer: the pointer expected in @pair
+ * @old_stamp: the stamp expected in @pair
+ * @new_pointer: the pointer to store
+ *
+ * Atomically replaces the contents of @pair with @new_pointer and
+ * @old_stamp + 1 if it still contains @old_pointer and @old_stamp.
+ *
+ * Return value: %TRUE if the exchange took place
+ */
+gboolean
+iris_atomics_compare_and_exchange_pair (volatile void *pair,
+                                        gpointer       old_pointer,
+                                        gsize          old_stamp,
+                                        gpointer       new_pointer)
+{
+#if GLIB_SIZEOF_VOID_P == 8 && defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+	union { GStampPair pair; unsigned __int128 word; } o, n;
+
+	o.pair.pointer = old_pointer;
+	o.pair.stamp = old_stamp;
+	n.pair.pointer = new_pointer;
+	n.pair.stamp = old_stamp + 1;
+
+	return __sync_bool_compare_and_swap ((unsigned __int128*)pair, o.word, n.word);
+#elif GLIB_SIZEOF_VOID_P == 4 && defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+	union { GStampPair pair; guint64 word; } o, n;
+
+	o.pair.pointer = old_pointer;
+	o.pair.stamp = old_stamp;
+	n.pair.pointer = new_pointer;
+	n.pair.stamp = old_stamp + 1;
+
+	return __sync_bool_compare_and_swap ((guint64*)pair, o.word, n.word);
+#else
+	GStampPair *p = (GStampPair*)pair;
+	gboolean    success = FALSE;
+
+	g_static_mutex_lock (&pair_mutex);
+	if (p->pointer == old_pointer && p->stamp == old_stamp) {
+		p->pointer = new_pointer;
+		p->stamp = old_stamp + 1;
+		success = TRUE;
+	}
+	g_static_mutex_unlock (&pair_mutex);
+
+	return success;
+#endif
+}
@@ -25,7 +25,11 @@
 
 G_BEGIN_DECLS
 
-inline gint iris_atomics_fetch_and_inc (volatile void *ptr);
+inline gint iris_atomics_fetch_and_inc             (volatile void *ptr);
+gboolean    iris_atomics_compare_and_exchange_pair (volatile void *pair,
+                                                    gpointer       old_pointer,
+                                                    gsize          old_stamp,
+                                                    gpointer       new_pointer);
 
 G_END_DECLS
 
@@ -0,0 +1,220 @@
+/* iris-event-count.c
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA
+ * 02110-1301 USA
+ */
+
+/* An event count lets a consumer of a lock-free structure block without
+ * polling and without taking a lock on the fast path. A consumer does
+ *
+ *   key = iris_event_count_prepare (ec);
+ *   if ((item = try_pop ()) != NULL)
+ *     iris_event_count_cancel (ec);
+ *   else
+ *     iris_event_count_wait (ec, key, timeout);
+ *
+ * and a producer calls iris_event_count_notify() after publishing an item.
+ * The notify is only a read when nobody is waiting. Both sides use a full
+ * barrier between their publish and their check, so either the consumer's
+ * try_pop() sees the item or the producer sees the waiter.
+ *
+ * On Linux waiters sleep on a futex on @seq; elsewhere a GCond is used.
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef FUTEX_WAIT_PRIVATE
+#define FUTEX_WAIT_PRIVATE FUTEX_WAIT
+#define FUTEX_WAKE_PRIVATE FUTEX_WAKE
+#endif
+#endif
+
+#include "iris-event-count.h"
+#include "iris-util.h"
+
+#ifdef LINUX
+/* Returns FALSE if @usec elapsed; wakeups may be spurious */
+static gboolean
+futex_wait (volatile gint *addr,
+            gint           val,
+            glong          usec)
+{
+	struct timespec  ts;
+	struct timespec *tsp = NULL;
+
+	if (usec >= 0) {
+		ts.tv_sec = usec / G_USEC_PER_SEC;
+		ts.tv_nsec = (usec % G_USEC_PER_SEC) * 1000;
+		tsp = &ts;
+	}
+
+	if (syscall (SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, tsp, NULL, 0) == 0)
+		return TRUE;
+
+	return errno != ETIMEDOUT;
+}
+
+static void
+futex_wake (volatile gint *addr,
+            gint           n_waiters)
+{
+	syscall (SYS_futex, addr, FUTEX_WAKE_PRIVATE, n_waiters, NULL, NULL, 0);
+}
+#endif
+
+void
+iris_event_count_init (IrisEventCount *event_count)
+{
+	event_count->seq = 0;
+	event_count->n_waiters = 0;
+
+#ifdef LINUX
+	event_count->mutex = NULL;
+	event_count->cond = NULL;
+#else
+	event_count->mutex = g_mutex_new ();
+	event_count->cond = g_cond_new ();
+#endif
+}
+
+void
+iris_event_count_destroy (IrisEventCount *event_count)
+{
+	g_warn_if_fail (event_count->n_waiters == 0);
+
+	if (event_count->mutex)
+		g_mutex_free (event_count->mutex);
+	if (event_count->cond)
+		g_cond_free (event_count->cond);
+}
+
+/*
+ * iris_event_count_prepare:
+ * @event_count: An #IrisEventCount
+ *
+ * Registers the calling thread as a waiter. The caller must check its
+ * condition again afterwards and then call either iris_event_count_wait()
+ * or iris_event_count_cancel().
+ *
+ * Return value: the key to pass to iris_event_count_wait()
+ */
+gint
+iris_event_count_prepare (IrisEventCount *event_count)
+{
+	/* The increment is a full barrier, ordering it before the caller's
+	 * second look at its condition.
+	 */
+	g_atomic_int_inc (&event_count->n_waiters);
+	return g_atomic_int_get (&event_count->seq);
+}
+
+/*
+ * iris_event_count_cancel:
+ * @event_count: An #IrisEventCount
+ *
+ * Unregisters a waiter that found its condition satisfied after
+ * iris_event_count_prepare().
+ */
+void
+iris_event_count_cancel (IrisEventCount *event_count)
+{
+	if (g_atomic_int_dec_and_test (&event_count->n_waiters)) { }
+}
+
+/*
+ * iris_event_count_wait:
+ * @event_count: An #IrisEventCount
+ * @key: The value returned by iris_event_count_prepare()
+ * @timeout: An absolute time to give up at, or %NULL to wait forever
+ *
+ * Blocks until iris_event_count_notify() is called after the matching
+ * iris_event_count_prepare(), or until @timeout passes.
+ *
+ * Return value: %FALSE if @timeout passed without a notify
+ */
+gboolean
+iris_event_count_wait (IrisEventCount *event_count,
+                       gint            key,
+                       GTimeVal       *timeout)
+{
+	gboolean notified = TRUE;
+#ifdef LINUX
+	glong    usec = -1;
+
+	while (g_atomic_int_get (&event_count->seq) == key) {
+		if (timeout != NULL && (usec = g_time_val_usec_until (timeout)) <= 0) {
+			notified = FALSE;
+			break;
+		}
+
+		futex_wait (&event_count->seq, key, usec);
+	}
+#else
+	g_mutex_lock (event_count->mutex);
+
+	while (g_atomic_int_get (&event_count->seq) == key) {
+		if (timeout == NULL)
+			g_cond_wait (event_count->cond, event_count->mutex);
+		else if (!g_cond_timed_wait (event_count->cond, event_count->mutex, timeout)) {
+			notified = (g_atomic_int_get (&event_count->seq) != key);
+			break;
+		}
+	}
+
+	g_mutex_unlock (event_count->mutex);
+#endif
+
+	iris_event_count_cancel (event_count);
+
+	return notified;
+}
+
+/*
+ * iris_event_count_notify:
+ * @event_count: An #IrisEventCount
+ * @all: %TRUE to wake every waiter, %FALSE to wake one
+ *
+ * Wakes threads blocked in iris_event_count_wait(). The caller must have
+ * published its change with a full barrier (an atomic compare-and-exchange
+ * or increment will do) before calling this.
+ */
+void
+iris_event_count_notify (IrisEventCount *event_count,
+                         gboolean        all)
+{
+	if (g_atomic_int_get (&event_count->n_waiters) == 0)
+		return;
+
+#ifdef LINUX
+	g_atomic_int_inc (&event_count->seq);
+	futex_wake (&event_count->seq, all ? INT_MAX : 1);
+#else
+	g_mutex_lock (event_count->mutex);
+	g_atomic_int_inc (&event_count->seq);
+	if (all)
+		g_cond_broadcast (event_count->cond);
+	else
+		g_cond_signal (event_count->cond);
+	g_mutex_unlock (event_count->mutex);
+#endif
+}
@@ -0,0 +1,55 @@
+/* iris-event-count.h
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA
+ * 02110-1301 USA
+ */
+
+#ifndef __IRIS_EVENT_COUNT_H__
+#define __IRIS_EVENT_COUNT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _IrisEventCount IrisEventCount;
+
+/* Lets consumers of a lock-free structure sleep until a producer has
+ * something for them, without polling. See iris_event_count_prepare().
+ */
+struct _IrisEventCount
+{
+	volatile gint  seq;       /* Bumped by every notify that has waiters */
+	volatile gint  n_waiters; /* Consumers between prepare and wait/cancel */
+
+	/* Only used where futexes are not available */
+	GMutex        *mutex;
+	GCond         *cond;
+};
+
+void     iris_event_count_init    (IrisEventCount *event_count);
+void     iris_event_count_destroy (IrisEventCount *event_count);
+gint     iris_event_count_prepare (IrisEventCount *event_count);
+void     iris_event_count_cancel  (IrisEventCount *event_count);
+gboolean iris_event_count_wait    (IrisEventCount *event_count,
+                                   gint            key,
+                                   GTimeVal       *timeout);
+void     iris_event_count_notify  (IrisEventCount *event_count,
+                                   gboolean        all);
+
+G_END_DECLS
+
+#endif /* __IRIS_EVENT_COUNT_H__ */
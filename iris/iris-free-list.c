@@ -18,8 +18,8 @@
  * 02110-1301 USA
  */
 
+#include "iris-atomics.h"
 #include "iris-free-list.h"
-#include "gstamppointer.h"
 
 /**
  * SECTION:iris-free-list
@@ -27,9 +27,11 @@
  *
  * IMPORTANT NOTE
  *
- * The #IrisFreeList is only for use by pointers that have the bottom
- * two bits free. This means that for 32bit architectures the pointer
- * must be aligned to sizeof(void*).  GSlice allocations provide this.
+ * The head of the free list is a #GStampPair which is swapped with a
+ * double-width compare-and-swap, so links must be aligned to
+ * 2 * sizeof(void*).  GSlice allocations provide this.  Links are never
+ * released to the allocator until the free list is freed; the lock-free
+ * structures built on top of it rely on that.
  *
  * END IMPORTANT NOTE
  *
@@ -87,9 +89,8 @@ _try_swap:
 		goto _try_swap;
 	
 	while (link) {
-		tmp = G_STAMP_POINTER_GET_LINK (link)->next;
-		if (link)
-			g_slice_free (IrisLink, G_STAMP_POINTER_GET_LINK (link));
+		tmp = link->next.pointer;
+		g_slice_free (IrisLink, link);
 		link = tmp;
 	}
 	
@@ -108,20 +109,25 @@ _try_swap:
 IrisLink*
 iris_free_list_get (IrisFreeList *free_list)
 {
-	IrisLink *link;
+	GStampPair  old;
+	IrisLink   *link;
 	
 	g_return_val_if_fail (free_list != NULL, NULL);
 	
 	do {
-		link = G_STAMP_POINTER_GET_LINK (free_list->head)->next;
+		G_STAMP_PAIR_LOAD (&free_list->head->next, &old);
+		link = old.pointer;
 		if (link == NULL)
 			return g_slice_new0 (IrisLink);
-	} while (!g_atomic_pointer_compare_and_exchange (
-				(gpointer*)&free_list->head->next,
-				link,
-				G_STAMP_POINTER_GET_LINK (link)->next));
+	} while (!iris_atomics_compare_and_exchange_pair (
+				&free_list->head->next,
+				old.pointer, old.stamp,
+				link->next.pointer));
 	
-	G_STAMP_POINTER_GET_LINK (link)->next = NULL;
+	/* Only the pointer is reset.  The stamp of a link's next pair keeps
+	 * counting across reuse so that #IrisLFQueue can tell a recycled
+	 * link from the one it read. */
+	link->next.pointer = NULL;
 	
 	return link;
 }
@@ -137,16 +143,18 @@ void
 iris_free_list_put (IrisFreeList *free_list,
                     IrisLink     *link)
 {
+	GStampPair old;
+
 	g_return_if_fail (free_list != NULL);
 	g_return_if_fail (link != NULL);
 	
-	G_STAMP_POINTER_GET_LINK (link)->data = NULL;
+	link->data = NULL;
 	
 	do {
-		G_STAMP_POINTER_GET_LINK (link)->next =
-			G_STAMP_POINTER_GET_LINK (free_list->head)->next;
-	} while (!g_atomic_pointer_compare_and_exchange (
-				(gpointer*)&free_list->head->next,
-				G_STAMP_POINTER_GET_LINK (link)->next,
+		G_STAMP_PAIR_LOAD (&free_list->head->next, &old);
+		link->next.pointer = old.pointer;
+	} while (!iris_atomics_compare_and_exchange_pair (
+				&free_list->head->next,
+				old.pointer, old.stamp,
 				link));
 }
@@ -55,23 +55,19 @@ struct _IrisGMainSchedulerPrivate
 G_DEFINE_TYPE (IrisGMainScheduler, iris_gmainscheduler, IRIS_TYPE_SCHEDULER);
 
 static void
-iris_gmainscheduler_queue_real (IrisScheduler  *scheduler,
-                                IrisCallback    func,
-                                gpointer        data,
-                                GDestroyNotify  destroy_notify)
+iris_gmainscheduler_queue_work_real (IrisScheduler  *scheduler,
+                                     IrisThreadWork *thread_work)
 {
 	IrisGMainSchedulerPrivate *priv;
-	IrisThreadWork            *thread_work;
 
 	g_return_if_fail (scheduler != NULL);
-	g_return_if_fail (func != NULL);
+	g_return_if_fail (thread_work != NULL);
 
 	priv = IRIS_GMAINSCHEDULER (scheduler)->priv;
 
 	g_return_if_fail (priv->source != 0);
 
-	thread_work = iris_thread_work_new (func, data, destroy_notify);
-	iris_queue_push (priv->queue, thread_work);
+	iris_queue_push_priority (priv->queue, thread_work, thread_work->priority);
 	g_main_context_wakeup (priv->context);
 }
 
@@ -118,7 +114,7 @@ iris_gmainscheduler_foreach_real (IrisScheduler            *scheduler,
 		                          user_data);
 
 		if (thread_work->remove == FALSE)
-			iris_queue_push (priv->queue, thread_work);
+			iris_queue_push_priority (priv->queue, thread_work, thread_work->priority);
 		else {
 			iris_thread_work_free (thread_work);
 		}
@@ -178,7 +174,7 @@ iris_gmainscheduler_class_init (IrisGMainSchedulerClass *klass)
 	IrisSchedulerClass *sched_class;
 
 	sched_class = IRIS_SCHEDULER_CLASS (klass);
-	sched_class->queue = iris_gmainscheduler_queue_real;
+	sched_class->queue_work = iris_gmainscheduler_queue_work_real;
 	sched_class->unqueue = iris_gmainscheduler_unqueue_real;
 	sched_class->foreach = iris_gmainscheduler_foreach_real;
 	sched_class->add_thread = iris_gmainscheduler_add_thread_real;
@@ -0,0 +1,231 @@
+/* iris-growth-policy.c
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA
+ * 02110-1301 USA
+ */
+
+#include "iris-growth-policy.h"
+
+/**
+ * SECTION:iris-growth-policy
+ * @title: IrisGrowthPolicy
+ * @short_description: Deciding how many threads a scheduler needs
+ *
+ * The first thread of a scheduler, its leader, periodically samples how
+ * fast work is arriving and being done, and asks the scheduler's
+ * #IrisGrowthPolicy how many threads it should have. The scheduler
+ * manager then lends it more threads, or lets the ones it no longer needs
+ * go as soon as they are idle.
+ *
+ * The default policy is iris_growth_policy_get_adaptive(). Others can be
+ * set with iris_scheduler_set_growth_policy() before the scheduler is
+ * first used.
+ */
+
+/* Adaptive policy. Rates are smoothed over about ADAPTIVE_SMOOTHING
+ * seconds. Threads are added as soon as they are needed, but only taken
+ * away once fewer have been enough for ADAPTIVE_SHRINK_HOLD seconds.
+ */
+#define ADAPTIVE_INTERVAL     (10)
+#define ADAPTIVE_SMOOTHING    (0.1)
+#define ADAPTIVE_UTILIZATION  (0.8)
+#define ADAPTIVE_DRAIN_TIME   (0.1)
+#define ADAPTIVE_SHRINK_HOLD  (0.5)
+
+/* Quantum policy, how schedulers grew before growth policies */
+#define QUANTUM_INTERVAL      (1000)
+
+typedef struct
+{
+	gboolean primed;
+	gdouble  arrival_rate;  /* Items queued per second        */
+	gdouble  service_time;  /* Seconds per item on one thread */
+	gint     current;       /* What we last asked for         */
+	gint     hold_target;   /* Most wanted while holding      */
+	gdouble  hold;          /* Seconds we have wanted fewer   */
+} IrisAdaptiveState;
+
+static gint
+ceil_to_int (gdouble value)
+{
+	gint result = (gint)value;
+
+	if (result < value)
+		result++;
+
+	return result;
+}
+
+static gpointer
+iris_growth_policy_adaptive_create (IrisScheduler *scheduler)
+{
+	return g_slice_new0 (IrisAdaptiveState);
+}
+
+static gint
+iris_growth_policy_adaptive_sample (gpointer                state,
+                                    const IrisGrowthSample *sample)
+{
+	IrisAdaptiveState *adaptive = state;
+	gdouble            arrival_rate,
+	                   service_time,
+	                   alpha,
+	                   needed;
+	gint               target;
+
+	if (sample->elapsed <= 0.0 || sample->n_run <= 0)
+		return adaptive->primed? adaptive->current: sample->n_threads;
+
+	arrival_rate = sample->n_arrived / sample->elapsed;
+	service_time = sample->busy / sample->n_run;
+
+	if (!adaptive->primed) {
+		adaptive->arrival_rate = arrival_rate;
+		adaptive->service_time = service_time;
+		adaptive->current = sample->n_threads;
+		adaptive->primed = TRUE;
+	}
+	else {
+		/* Weight by how long the sample covers, so that the smoothing
+		 * does not depend on how busy the leader is.
+		 */
+		alpha = sample->elapsed / (sample->elapsed + ADAPTIVE_SMOOTHING);
+		adaptive->arrival_rate += alpha * (arrival_rate - adaptive->arrival_rate);
+		adaptive->service_time += alpha * (service_time - adaptive->service_time);
+	}
+
+	/* Little's law: to keep up, arrival_rate * service_time items must be
+	 * in progress at any time. Leave some headroom so that queues don't
+	 * build up from random bursts, and add enough threads to clear any
+	 * backlog within ADAPTIVE_DRAIN_TIME.
+	 */
+	needed = adaptive->arrival_rate * adaptive->service_time / ADAPTIVE_UTILIZATION +
+	         sample->n_backlog * adaptive->service_time / ADAPTIVE_DRAIN_TIME;
+
+	target = MAX (ceil_to_int (needed), 1);
+
+	if (target >= adaptive->current) {
+		adaptive->current = target;
+		adaptive->hold = 0.0;
+		adaptive->hold_target = 0;
+	}
+	else {
+		adaptive->hold += sample->elapsed;
+		adaptive->hold_target = MAX (adaptive->hold_target, target);
+
+		if (adaptive->hold >= ADAPTIVE_SHRINK_HOLD) {
+			adaptive->current = adaptive->hold_target;
+			adaptive->hold = 0.0;
+			adaptive->hold_target = 0;
+		}
+	}
+
+	return adaptive->current;
+}
+
+static void
+iris_growth_policy_adaptive_destroy (gpointer state)
+{
+	g_slice_free (IrisAdaptiveState, state);
+}
+
+static const IrisGrowthPolicy adaptive_policy = {
+	"adaptive",
+	ADAPTIVE_INTERVAL,
+	iris_growth_policy_adaptive_create,
+	iris_growth_policy_adaptive_sample,
+	iris_growth_policy_adaptive_destroy
+};
+
+/**
+ * iris_growth_policy_get_adaptive:
+ *
+ * Retrieves the default growth policy. It keeps a moving average of how
+ * fast work arrives and how long each item takes, and by Little's law
+ * asks for enough threads to keep up with that rate while leaving some
+ * headroom, plus enough to soon clear any backlog. It grows as soon as
+ * more threads are needed, but only shrinks once fewer threads have been
+ * enough for half a second, so that bursty work does not make the
+ * scheduler thrash.
+ *
+ * Return value: the adaptive #IrisGrowthPolicy
+ */
+const IrisGrowthPolicy*
+iris_growth_policy_get_adaptive (void)
+{
+	return &adaptive_policy;
+}
+
+static gpointer
+iris_growth_policy_quantum_create (IrisScheduler *scheduler)
+{
+	/* Whether we have guessed at more work on an empty queue */
+	return g_new0 (gboolean, 1);
+}
+
+static gint
+iris_growth_policy_quantum_sample (gpointer                state,
+                                   const IrisGrowthSample *sample)
+{
+	gboolean *has_resized = state;
+	gint      queued;
+
+	/* We check to see if we have a bunch more work to do
+	 * or a potential edge case where we are processing about
+	 * the same speed as the pusher, but it creates enough
+	 * contention where we dont speed up. This is because
+	 * some schedulers will round-robin or steal.  And unless
+	 * we look to add another thread even though we have nothing
+	 * in the queue, we know there are more coming.
+	 */
+	queued = sample->n_backlog;
+	if (queued == 0 && !*has_resized) {
+		queued = sample->n_run * 2;
+		*has_resized = TRUE;
+	}
+
+	if (sample->n_run < queued)
+		return MAX (queued / sample->n_run, sample->n_threads);
+
+	return sample->n_threads;
+}
+
+static const IrisGrowthPolicy quantum_policy = {
+	"quantum",
+	QUANTUM_INTERVAL,
+	iris_growth_policy_quantum_create,
+	iris_growth_policy_quantum_sample,
+	g_free
+};
+
+/**
+ * iris_growth_policy_get_quantum:
+ *
+ * Retrieves the growth policy schedulers used before growth policies
+ * could be chosen. Once a second, if the backlog is larger than what the
+ * leader thread got through in that second, it asks for as many threads
+ * as it would take the leader alone to clear the backlog in a second.
+ * It never asks for fewer threads, so threads only leave once they have
+ * been idle for a while.
+ *
+ * Return value: the quantum #IrisGrowthPolicy
+ */
+const IrisGrowthPolicy*
+iris_growth_policy_get_quantum (void)
+{
+	return &quantum_policy;
+}
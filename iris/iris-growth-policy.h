@@ -0,0 +1,95 @@
+/* iris-growth-policy.h
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA
+ * 02110-1301 USA
+ */
+
+#ifndef __IRIS_GROWTH_POLICY_H__
+#define __IRIS_GROWTH_POLICY_H__
+
+#include <glib.h>
+
+#include "iris-scheduler.h"
+
+G_BEGIN_DECLS
+
+typedef struct _IrisGrowthSample IrisGrowthSample;
+
+/**
+ * IrisGrowthSample:
+ * @elapsed: seconds since the previous sample
+ * @n_arrived: work items queued on the scheduler in that time
+ * @n_completed: work items finished by all of the scheduler's threads in
+ *   that time
+ * @n_backlog: work items queued and not yet finished
+ * @n_run: work items the leader thread ran in that time
+ * @busy: seconds the leader thread spent running them
+ * @n_threads: threads the scheduler has, or is about to have
+ * @min_threads: the scheduler's minimum number of threads
+ * @max_threads: the scheduler's maximum number of threads
+ *
+ * What the leader thread of a scheduler has seen since it last consulted
+ * the scheduler's #IrisGrowthPolicy. @n_run is always at least 1, since
+ * samples are taken after the leader finishes a work item.
+ */
+struct _IrisGrowthSample
+{
+	gdouble elapsed;
+	gint    n_arrived;
+	gint    n_completed;
+	gint    n_backlog;
+	gint    n_run;
+	gdouble busy;
+	gint    n_threads;
+	gint    min_threads;
+	gint    max_threads;
+};
+
+/**
+ * IrisGrowthPolicy:
+ * @name: a name for the policy, for debugging and benchmarks
+ * @interval: the number of milliseconds between samples
+ * @create: returns the policy's state for a scheduler, or %NULL
+ * @sample: returns the number of threads the scheduler should have. If it
+ *   is more than the scheduler has, the scheduler manager adds threads. If
+ *   it is less, threads beyond it leave as soon as they run out of work
+ *   instead of waiting around for more.
+ * @destroy: frees the state returned by @create, or %NULL
+ *
+ * Decides when a scheduler grows and shrinks, see
+ * iris_scheduler_set_growth_policy(). @create and @sample are called by
+ * the scheduler's leader thread only, so the state needs no locking.
+ * The result of @sample is clamped to the scheduler's minimum and maximum
+ * number of threads.
+ */
+struct _IrisGrowthPolicy
+{
+	const gchar *name;
+	guint        interval;
+
+	gpointer (*create)  (IrisScheduler          *scheduler);
+	gint     (*sample)  (gpointer                state,
+	                     const IrisGrowthSample *sample);
+	void     (*destroy) (gpointer                state);
+};
+
+const IrisGrowthPolicy* iris_growth_policy_get_adaptive (void);
+const IrisGrowthPolicy* iris_growth_policy_get_quantum  (void);
+
+G_END_DECLS
+
+#endif /* __IRIS_GROWTH_POLICY_H__ */
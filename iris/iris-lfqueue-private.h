@@ -21,17 +21,26 @@
 #ifndef __IRIS_LFQUEUE_PRIVATE_H__
 #define __IRIS_LFQUEUE_PRIVATE_H__
 
+#include "iris-event-count.h"
 #include "iris-link.h"
 #include "iris-free-list.h"
 
 G_BEGIN_DECLS
 
+/* One Michael-Scott queue each for urgent, normal and low priority items,
+ * see iris_queue_push_priority().
+ */
+#define IRIS_LFQUEUE_N_LANES (3)
+#define IRIS_LFQUEUE_LANE(priority) ((priority) < 0 ? 0 : (priority) > 0 ? 2 : 1)
+
 struct _IrisLFQueuePrivate
 {
-	IrisLink     *head;
-	IrisLink     *tail;
-	IrisFreeList *free_list;
-	guint         length;
+	GStampPair     *head[IRIS_LFQUEUE_N_LANES]; /* All are slice allocated  */
+	GStampPair     *tail[IRIS_LFQUEUE_N_LANES]; /* so that they are aligned *
+	                                             * for iris_atomics_..pair() */
+	IrisFreeList   *free_list;
+	guint           length;
+	IrisEventCount  event_count; /* Parks threads in pop() and timed_pop() */
 };
 
 G_END_DECLS
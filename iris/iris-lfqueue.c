@@ -18,7 +18,8 @@
  * 02110-1301 USA
  */
 
-#include "gstamppointer.h"
+#include "iris-atomics.h"
+#include "iris-event-count.h"
 #include "iris-lfqueue.h"
 #include "iris-lfqueue-private.h"
 #include "iris-util.h"
@@ -36,6 +37,14 @@
  * Keep in mind that lock-free is not always the fastest implementation
  * for all problem sets.
  *
+ * The queue is the Michael-Scott algorithm using counted pointers: the
+ * head, the tail and the next pointer of every link are #GStampPair<!-- -->s
+ * swapped with a double-width compare-and-swap, which makes the queue
+ * immune to the ABA problem when links are recycled through the
+ * #IrisFreeList. Items pushed with iris_queue_push_priority() go into
+ * separate queues for urgent and low priority items, which are checked
+ * before and after the normal one.
+ *
  * <warning><para>
  * #IrisLFQueue is experimental code and may not run correctly. Do
  * not use it in production!
@@ -49,6 +58,9 @@ static gpointer iris_lfqueue_real_timed_pop  (IrisQueue *queue,
 static gpointer iris_lfqueue_real_try_pop    (IrisQueue *queue);
 static gboolean iris_lfqueue_real_push       (IrisQueue *queue,
                                               gpointer   data);
+static gboolean iris_lfqueue_real_push_priority (IrisQueue *queue,
+                                                 gpointer   data,
+                                                 gint       priority);
 
 G_DEFINE_TYPE (IrisLFQueue, iris_lfqueue, IRIS_TYPE_QUEUE)
 
@@ -57,20 +69,25 @@ iris_lfqueue_finalize (GObject *object)
 {
 	IrisLFQueuePrivate *priv;
 	IrisLink           *link, *tmp;
+	gint                lane;
 
 	priv = IRIS_LFQUEUE (object)->priv;
 
-	link = priv->head;
-	priv->tail = NULL;
+	for (lane = 0; lane < IRIS_LFQUEUE_N_LANES; lane++) {
+		link = priv->head[lane]->pointer;
+
+		while (link) {
+			tmp = link->next.pointer;
+			g_slice_free (IrisLink, link);
+			link = tmp;
+		}
 
-	while (link) {
-		tmp = G_STAMP_POINTER_GET_LINK (link)->next;
-		if (link)
-			g_slice_free (IrisLink, G_STAMP_POINTER_GET_POINTER (link));
-		link = tmp;
+		g_slice_free (GStampPair, priv->head[lane]);
+		g_slice_free (GStampPair, priv->tail[lane]);
 	}
 
 	iris_free_list_free (priv->free_list);
+	iris_event_count_destroy (&priv->event_count);
 
 	G_OBJECT_CLASS (iris_lfqueue_parent_class)->finalize (object);
 }
@@ -87,6 +104,7 @@ iris_lfqueue_class_init (IrisLFQueueClass *klass)
 
 	queue_class = IRIS_QUEUE_CLASS (klass);
 	queue_class->push = iris_lfqueue_real_push;
+	queue_class->push_priority = iris_lfqueue_real_push_priority;
 	queue_class->pop = iris_lfqueue_real_pop;
 	queue_class->try_pop = iris_lfqueue_real_try_pop;
 	queue_class->timed_pop = iris_lfqueue_real_timed_pop;
@@ -96,13 +114,20 @@ iris_lfqueue_class_init (IrisLFQueueClass *klass)
 static void
 iris_lfqueue_init (IrisLFQueue *queue)
 {
+	gint lane;
+
 	queue->priv = G_TYPE_INSTANCE_GET_PRIVATE (queue,
 	                                           IRIS_TYPE_LFQUEUE,
 	                                           IrisLFQueuePrivate);
 
-	queue->priv->head = g_slice_new0 (IrisLink);
-	queue->priv->tail = queue->priv->head;
+	for (lane = 0; lane < IRIS_LFQUEUE_N_LANES; lane++) {
+		queue->priv->head[lane] = g_slice_new0 (GStampPair);
+		queue->priv->tail[lane] = g_slice_new0 (GStampPair);
+		queue->priv->head[lane]->pointer = g_slice_new0 (IrisLink);
+		queue->priv->tail[lane]->pointer = queue->priv->head[lane]->pointer;
+	}
 	queue->priv->free_list = iris_free_list_new ();
+	iris_event_count_init (&queue->priv->event_count);
 }
 
 /**
@@ -119,142 +144,174 @@ iris_lfqueue_new ()
 }
 
 static gboolean
-iris_lfqueue_real_push (IrisQueue *queue,
-                        gpointer   data)
+iris_lfqueue_push_lane (IrisQueue *queue,
+                        gpointer   data,
+                        gint       lane)
 {
 	IrisLFQueuePrivate *priv;
-	IrisLink           *old_tail;
-	IrisLink           *old_next;
+	GStampPair         *lane_tail;
+	GStampPair          tail;
+	GStampPair          next;
 	IrisLink           *link;
-	gboolean            success = FALSE;
 
 	g_return_val_if_fail (queue != NULL, FALSE);
 	g_return_val_if_fail (data != NULL, FALSE);
 
 	priv = IRIS_LFQUEUE (queue)->priv;
-	link = G_STAMP_POINTER_INCREMENT (iris_free_list_get (priv->free_list));
-	G_STAMP_POINTER_GET_LINK (link)->data = data;
-
-	while (!success) {
-		old_tail = priv->tail;
-		old_next = G_STAMP_POINTER_GET_LINK (old_tail)->next;
-
-		if (priv->tail == old_tail) {
-			if (!old_next) {
-				success = g_atomic_pointer_compare_and_exchange (
-						(gpointer*)&G_STAMP_POINTER_GET_LINK (priv->tail)->next,
-						NULL, link);
-			}
+	lane_tail = priv->tail[lane];
+
+	/* the free list hands links out with next.pointer set to NULL */
+	link = iris_free_list_get (priv->free_list);
+	link->data = data;
+
+	for (;;) {
+		G_STAMP_PAIR_LOAD (lane_tail, &tail);
+		G_STAMP_PAIR_LOAD (&((IrisLink*)tail.pointer)->next, &next);
+
+		if (!G_STAMP_PAIR_EQUAL (lane_tail, &tail))
+			continue;
+
+		if (next.pointer == NULL) {
+			if (iris_atomics_compare_and_exchange_pair (
+					&((IrisLink*)tail.pointer)->next,
+					NULL, next.stamp, link))
+				break;
 		}
 		else {
-			g_atomic_pointer_compare_and_exchange (
-					(gpointer*)&priv->tail, old_tail, old_next);
+			/* tail is lagging behind, help swing it forward */
+			iris_atomics_compare_and_exchange_pair (lane_tail,
+			                                        tail.pointer, tail.stamp,
+			                                        next.pointer);
 		}
 	}
 
-	g_atomic_pointer_compare_and_exchange ((gpointer*)&priv->tail, old_tail, link);
+	iris_atomics_compare_and_exchange_pair (lane_tail,
+	                                        tail.pointer, tail.stamp,
+	                                        link);
 	g_atomic_int_inc ((gint*)&priv->length);
 
+	/* Wake a consumer blocked in pop() or timed_pop() */
+	iris_event_count_notify (&priv->event_count, FALSE);
+
 	return TRUE;
 }
 
+static gboolean
+iris_lfqueue_real_push (IrisQueue *queue,
+                        gpointer   data)
+{
+	return iris_lfqueue_push_lane (queue, data, IRIS_LFQUEUE_LANE (0));
+}
+
+static gboolean
+iris_lfqueue_real_push_priority (IrisQueue *queue,
+                                 gpointer   data,
+                                 gint       priority)
+{
+	return iris_lfqueue_push_lane (queue, data, IRIS_LFQUEUE_LANE (priority));
+}
+
+static gpointer
+iris_lfqueue_try_pop_lane (IrisLFQueuePrivate *priv,
+                           gint                lane)
+{
+	GStampPair *lane_head = priv->head[lane];
+	GStampPair *lane_tail = priv->tail[lane];
+	GStampPair  head;
+	GStampPair  tail;
+	GStampPair  next;
+	gpointer    result = NULL;
+
+	for (;;) {
+		G_STAMP_PAIR_LOAD (lane_head, &head);
+		G_STAMP_PAIR_LOAD (lane_tail, &tail);
+		G_STAMP_PAIR_LOAD (&((IrisLink*)head.pointer)->next, &next);
+
+		if (!G_STAMP_PAIR_EQUAL (lane_head, &head))
+			continue;
+
+		if (head.pointer == tail.pointer) {
+			if (next.pointer == NULL)
+				return NULL;
+
+			iris_atomics_compare_and_exchange_pair (lane_tail,
+			                                        tail.pointer, tail.stamp,
+			                                        next.pointer);
+		}
+		else {
+			/* read before the swap, once it succeeds another
+			 * consumer may recycle next */
+			result = ((IrisLink*)next.pointer)->data;
+			if (iris_atomics_compare_and_exchange_pair (lane_head,
+			                                            head.pointer, head.stamp,
+			                                            next.pointer))
+				break;
+		}
+	}
+
+	iris_free_list_put (priv->free_list, head.pointer);
+	(void)g_atomic_int_dec_and_test ((gint*)&priv->length);
+
+	return result;
+}
+
 static gpointer
 iris_lfqueue_real_try_pop (IrisQueue *queue)
 {
 	IrisLFQueuePrivate *priv;
-	IrisLink           *old_head;
-	IrisLink           *old_tail;
-	IrisLink           *old_head_next;
-	gboolean            success       = FALSE;
-	gpointer            result        = NULL;
+	gpointer            result;
+	gint                lane;
 
 	g_return_val_if_fail (queue != NULL, NULL);
 
 	priv = IRIS_LFQUEUE (queue)->priv;
 
-	while (!success) {
-		old_head = priv->head;
-		old_tail = priv->tail;
-		old_head_next = G_STAMP_POINTER_GET_LINK (old_head)->next;
-
-		if (old_head == priv->head) {
-			if (old_head == old_tail) {
-				if (!old_head_next)
-					return NULL;
-
-				g_atomic_pointer_compare_and_exchange (
-						(gpointer*)&priv->tail,
-						old_tail,
-						old_head_next);
-			}
-			else {
-				result = G_STAMP_POINTER_GET_LINK (old_head_next)->data;
-				success = g_atomic_pointer_compare_and_exchange (
-						(gpointer*)&priv->head,
-						old_head,
-						old_head_next);
-			}
-		}
-	}
-
-	iris_free_list_put (priv->free_list, old_head);
-	(void)g_atomic_int_dec_and_test ((gint*)&priv->length);
+	for (lane = 0; lane < IRIS_LFQUEUE_N_LANES; lane++)
+		if ((result = iris_lfqueue_try_pop_lane (priv, lane)) != NULL)
+			return result;
 
-	return result;
+	return NULL;
 }
 
 static gpointer
 iris_lfqueue_real_timed_pop (IrisQueue *queue,
                              GTimeVal  *timeout)
 {
-	gpointer result;
-	gint     spin_count = 0;
-	glong    usec;
+	IrisLFQueuePrivate *priv;
+	gpointer            result;
+	gint                spin_count;
+	gint                key;
 
 	g_return_val_if_fail (queue != NULL, NULL);
 
-retry:
-	if (!(result = iris_lfqueue_real_try_pop (queue))) {
-		/* spin a few times retrying */
-		if (spin_count < 5) {
-			spin_count++;
-			goto retry;
+	priv = IRIS_LFQUEUE (queue)->priv;
+
+	/* spin a few times retrying before we go to sleep */
+	for (spin_count = 0; spin_count < 5; spin_count++)
+		if ((result = iris_lfqueue_real_try_pop (queue)) != NULL)
+			return result;
+
+	for (;;) {
+		key = iris_event_count_prepare (&priv->event_count);
+
+		if ((result = iris_lfqueue_real_try_pop (queue)) != NULL) {
+			iris_event_count_cancel (&priv->event_count);
+			return result;
 		}
 
-		/* make sure the timeout hasn't passed */
-		usec = g_time_val_usec_until (timeout);
-		if (usec <= 0)
-			return NULL;
+		/* timeout is NULL when called from pop() */
+		if (!iris_event_count_wait (&priv->event_count, key, timeout))
+			return iris_lfqueue_real_try_pop (queue);
 
-		/* sleep 10 milliseconds */
-		g_usleep (10000);
-		goto retry;
+		if ((result = iris_lfqueue_real_try_pop (queue)) != NULL)
+			return result;
 	}
-
-	return result;
 }
 
 static gpointer
 iris_lfqueue_real_pop (IrisQueue *queue)
 {
-	/* since this method must block, we will retry things periodically
-	 * since we cannot add a lock/condition wait.  This should *not*
-	 * be used on power saving devices such as embedded platforms.
-	 */
-
-	gpointer result  = NULL;
-	GTimeVal timeout = {0,0};
-
-	if ((result = iris_lfqueue_real_try_pop (queue)) != NULL)
-		return result;
-
-	do {
-		g_get_current_time (&timeout);
-		g_time_val_add (&timeout, G_USEC_PER_SEC / 5); /* 200ms */
-		result = iris_lfqueue_real_timed_pop (queue, &timeout);
-	} while (!result);
-
-	return result;
+	return iris_lfqueue_real_timed_pop (queue, NULL);
 }
 
 static guint
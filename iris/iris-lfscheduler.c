@@ -64,26 +64,17 @@ iris_lfscheduler_queue_real_cb (gpointer data,
 	queue = data;
 	thread_work = user_data;
 
-	iris_queue_push (queue, thread_work);
+	iris_queue_push_priority (queue, thread_work, thread_work->priority);
 
 	return TRUE;
 }
 
 static void
-iris_lfscheduler_queue_real (IrisScheduler  *scheduler,
-                             IrisCallback    func,
-                             gpointer        data,
-                             GDestroyNotify  destroy_notify)
+iris_lfscheduler_queue_work_real (IrisScheduler  *scheduler,
+                                  IrisThreadWork *thread_work)
 {
-	IrisLFSchedulerPrivate *priv;
-	IrisThreadWork         *thread_work;
-
 	g_return_if_fail (scheduler != NULL);
-	g_return_if_fail (func != NULL);
-
-	priv = IRIS_LFSCHEDULER (scheduler)->priv;
-
-	thread_work = iris_thread_work_new (func, data, destroy_notify);
+	g_return_if_fail (thread_work != NULL);
 
 	/* deliver to next round robin */
 	iris_rrobin_apply (IRIS_LFSCHEDULER (scheduler)->priv->rrobin,
@@ -122,7 +113,7 @@ iris_scheduler_foreach_rrobin_cb (IrisRRobin *rrobin,
 		                                   closure->user_data);
 
 		if (g_atomic_int_get (&thread_work->remove) == FALSE)
-			iris_queue_push (queue, thread_work);
+			iris_queue_push_priority (queue, thread_work, thread_work->priority);
 		else
 			iris_thread_work_free (thread_work);
 
@@ -169,7 +160,8 @@ iris_lfscheduler_add_thread_real (IrisScheduler  *scheduler,
 
 	priv = IRIS_LFSCHEDULER (scheduler)->priv;
 
-	queue = iris_lfqueue_new ();
+	if (!(queue = iris_scheduler_create_queue (scheduler)))
+		queue = iris_lfqueue_new ();
 	thread->user_data = queue;
 
 	/* add the queue to the round robin */
@@ -235,7 +227,7 @@ iris_lfscheduler_class_init (IrisLFSchedulerClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	IrisSchedulerClass *sched_class = IRIS_SCHEDULER_CLASS (klass);
 
-	sched_class->queue = iris_lfscheduler_queue_real;
+	sched_class->queue_work = iris_lfscheduler_queue_work_real;
 	sched_class->foreach = iris_lfscheduler_foreach_real;
 	sched_class->add_thread = iris_lfscheduler_add_thread_real;
 	sched_class->remove_thread = iris_lfscheduler_remove_thread_real;
@@ -260,7 +252,7 @@ iris_lfscheduler_init (IrisLFScheduler *scheduler)
 	 */
 
 	max_threads = iris_scheduler_get_max_threads (IRIS_SCHEDULER (scheduler));
-	scheduler->priv->rrobin = iris_rrobin_new (max_threads);
+	scheduler->priv->rrobin = iris_rrobin_new (max_threads + IRIS_SCHEDULER_MAX_LENT);
 }
 
 /**
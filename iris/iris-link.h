@@ -21,12 +21,17 @@
 #ifndef __IRIS_LINK_H__
 #define __IRIS_LINK_H__
 
+#include "gstamppointer.h"
+
 typedef struct _IrisLink IrisLink;
 
+/* next comes first so that it gets the GSlice alignment needed for the
+ * double-width compare-and-swap.  next.pointer is an #IrisLink.
+ */
 struct _IrisLink
 {
-	gpointer  data;
-	IrisLink *next;
+	GStampPair next;
+	gpointer   data;
 };
 
 #endif /* __IRIS_LINK_H__ */
@@ -0,0 +1,56 @@
+/* iris-message-private.h
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA
+ * 02110-1301 USA
+ */
+
+#ifndef __IRIS_MESSAGE_PRIVATE_H__
+#define __IRIS_MESSAGE_PRIVATE_H__
+
+#include <glib-object.h>
+
+#include "iris-message.h"
+
+G_BEGIN_DECLS
+
+/* Number of named items stored inside the message itself before the
+ * remaining ones spill into a hash table. No message that Iris sends itself
+ * has more than three.
+ */
+#define IRIS_MESSAGE_N_INLINE 4
+
+typedef struct
+{
+	GQuark          key;
+	GValue          value;
+} IrisMessageSlot;
+
+/* What iris_message_new() allocates. The public struct comes first, so the
+ * inline slots stay out of the public header and its layout.
+ */
+typedef struct
+{
+	IrisMessage     message;
+	guint           n_slots;
+	IrisMessageSlot slots[IRIS_MESSAGE_N_INLINE];
+} IrisMessageReal;
+
+#define IRIS_MESSAGE_REAL(m) ((IrisMessageReal *)(m))
+
+G_END_DECLS
+
+#endif /* __IRIS_MESSAGE_PRIVATE_H__ */
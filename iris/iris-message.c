@@ -23,6 +23,8 @@
 
 #include "gdestructiblepointer.h"
 #include "iris-message.h"
+#include "iris-message-private.h"
+#include "iris-thread-private.h"
 
 /**
  * SECTION:iris-message
@@ -55,10 +57,12 @@
  * for most base types within GLib.  For complex types, use
  * iris_message_set_value() containing a #GValue with the complex type.
  *
- * Named keys uses a hashtable internally which may be more of an
- * expensive operation than is desired.  #IrisMessage provides a way to
- * pack the data into the message using iris_message_set_data().  For
- * light-weight messages containing a single value this is preferred.
+ * Keys are interned as #GQuark<!-- -->s and the first few items are stored
+ * inside the message itself, so small messages need no further allocation.
+ * Messages with many named items fall back to a hashtable, which is a more
+ * expensive operation.  #IrisMessage also provides a way to pack the data
+ * into the message using iris_message_set_data().  For light-weight
+ * messages containing a single value this is preferred.
  *
  * Updating the structure is not currently thread-safe (ref/unref is safe). This
  * may change in future versions of Iris, but right now it is not recommended to
@@ -95,37 +99,83 @@ static void
 iris_message_init_items (IrisMessage *message)
 {
 	if (G_LIKELY (!message->items))
-		message->items = g_hash_table_new_full (g_str_hash,
-		                                        g_str_equal,
-		                                        g_free,
+		message->items = g_hash_table_new_full (g_direct_hash,
+		                                        g_direct_equal,
+		                                        NULL,
 		                                        iris_message_value_free);
 }
 
+static GValue*
+iris_message_lookup_quark (IrisMessage *message,
+                           GQuark       key)
+{
+	IrisMessageReal *real = IRIS_MESSAGE_REAL (message);
+	guint            i;
+
+	for (i = 0; i < real->n_slots; i++)
+		if (real->slots[i].key == key)
+			return &real->slots[i].value;
+
+	if (G_UNLIKELY (message->items != NULL))
+		return g_hash_table_lookup (message->items, GUINT_TO_POINTER (key));
+
+	return NULL;
+}
+
 static const GValue*
-iris_message_get_value_internal (IrisMessage *message,
-                                 const gchar *name)
+iris_message_get_value_quark (IrisMessage *message,
+                              GQuark       key)
 {
 	g_return_val_if_fail (message != NULL, NULL);
-	g_return_val_if_fail (message->items != NULL, NULL);
 
-	return g_hash_table_lookup (message->items, name);
+	/* Also the result of looking up a name that was never interned. */
+	if (G_UNLIKELY (!key))
+		return NULL;
+
+	return iris_message_lookup_quark (message, key);
 }
 
-static void
-iris_message_set_value_internal (IrisMessage *message,
-                                 const gchar *name,
-                                 GValue      *value)
+/* Returns the storage for @key, initialized to hold a @type. Any previous
+ * value is unset first. The first IRIS_MESSAGE_N_INLINE keys live inside the
+ * message; the rest are allocated and kept in message->items.
+ */
+static GValue*
+iris_message_prepare_value_quark (IrisMessage *message,
+                                  GQuark       key,
+                                  GType        type)
 {
-	g_return_if_fail (message != NULL);
+	IrisMessageReal *real = IRIS_MESSAGE_REAL (message);
+	IrisMessageSlot *slot;
+	GValue          *value;
+
+	value = iris_message_lookup_quark (message, key);
 
-	if (!message->items)
+	if (value) {
+		if (G_VALUE_TYPE (value) != G_TYPE_INVALID)
+			g_value_unset (value);
+	}
+	else if (G_LIKELY (real->n_slots < IRIS_MESSAGE_N_INLINE)) {
+		slot = &real->slots[real->n_slots++];
+		slot->key = key;
+		value = &slot->value;
+		memset (value, 0, sizeof (GValue));
+	}
+	else {
 		iris_message_init_items (message);
-	g_hash_table_insert (message->items, g_strdup (name), value);
+		value = iris_message_value_new (NULL);
+		g_hash_table_insert (message->items, GUINT_TO_POINTER (key), value);
+	}
+
+	g_value_init (value, type);
+	return value;
 }
 
 static void
 iris_message_destroy (IrisMessage *message)
 {
+	IrisMessageReal *real = IRIS_MESSAGE_REAL (message);
+	GValue          *value;
+
 	g_return_if_fail (message != NULL);
 
 	if (g_atomic_int_get (&message->floating))
@@ -133,6 +183,12 @@ iris_message_destroy (IrisMessage *message)
 		           "present. iris_message_ref_sink() must be called before the "
 		           "final reference is removed.");
 
+	while (real->n_slots > 0) {
+		value = &real->slots[--real->n_slots].value;
+		if (G_VALUE_TYPE (value) != G_TYPE_INVALID)
+			g_value_unset (value);
+	}
+
 	if (message->items) {
 		g_hash_table_unref (message->items);
 		message->items = NULL;
@@ -145,7 +201,7 @@ iris_message_destroy (IrisMessage *message)
 static void
 iris_message_free (IrisMessage *message)
 {
-	g_slice_free (IrisMessage, message);
+	iris_thread_cache_free (message);
 }
 
 GType
@@ -176,10 +232,16 @@ iris_message_new (gint what)
 {
 	IrisMessage *message;
 
-	message = g_slice_new0 (IrisMessage);
+	/* Only the header is cleared; inline slots are initialized as they
+	 * are claimed by iris_message_prepare_value_quark().
+	 */
+	message = iris_thread_cache_alloc (IRIS_THREAD_CACHE_MESSAGE,
+	                                   sizeof (IrisMessageReal));
+	memset (message, 0, G_STRUCT_OFFSET (IrisMessageReal, slots));
 	message->what = what;
 	message->ref_count = 1;
 	message->floating = TRUE;
+	message->items = NULL;
 
 	return message;
 }
@@ -351,22 +413,32 @@ iris_message_unref (IrisMessage *message)
 IrisMessage*
 iris_message_copy (IrisMessage *message)
 {
-	IrisMessage    *dst;
-	GHashTableIter  iter;
-	gpointer        key, value;
-	gpointer        dkey, dvalue;
+	IrisMessageReal *real = IRIS_MESSAGE_REAL (message);
+	IrisMessage     *dst;
+	GHashTableIter   iter;
+	gpointer         key, value;
+	GValue          *dvalue;
+	guint            i;
 
 	g_return_val_if_fail (message != NULL, NULL);
 
 	dst = iris_message_new (message->what);
 
+	for (i = 0; i < real->n_slots; i++) {
+		value = &real->slots[i].value;
+		dvalue = iris_message_prepare_value_quark (dst,
+		                                           real->slots[i].key,
+		                                           G_VALUE_TYPE (value));
+		g_value_copy (value, dvalue);
+	}
+
 	if (message->items) {
-		iris_message_init_items (dst);
 		g_hash_table_iter_init (&iter, message->items);
 		while (g_hash_table_iter_next (&iter, &key, &value)) {
-			dkey = g_strdup (key);
-			dvalue = iris_message_value_new ((const GValue*)value);
-			g_hash_table_insert (dst->items, dkey, dvalue);
+			dvalue = iris_message_prepare_value_quark (dst,
+			                                           GPOINTER_TO_UINT (key),
+			                                           G_VALUE_TYPE (value));
+			g_value_copy (value, dvalue);
 		}
 	}
 
@@ -426,9 +498,9 @@ guint
 iris_message_count_names (IrisMessage *message)
 {
 	g_return_val_if_fail (message != NULL, 0);
-	if (G_UNLIKELY (!message->items))
-		return 0;
-	return g_hash_table_size (message->items);
+	if (G_LIKELY (!message->items))
+		return IRIS_MESSAGE_REAL (message)->n_slots;
+	return IRIS_MESSAGE_REAL (message)->n_slots + g_hash_table_size (message->items);
 }
 
 /**
@@ -443,11 +515,26 @@ iris_message_count_names (IrisMessage *message)
 gboolean
 iris_message_contains (IrisMessage *message,
                        const gchar *name)
+{
+	return iris_message_contains_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_contains_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_contains(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: TRUE if the message contains @key
+ */
+gboolean
+iris_message_contains_q (IrisMessage *message,
+                         GQuark       key)
 {
 	g_return_val_if_fail (message != NULL, FALSE);
-	if (!message->items)
-		return FALSE;
-	return (NULL != g_hash_table_lookup (message->items, name));
+	return (NULL != iris_message_get_value_quark (message, key));
 }
 
 /**
@@ -464,10 +551,8 @@ iris_message_is_empty (IrisMessage *message)
 {
 	g_return_val_if_fail (message != NULL, FALSE);
 
-	if (G_UNLIKELY (!message->items))
-		return TRUE;
-
-	return (g_hash_table_size (message->items) == 0);
+	/* Items only spill into the table once every inline slot is taken. */
+	return (IRIS_MESSAGE_REAL (message)->n_slots == 0);
 }
 
 /**
@@ -484,10 +569,27 @@ void
 iris_message_get_value (IrisMessage *message,
                         const gchar *name,
                         GValue      *value)
+{
+	iris_message_get_value_q (message, g_quark_try_string (name), value);
+}
+
+/**
+ * iris_message_get_value_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: a #GValue to store the result in
+ *
+ * Like iris_message_get_value(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_get_value_q (IrisMessage *message,
+                          GQuark       key,
+                          GValue      *value)
 {
 	const GValue *real_value;
 
-	real_value = iris_message_get_value_internal (message, name);
+	real_value = iris_message_get_value_quark (message, key);
 	g_value_init (value, G_VALUE_TYPE (real_value));
 	g_value_copy (real_value, value);
 }
@@ -504,13 +606,33 @@ void
 iris_message_set_value (IrisMessage  *message,
                         const gchar  *name,
                         const GValue *value)
+{
+	iris_message_set_value_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_value_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: A #GValue containing the new value
+ *
+ * Like iris_message_set_value(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_value_q (IrisMessage  *message,
+                          GQuark        key,
+                          const GValue *value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
+	g_return_if_fail (value != NULL);
 
-	real_value = iris_message_value_new (value);
-	iris_message_set_value_internal (message, name, real_value);
+	real_value = iris_message_prepare_value_quark (message, key,
+	                                               G_VALUE_TYPE (value));
+	g_value_copy (value, real_value);
 }
 
 /**
@@ -525,9 +647,26 @@ iris_message_set_value (IrisMessage  *message,
 const gchar*
 iris_message_get_string (IrisMessage *message,
                          const gchar *name)
+{
+	return iris_message_get_string_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_string_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_string(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: a string containing the value for @key.
+ */
+const gchar*
+iris_message_get_string_q (IrisMessage *message,
+                           GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, NULL);
 	g_return_val_if_fail (G_VALUE_TYPE (value) == G_TYPE_STRING, NULL);
 	return g_value_get_string (value);
@@ -546,16 +685,31 @@ void
 iris_message_set_string (IrisMessage *message,
                          const gchar *name,
                          const gchar *value)
+{
+	iris_message_set_string_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_string_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: a string
+ *
+ * Like iris_message_set_string(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_string_q (IrisMessage *message,
+                           GQuark       key,
+                           const gchar *value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_STRING);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_STRING);
 	g_value_set_string (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -570,9 +724,26 @@ iris_message_set_string (IrisMessage *message,
 gint
 iris_message_get_int (IrisMessage *message,
                       const gchar *name)
+{
+	return iris_message_get_int_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_int_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_int(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key as a #gint.
+ */
+gint
+iris_message_get_int_q (IrisMessage *message,
+                        GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_int (value);
 }
@@ -589,16 +760,31 @@ void
 iris_message_set_int (IrisMessage *message,
                       const gchar *name,
                       gint         value)
+{
+	iris_message_set_int_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_int_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_int(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_int_q (IrisMessage *message,
+                        GQuark       key,
+                        gint         value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_INT);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_INT);
 	g_value_set_int (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -613,9 +799,26 @@ iris_message_set_int (IrisMessage *message,
 gint64
 iris_message_get_int64 (IrisMessage *message,
                         const gchar *name)
+{
+	return iris_message_get_int64_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_int64_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_int64(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key as a #gint64.
+ */
+gint64
+iris_message_get_int64_q (IrisMessage *message,
+                          GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_int64 (value);
 }
@@ -632,16 +835,31 @@ void
 iris_message_set_int64 (IrisMessage *message,
                         const gchar *name,
                         gint64       value)
+{
+	iris_message_set_int64_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_int64_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_int64(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_int64_q (IrisMessage *message,
+                          GQuark       key,
+                          gint64       value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_INT64);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_INT64);
 	g_value_set_int64 (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -656,9 +874,26 @@ iris_message_set_int64 (IrisMessage *message,
 gfloat
 iris_message_get_float (IrisMessage *message,
                         const gchar *name)
+{
+	return iris_message_get_float_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_float_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_float(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key as a #gfloat.
+ */
+gfloat
+iris_message_get_float_q (IrisMessage *message,
+                          GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_float (value);
 }
@@ -675,16 +910,31 @@ void
 iris_message_set_float (IrisMessage *message,
                         const gchar *name,
                         gfloat       value)
+{
+	iris_message_set_float_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_float_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_float(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_float_q (IrisMessage *message,
+                          GQuark       key,
+                          gfloat       value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_FLOAT);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_FLOAT);
 	g_value_set_float (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -699,9 +949,26 @@ iris_message_set_float (IrisMessage *message,
 gdouble
 iris_message_get_double (IrisMessage *message,
                          const gchar *name)
+{
+	return iris_message_get_double_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_double_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_double(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key as a #gdouble.
+ */
+gdouble
+iris_message_get_double_q (IrisMessage *message,
+                           GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_double (value);
 }
@@ -718,16 +985,31 @@ void
 iris_message_set_double (IrisMessage *message,
                          const gchar *name,
                          gdouble      value)
+{
+	iris_message_set_double_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_double_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_double(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_double_q (IrisMessage *message,
+                           GQuark       key,
+                           gdouble      value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_DOUBLE);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_DOUBLE);
 	g_value_set_double (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -742,9 +1024,26 @@ iris_message_set_double (IrisMessage *message,
 glong
 iris_message_get_long (IrisMessage *message,
                        const gchar *name)
+{
+	return iris_message_get_long_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_long_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_long(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key
+ */
+glong
+iris_message_get_long_q (IrisMessage *message,
+                         GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_long (value);
 }
@@ -761,16 +1060,31 @@ void
 iris_message_set_long (IrisMessage *message,
                        const gchar *name,
                        glong        value)
+{
+	iris_message_set_long_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_long_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_long(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_long_q (IrisMessage *message,
+                         GQuark       key,
+                         glong        value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_LONG);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_LONG);
 	g_value_set_long (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -784,10 +1098,27 @@ iris_message_set_long (IrisMessage *message,
  */
 gulong
 iris_message_get_ulong (IrisMessage *message,
-                       const gchar *name)
+                        const gchar *name)
+{
+	return iris_message_get_ulong_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_ulong_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_ulong(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key
+ */
+gulong
+iris_message_get_ulong_q (IrisMessage *message,
+                          GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_ulong (value);
 }
@@ -804,16 +1135,31 @@ void
 iris_message_set_ulong (IrisMessage *message,
                         const gchar *name,
                         gulong       value)
+{
+	iris_message_set_ulong_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_ulong_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_ulong(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_ulong_q (IrisMessage *message,
+                          GQuark       key,
+                          gulong       value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_ULONG);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_ULONG);
 	g_value_set_ulong (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -828,9 +1174,26 @@ iris_message_set_ulong (IrisMessage *message,
 gchar
 iris_message_get_char (IrisMessage *message,
                        const gchar *name)
+{
+	return iris_message_get_char_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_char_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_char(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key
+ */
+gchar
+iris_message_get_char_q (IrisMessage *message,
+                         GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_char (value);
 }
@@ -847,16 +1210,31 @@ void
 iris_message_set_char (IrisMessage *message,
                        const gchar *name,
                        gchar        value)
+{
+	iris_message_set_char_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_char_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_char(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_char_q (IrisMessage *message,
+                         GQuark       key,
+                         gchar        value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_CHAR);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_CHAR);
 	g_value_set_char (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -871,9 +1249,26 @@ iris_message_set_char (IrisMessage *message,
 guchar
 iris_message_get_uchar (IrisMessage *message,
                         const gchar *name)
+{
+	return iris_message_get_uchar_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_uchar_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_uchar(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key
+ */
+guchar
+iris_message_get_uchar_q (IrisMessage *message,
+                          GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_uchar (value);
 }
@@ -890,16 +1285,31 @@ void
 iris_message_set_uchar (IrisMessage *message,
                         const gchar *name,
                         guchar       value)
+{
+	iris_message_set_uchar_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_uchar_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_uchar(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_uchar_q (IrisMessage *message,
+                          GQuark       key,
+                          guchar       value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_UCHAR);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_UCHAR);
 	g_value_set_uchar (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -914,9 +1324,26 @@ iris_message_set_uchar (IrisMessage *message,
 gboolean
 iris_message_get_boolean (IrisMessage *message,
                           const gchar *name)
+{
+	return iris_message_get_boolean_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_boolean_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_boolean(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key
+ */
+gboolean
+iris_message_get_boolean_q (IrisMessage *message,
+                            GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_boolean (value);
 }
@@ -933,16 +1360,31 @@ void
 iris_message_set_boolean (IrisMessage *message,
                           const gchar *name,
                           gboolean     value)
+{
+	iris_message_set_boolean_q (message, g_quark_from_string (name), value);
+}
+
+/**
+ * iris_message_set_boolean_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @value: the value
+ *
+ * Like iris_message_set_boolean(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_boolean_q (IrisMessage *message,
+                            GQuark       key,
+                            gboolean     value)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_BOOLEAN);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_BOOLEAN);
 	g_value_set_boolean (real_value, value);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
 
 /**
@@ -957,9 +1399,26 @@ iris_message_set_boolean (IrisMessage *message,
 gpointer
 iris_message_get_pointer (IrisMessage *message,
                           const gchar *name)
+{
+	return iris_message_get_pointer_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_pointer_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_pointer(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key
+ */
+gpointer
+iris_message_get_pointer_q (IrisMessage *message,
+                            GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, 0);
 	return g_value_get_pointer (value);
 }
@@ -976,16 +1435,31 @@ void
 iris_message_set_pointer (IrisMessage *message,
                           const gchar *name,
                           gpointer     pointer)
+{
+	iris_message_set_pointer_q (message, g_quark_from_string (name), pointer);
+}
+
+/**
+ * iris_message_set_pointer_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @pointer: the value
+ *
+ * Like iris_message_set_pointer(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_pointer_q (IrisMessage *message,
+                            GQuark       key,
+                            gpointer     pointer)
 {
 	GValue *value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	value = iris_message_value_new (NULL);
-	g_value_init (value, G_TYPE_POINTER);
+	value = iris_message_prepare_value_quark (message, key, G_TYPE_POINTER);
 	g_value_set_pointer (value, pointer);
-
-	iris_message_set_value_internal (message, name, value);
 }
 
 /**
@@ -1001,19 +1475,37 @@ iris_message_set_pointer (IrisMessage *message,
  */
 void
 iris_message_set_pointer_full (IrisMessage   *message,
-                              const gchar    *name,
-                              gpointer        pointer,
-                              GDestroyNotify  destroy_notify)
+                               const gchar   *name,
+                               gpointer       pointer,
+                               GDestroyNotify destroy_notify)
+{
+	iris_message_set_pointer_full_q (message, g_quark_from_string (name), pointer, destroy_notify);
+}
+
+/**
+ * iris_message_set_pointer_full_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @pointer: the value
+ * @destroy_notify: function to call when @message is finalized, that will free
+ *
+ * Like iris_message_set_pointer_full(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_pointer_full_q (IrisMessage   *message,
+                                 GQuark         key,
+                                 gpointer       pointer,
+                                 GDestroyNotify destroy_notify)
 {
 	GValue *value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	value = iris_message_value_new (NULL);
-	g_value_init (value, G_TYPE_DESTRUCTIBLE_POINTER);
+	value = iris_message_prepare_value_quark (message, key,
+	                                          G_TYPE_DESTRUCTIBLE_POINTER);
 	g_value_set_destructible_pointer (value, pointer, destroy_notify);
-
-	iris_message_set_value_internal (message, name, value);
 }
 
 /**
@@ -1028,9 +1520,26 @@ iris_message_set_pointer_full (IrisMessage   *message,
 GObject*
 iris_message_get_object (IrisMessage *message,
                          const gchar *name)
+{
+	return iris_message_get_object_q (message, g_quark_try_string (name));
+}
+
+/**
+ * iris_message_get_object_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ *
+ * Like iris_message_get_object(), but takes an interned key so no string
+ * hashing is needed.
+ *
+ * Return value: the value for @key or %NULL
+ */
+GObject*
+iris_message_get_object_q (IrisMessage *message,
+                           GQuark       key)
 {
 	const GValue *value;
-	value = iris_message_get_value_internal (message, name);
+	value = iris_message_get_value_quark (message, key);
 	g_return_val_if_fail (value != NULL, NULL);
 	return g_value_get_object (value);
 }
@@ -1047,14 +1556,29 @@ void
 iris_message_set_object (IrisMessage *message,
                          const gchar *name,
                          GObject     *object)
+{
+	iris_message_set_object_q (message, g_quark_from_string (name), object);
+}
+
+/**
+ * iris_message_set_object_q:
+ * @message: An #IrisMessage
+ * @key: the key, as returned from IRIS_MESSAGE_KEY()
+ * @object: the value
+ *
+ * Like iris_message_set_object(), but takes an interned key so no string
+ * hashing is needed.
+ */
+void
+iris_message_set_object_q (IrisMessage *message,
+                           GQuark       key,
+                           GObject     *object)
 {
 	GValue *real_value;
 
 	g_return_if_fail (message != NULL);
+	g_return_if_fail (key != 0);
 
-	real_value = iris_message_value_new (NULL);
-	g_value_init (real_value, G_TYPE_OBJECT);
+	real_value = iris_message_prepare_value_quark (message, key, G_TYPE_OBJECT);
 	g_value_set_object (real_value, object);
-
-	iris_message_set_value_internal (message, name, real_value);
 }
@@ -39,6 +39,27 @@ typedef struct _IrisMessage IrisMessage;
  */
 typedef void (*IrisMessageHandler) (IrisMessage *message, gpointer data);
 
+/**
+ * IRIS_MESSAGE_KEY:
+ * @name: a static string naming a message item
+ *
+ * Interns @name the first time it is evaluated and returns the #GQuark for
+ * use with the <function>_q</function> accessors such as
+ * iris_message_get_int_q(). Later evaluations at the same call site return
+ * the cached quark without hashing @name.
+ */
+#if defined (__GNUC__) && !defined (__STRICT_ANSI__)
+#define IRIS_MESSAGE_KEY(name)                                               \
+	(G_GNUC_EXTENSION ({                                                 \
+		static GQuark __iris_message_key = 0;                        \
+		if (G_UNLIKELY (!__iris_message_key))                        \
+			__iris_message_key = g_quark_from_static_string (name); \
+		__iris_message_key;                                          \
+	}))
+#else
+#define IRIS_MESSAGE_KEY(name) (g_quark_from_static_string (name))
+#endif
+
 struct _IrisMessage
 {
 	gint            what;
@@ -67,46 +88,74 @@ void                   iris_message_set_data         (IrisMessage *message, cons
 guint                  iris_message_count_names      (IrisMessage *message);
 gboolean               iris_message_is_empty         (IrisMessage *message);
 gboolean               iris_message_contains         (IrisMessage *message, const gchar *name);
+gboolean               iris_message_contains_q       (IrisMessage *message, GQuark key);
 
 void                   iris_message_get_value        (IrisMessage *message, const gchar *name, GValue *value);
+void                   iris_message_get_value_q      (IrisMessage *message, GQuark key, GValue *value);
 void                   iris_message_set_value        (IrisMessage *message, const gchar *name, const GValue *value);
+void                   iris_message_set_value_q      (IrisMessage *message, GQuark key, const GValue *value);
 
 const gchar*           iris_message_get_string       (IrisMessage *message, const gchar *name);
+const gchar*           iris_message_get_string_q     (IrisMessage *message, GQuark key);
 void                   iris_message_set_string       (IrisMessage *message, const gchar *name, const gchar *value);
+void                   iris_message_set_string_q     (IrisMessage *message, GQuark key, const gchar *value);
 
 gint                   iris_message_get_int          (IrisMessage *message, const gchar *name);
+gint                   iris_message_get_int_q        (IrisMessage *message, GQuark key);
 void                   iris_message_set_int          (IrisMessage *message, const gchar *name, gint value);
+void                   iris_message_set_int_q        (IrisMessage *message, GQuark key, gint value);
 
 gint64                 iris_message_get_int64        (IrisMessage *message, const gchar *name);
+gint64                 iris_message_get_int64_q      (IrisMessage *message, GQuark key);
 void                   iris_message_set_int64        (IrisMessage *message, const gchar *name, gint64 value);
+void                   iris_message_set_int64_q      (IrisMessage *message, GQuark key, gint64 value);
 
 gfloat                 iris_message_get_float        (IrisMessage *message, const gchar *name);
+gfloat                 iris_message_get_float_q      (IrisMessage *message, GQuark key);
 void                   iris_message_set_float        (IrisMessage *message, const gchar *name, gfloat value);
+void                   iris_message_set_float_q      (IrisMessage *message, GQuark key, gfloat value);
 
 gdouble                iris_message_get_double       (IrisMessage *message, const gchar *name);
+gdouble                iris_message_get_double_q     (IrisMessage *message, GQuark key);
 void                   iris_message_set_double       (IrisMessage *message, const gchar *name, gdouble value);
+void                   iris_message_set_double_q     (IrisMessage *message, GQuark key, gdouble value);
 
 glong                  iris_message_get_long         (IrisMessage *message, const gchar *name);
+glong                  iris_message_get_long_q       (IrisMessage *message, GQuark key);
 void                   iris_message_set_long         (IrisMessage *message, const gchar *name, glong value);
+void                   iris_message_set_long_q       (IrisMessage *message, GQuark key, glong value);
 
 gulong                 iris_message_get_ulong        (IrisMessage *message, const gchar *name);
+gulong                 iris_message_get_ulong_q      (IrisMessage *message, GQuark key);
 void                   iris_message_set_ulong        (IrisMessage *message, const gchar *name, gulong value);
+void                   iris_message_set_ulong_q      (IrisMessage *message, GQuark key, gulong value);
 
 gchar                  iris_message_get_char         (IrisMessage *message, const gchar *name);
+gchar                  iris_message_get_char_q       (IrisMessage *message, GQuark key);
 void                   iris_message_set_char         (IrisMessage *message, const gchar *name, gchar value);
+void                   iris_message_set_char_q       (IrisMessage *message, GQuark key, gchar value);
 
 guchar                 iris_message_get_uchar        (IrisMessage *message, const gchar *name);
+guchar                 iris_message_get_uchar_q      (IrisMessage *message, GQuark key);
 void                   iris_message_set_uchar        (IrisMessage *message, const gchar *name, guchar value);
+void                   iris_message_set_uchar_q      (IrisMessage *message, GQuark key, guchar value);
 
 gboolean               iris_message_get_boolean      (IrisMessage *message, const gchar *name);
+gboolean               iris_message_get_boolean_q    (IrisMessage *message, GQuark key);
 void                   iris_message_set_boolean      (IrisMessage *message, const gchar *name, gboolean value);
+void                   iris_message_set_boolean_q    (IrisMessage *message, GQuark key, gboolean value);
 
 GObject*               iris_message_get_object       (IrisMessage *message, const gchar *name);
+GObject*               iris_message_get_object_q     (IrisMessage *message, GQuark key);
 void                   iris_message_set_object       (IrisMessage *message, const gchar *name, GObject *object);
+void                   iris_message_set_object_q     (IrisMessage *message, GQuark key, GObject *object);
 
 gpointer               iris_message_get_pointer      (IrisMessage *message, const gchar *name);
+gpointer               iris_message_get_pointer_q    (IrisMessage *message, GQuark key);
 void                   iris_message_set_pointer      (IrisMessage *message, const gchar *name, gpointer pointer);
+void                   iris_message_set_pointer_q    (IrisMessage *message, GQuark key, gpointer pointer);
 void                   iris_message_set_pointer_full (IrisMessage *message, const gchar *name, gpointer pointer, GDestroyNotify destroy_notify);
+void                   iris_message_set_pointer_full_q (IrisMessage *message, GQuark key, gpointer pointer, GDestroyNotify destroy_notify);
 
 
 G_END_DECLS
@@ -23,9 +23,38 @@
 
 #include <glib-object.h>
 
+#include "iris-event-count.h"
 #include "iris-message.h"
 #include "iris-receiver.h"
 
+/* Ring buffer behind a port created with iris_port_new_spsc(). The producer
+ * owns tail, the draining work item owns head, and they live on separate
+ * cache lines. The producer keeps its own copy of head so it only reads the
+ * consumer's line when the ring looks full.
+ */
+#define IRIS_PORT_SPSC_SIZE  256
+#define IRIS_PORT_SPSC_MASK  (IRIS_PORT_SPSC_SIZE - 1)
+#define IRIS_PORT_SPSC_BATCH 32
+
+typedef struct
+{
+	volatile guint  head;
+	gchar           pad1[64 - sizeof (guint)];
+
+	volatile guint  tail;
+	guint           head_cache;
+	gchar           pad2[64 - 2 * sizeof (guint)];
+
+	volatile gint   scheduled;   /* A drain is queued in the scheduler */
+	volatile gint   backlog;     /* Messages queued in the port before the
+	                              * receiver was set go out first */
+	IrisEventCount  not_full;    /* Parks the producer while the ring is
+	                              * full, notified as the drain takes
+	                              * messages out */
+
+	IrisMessage    *ring[IRIS_PORT_SPSC_SIZE];
+} IrisPortSpsc;
+
 struct _IrisPortPrivate
 {
 	/* Queuing: 'current' is the head of the queue, messages in 'queue' follow */
@@ -44,6 +73,10 @@ struct _IrisPortPrivate
 	/* FIXME: would be nice to merge these, and use some g_atomic bitfield operators ... */
 	volatile gint paused;
 	volatile gint flushing;  /* Must be paused while flushing */
+
+	IrisPortSpsc *spsc;      /* Only for ports made with iris_port_new_spsc() */
 };
 
+guint iris_port_spsc_pop (IrisPort *port, IrisMessage **messages, guint n_messages);
+
 #endif /* __IRIS_PORT_PRIVATE_H__ */
@@ -38,6 +38,11 @@
  * different threads. If the order is important, use iris_arbiter_coordinate()
  * to make the receiver <firstterm>exclusive</firstterm>, which guarantees that
  * the messages will be processed one at a time.
+ *
+ * A port that is only ever posted to from one thread can be created with
+ * iris_port_new_spsc() instead. It hands messages to its receiver through a
+ * ring buffer, which is cheaper than an exclusive receiver and also handles
+ * the messages one at a time.
  */
 
 #define PORT_IS_PAUSED(p)   (g_atomic_int_get (&p->priv->paused))
@@ -68,6 +73,12 @@ iris_port_set_receiver_real (IrisPort     *port,
 		}
 
 		if (receiver) {
+			/* The drain must hand out what is already queued before the
+			 * first message that the fast path puts in the ring, so flag it
+			 * before the fast path can see the receiver. */
+			if (priv->spsc && priv->current && iris_receiver_can_batch (receiver))
+				g_atomic_int_set (&priv->spsc->backlog, TRUE);
+
 			priv->receiver = g_object_ref (receiver);
 			flush = TRUE;
 			/* FIXME: Hook current receiver? */
@@ -89,6 +100,7 @@ iris_port_finalize (GObject *object)
 	IrisPort        *port;
 	IrisPortPrivate *priv;
 	IrisMessage     *message;
+	guint            i;
 
 	port = IRIS_PORT (object);
 	priv = port->priv;
@@ -105,6 +117,14 @@ iris_port_finalize (GObject *object)
 		priv->current = NULL;
 	}
 
+	if (priv->spsc != NULL) {
+		for (i = priv->spsc->head; i != priv->spsc->tail; i++)
+			iris_message_unref (priv->spsc->ring[i & IRIS_PORT_SPSC_MASK]);
+		iris_event_count_destroy (&priv->spsc->not_full);
+		g_slice_free (IrisPortSpsc, priv->spsc);
+		priv->spsc = NULL;
+	}
+
 	g_mutex_free (priv->mutex);
 
 	G_OBJECT_CLASS (iris_port_parent_class)->finalize (object);
@@ -148,6 +168,204 @@ iris_port_new (void)
 	return g_object_new (IRIS_TYPE_PORT, NULL);
 }
 
+/**
+ * iris_port_new_spsc:
+ *
+ * Creates a new #IrisPort for use by a single producer thread. Once it is
+ * connected to a receiver created with iris_arbiter_receive() and no
+ * arbiter, posted messages go into a wait-free ring buffer that is drained
+ * in batches by one work item in the receiver's scheduler. The handler is
+ * then called for one message at a time, in the order they were posted,
+ * without the cost of an exclusive receiver.
+ *
+ * Only one thread may post to the port at a time. When the ring is full,
+ * iris_port_post() sleeps until the receiver catches up, so don't post to the
+ * port from the receiver's own handler. Messages posted before the receiver
+ * is connected are queued in the port and handed to the drain ahead of the
+ * ring, so they too are handled one at a time and in order. A receiver that
+ * has an arbiter gets messages through the regular path instead.
+ *
+ * Return value: The newly created #IrisPort
+ */
+IrisPort*
+iris_port_new_spsc (void)
+{
+	IrisPort *port;
+
+	port = g_object_new (IRIS_TYPE_PORT, NULL);
+	port->priv->spsc = g_slice_new0 (IrisPortSpsc);
+	iris_event_count_init (&port->priv->spsc->not_full);
+
+	return port;
+}
+
+/* Makes messages written to the ring visible to the drain and queues one if
+ * none is pending. The add is a full barrier, which the drain relies on
+ * when it clears the scheduled flag and looks at the tail again.
+ */
+static void
+spsc_publish (IrisPort     *port,
+              IrisReceiver *receiver,
+              guint         n_messages)
+{
+	IrisPortSpsc *spsc = port->priv->spsc;
+
+	g_atomic_int_add ((gint *)&spsc->tail, n_messages);
+
+	if (!g_atomic_int_get (&spsc->scheduled) &&
+	    g_atomic_int_compare_and_exchange (&spsc->scheduled, FALSE, TRUE))
+		iris_receiver_queue_drain (receiver, port);
+}
+
+/* Whether messages for @receiver go through the ring of a single producer
+ * port */
+static gboolean
+spsc_active (IrisPort     *port,
+             IrisReceiver *receiver)
+{
+	return port->priv->spsc != NULL && receiver != NULL &&
+	       iris_receiver_can_batch (receiver);
+}
+
+/* Fast path of iris_port_post() for single producer ports */
+static void
+post_spsc (IrisPort      *port,
+           IrisReceiver  *receiver,
+           IrisMessage  **messages,
+           guint          n_messages)
+{
+	IrisPortSpsc *spsc = port->priv->spsc;
+	guint         tail;
+	guint         i;
+	gint          key;
+
+	tail = spsc->tail;
+
+	for (i = 0; i < n_messages; i++) {
+		if (tail - spsc->head_cache == IRIS_PORT_SPSC_SIZE) {
+			spsc->head_cache = g_atomic_int_get ((gint *)&spsc->head);
+
+			if (tail - spsc->head_cache == IRIS_PORT_SPSC_SIZE) {
+				/* Really full; let the drain see what we have so far and
+				 * sleep until it makes room. The head is checked again
+				 * after preparing, so a notify cannot be missed. */
+				spsc_publish (port, receiver, tail - spsc->tail);
+
+				for (;;) {
+					key = iris_event_count_prepare (&spsc->not_full);
+					spsc->head_cache = g_atomic_int_get ((gint *)&spsc->head);
+
+					if (tail - spsc->head_cache != IRIS_PORT_SPSC_SIZE) {
+						iris_event_count_cancel (&spsc->not_full);
+						break;
+					}
+
+					iris_event_count_wait (&spsc->not_full, key, NULL);
+				}
+			}
+		}
+
+		g_atomic_pointer_set (&spsc->ring[tail & IRIS_PORT_SPSC_MASK],
+		                      iris_message_ref_sink (messages[i]));
+		tail++;
+	}
+
+	spsc_publish (port, receiver, tail - spsc->tail);
+}
+
+/* Moves messages queued in the port before the receiver was set into
+ * @messages, clearing the backlog flag once there are none left.
+ */
+static guint
+spsc_pop_backlog (IrisPort     *port,
+                  IrisMessage **messages,
+                  guint         n_messages)
+{
+	IrisPortPrivate *priv = port->priv;
+	guint            i;
+
+	g_mutex_lock (priv->mutex);
+
+	for (i = 0; i < n_messages && priv->current != NULL; i++) {
+		messages[i] = priv->current;
+
+		if (priv->queue != NULL && g_queue_get_length (priv->queue) > 0)
+			priv->current = g_queue_pop_head (priv->queue);
+		else
+			priv->current = NULL;
+	}
+
+	if (priv->current == NULL)
+		g_atomic_int_set (&priv->spsc->backlog, FALSE);
+
+	g_mutex_unlock (priv->mutex);
+
+	return i;
+}
+
+/*
+ * iris_port_spsc_pop:
+ * @port: An #IrisPort created with iris_port_new_spsc()
+ * @messages: Location for up to @n_messages messages
+ * @n_messages: Size of @messages
+ *
+ * Takes the oldest messages out of the ring, along with their references.
+ * Messages that were queued in the port before its receiver was set come
+ * out first. Must only be called by the drain queued by the port. When the
+ * ring is empty the scheduled flag is cleared and 0 is returned, after which
+ * the caller must stop draining.
+ *
+ * Return value: the number of messages stored in @messages
+ */
+guint
+iris_port_spsc_pop (IrisPort     *port,
+                    IrisMessage **messages,
+                    guint         n_messages)
+{
+	IrisPortSpsc *spsc = port->priv->spsc;
+	guint         head, tail;
+	guint         i;
+
+	for (;;) {
+		if (G_UNLIKELY (g_atomic_int_get (&spsc->backlog))) {
+			i = spsc_pop_backlog (port, messages, n_messages);
+			if (i > 0)
+				return i;
+		}
+
+		head = spsc->head;
+		tail = g_atomic_int_get ((gint *)&spsc->tail);
+
+		if (head != tail) {
+			n_messages = MIN (n_messages, tail - head);
+			for (i = 0; i < n_messages; i++)
+				messages[i] = g_atomic_pointer_get (
+					&spsc->ring[(head + i) & IRIS_PORT_SPSC_MASK]);
+
+			/* Hand the slots back before running the batch, and wake
+			 * the producer if it is waiting for them. The add is a full
+			 * barrier, which the producer relies on when it checks the
+			 * head after preparing to wait. */
+			g_atomic_int_add ((gint *)&spsc->head, n_messages);
+			iris_event_count_notify (&spsc->not_full, FALSE);
+
+			return n_messages;
+		}
+
+		/* Empty. The producer only queues a drain when the flag is clear,
+		 * so look again after clearing it in case a message slipped in.
+		 */
+		g_atomic_int_compare_and_exchange (&spsc->scheduled, TRUE, FALSE);
+
+		if (g_atomic_int_get ((gint *)&spsc->tail) == head &&
+		    !g_atomic_int_get (&spsc->backlog))
+			return 0;
+
+		if (!g_atomic_int_compare_and_exchange (&spsc->scheduled, FALSE, TRUE))
+			return 0; /* the producer queued another drain */
+	}
+}
+
 static void
 store_message_at_head_ul (IrisPort    *port, 
                           IrisMessage *message)
@@ -222,6 +440,47 @@ post_with_lock_ul (IrisPort     *port,
 }
 
 
+/* Slow path of iris_port_post(), for when the port is paused or has no
+ * receiver. Must be called with the port lock held.
+ */
+static void
+post_paused_ul (IrisPort     *port,
+                IrisReceiver *receiver,
+                IrisMessage  *message)
+{
+	IrisPortPrivate *priv;
+	gboolean         was_paused;
+
+	priv = port->priv;
+
+	if (!PORT_IS_PAUSED (port) && receiver) {
+		/* Port has reopened since we acquired the mutex. This means that we
+		 * were waiting on a flush or post which has now completed. We must
+		 * deliver before releasing the mutex to preserve message ordering.
+		 */
+		post_with_lock_ul (port, receiver, message, FALSE);
+	}
+	else if (receiver == NULL) {
+		store_message_at_tail_ul (port, message);
+	}
+	else if (priv->current == NULL && !PORT_IS_FLUSHING (port)) {
+		/* Avoid freezing in synchronous schedulers. The port should be
+		 * unpaused when the receiver's last message completes, but if
+		 * the message has triggered another and the scheduler executes
+		 * it straight away we have no other way to unpause than this.
+		 */
+		g_warn_if_fail (priv->queue == NULL || g_queue_get_length (priv->queue) == 0);
+
+		was_paused = g_atomic_int_compare_and_exchange (&priv->paused, TRUE, FALSE);
+		g_warn_if_fail (was_paused);
+
+		post_with_lock_ul (port, receiver, message, FALSE);
+	}
+	else
+		store_message_at_tail_ul (port, message);
+}
+
+
 /**
  * iris_port_post:
  * @port: An #IrisPort
@@ -268,7 +527,6 @@ iris_port_post (IrisPort    *port,
 	IrisPortPrivate    *priv;
 	IrisReceiver       *receiver;
 	IrisDeliveryStatus  delivered;
-	gboolean            was_paused;
 
 	iris_debug (IRIS_DEBUG_PORT);
 
@@ -278,35 +536,25 @@ iris_port_post (IrisPort    *port,
 	priv = port->priv;
 	receiver = g_atomic_pointer_get (&priv->receiver);
 
+	/* Once a single producer port has its receiver every message goes
+	 * through the ring, paused or not, to keep them in order */
+	if (spsc_active (port, receiver)) {
+		post_spsc (port, receiver, &message, 1);
+		return;
+	}
+
 	if (PORT_IS_PAUSED (port) || !receiver) {
 		g_mutex_lock (priv->mutex);
 
-		if (!PORT_IS_PAUSED (port) && receiver) {
-			/* Port has reopened since we acquired the mutex. This means that we
-			 * were waiting on a flush or post which has now completed. We must
-			 * deliver before releasing the mutex to preserve message ordering.
-			 */
-			post_with_lock_ul (port, receiver, message, FALSE);
-		}
-		else if (receiver == NULL) {
-			store_message_at_tail_ul (port, message);
-		}
-		else if (priv->current == NULL && !PORT_IS_FLUSHING (port)) {
-			/* Avoid freezing in synchronous schedulers. The port should be
-			 * unpaused when the receiver's last message completes, but if
-			 * the message has triggered another and the scheduler executes
-			 * it straight away we have no other way to unpause than this.
-			 */
-			g_warn_if_fail (priv->queue == NULL || g_queue_get_length (priv->queue) == 0);
-
-			was_paused = g_atomic_int_compare_and_exchange (&priv->paused, TRUE, FALSE);
-			g_warn_if_fail (was_paused);
-
-			post_with_lock_ul (port, receiver, message, FALSE);
+		/* The receiver may have been set since we looked */
+		if (spsc_active (port, priv->receiver)) {
+			receiver = priv->receiver;
+			g_mutex_unlock (priv->mutex);
+			post_spsc (port, receiver, &message, 1);
+			return;
 		}
-		else
-			store_message_at_tail_ul (port, message);
 
+		post_paused_ul (port, receiver, message);
 		g_mutex_unlock (priv->mutex);
 		return;
 	}
@@ -342,6 +590,103 @@ iris_port_post (IrisPort    *port,
 	}
 }
 
+/**
+ * iris_port_post_many:
+ * @port: An #IrisPort
+ * @messages: An array of #IrisMessage
+ * @n_messages: The number of messages in @messages
+ *
+ * Posts each message in @messages to the port, in order. This behaves like
+ * calling iris_port_post() on each message but is cheaper for bursts: the
+ * port state is checked once, and a receiver without an arbiter queues the
+ * whole batch in its scheduler as a single work item. Such a batch is then
+ * handled by one thread, one message after another.
+ *
+ * The port takes a reference on each message just like iris_port_post().
+ * Messages posted concurrently from other threads may be delivered between
+ * the messages of the batch.
+ */
+void
+iris_port_post_many (IrisPort     *port,
+                     IrisMessage **messages,
+                     guint         n_messages)
+{
+	IrisPortPrivate    *priv;
+	IrisReceiver       *receiver;
+	IrisDeliveryStatus  delivered;
+	guint               n_accepted;
+	guint               i;
+
+	iris_debug (IRIS_DEBUG_PORT);
+
+	g_return_if_fail (IRIS_IS_PORT (port));
+	g_return_if_fail (messages != NULL || n_messages == 0);
+
+	if (n_messages == 0)
+		return;
+
+	priv = port->priv;
+	receiver = g_atomic_pointer_get (&priv->receiver);
+
+	/* Once a single producer port has its receiver every message goes
+	 * through the ring, paused or not, to keep them in order */
+	if (spsc_active (port, receiver)) {
+		post_spsc (port, receiver, messages, n_messages);
+		return;
+	}
+
+	if (PORT_IS_PAUSED (port) || !receiver) {
+		g_mutex_lock (priv->mutex);
+
+		if (spsc_active (port, priv->receiver)) {
+			receiver = priv->receiver;
+			g_mutex_unlock (priv->mutex);
+			post_spsc (port, receiver, messages, n_messages);
+			return;
+		}
+
+		for (i = 0; i < n_messages; i++)
+			post_paused_ul (port, g_atomic_pointer_get (&priv->receiver),
+			                messages[i]);
+		g_mutex_unlock (priv->mutex);
+		return;
+	}
+
+	/* Lock-free like iris_port_post(), see there for the details */
+	delivered = iris_receiver_deliver_many (receiver, messages, n_messages,
+	                                        &n_accepted);
+
+	if (delivered == IRIS_DELIVERY_ACCEPTED_REMOVE)
+		g_atomic_pointer_compare_and_exchange ((gpointer *)&priv->receiver, receiver, NULL);
+
+	if (n_accepted == n_messages)
+		return;
+
+	g_mutex_lock (priv->mutex);
+
+	i = n_accepted;
+
+	switch (delivered) {
+		case IRIS_DELIVERY_ACCEPTED_REMOVE:
+			break;
+		case IRIS_DELIVERY_PAUSE:
+			post_with_lock_ul (port, receiver, messages[i++], FALSE);
+			break;
+		case IRIS_DELIVERY_REMOVE:
+			store_message_at_tail_ul (port, messages[i++]);
+			g_atomic_pointer_compare_and_exchange ((gpointer *)&priv->receiver, receiver, NULL);
+			break;
+		default:
+			g_warn_if_reached ();
+	}
+
+	for (; i < n_messages; i++)
+		post_paused_ul (port, g_atomic_pointer_get (&priv->receiver),
+		                messages[i]);
+
+	g_mutex_unlock (priv->mutex);
+}
+
 /**
  * iris_port_has_receiver:
  * @port: An #IrisPort
@@ -415,6 +760,10 @@ iris_port_get_queue_length (IrisPort *port)
 		queue_count += g_queue_get_length (priv->queue);
 	g_mutex_unlock (priv->mutex);
 
+	if (priv->spsc)
+		queue_count += g_atomic_int_get ((gint *)&priv->spsc->tail) -
+		               g_atomic_int_get ((gint *)&priv->spsc->head);
+
 	return queue_count;
 }
 
@@ -451,6 +800,19 @@ iris_port_resume (IrisPort *port)
 	g_object_ref (port);
 	g_mutex_lock (priv->mutex);
 
+	if (spsc_active (port, receiver)) {
+		/* The drain delivers the backlog ahead of the ring, see
+		 * iris_port_set_receiver_real() */
+		g_atomic_int_set (&priv->paused, FALSE);
+		g_mutex_unlock (priv->mutex);
+
+		if (g_atomic_int_get (&priv->spsc->backlog))
+			spsc_publish (port, receiver, 0);
+
+		g_object_unref (port);
+		return;
+	}
+
 	if (g_atomic_int_get (&priv->flushing)) {
 		/* No need to run the flush if we got here. It is vital that after an
 		 * exclusive receiver's last message is handled the port is flushed so
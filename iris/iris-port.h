@@ -60,8 +60,11 @@ struct _IrisPortClass
 
 GType         iris_port_get_type        (void) G_GNUC_CONST;
 IrisPort*     iris_port_new             (void);
+IrisPort*     iris_port_new_spsc        (void);
 
 void          iris_port_post            (IrisPort *port, IrisMessage *message);
+void          iris_port_post_many       (IrisPort *port, IrisMessage **messages,
+                                         guint n_messages);
 void          iris_port_resume          (IrisPort *port);
 gboolean      iris_port_is_paused       (IrisPort *port);
 
@@ -51,6 +51,15 @@ typedef enum
 	IRIS_PROCESS_MESSAGE_CHAIN_ESTIMATE
 } IrisProcessMessageType;
 
+/* One entry of the reorder buffer: output forwarded while processing a work
+ * item, held until every earlier work item has completed.
+ */
+typedef struct
+{
+	GQueue   outputs;
+	gboolean done;
+} IrisProcessReorderSlot;
+
 struct _IrisProcessPrivate
 {
 	/* Structures for delivery and storage of work items. */
@@ -69,6 +78,74 @@ struct _IrisProcessPrivate
 	              total_items,
 	              estimated_total_items;
 
+	/* Workers running the work function: how many exist (running, scheduled
+	 * or parked), how many are parked waiting for work and how many may
+	 * exist at once. See wake_work_function() in iris-process.c.
+	 */
+	volatile gint n_workers,
+	              n_parked,
+	              max_parallelism;
+
+	/* Set while a periodic timeout sends status updates to watchers, see
+	 * start_status_updates() in iris-process.c.
+	 */
+	volatile gint updating_status;
+	guint         status_timeout_id;
+
+	/* Set while a timeout is pending to post the next output estimate to
+	 * the sink, see iris_process_enqueue().
+	 */
+	volatile gint estimate_pending;
+
+	/* Ordered mode, see iris_process_set_ordered(). Work items are numbered
+	 * as they are enqueued, pushed to work_queue in that order (early
+	 * arrivals wait in intake_pending) and their forwarded output is held in
+	 * reorder_slots until it can be released in order. At most
+	 * reorder_window items can be between next_release and next_pop.
+	 * Released output waits in release_queue until the worker holding the
+	 * 'releasing' token forwards it. Both are protected by reorder_mutex.
+	 */
+	guint                   reorder_window;     /* 0 if not ordered */
+	guint                   reorder_mask;
+	IrisProcessReorderSlot *reorder_slots;
+	GMutex                 *reorder_mutex;
+	volatile gint           next_sequence;
+	gint                    intake_sequence;    /* work receiver only */
+	gint                    next_intake;        /* work receiver only */
+	GHashTable             *intake_pending;     /* work receiver only */
+	volatile gint           next_pop,
+	                        next_release;
+	GQueue                  release_queue;
+	gboolean                releasing;
+
+	/* Backpressure, see iris_process_set_queue_limit(). Producers wait on
+	 * throttle_cond while 'throttled' is set; it is set when the queue
+	 * reaches queue_limit_high and cleared when it drains to queue_limit_low.
+	 * Workers of the source process park instead of waiting, see
+	 * park_on_sink() in iris-process.c; throttle_timer runs from when the
+	 * first of them parked. The statistics and n_parked_producers are
+	 * protected by throttle_mutex.
+	 */
+	volatile gint   queue_limit_high,
+	                queue_limit_low;
+	volatile gint   throttled;
+	GMutex         *throttle_mutex;
+	GCond          *throttle_cond;
+	guint           n_throttled;
+	gdouble         throttled_time;
+	guint           n_parked_producers;
+	GTimer         *throttle_timer;
+
+	/* Non-zero if the work function is an IrisProcessBatchFunc. Only set
+	 * before the process starts.
+	 */
+	guint         max_batch_size;
+
+	/* A spare buffer for batches larger than fit on a worker's stack, see
+	 * take_batch_buffer() in iris-process.c.
+	 */
+	volatile gpointer batch_buffer;
+
 	/* Atomically accessed as a pointer ... */
 	volatile gfloat *output_estimate_factor;
 
@@ -82,7 +159,6 @@ struct _IrisProcessPrivate
 
 	/* Monitoring UI */
 	GList          *watch_port_list;      /* list of watchers */
-	GTimer         *watch_timer;          /* timeouts to throttle status messages */
 };
 
 #endif /* __IRIS_PROCESS_PRIVATE_H__ */
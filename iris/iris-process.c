@@ -20,6 +20,7 @@
 
 #include "iris-debug.h"
 #include "iris-receiver-private.h"
+#include "iris-scheduler-manager-private.h"
 #include "iris-task-private.h"
 #include "iris-process.h"
 #include "iris-process-private.h"
@@ -106,6 +107,23 @@
 /* How frequently the process checks for cancellation between try_pop calls. */
 #define WAKE_UP_INTERVAL  20000
 
+/* Batches of up to this many work items are popped into a buffer on the
+ * worker's stack, larger ones into the process's batch_buffer.
+ */
+#define BATCH_STACK_SIZE 64
+
+/* Default reorder window for ordered processes */
+#define REORDER_WINDOW_DEFAULT 64
+
+/* How often throttled producers check if the process was cancelled */
+#define THROTTLE_CHECK_INTERVAL (G_USEC_PER_SEC / 10)
+
+/* Least time between output estimates sent to the sink, in milliseconds */
+#define OUTPUT_ESTIMATE_INTERVAL 100
+
+/* Time between status messages sent to watchers, in milliseconds */
+#define STATUS_UPDATE_INTERVAL 200
+
 #define FLAG_IS_ON(p,f)  ((IRIS_TASK(p)->priv->flags & f) != 0)
 #define FLAG_IS_OFF(p,f) ((IRIS_TASK(p)->priv->flags & f) == 0)
 #define ENABLE_FLAG(p,f) G_STMT_START{IRIS_TASK(p)->priv->flags|=f;}G_STMT_END
@@ -119,10 +137,34 @@ enum {
 };
 
 static void             post_output_estimate         (IrisProcess *process);
+static void             schedule_output_estimate     (IrisProcess *process);
 
 static void             post_progress_message        (IrisProcess *process,
                                                       IrisMessage *progress_message);
 
+static void             update_status                (IrisProcess *process,
+                                                      gboolean     force);
+
+static void             wake_work_function           (IrisProcess *process,
+                                                      gboolean     all);
+
+static void             iris_process_worker          (IrisProcess *process);
+
+static IrisMessage*     wrap_ordered_work_item       (IrisProcess *process,
+                                                      IrisMessage *work_item);
+
+static gboolean         buffer_ordered_output        (IrisProcess *process,
+                                                      IrisMessage *work_item);
+
+static void             intake_ordered_work_item     (IrisProcess *process,
+                                                      IrisMessage *work_item,
+                                                      gint         sequence);
+
+static void             throttle_producer            (IrisProcess *process);
+
+static void             release_producers            (IrisProcess *process,
+                                                      gboolean     force);
+
 static void             iris_process_dummy           (IrisProcess *task,
                                                       IrisMessage *work_item,
                                                       gpointer user_data);
@@ -178,6 +220,38 @@ iris_process_new_with_closure (GClosure *closure)
 	return process;
 }
 
+/**
+ * iris_process_new_batched:
+ * @func: An #IrisProcessBatchFunc to call for each batch of work items.
+ * @max_batch_size: the largest number of work items to pass to @func at once
+ * @user_data: user data for @func
+ * @notify: An optional #GDestroyNotify or %NULL
+ *
+ * Create a new #IrisProcess instance which processes its work items in
+ * batches. This is useful when each work item is very cheap to process, and
+ * the overhead of calling the work function for each one would dominate. See
+ * iris_process_set_batch_func().
+ *
+ * Return value: the newly created #IrisProcess instance
+ */
+IrisProcess*
+iris_process_new_batched (IrisProcessBatchFunc func,
+                          guint                max_batch_size,
+                          gpointer             user_data,
+                          GDestroyNotify       notify)
+{
+	IrisProcess *process;
+
+	g_return_val_if_fail (func != NULL, NULL);
+	g_return_val_if_fail (max_batch_size > 0, NULL);
+
+	process = g_object_new (IRIS_TYPE_PROCESS, NULL);
+
+	iris_process_set_batch_func (process, func, max_batch_size, user_data, notify);
+
+	return process;
+}
+
 /**
  * iris_process_run:
  * @process: An #IrisProcess
@@ -318,6 +392,10 @@ iris_process_connect (IrisProcess *head,
  *
  * @process must still be open to work items, but may be cancelled - in this
  * case, @work_item will simply be discarded.
+ *
+ * If @process has a queue limit and is running, this function may block until
+ * @process has worked through some of its queue. See
+ * iris_process_set_queue_limit().
  */
 void
 iris_process_enqueue (IrisProcess *process,
@@ -349,6 +427,9 @@ iris_process_enqueue (IrisProcess *process,
 		return;
 	}
 
+	if (g_atomic_int_get (&priv->queue_limit_high) > 0)
+		throttle_producer (process);
+
 	g_atomic_int_inc (&priv->total_items);
 
 	total_items = g_atomic_int_get (&priv->total_items);
@@ -358,14 +439,13 @@ iris_process_enqueue (IrisProcess *process,
 	if (total_items > estimated_total_items)
 		g_atomic_int_set (&priv->estimated_total_items, total_items);
 
+	if (priv->reorder_window > 0)
+		work_item = wrap_ordered_work_item (process, work_item);
+
 	iris_port_post (priv->work_port, work_item);
 
-	/* FIXME: it's bad that we call this function on every queued work item.
-	 * The best way I can think of to avoid this is to implement
-	 * iris_scheduler_queue_timeout() and send the message from a timeout. You
-	 * can see why I haven't done that yet :)
-	 */
-	post_output_estimate (process);
+	if (FLAG_IS_ON (process, IRIS_PROCESS_FLAG_HAS_SINK))
+		schedule_output_estimate (process);
 };
 
 
@@ -381,6 +461,12 @@ iris_process_enqueue (IrisProcess *process,
  *
  * @work_item can be the same message that was passed to the calling work
  * function, and references will be correctly managed.
+ *
+ * Forwarded work items arrive in the sink in the order they are forwarded. If
+ * @process runs its work function in several threads at once (see
+ * iris_process_set_max_parallelism()), that need not be the order in which
+ * they were enqueued in @process, unless @process is ordered (see
+ * iris_process_set_ordered()).
  */
 void
 iris_process_forward (IrisProcess *process,
@@ -408,6 +494,10 @@ iris_process_forward (IrisProcess *process,
 		return;
 	}
 
+	/* In ordered mode, hold the output back until it's its turn */
+	if (priv->reorder_window > 0 && buffer_ordered_output (process, work_item))
+		return;
+
 	iris_process_enqueue (priv->sink, work_item);
 }
 
@@ -444,6 +534,9 @@ iris_process_recurse (IrisProcess *process,
 	/* 'process' cannot now finish until this new item is completed */
 	g_atomic_int_inc (&priv->total_items);
 
+	if (priv->reorder_window > 0)
+		work_item = wrap_ordered_work_item (process, work_item);
+
 	iris_port_post (priv->work_port, work_item);
 }
 
@@ -454,7 +547,7 @@ iris_process_recurse (IrisProcess *process,
  * Causes @process to stop accepting new work items. It will finish up its
  * remaining work and then destroy itself, unless it was cancelled in which case
  * it will finish immediately. If this function is never called, @process will
- * stay around idling and using a substantial amount of CPU cycles forever.
+ * stay around idling forever, holding on to its execution reference.
  *
  * If @process has a sink process connected, closure will be propagated down so
  * that the sink will complete once @process has done so. iris_process_close()
@@ -790,6 +883,44 @@ iris_process_set_closure (IrisProcess *process,
 		g_closure_unref (IRIS_TASK(process)->priv->closure);
 
 	IRIS_TASK(process)->priv->closure = g_closure_ref (closure);
+	process->priv->max_batch_size = 0;
+}
+
+/**
+ * iris_process_set_batch_func:
+ * @process: An #IrisProcess
+ * @func: An #IrisProcessBatchFunc
+ * @max_batch_size: the largest number of work items to pass to @func at once
+ * @user_data: user data for @func
+ * @notify: An optional #GDestroyNotify or %NULL
+ *
+ * Sets the work function of @process to @func, which will be passed up to
+ * @max_batch_size work items per call. The batch size adapts to the number of
+ * items waiting in the queue. This function cannot be called after
+ * iris_process_run() or iris_process_cancel().
+ */
+void
+iris_process_set_batch_func (IrisProcess          *process,
+                             IrisProcessBatchFunc  func,
+                             guint                 max_batch_size,
+                             gpointer              user_data,
+                             GDestroyNotify        notify)
+{
+	GClosure *closure;
+
+	g_return_if_fail (IRIS_IS_PROCESS (process));
+	g_return_if_fail (func != NULL);
+	g_return_if_fail (max_batch_size > 0);
+	g_return_if_fail (FLAG_IS_OFF (process, IRIS_TASK_FLAG_STARTED));
+
+	/* The closure is never invoked, it just holds @user_data and @notify */
+	closure = g_cclosure_new (G_CALLBACK (func),
+	                          user_data,
+	                          (GClosureNotify)notify);
+	iris_process_set_closure (process, closure);
+	g_closure_unref (closure);
+
+	process->priv->max_batch_size = max_batch_size;
 }
 
 /**
@@ -886,6 +1017,196 @@ iris_process_set_output_estimation (IrisProcess *process,
 	post_output_estimate (process);
 }
 
+/**
+ * iris_process_set_max_parallelism:
+ * @process: An #IrisProcess
+ * @max_parallelism: the largest number of threads that may run the work
+ *                   function of @process at the same time
+ *
+ * By default, an #IrisProcess runs its work function in one thread at a time.
+ * Setting @max_parallelism to more than one allows that many threads from the
+ * work scheduler to process work items from @process concurrently, which is
+ * useful for CPU-bound work. Your work function must be MT-safe if you do
+ * this. Extra threads are only used while there is enough work to keep them
+ * busy.
+ *
+ * When @max_parallelism is more than one, work items may complete in any
+ * order even if they were enqueued before the process started running. In
+ * particular, work forwarded to a sink using iris_process_forward() will not
+ * arrive in the order it was enqueued.
+ *
+ * This function may be called at any time, but lowering the value will not
+ * stop threads that are already running.
+ */
+void
+iris_process_set_max_parallelism (IrisProcess *process,
+                                  guint        max_parallelism)
+{
+	g_return_if_fail (IRIS_IS_PROCESS (process));
+	g_return_if_fail (max_parallelism > 0);
+
+	g_atomic_int_set (&process->priv->max_parallelism, max_parallelism);
+}
+
+/**
+ * iris_process_get_max_parallelism:
+ * @process: An #IrisProcess
+ *
+ * See iris_process_set_max_parallelism().
+ *
+ * Return value: the largest number of threads that may run the work function
+ *   of @process at the same time.
+ */
+guint
+iris_process_get_max_parallelism (IrisProcess *process)
+{
+	g_return_val_if_fail (IRIS_IS_PROCESS (process), 1);
+
+	return g_atomic_int_get (&process->priv->max_parallelism);
+}
+
+/**
+ * iris_process_set_queue_limit:
+ * @process: An #IrisProcess
+ * @high_watermark: the queue length at which producers are throttled, or 0
+ *                  for no limit
+ * @low_watermark: the queue length at which throttled producers may continue
+ *
+ * Limits how much work can build up in the queue of @process. Once @process
+ * is running and has @high_watermark items that have been enqueued but not
+ * completed, calls to iris_process_enqueue() block until the queue has
+ * drained to @low_watermark. This stops a fast source process from flooding a
+ * slow sink with work items and using up memory. Work enqueued before
+ * @process is run is never throttled, and cancelling @process releases any
+ * waiting producers.
+ *
+ * The workers of a source process are not blocked, since they may hold the
+ * scheduler threads that @process needs to drain its queue. A worker
+ * finishes the work item it is on, forwarding its output even past the
+ * limit, and then parks without a thread until @process has drained.
+ *
+ * The time producers spend held back can be read using
+ * iris_process_get_throttle_stats().
+ */
+void
+iris_process_set_queue_limit (IrisProcess *process,
+                              guint        high_watermark,
+                              guint        low_watermark)
+{
+	IrisProcessPrivate *priv;
+
+	g_return_if_fail (IRIS_IS_PROCESS (process));
+	g_return_if_fail (low_watermark <= high_watermark);
+
+	priv = process->priv;
+
+	g_atomic_int_set (&priv->queue_limit_low, low_watermark);
+	g_atomic_int_set (&priv->queue_limit_high, high_watermark);
+
+	/* The new limits may let blocked producers continue */
+	release_producers (process, high_watermark == 0);
+}
+
+/**
+ * iris_process_get_throttle_stats:
+ * @process: An #IrisProcess
+ * @p_n_throttled: return location for the number of times a producer was
+ *                 throttled, or %NULL
+ * @p_throttled_time: return location for the total time in seconds that
+ *                    producers have spent throttled, or %NULL. Time during
+ *                    which several workers of the source process were
+ *                    parked counts once.
+ *
+ * Returns statistics about how often the queue limit of @process has stopped
+ * other threads and processes from enqueuing work. See
+ * iris_process_set_queue_limit().
+ */
+void
+iris_process_get_throttle_stats (IrisProcess *process,
+                                 guint       *p_n_throttled,
+                                 gdouble     *p_throttled_time)
+{
+	IrisProcessPrivate *priv;
+
+	g_return_if_fail (IRIS_IS_PROCESS (process));
+
+	priv = process->priv;
+
+	g_mutex_lock (priv->throttle_mutex);
+
+	if (p_n_throttled != NULL)
+		*p_n_throttled = priv->n_throttled;
+	if (p_throttled_time != NULL)
+		*p_throttled_time = priv->throttled_time;
+
+	g_mutex_unlock (priv->throttle_mutex);
+}
+
+/**
+ * iris_process_set_ordered:
+ * @process: An #IrisProcess
+ * @ordered: %TRUE to forward work in the order it was enqueued
+ * @window_size: the largest number of work items that may be in progress or
+ *               waiting to be forwarded at once, or 0 for a default
+ *
+ * When @process runs in several threads (see
+ * iris_process_set_max_parallelism()), its work items can complete in any
+ * order. Setting @ordered makes @process hold back anything passed to
+ * iris_process_forward() while processing a work item until every work item
+ * enqueued before it has completed, so the sink sees output in the order that
+ * the input was enqueued.
+ *
+ * At most @window_size work items will be started before the oldest one
+ * completes. A larger window lets @process keep more threads busy when work
+ * items take uneven amounts of time, at the cost of buffering more output.
+ *
+ * A batched process (see iris_process_new_batched()) is passed one work item
+ * at a time when ordered. This function cannot be called after
+ * iris_process_run() or iris_process_cancel().
+ */
+void
+iris_process_set_ordered (IrisProcess *process,
+                          gboolean     ordered,
+                          guint        window_size)
+{
+	IrisProcessPrivate *priv;
+	guint               n_slots;
+
+	g_return_if_fail (IRIS_IS_PROCESS (process));
+	g_return_if_fail (FLAG_IS_OFF (process, IRIS_TASK_FLAG_STARTED));
+	g_return_if_fail (g_atomic_int_get (&process->priv->total_items) == 0);
+
+	priv = process->priv;
+
+	if (priv->reorder_window > 0) {
+		g_free (priv->reorder_slots);
+		priv->reorder_slots = NULL;
+		priv->reorder_window = 0;
+	}
+
+	if (!ordered)
+		return;
+
+	if (window_size == 0)
+		window_size = REORDER_WINDOW_DEFAULT;
+
+	/* A power of two keeps the slot index right if the sequence wraps */
+	n_slots = 1;
+	while (n_slots < window_size)
+		n_slots <<= 1;
+
+	priv->reorder_slots = g_new0 (IrisProcessReorderSlot, n_slots);
+	priv->reorder_mask = n_slots - 1;
+	priv->reorder_window = window_size;
+
+	if (priv->reorder_mutex == NULL)
+		priv->reorder_mutex = g_mutex_new ();
+	if (priv->intake_pending == NULL)
+		priv->intake_pending = g_hash_table_new_full
+		                         (g_direct_hash, g_direct_equal, NULL,
+		                          (GDestroyNotify)iris_message_unref);
+}
+
 
 /**
  * iris_process_add_watch:
@@ -918,6 +1239,144 @@ iris_process_add_watch (IrisProcess               *process,
  *                      IrisProcess Internal Helpers                      *
  *************************************************************************/
 
+/* Workers park themselves when they run out of work instead of re-queueing
+ * themselves in the scheduler (see iris_process_worker()). Each parked worker
+ * leaves a token in n_parked; whoever takes a token must schedule a worker to
+ * replace it. Returns %TRUE if a token was taken.
+ */
+static gboolean
+take_parked_worker (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+	gint                n_parked;
+
+	priv = process->priv;
+
+	/* The compare-and-exchange is a full barrier, which a plain read is not
+	 * on every platform. We must not miss a worker that parked just after
+	 * we changed the state it was checking.
+	 */
+	if (g_atomic_int_compare_and_exchange (&priv->n_parked, 0, 0))
+		return FALSE;
+
+	do {
+		n_parked = g_atomic_int_get (&priv->n_parked);
+		if (n_parked == 0)
+			return FALSE;
+	} while (!g_atomic_int_compare_and_exchange (&priv->n_parked,
+	                                             n_parked, n_parked - 1));
+
+	return TRUE;
+}
+
+/* Adds a new worker if the process is executing and below its limit */
+static gboolean
+add_worker (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+	gint                n_workers,
+	                    max_parallelism;
+
+	priv = process->priv;
+	max_parallelism = g_atomic_int_get (&priv->max_parallelism);
+
+	/* More threads than processors cannot make CPU-bound work go faster */
+	if (IRIS_TASK (process)->priv->performance_hint == IRIS_CPU_BOUND)
+		max_parallelism = MIN (max_parallelism, iris_scheduler_get_n_cpu ());
+
+	do {
+		n_workers = g_atomic_int_get (&priv->n_workers);
+
+		/* n_workers is 0 before execution starts and after it finishes */
+		if (n_workers == 0 || n_workers >= max_parallelism)
+			return FALSE;
+	} while (!g_atomic_int_compare_and_exchange (&priv->n_workers,
+	                                             n_workers, n_workers + 1));
+
+	return TRUE;
+}
+
+static void
+schedule_worker (IrisProcess *process)
+{
+	IrisTaskPrivate *task_priv = IRIS_TASK (process)->priv;
+
+	iris_scheduler_manager_queue_hinted (g_atomic_pointer_get (&task_priv->work_scheduler),
+	                                     task_priv->performance_hint,
+	                                     (IrisCallback)iris_process_worker,
+	                                     process);
+}
+
+/* Anything that could let a parked worker make progress must call this
+ * afterwards. A new work item needs only one worker, which may be a new one
+ * if the process can run in parallel. Closing or cancelling the process must
+ * wake every worker, so @all should be %TRUE. It is MT-safe.
+ */
+static void
+wake_work_function (IrisProcess *process,
+                    gboolean     all)
+{
+	if (all) {
+		while (take_parked_worker (process))
+			schedule_worker (process);
+	}
+	else
+	if (take_parked_worker (process) || add_worker (process))
+		schedule_worker (process);
+}
+
+static void
+update_status_cb (gpointer data)
+{
+	IrisProcess        *process = data;
+	IrisProcessPrivate *priv = process->priv;
+
+	/* Nothing can have changed while every worker is parked */
+	if (g_atomic_int_get (&priv->n_parked) < g_atomic_int_get (&priv->n_workers))
+		update_status (process, FALSE);
+}
+
+/* Watchers get a status message every STATUS_UPDATE_INTERVAL from a
+ * periodic timeout while the work function runs, rather than the workers
+ * checking the time between work items. The first worker to see a watcher
+ * starts the timeout and the last one out stops it in
+ * stop_status_updates().
+ */
+static void
+start_status_updates (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (!g_atomic_int_compare_and_exchange (&priv->updating_status, FALSE, TRUE))
+		return;
+
+	priv->status_timeout_id =
+	  iris_scheduler_queue_periodic (IRIS_TASK (process)->priv->control_scheduler,
+	                                 STATUS_UPDATE_INTERVAL,
+	                                 update_status_cb,
+	                                 g_object_ref (process),
+	                                 g_object_unref);
+}
+
+/* Only called by the last worker to exit, so start_status_updates() has
+ * finished setting status_timeout_id.
+ */
+static void
+stop_status_updates (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (!g_atomic_int_compare_and_exchange (&priv->updating_status, TRUE, FALSE))
+		return;
+
+	iris_scheduler_remove_timeout (priv->status_timeout_id);
+	priv->status_timeout_id = 0;
+}
+
 /* This must be MT-safe, it's called from iris_process_enqueue() */
 static void
 post_output_estimate (IrisProcess *process)
@@ -956,6 +1415,39 @@ post_output_estimate (IrisProcess *process)
 	iris_port_post (IRIS_TASK (sink)->priv->port, message);
 }
 
+static void
+post_output_estimate_cb (gpointer data)
+{
+	IrisProcess *process = data;
+
+	g_atomic_int_set (&process->priv->estimate_pending, FALSE);
+	post_output_estimate (process);
+}
+
+/* Estimates are posted as work is enqueued, but at most once every
+ * OUTPUT_ESTIMATE_INTERVAL: the first enqueue posts one straight away and
+ * any after it are covered by a timeout. The final estimate is posted when
+ * the process closes.
+ */
+static void
+schedule_output_estimate (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (!g_atomic_int_compare_and_exchange (&priv->estimate_pending, FALSE, TRUE))
+		return;
+
+	post_output_estimate (process);
+
+	iris_scheduler_queue_timeout (IRIS_TASK (process)->priv->control_scheduler,
+	                              OUTPUT_ESTIMATE_INTERVAL,
+	                              post_output_estimate_cb,
+	                              g_object_ref (process),
+	                              g_object_unref);
+}
+
 static void
 post_progress_message (IrisProcess *process,
                        IrisMessage *progress_message)
@@ -1184,6 +1676,12 @@ handle_start_cancel (IrisProcess *process,
 		iris_port_post (IRIS_TASK (priv->sink)->priv->port, out_message);
 	}
 
+	/* Parked workers need to notice the cancel and exit, and anyone waiting
+	 * to enqueue work can give up.
+	 */
+	wake_work_function (process, TRUE);
+	release_producers (process, TRUE);
+
 	iris_task_notify_observers (IRIS_TASK (process));
 }
 
@@ -1277,6 +1775,10 @@ handle_dep_finished (IrisProcess *process,
 		g_warn_if_fail (FLAG_IS_OFF (process, IRIS_TASK_FLAG_FINISHED));
 
 		DISABLE_FLAG (process, IRIS_PROCESS_FLAG_OPEN);
+		wake_work_function (process, TRUE);
+
+		/* No more work is coming, so don't wait for the timeout */
+		post_output_estimate (process);
 
 		if (FLAG_IS_ON (process, IRIS_TASK_FLAG_CANCELLED) &&
 		    FLAG_IS_OFF (process, IRIS_TASK_FLAG_WORK_ACTIVE)) {
@@ -1345,6 +1847,10 @@ handle_close (IrisProcess *process,
 	g_return_if_fail (FLAG_IS_OFF (process, IRIS_PROCESS_FLAG_HAS_SOURCE));
 
 	DISABLE_FLAG (process, IRIS_PROCESS_FLAG_OPEN);
+	wake_work_function (process, TRUE);
+
+	/* No more work is coming, so don't wait for the timeout */
+	post_output_estimate (process);
 
 	if (FLAG_IS_ON (process, IRIS_TASK_FLAG_CANCELLED)) {
 		if (FLAG_IS_ON (process, IRIS_TASK_FLAG_WORK_ACTIVE));
@@ -1647,7 +2153,13 @@ iris_task_post_work_item_real (IrisProcess *process,
 	 */
 	if (FLAG_IS_OFF (process, IRIS_TASK_FLAG_CANCELLED)) {
 		iris_message_ref (work_item);
-		iris_queue_push (priv->work_queue, work_item);
+
+		if (priv->reorder_window > 0)
+			intake_ordered_work_item (process, work_item, priv->intake_sequence);
+		else
+			iris_queue_push (priv->work_queue, work_item);
+
+		wake_work_function (process, FALSE);
 	}
 
 	/* total_items and estimated_total_items are updated in iris_process_enqueue() */
@@ -1666,6 +2178,16 @@ iris_process_post_work_item (IrisMessage *work_item,
 	g_return_if_fail (IRIS_IS_PROCESS (data));
 
 	process = IRIS_PROCESS (data);
+
+	/* In ordered mode the work item comes wrapped with its sequence number,
+	 * see wrap_ordered_work_item(). The work receiver is exclusive, so the
+	 * sequence can be passed on in the process.
+	 */
+	if (process->priv->reorder_window > 0) {
+		process->priv->intake_sequence = work_item->what;
+		work_item = g_value_get_boxed (iris_message_get_data (work_item));
+	}
+
 	IRIS_PROCESS_GET_CLASS (process)->post_work_item (process, work_item);
 }
 
@@ -1686,22 +2208,503 @@ work_function_can_finish (IrisProcess *process)
 	return TRUE;
 }
 
+/* Pops up to @max_items work items into @work_items. The batch grows with the
+ * depth of the queue so that a busy process amortises the per-call overhead,
+ * while a trickle of work is still handled one item at a time without waiting
+ * for a batch to fill.
+ */
+static guint
+pop_work_items (IrisProcess  *process,
+                IrisMessage **work_items,
+                guint         max_items)
+{
+	IrisQueue *work_queue;
+	guint      n_wanted,
+	           n_items;
+
+	work_queue = process->priv->work_queue;
+
+	if (max_items == 1) {
+		work_items[0] = iris_queue_try_pop (work_queue);
+		return work_items[0] != NULL ? 1 : 0;
+	}
+
+	n_wanted = CLAMP (iris_queue_get_length (work_queue), 1, max_items);
+
+	for (n_items = 0; n_items < n_wanted; n_items++) {
+		work_items[n_items] = iris_queue_try_pop (work_queue);
+		if (work_items[n_items] == NULL)
+			break;
+	}
+
+	return n_items;
+}
+
+/* Takes the spare buffer for batches too big for the stack, or allocates one
+ * if another worker has it.
+ */
+static IrisMessage**
+take_batch_buffer (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+	gpointer            buffer;
+
+	priv = process->priv;
+
+	do {
+		buffer = g_atomic_pointer_get (&priv->batch_buffer);
+		if (buffer == NULL)
+			return g_new (IrisMessage *, priv->max_batch_size);
+	} while (!g_atomic_pointer_compare_and_exchange (&priv->batch_buffer,
+	                                                 buffer, NULL));
+
+	return buffer;
+}
 
 static void
-iris_process_execute_real (IrisTask *task)
+return_batch_buffer (IrisProcess  *process,
+                     IrisMessage **buffer)
+{
+	if (!g_atomic_pointer_compare_and_exchange (&process->priv->batch_buffer,
+	                                            NULL, buffer))
+		g_free (buffer);
+}
+
+/* Ordered mode. There is an item on a worker thread's stack for the work
+ * item it is processing, so iris_process_forward() can find its slot.
+ */
+typedef struct
+{
+	IrisProcess *process;
+	gint         sequence;
+} IrisProcessCurrentItem;
+
+static GStaticPrivate current_item = G_STATIC_PRIVATE_INIT;
+
+/* The process whose worker is running on this thread, if any, so that
+ * throttle_producer() can tell a source's workers from other producers.
+ */
+static GStaticPrivate current_worker = G_STATIC_PRIVATE_INIT;
+
+/* Called from iris_process_enqueue() and iris_process_recurse(). Numbers
+ * @work_item by wrapping it in a message of our own, so the number is never
+ * seen by the work function or the sink and the same work item can be
+ * enqueued to several ordered processes.
+ */
+static IrisMessage*
+wrap_ordered_work_item (IrisProcess *process,
+                        IrisMessage *work_item)
+{
+	IrisMessage *wrapper;
+	GValue       value = {0,};
+	gint         sequence;
+
+	sequence = g_atomic_int_exchange_and_add (&process->priv->next_sequence, 1);
+	wrapper = iris_message_new (sequence);
+
+	g_value_init (&value, IRIS_TYPE_MESSAGE);
+	g_value_take_boxed (&value, iris_message_ref_sink (work_item));
+	iris_message_set_data (wrapper, &value);
+	g_value_unset (&value);
+
+	return wrapper;
+}
+
+/* Work items can reach the work receiver out of order if they were enqueued
+ * from different threads, so hold on to early ones until the gap is filled.
+ * The work receiver is exclusive, so this needs no locking.
+ */
+static void
+intake_ordered_work_item (IrisProcess *process,
+                          IrisMessage *work_item,
+                          gint         sequence)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (sequence != priv->next_intake) {
+		g_hash_table_insert (priv->intake_pending,
+		                     GINT_TO_POINTER (sequence), work_item);
+		return;
+	}
+
+	do {
+		iris_queue_push (priv->work_queue, work_item);
+		priv->next_intake ++;
+
+		work_item = g_hash_table_lookup (priv->intake_pending,
+		                                 GINT_TO_POINTER (priv->next_intake));
+		if (work_item != NULL)
+			g_hash_table_steal (priv->intake_pending,
+			                    GINT_TO_POINTER (priv->next_intake));
+	} while (work_item != NULL);
+}
+
+static gboolean
+reorder_window_full (IrisProcessPrivate *priv)
+{
+	return (guint)(g_atomic_int_get (&priv->next_pop) -
+	               g_atomic_int_get (&priv->next_release)) >= priv->reorder_window;
+}
+
+/* work_queue is in sequence order, so the item we pop is always next_pop */
+static guint
+pop_ordered_work_item (IrisProcess  *process,
+                       IrisMessage **p_work_item,
+                       gint         *p_sequence)
+{
+	IrisProcessPrivate *priv;
+	guint               n_items = 0;
+
+	priv = process->priv;
+
+	g_mutex_lock (priv->reorder_mutex);
+
+	if (!reorder_window_full (priv)) {
+		*p_work_item = iris_queue_try_pop (priv->work_queue);
+
+		if (*p_work_item != NULL) {
+			*p_sequence = priv->next_pop;
+			g_atomic_int_inc (&priv->next_pop);
+			n_items = 1;
+		}
+	}
+
+	g_mutex_unlock (priv->reorder_mutex);
+
+	return n_items;
+}
+
+/* Marks @sequence as done and forwards everything that is now in order */
+static void
+complete_ordered_item (IrisProcess *process,
+                       gint         sequence)
+{
+	IrisProcessPrivate     *priv;
+	IrisProcessReorderSlot *slot;
+	IrisMessage            *output;
+	GQueue                  outputs = G_QUEUE_INIT;
+	gboolean                released = FALSE,
+	                        releasing = FALSE;
+
+	priv = process->priv;
+
+	g_mutex_lock (priv->reorder_mutex);
+
+	priv->reorder_slots[sequence & priv->reorder_mask].done = TRUE;
+
+	while (1) {
+		slot = &priv->reorder_slots[priv->next_release & priv->reorder_mask];
+
+		if (!slot->done)
+			break;
+
+		while ((output = g_queue_pop_head (&slot->outputs)) != NULL)
+			g_queue_push_tail (&priv->release_queue, output);
+
+		slot->done = FALSE;
+		g_atomic_int_inc (&priv->next_release);
+		released = TRUE;
+	}
+
+	/* Only the holder of the release token forwards, so the output of
+	 * different workers can't interleave.
+	 */
+	if (!priv->releasing && priv->release_queue.length > 0)
+		priv->releasing = releasing = TRUE;
+
+	g_mutex_unlock (priv->reorder_mutex);
+
+	/* Workers may be parked on the window */
+	if (released)
+		wake_work_function (process, TRUE);
+
+	/* Forward without the lock, since the sink may throttle us, and carry on
+	 * with anything other workers released in the meantime.
+	 */
+	while (releasing) {
+		g_mutex_lock (priv->reorder_mutex);
+
+		outputs = priv->release_queue;
+		g_queue_init (&priv->release_queue);
+
+		if (outputs.length == 0)
+			priv->releasing = releasing = FALSE;
+
+		g_mutex_unlock (priv->reorder_mutex);
+
+		while ((output = g_queue_pop_head (&outputs)) != NULL) {
+			if (FLAG_IS_OFF (process, IRIS_TASK_FLAG_CANCELLED))
+				iris_process_enqueue (priv->sink, output);
+			iris_message_unref (output);
+		}
+	}
+}
+
+static gboolean
+buffer_ordered_output (IrisProcess *process,
+                       IrisMessage *work_item)
+{
+	IrisProcessPrivate     *priv;
+	IrisProcessCurrentItem *current;
+
+	priv = process->priv;
+	current = g_static_private_get (&current_item);
+
+	/* Not called from our work function, so there's nothing to order by */
+	if (current == NULL || current->process != process)
+		return FALSE;
+
+	iris_message_ref_sink (work_item);
+
+	g_mutex_lock (priv->reorder_mutex);
+	g_queue_push_tail (&priv->reorder_slots[current->sequence & priv->reorder_mask].outputs,
+	                   work_item);
+	g_mutex_unlock (priv->reorder_mutex);
+
+	return TRUE;
+}
+
+/* Whether a worker could pop a work item right now */
+static gboolean
+have_work (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (iris_queue_get_length (priv->work_queue) == 0)
+		return FALSE;
+
+	if (priv->reorder_window > 0 && reorder_window_full (priv))
+		return FALSE;
+
+	return TRUE;
+}
+
+/* Sets 'throttled' once @process has reached its high watermark. Returns
+ * %TRUE if producers must hold back.
+ */
+static gboolean
+check_throttle (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (g_atomic_int_get (&priv->throttled))
+		return TRUE;
+
+	if (iris_process_get_queue_length (process) <
+	    g_atomic_int_get (&priv->queue_limit_high))
+		return FALSE;
+
+	g_atomic_int_set (&priv->throttled, TRUE);
+	return TRUE;
+}
+
+/* Clears 'throttled' and lets waiting producers go. Called with
+ * throttle_mutex held; the caller must then wake the source's workers with
+ * wake_source().
+ */
+static void
+unthrottle_ul (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	g_atomic_int_set (&priv->throttled, FALSE);
+	g_cond_broadcast (priv->throttle_cond);
+
+	if (priv->n_parked_producers > 0) {
+		priv->throttled_time += g_timer_elapsed (priv->throttle_timer, NULL);
+		priv->n_parked_producers = 0;
+	}
+}
+
+/* Reschedules the source workers that parked on @process */
+static void
+wake_source (IrisProcess *process)
+{
+	IrisProcess *source;
+
+	source = g_atomic_pointer_get (&process->priv->source);
+
+	if (source != NULL)
+		wake_work_function (source, TRUE);
+}
+
+/* Called from iris_process_enqueue(), in the producer's thread. Waits while
+ * @process is over its queue limit. A worker of the source process must not
+ * tie up a scheduler thread that the sink may need, so it returns at once and
+ * the worker parks before taking its next work item, see park_on_sink().
+ */
+static void
+throttle_producer (IrisProcess *process)
+{
+	IrisProcessPrivate *priv;
+	GTimeVal            timeout;
+	GTimer             *timer = NULL;
+	gboolean            released = FALSE;
+
+	priv = process->priv;
+
+	/* Not running yet, so nothing would ever release us */
+	if (FLAG_IS_OFF (process, IRIS_TASK_FLAG_WORK_ACTIVE))
+		return;
+
+	if (!check_throttle (process))
+		return;
+
+	if (priv->source != NULL &&
+	    g_static_private_get (&current_worker) == priv->source)
+		return;
+
+	/* On one of our threads, let the scheduler go on with other work while
+	 * we wait, since that may be what drains the queue
+	 */
+	iris_thread_enter_blocking ();
+
+	g_mutex_lock (priv->throttle_mutex);
+
+	while (g_atomic_int_get (&priv->throttled) &&
+	       FLAG_IS_OFF (process, IRIS_TASK_FLAG_CANCELLED) &&
+	       FLAG_IS_ON (process, IRIS_TASK_FLAG_WORK_ACTIVE)) {
+		/* The workers may have drained the queue before they could see
+		 * 'throttled', in which case nobody else will release us. Checking
+		 * under the mutex means release_producers() can't slip in between
+		 * this and the wait.
+		 */
+		if (iris_process_get_queue_length (process) <=
+		    g_atomic_int_get (&priv->queue_limit_low)) {
+			unthrottle_ul (process);
+			released = TRUE;
+			break;
+		}
+
+		if (timer == NULL)
+			timer = g_timer_new ();
+
+		g_get_current_time (&timeout);
+		g_time_val_add (&timeout, THROTTLE_CHECK_INTERVAL);
+		g_cond_timed_wait (priv->throttle_cond, priv->throttle_mutex, &timeout);
+	}
+
+	/* Only count the times we really waited */
+	if (timer != NULL) {
+		priv->n_throttled ++;
+		priv->throttled_time += g_timer_elapsed (timer, NULL);
+	}
+
+	g_mutex_unlock (priv->throttle_mutex);
+
+	iris_thread_leave_blocking ();
+
+	if (timer != NULL)
+		g_timer_destroy (timer);
+
+	if (released)
+		wake_source (process);
+}
+
+/* Lets throttled producers continue once the queue has drained to the low
+ * watermark, or straight away if @force is set.
+ */
+static void
+release_producers (IrisProcess *process,
+                   gboolean     force)
+{
+	IrisProcessPrivate *priv;
+
+	priv = process->priv;
+
+	if (!g_atomic_int_get (&priv->throttled))
+		return;
+
+	if (!force && iris_process_get_queue_length (process) >
+	              g_atomic_int_get (&priv->queue_limit_low))
+		return;
+
+	g_mutex_lock (priv->throttle_mutex);
+	unthrottle_ul (process);
+	g_mutex_unlock (priv->throttle_mutex);
+
+	wake_source (process);
+}
+
+/* Called by a worker of @process before it takes a work item while its sink
+ * is throttled. Parks the worker the same way as when it runs out of work,
+ * so that it doesn't hold a scheduler thread while the sink catches up;
+ * release_producers() reschedules it. Returns %TRUE if the worker parked and
+ * must return.
+ */
+static gboolean
+park_on_sink (IrisProcess *process,
+              IrisProcess *sink)
+{
+	IrisProcessPrivate *priv,
+	                   *sink_priv;
+
+	priv = process->priv;
+	sink_priv = sink->priv;
+
+	g_atomic_int_inc (&priv->n_parked);
+
+	/* As in throttle_producer(), the sink may have drained before it could
+	 * see 'throttled'. Having published our token first, either we see the
+	 * release here or the releaser sees the token.
+	 */
+	release_producers (sink, FALSE);
+
+	if (g_atomic_int_get (&sink_priv->throttled) &&
+	    FLAG_IS_OFF (process, IRIS_TASK_FLAG_CANCELLED)) {
+		g_mutex_lock (sink_priv->throttle_mutex);
+		if (g_atomic_int_get (&sink_priv->throttled)) {
+			if (sink_priv->n_parked_producers++ == 0)
+				g_timer_start (sink_priv->throttle_timer);
+			sink_priv->n_throttled ++;
+		}
+		g_mutex_unlock (sink_priv->throttle_mutex);
+
+		return TRUE;
+	}
+
+	/* If a waker beat us to the token it has rescheduled a worker in our
+	 * place already
+	 */
+	return !take_parked_worker (process);
+}
+
+
+/* Runs the work function for as long as there is work to do. With a
+ * max_parallelism of more than one, several of these can be running on the
+ * same process at once; the last one to exit handles completion.
+ */
+static void
+iris_process_worker (IrisProcess *process)
 {
 	GValue    params[2] = { {0,}, {0,} };
 	gboolean  cancelled,
 	          send_finish_cancel;
 	GTimer   *timer;
-	IrisProcess        *process;
+	IrisTask           *task;
 	IrisProcessPrivate *priv;
-	IrisScheduler      *work_scheduler;
 	IrisMessage        *message;
+	IrisMessage        *stack_items[BATCH_STACK_SIZE],
+	                  **work_items;
+	IrisProcessBatchFunc batch_func;
+	IrisProcessCurrentItem current;
+	IrisProcess        *sink,
+	                   *outer_worker;
+	guint               max_batch_size,
+	                    n_items,
+	                    i;
 
-	g_return_if_fail (IRIS_IS_PROCESS (task));
+	g_return_if_fail (IRIS_IS_PROCESS (process));
 
-	process = IRIS_PROCESS (task);
+	task = IRIS_TASK (process);
 	priv = process->priv;
 
 	g_value_init (&params[0], G_TYPE_OBJECT);
@@ -1710,21 +2713,35 @@ iris_process_execute_real (IrisTask *task)
 
 	g_warn_if_fail (task->priv->closure != NULL);
 
-	/* See TODO about why this code is really dumb and how it could be improved */
+	/* Batched processes call the C function directly, see
+	 * iris_process_set_batch_func().
+	 */
+	max_batch_size = priv->max_batch_size;
+	if (max_batch_size > 0 && priv->reorder_window == 0) {
+		batch_func = (IrisProcessBatchFunc)((GCClosure *)task->priv->closure)->callback;
+		work_items = max_batch_size <= BATCH_STACK_SIZE ?
+		             stack_items : take_batch_buffer (process);
+	} else {
+		batch_func = max_batch_size > 0 ?
+		  (IrisProcessBatchFunc)((GCClosure *)task->priv->closure)->callback : NULL;
+		max_batch_size = 1;
+		work_items = stack_items;
+	}
+
+	current.process = process;
+	current.sequence = 0;
+
+	outer_worker = g_static_private_get (&current_worker);
+	g_static_private_set (&current_worker, process, NULL);
 
 	timer = g_timer_new ();
 
 	while (1) {
-		IrisMessage *work_item;
-
 		cancelled = FLAG_IS_ON (process, IRIS_TASK_FLAG_CANCELLED);
 
-		/* Update progress monitors, no more than five times a second */
-		if (priv->watch_port_list != NULL &&
-		    g_timer_elapsed (priv->watch_timer, NULL) >= 0.200) {
-			g_timer_reset (priv->watch_timer);
-			update_status (process, FALSE);
-		}
+		/* Progress monitors are updated from a timeout */
+		if (priv->watch_port_list != NULL)
+			start_status_updates (process);
 
 		if (cancelled)
 			break;
@@ -1732,36 +2749,108 @@ iris_process_execute_real (IrisTask *task)
 		if (G_UNLIKELY (g_timer_elapsed(timer, NULL) > 1.0))
 			goto _yield;
 
-		work_item = iris_queue_try_pop (priv->work_queue);
+		/* Don't make more work for a sink that is over its limit */
+		sink = g_atomic_pointer_get (&priv->sink);
+		if (sink != NULL && g_atomic_int_get (&sink->priv->throttled)) {
+			if (park_on_sink (process, sink))
+				goto _park;
+			continue;
+		}
+
+		if (priv->reorder_window > 0)
+			n_items = pop_ordered_work_item (process, work_items,
+			                                 &current.sequence);
+		else
+			n_items = pop_work_items (process, work_items, max_batch_size);
 
-		if (!work_item) {
+		if (n_items == 0) {
 			if (work_function_can_finish (process))
 				break;
 
+			/* Park until there is something to do, rather than spinning
+			 * through the scheduler. After publishing that we are parked we
+			 * must check again, because a waker that changed things before it
+			 * could see us will not have rescheduled anyone.
+			 */
+			g_atomic_int_inc (&priv->n_parked);
+
+			if (!have_work (process) &&
+			    !work_function_can_finish (process) &&
+			    FLAG_IS_OFF (process, IRIS_TASK_FLAG_CANCELLED))
+				goto _park;
+
+			if (!take_parked_worker (process))
+				/* A waker beat us to it and has already rescheduled a
+				 * worker in our place.
+				 */
+				goto _park;
+
+			continue;
+
 _yield:
+			/* Yield, by reposting this function to the scheduler and returning.
+			 * This lets the scheduler share the thread if it needs to, and
+			 * CPU-bound work share the processors.
+			 */
+			schedule_worker (process);
+
+_park:
+			g_static_private_set (&current_worker, outer_worker, NULL);
+			if (work_items != stack_items)
+				return_batch_buffer (process, work_items);
 			g_value_unset (&params[0]);
 			g_timer_destroy (timer);
-
-			/* Yield, by reposting this function to the scheduler and returning. */
-			work_scheduler = g_atomic_pointer_get (&IRIS_TASK (process)->priv->work_scheduler);
-			iris_scheduler_queue (work_scheduler,
-			                      (IrisCallback)iris_process_execute_real,
-			                      process, NULL);
 			return;
 		}
 
-		/* Execute work item */
-		g_value_set_pointer (&params[1], work_item);
-		g_closure_invoke (task->priv->closure, NULL, 2, params, NULL);
+		/* If there is more work than we took, get some help with it */
+		if (g_atomic_int_get (&priv->max_parallelism) > 1 &&
+		    have_work (process))
+			wake_work_function (process, FALSE);
 
-		iris_message_unref (work_item);
+		/* Execute work items */
+		if (priv->reorder_window > 0)
+			g_static_private_set (&current_item, &current, NULL);
 
-		g_atomic_int_inc (&priv->processed_items);
+		if (batch_func != NULL)
+			batch_func (process, work_items, n_items,
+			            task->priv->closure->data);
+		else {
+			g_value_set_pointer (&params[1], work_items[0]);
+			g_closure_invoke (task->priv->closure, NULL, 2, params, NULL);
+		}
+
+		if (priv->reorder_window > 0) {
+			g_static_private_set (&current_item, NULL, NULL);
+			complete_ordered_item (process, current.sequence);
+		}
+
+		for (i = 0; i < n_items; i++)
+			iris_message_unref (work_items[i]);
+
+		g_atomic_int_add (&priv->processed_items, n_items);
+
+		release_producers (process, FALSE);
 	};
 
+	g_static_private_set (&current_worker, outer_worker, NULL);
+	if (work_items != stack_items)
+		return_batch_buffer (process, work_items);
 	g_value_unset (&params[0]);
 	g_timer_destroy (timer);
 
+	/* Any parked workers need to notice that we are done, and only the last
+	 * worker out may finish the process.
+	 */
+	wake_work_function (process, TRUE);
+
+	if (!g_atomic_int_dec_and_test (&priv->n_workers))
+		return;
+
+	release_producers (process, TRUE);
+
+	stop_status_updates (process);
+
 	if (priv->watch_port_list != NULL)
 		update_status (process, TRUE);
 
@@ -1809,6 +2898,17 @@ _yield:
 	}
 }
 
+static void
+iris_process_execute_real (IrisTask *task)
+{
+	g_return_if_fail (IRIS_IS_PROCESS (task));
+
+	/* This is the first worker, wake_work_function() adds any others */
+	g_atomic_int_set (&IRIS_PROCESS (task)->priv->n_workers, 1);
+
+	iris_process_worker (IRIS_PROCESS (task));
+}
+
 static void
 iris_process_constructed (GObject       *object)
 {
@@ -1877,6 +2977,8 @@ iris_process_finalize (GObject *object)
 	IrisProcess        *process = IRIS_PROCESS (object);
 	IrisProcessPrivate *priv    = process->priv;
 	GList              *node;
+	IrisMessage        *work_item;
+	guint               i;
 
 	if (priv->work_port != NULL) {
 		iris_receiver_destroy (priv->work_receiver, FALSE);
@@ -1899,14 +3001,36 @@ iris_process_finalize (GObject *object)
 
 	g_slice_free (gfloat, (gfloat *)priv->output_estimate_factor);
 
+	g_free (priv->batch_buffer);
+
+	if (priv->reorder_slots != NULL) {
+		/* Output of a cancelled process may never have been released */
+		for (i = 0; i <= priv->reorder_mask; i++) {
+			while ((work_item = g_queue_pop_head (&priv->reorder_slots[i].outputs)))
+				iris_message_unref (work_item);
+		}
+		g_free (priv->reorder_slots);
+	}
+
+	while ((work_item = g_queue_pop_head (&priv->release_queue)))
+		iris_message_unref (work_item);
+
+	if (priv->reorder_mutex != NULL)
+		g_mutex_free (priv->reorder_mutex);
+
+	if (priv->intake_pending != NULL)
+		g_hash_table_destroy (priv->intake_pending);
+
+	g_mutex_free (priv->throttle_mutex);
+	g_cond_free (priv->throttle_cond);
+	g_timer_destroy (priv->throttle_timer);
+
 	g_free ((gpointer)priv->title);
 
 	for (node=priv->watch_port_list; node; node=node->next)
 		g_object_unref (IRIS_PORT (node->data));
 	g_list_free (priv->watch_port_list);
 
-	g_timer_destroy (priv->watch_timer);
-
 	G_OBJECT_CLASS (iris_process_parent_class)->finalize (object);
 }
 
@@ -1965,6 +3089,34 @@ iris_process_init (IrisProcess *process)
 	priv->total_items = 0;
 	priv->estimated_total_items = 0;
 
+	priv->n_workers = 0;
+	priv->n_parked = 0;
+	priv->max_parallelism = 1;
+	priv->updating_status = FALSE;
+	priv->status_timeout_id = 0;
+	priv->estimate_pending = FALSE;
+
+	priv->reorder_window = 0;
+	priv->reorder_mask = 0;
+	priv->reorder_slots = NULL;
+	priv->reorder_mutex = NULL;
+	priv->next_sequence = 0;
+	priv->next_intake = 0;
+	priv->intake_pending = NULL;
+	priv->next_pop = 0;
+	priv->next_release = 0;
+
+	priv->queue_limit_high = 0;
+	priv->queue_limit_low = 0;
+	priv->throttled = FALSE;
+	priv->throttle_mutex = g_mutex_new ();
+	priv->throttle_cond = g_cond_new ();
+	priv->n_throttled = 0;
+	priv->throttled_time = 0.0;
+	priv->n_parked_producers = 0;
+	priv->throttle_timer = g_timer_new ();
+	priv->max_batch_size = 0;
+
 	priv->watch_total_items = 0;
 
 	/* No atomic float access :( */
@@ -1975,7 +3127,6 @@ iris_process_init (IrisProcess *process)
 	priv->title = NULL;
 
 	priv->watch_port_list = NULL;
-	priv->watch_timer = g_timer_new ();
 
 	ENABLE_FLAG (process, IRIS_PROCESS_FLAG_OPEN);
 
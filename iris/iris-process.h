@@ -53,6 +53,18 @@ typedef struct _IrisProcessPrivate IrisProcessPrivate;
  */
 typedef void (*IrisProcessFunc) (IrisProcess *process, IrisMessage *work_item, gpointer user_data);
 
+/**
+ * IrisProcessBatchFunc:
+ * @process: An #IrisProcess
+ * @work_items: An array of #IrisMessage work items
+ * @n_items: the number of items in @work_items
+ * @user_data: user specified data
+ *
+ * Callback for batched processes, to handle several work items at once. The
+ * work items are unreferenced after the callback returns.
+ */
+typedef void (*IrisProcessBatchFunc) (IrisProcess *process, IrisMessage **work_items, guint n_items, gpointer user_data);
+
 struct _IrisProcess
 {
 	IrisTask parent;
@@ -79,6 +91,10 @@ IrisProcess*  iris_process_new                   (IrisProcessFunc      func,
                                                   gpointer             user_data,
                                                   GDestroyNotify       notify);
 IrisProcess*  iris_process_new_with_closure      (GClosure            *closure);
+IrisProcess*  iris_process_new_batched           (IrisProcessBatchFunc func,
+                                                  guint                max_batch_size,
+                                                  gpointer             user_data,
+                                                  GDestroyNotify       notify);
 
 void          iris_process_run                   (IrisProcess            *process);
 void          iris_process_cancel                (IrisProcess            *process);
@@ -117,10 +133,27 @@ void          iris_process_set_func              (IrisProcess            *proces
                                                   GDestroyNotify          notify);
 void          iris_process_set_closure           (IrisProcess            *process,
                                                   GClosure               *closure);
+void          iris_process_set_batch_func        (IrisProcess            *process,
+                                                  IrisProcessBatchFunc    func,
+                                                  guint                   max_batch_size,
+                                                  gpointer                user_data,
+                                                  GDestroyNotify          notify);
 void          iris_process_set_title             (IrisProcess            *process,
                                                   const gchar            *title);
 void          iris_process_set_output_estimation (IrisProcess            *process,
                                                   gfloat                  factor);
+void          iris_process_set_max_parallelism   (IrisProcess            *process,
+                                                  guint                   max_parallelism);
+guint         iris_process_get_max_parallelism   (IrisProcess            *process);
+void          iris_process_set_ordered           (IrisProcess            *process,
+                                                  gboolean                ordered,
+                                                  guint                   window_size);
+void          iris_process_set_queue_limit       (IrisProcess            *process,
+                                                  guint                   high_watermark,
+                                                  guint                   low_watermark);
+void          iris_process_get_throttle_stats    (IrisProcess            *process,
+                                                  guint                  *p_n_throttled,
+                                                  gdouble                *p_throttled_time);
 
 void          iris_process_add_watch             (IrisProcess            *process,
                                                   IrisPort               *watch_port);
@@ -27,18 +27,42 @@ G_BEGIN_DECLS
 
 struct _IrisQueuePrivate
 {
-	GAsyncQueue *q;
+	/* The default implementation is a plain GQueue protected by @mutex,
+	 * with @cond signalled on push when @waiting_threads is non-zero. Only
+	 * allocated for IrisQueue itself, not for subclasses.
+	 */
+	GMutex *mutex;
+	GCond  *cond;
+	GQueue  queue;
+	guint   waiting_threads;
 
 	/* 'open' should be accessed using g_atomic_int_* methods, because although
-	 * it is only set inside the GAsyncQueue mutex it is also read in
+	 * it is only set inside the queue mutex it is also read in
 	 * iris_queue_is_open().
 	 */
 	volatile gint open;
 
 	/* Number of close tokens posted by iris_queue_close() */
 	gint close_token_count;
+
+	/* Links of popped items, kept so that pushing does not allocate.
+	 * Protected by the queue mutex.
+	 */
+	GList *free_links;
+	guint  n_free_links;
+
+	/* Items are kept in a single GQueue, newest at the head, with urgent
+	 * items gathered at the tail and low priority items at the head. These
+	 * point to the newest urgent item and to the oldest low priority item,
+	 * and are protected by the queue mutex.
+	 */
+	GList * volatile high_newest;
+	GList           *low_oldest;
 };
 
+#define IRIS_QUEUE_HAS_URGENT(queue) \
+	(g_atomic_pointer_get (&(queue)->priv->high_newest) != NULL)
+
 G_END_DECLS
 
 #endif /* __IRIS_QUEUE_PRIVATE_H__ */
@@ -28,7 +28,7 @@
  * @see_also: #IrisLFQueue, #IrisWSQueue
  *
  * #IrisQueue is a queue abstraction for concurrent queues.  The default
- * implementation wraps #GAsyncQueue which is a lock-based queue.
+ * implementation is a lock-based queue, similar to #GAsyncQueue.
  *
  * A useful feature of #IrisQueue is the 'closing' of queues. This has two
  * possible uses. Firstly, the owner of the queue can call iris_queue_close()
@@ -65,6 +65,9 @@ G_DEFINE_TYPE (IrisQueue, iris_queue, G_TYPE_OBJECT)
 
 static gboolean iris_queue_real_push               (IrisQueue *queue,
                                                     gpointer   data);
+static gboolean iris_queue_real_push_priority      (IrisQueue *queue,
+                                                    gpointer   data,
+                                                    gint       priority);
 static gpointer iris_queue_real_pop                (IrisQueue *queue);
 static gpointer iris_queue_real_try_pop            (IrisQueue *queue);
 static gpointer iris_queue_real_timed_pop          (IrisQueue *queue,
@@ -77,20 +80,6 @@ static guint    iris_queue_real_get_length         (IrisQueue *queue);
 static gboolean iris_queue_real_is_closed          (IrisQueue *queue);
 
 
-/* IrisQueue currently involves some hacks around the GAsyncQueue codebase,
- * mainly to implement closing. I don't think that's a problem, the code hasn't
- * changed too much since 2000.
- */
-struct _GAsyncQueue
-{
-  GMutex *mutex;
-  GCond *cond;
-  GQueue queue;
-  GDestroyNotify item_free_func;
-  guint waiting_threads;
-  gint32 ref_count;
-};
-
 /* Value pushed by iris_queue_close() to wake up pop listeners. Note that it
  * isn't a problem that this value might conflict with legitimate items. Pop
  * functions will only treat this value as special if it is the last item in a
@@ -99,13 +88,21 @@ struct _GAsyncQueue
  */
 #define CLOSE_TOKEN (gpointer)0x12345678
 
+/* Upper bound on the links kept around by a queue for reuse */
+#define MAX_FREE_LINKS 1024
+
 static void
 iris_queue_finalize (GObject *object)
 {
 	IrisQueue *queue = IRIS_QUEUE (object);
 
-	if (queue->priv->q != NULL)
-		g_async_queue_unref (queue->priv->q);
+	if (queue->priv->mutex != NULL) {
+		g_mutex_free (queue->priv->mutex);
+		g_cond_free (queue->priv->cond);
+		g_list_free (queue->priv->queue.head);
+	}
+
+	g_list_free (queue->priv->free_links);
 
 	G_OBJECT_CLASS (iris_queue_parent_class)->finalize (object);
 }
@@ -120,6 +117,7 @@ iris_queue_class_init (IrisQueueClass *klass)
 	g_type_class_add_private (object_class, sizeof (IrisQueuePrivate));
 
 	klass->push = iris_queue_real_push;
+	klass->push_priority = iris_queue_real_push_priority;
 	klass->pop = iris_queue_real_pop;
 	klass->try_pop = iris_queue_real_try_pop;
 	klass->timed_pop = iris_queue_real_timed_pop;
@@ -135,13 +133,22 @@ iris_queue_init (IrisQueue *queue)
 {
 	queue->priv = G_TYPE_INSTANCE_GET_PRIVATE (queue, IRIS_TYPE_QUEUE, IrisQueuePrivate);
 
-	/* only create GAsyncQueue if needed */
-	if (G_TYPE_FROM_INSTANCE (queue) == IRIS_TYPE_QUEUE)
-		queue->priv->q = g_async_queue_new ();
-	else
-		queue->priv->q = NULL;
+	/* only create the lock if needed, subclasses bring their own storage */
+	if (G_TYPE_FROM_INSTANCE (queue) == IRIS_TYPE_QUEUE) {
+		queue->priv->mutex = g_mutex_new ();
+		queue->priv->cond = g_cond_new ();
+	}
+	else {
+		queue->priv->mutex = NULL;
+		queue->priv->cond = NULL;
+	}
+
+	g_queue_init (&queue->priv->queue);
+	queue->priv->waiting_threads = 0;
 
 	queue->priv->open = TRUE;
+	queue->priv->high_newest = NULL;
+	queue->priv->low_oldest = NULL;
 }
 
 /**
@@ -174,6 +181,37 @@ iris_queue_push (IrisQueue *queue,
 	return IRIS_QUEUE_GET_CLASS (queue)->push (queue, data);
 }
 
+/**
+ * iris_queue_push_priority:
+ * @queue: An #IrisQueue
+ * @data: a pointer to store that is not %NULL
+ * @priority: a negative value for urgent items, zero for normal ones or
+ *            a positive value for items which can wait
+ *
+ * Like iris_queue_push(), but urgent items are popped before any normal ones,
+ * and normal items before those with a positive @priority. Items of the same
+ * priority are still popped in order. The values of #IrisSchedulerPriority
+ * can be used for @priority.
+ *
+ * Queue implementations which do not support priorities treat this the same
+ * as iris_queue_push().
+ *
+ * Return value: %TRUE if @data was pushed successfully, %FALSE if @queue is
+ *               closed.
+ */
+gboolean
+iris_queue_push_priority (IrisQueue *queue,
+                          gpointer   data,
+                          gint       priority)
+{
+	IrisQueueClass *klass = IRIS_QUEUE_GET_CLASS (queue);
+
+	if (priority == 0 || klass->push_priority == NULL)
+		return klass->push (queue, data);
+
+	return klass->push_priority (queue, data, priority);
+}
+
 /**
  * iris_queue_pop:
  * @queue: An #IrisQueue
@@ -325,6 +363,143 @@ iris_queue_is_closed (IrisQueue *queue)
  *************************************************************************/
 
 
+static void
+insert_link_before_ul (GQueue *queue,
+                       GList  *sibling,
+                       GList  *link)
+{
+	link->next = sibling;
+	link->prev = sibling->prev;
+
+	if (sibling->prev != NULL)
+		sibling->prev->next = link;
+	else
+		queue->head = link;
+
+	sibling->prev = link;
+	queue->length ++;
+}
+
+static void
+insert_link_after_ul (GQueue *queue,
+                      GList  *sibling,
+                      GList  *link)
+{
+	link->prev = sibling;
+	link->next = sibling->next;
+
+	if (sibling->next != NULL)
+		sibling->next->prev = link;
+	else
+		queue->tail = link;
+
+	sibling->next = link;
+	queue->length ++;
+}
+
+/* Pushes @data with the queue lock held, reusing the link of a
+ * previously popped item when there is one. Items are popped from the tail,
+ * so urgent items are kept together at the tail end and low priority ones at
+ * the head end, each group in the order it was pushed.
+ */
+static void
+push_ul (IrisQueue *queue,
+         gpointer   data,
+         gint       priority)
+{
+	IrisQueuePrivate *priv = queue->priv;
+	GList            *link;
+
+	if (G_LIKELY ((link = priv->free_links) != NULL)) {
+		priv->free_links = link->next;
+		priv->n_free_links --;
+		link->next = NULL;
+	}
+	else
+		link = g_list_alloc ();
+
+	link->data = data;
+
+	if (G_UNLIKELY (priority < 0)) {
+		if (priv->high_newest != NULL)
+			insert_link_before_ul (&priv->queue, priv->high_newest, link);
+		else
+			g_queue_push_tail_link (&priv->queue, link);
+		g_atomic_pointer_set (&priv->high_newest, link);
+	}
+	else if (G_UNLIKELY (priority > 0)) {
+		g_queue_push_head_link (&priv->queue, link);
+		if (priv->low_oldest == NULL)
+			priv->low_oldest = link;
+	}
+	else if (G_UNLIKELY (priv->low_oldest != NULL))
+		insert_link_after_ul (&priv->queue, priv->low_oldest, link);
+	else
+		g_queue_push_head_link (&priv->queue, link);
+
+	if (priv->waiting_threads > 0)
+		g_cond_signal (priv->cond);
+}
+
+/* Pops the oldest item with the queue lock held, blocking if @wait is %TRUE
+ * until an item arrives or @end_time passes. The link of the popped item is
+ * kept for push_ul().
+ */
+static gpointer
+pop_ul (IrisQueue *queue,
+        gboolean   wait,
+        GTimeVal  *end_time)
+{
+	IrisQueuePrivate *priv = queue->priv;
+	GList            *link;
+	gpointer          item;
+
+	if (!g_queue_peek_tail_link (&priv->queue)) {
+		if (!wait)
+			return NULL;
+
+		priv->waiting_threads++;
+		while (!g_queue_peek_tail_link (&priv->queue)) {
+			if (!end_time)
+				g_cond_wait (priv->cond, priv->mutex);
+			else if (!g_cond_timed_wait (priv->cond, priv->mutex, end_time))
+				break;
+		}
+		priv->waiting_threads--;
+	}
+
+	if (!(link = g_queue_pop_tail_link (&priv->queue)))
+		return NULL;
+
+	item = link->data;
+
+	if (G_UNLIKELY (link == priv->high_newest))
+		g_atomic_pointer_set (&priv->high_newest, NULL);
+	else if (G_UNLIKELY (link == priv->low_oldest))
+		/* only low priority items are left */
+		priv->low_oldest = g_queue_peek_tail_link (&priv->queue);
+
+	if (priv->n_free_links < MAX_FREE_LINKS) {
+		link->prev = NULL;
+		link->next = priv->free_links;
+		priv->free_links = link;
+		priv->n_free_links ++;
+	}
+	else
+		g_list_free_1 (link);
+
+	return item;
+}
+
+/* Number of queued items minus the threads blocked waiting for one, like
+ * g_async_queue_length_unlocked().
+ */
+static gint
+length_ul (IrisQueue *queue)
+{
+	return (gint) queue->priv->queue.length - (gint) queue->priv->waiting_threads;
+}
+
 static void
 close_ul (IrisQueue *queue)
 {
@@ -333,10 +508,11 @@ close_ul (IrisQueue *queue)
 	g_atomic_int_set (&queue->priv->open, FALSE);
 
 	/* Send the close token to any threads currently blocking on the queue. */
-	for (i=0; i < queue->priv->q->waiting_threads; i++)
-		g_async_queue_push_unlocked (queue->priv->q, CLOSE_TOKEN);
+	/* Behind everything else, since tokens must be the last items */
+	for (i=0; i < queue->priv->waiting_threads; i++)
+		push_ul (queue, CLOSE_TOKEN, 1);
 
-	queue->priv->close_token_count = queue->priv->q->waiting_threads;
+	queue->priv->close_token_count = queue->priv->waiting_threads;
 }
 
 /* Swallow CLOSE_TOKEN items */
@@ -352,8 +528,7 @@ handle_close_token_ul (IrisQueue *queue,
 	/* Filter close tokens. They must be the last items in the queue, so we can
 	 * avoid filtering actual queue items that happen to be the same value.
 	 */
-	remaining_items = g_async_queue_length_unlocked (queue->priv->q) + 
-	                  queue->priv->q->waiting_threads;
+	remaining_items = queue->priv->queue.length;
 
 	g_warn_if_fail (remaining_items >= queue->priv->close_token_count -1);
 
@@ -376,14 +551,35 @@ iris_queue_real_push (IrisQueue *queue,
 
 	g_return_val_if_fail (data != NULL, FALSE);
 
-	g_async_queue_lock (queue->priv->q);
+	g_mutex_lock (queue->priv->mutex);
+
+	is_open = g_atomic_int_get (&queue->priv->open);
+
+	if (G_LIKELY (is_open))
+		push_ul (queue, data, 0);
+
+	g_mutex_unlock (queue->priv->mutex);
+
+	return is_open;
+}
+
+static gboolean
+iris_queue_real_push_priority (IrisQueue *queue,
+                               gpointer   data,
+                               gint       priority)
+{
+	gboolean is_open;
+
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	g_mutex_lock (queue->priv->mutex);
 
 	is_open = g_atomic_int_get (&queue->priv->open);
 
 	if (G_LIKELY (is_open))
-		g_async_queue_push_unlocked (queue->priv->q, data);
+		push_ul (queue, data, priority);
 
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 
 	return is_open;
 }
@@ -393,19 +589,19 @@ iris_queue_real_pop (IrisQueue *queue)
 {
 	gpointer item;
 
-	g_async_queue_lock (queue->priv->q);
+	g_mutex_lock (queue->priv->mutex);
 
 	if (g_atomic_int_get (&queue->priv->open) == FALSE &&
-	    g_async_queue_length_unlocked (queue->priv->q) <= 0) {
-		g_async_queue_unlock (queue->priv->q);
+	    length_ul (queue) <= 0) {
+		g_mutex_unlock (queue->priv->mutex);
 		return NULL;
 	}
 
-	item = g_async_queue_pop_unlocked (queue->priv->q);
+	item = pop_ul (queue, TRUE, NULL);
 
 	if (g_atomic_int_get (&queue->priv->open) == FALSE)
 		item = handle_close_token_ul (queue, item);
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 
 	return item;
 }
@@ -415,12 +611,12 @@ iris_queue_real_try_pop (IrisQueue *queue)
 {
 	gpointer item;
 
-	g_async_queue_lock (queue->priv->q);
-	item = g_async_queue_try_pop_unlocked (queue->priv->q);
+	g_mutex_lock (queue->priv->mutex);
+	item = pop_ul (queue, FALSE, NULL);
 
 	if (g_atomic_int_get (&queue->priv->open) == FALSE)
 		item = handle_close_token_ul (queue, item);
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 
 	return item;
 }
@@ -431,18 +627,18 @@ iris_queue_real_timed_pop (IrisQueue *queue,
 {
 	gpointer item;
 
-	g_async_queue_lock (queue->priv->q);
+	g_mutex_lock (queue->priv->mutex);
 	if (g_atomic_int_get (&queue->priv->open) == FALSE &&
-	    g_async_queue_length_unlocked (queue->priv->q) <= 0) {
-		g_async_queue_unlock (queue->priv->q);
+	    length_ul (queue) <= 0) {
+		g_mutex_unlock (queue->priv->mutex);
 		return NULL;
 	}
 
-	item = g_async_queue_timed_pop_unlocked (queue->priv->q, timeout);
+	item = pop_ul (queue, TRUE, timeout);
 
 	if (g_atomic_int_get (&queue->priv->open) == FALSE)
 		item = handle_close_token_ul (queue, item);
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 
 	return item;
 }
@@ -452,14 +648,14 @@ iris_queue_real_try_pop_or_close (IrisQueue *queue)
 {
 	gpointer item;
 
-	g_async_queue_lock (queue->priv->q);
-	item = g_async_queue_try_pop_unlocked (queue->priv->q);
+	g_mutex_lock (queue->priv->mutex);
+	item = pop_ul (queue, FALSE, NULL);
 
 	if (g_atomic_int_get (&queue->priv->open) == FALSE)
 		item = handle_close_token_ul (queue, item);
 	else if (item == NULL)
 		close_ul (queue);
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 
 	return item;
 }
@@ -470,14 +666,14 @@ iris_queue_real_timed_pop_or_close (IrisQueue *queue,
 {
 	gpointer item;
 
-	g_async_queue_lock (queue->priv->q);
-	item = g_async_queue_timed_pop_unlocked (queue->priv->q, timeout);
+	g_mutex_lock (queue->priv->mutex);
+	item = pop_ul (queue, TRUE, timeout);
 
 	if (g_atomic_int_get (&queue->priv->open) == FALSE)
 		item = handle_close_token_ul (queue, item);
 	else if (item == NULL)
 		close_ul (queue);
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 
 	return item;
 }
@@ -485,15 +681,21 @@ iris_queue_real_timed_pop_or_close (IrisQueue *queue,
 static void
 iris_queue_real_close (IrisQueue *queue)
 {
-	g_async_queue_lock (queue->priv->q);
+	g_mutex_lock (queue->priv->mutex);
 	close_ul (queue);
-	g_async_queue_unlock (queue->priv->q);
+	g_mutex_unlock (queue->priv->mutex);
 }
 
 static guint
 iris_queue_real_get_length (IrisQueue *queue)
 {
-	return g_async_queue_length (queue->priv->q);
+	gint length;
+
+	g_mutex_lock (queue->priv->mutex);
+	length = length_ul (queue);
+	g_mutex_unlock (queue->priv->mutex);
+
+	return MAX (length, 0);
 }
 
 static gboolean
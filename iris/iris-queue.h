@@ -62,6 +62,11 @@ struct _IrisQueueClass
 
 	guint    (*get_length)         (IrisQueue *queue);
 	gboolean (*is_closed)          (IrisQueue *queue);
+
+	/* Added after the rest so that the layout stays compatible */
+	gboolean (*push_priority)      (IrisQueue *queue,
+	                                gpointer   data,
+	                                gint       priority);
 };
 
 GType       iris_queue_get_type           (void) G_GNUC_CONST;
@@ -69,6 +74,9 @@ IrisQueue * iris_queue_new                (void);
 
 gboolean    iris_queue_push               (IrisQueue *queue,
                                            gpointer   data);
+gboolean    iris_queue_push_priority      (IrisQueue *queue,
+                                           gpointer   data,
+                                           gint       priority);
 gpointer    iris_queue_pop                (IrisQueue *queue);
 gpointer    iris_queue_try_pop            (IrisQueue *queue);
 gpointer    iris_queue_timed_pop          (IrisQueue *queue,
@@ -101,6 +101,11 @@ struct _IrisReceiverPrivate
 	gint           max_active; /* The maximum number of receives that
 	                            * we can process concurrently.
 	                            */
+
+	IrisSchedulerPriority
+	               priority;   /* Priority of our work items in the
+	                            * scheduler, high unless changed.
+	                            */
 };
 
 struct _IrisReceiverClass
@@ -114,6 +119,13 @@ struct _IrisReceiverClass
 GType              iris_delivery_status_get_type (void) G_GNUC_CONST;
 IrisDeliveryStatus iris_receiver_deliver         (IrisReceiver *receiver,
                                                   IrisMessage  *message);
+IrisDeliveryStatus iris_receiver_deliver_many    (IrisReceiver *receiver,
+                                                  IrisMessage **messages,
+                                                  guint         n_messages,
+                                                  guint        *n_accepted);
+gboolean           iris_receiver_can_batch       (IrisReceiver *receiver);
+void               iris_receiver_queue_drain     (IrisReceiver *receiver,
+                                                  IrisPort     *port);
 void               iris_receiver_resume          (IrisReceiver *receiver);
 gboolean           iris_receiver_has_arbiter     (IrisReceiver *receiver);
 
@@ -24,6 +24,8 @@
 #include "iris-receiver.h"
 #include "iris-receiver-private.h"
 #include "iris-port.h"
+#include "iris-port-private.h"
+#include "iris-thread-private.h"
 
 /**
  * SECTION:iris-receiver
@@ -52,11 +54,33 @@ enum {
 
 typedef struct
 {
-	gboolean      executed;
-	IrisReceiver *receiver;
-	IrisMessage  *message;
+	IrisThreadWork  work;      /* Queued in the scheduler, so delivering a
+	                            * message needs only this one allocation */
+	gboolean        executed;
+	IrisReceiver   *receiver;
+	IrisMessage    *message;
 } IrisWorkerData;
 
+typedef struct
+{
+	IrisThreadWork  work;
+	gboolean        executed;
+	IrisReceiver   *receiver;
+	guint           n_messages;
+	IrisMessage    *messages[1]; /* Allocated to hold n_messages */
+} IrisBatchWorkerData;
+
+#define BATCH_WORKER_SIZE(n) \
+	(G_STRUCT_OFFSET (IrisBatchWorkerData, messages) + (n) * sizeof (IrisMessage *))
+
+typedef struct
+{
+	IrisThreadWork  work;
+	gboolean        executed;
+	IrisReceiver   *receiver;
+	IrisPort       *port;      /* Port created with iris_port_new_spsc() */
+} IrisDrainWorkerData;
+
 GType
 iris_delivery_status_get_type (void)
 {
@@ -84,7 +108,7 @@ iris_receiver_worker_destroy_cb (gpointer data)
 		if (g_atomic_int_dec_and_test (&worker->receiver->priv->active)) { };
 
 	iris_message_unref (worker->message);
-	g_slice_free (IrisWorkerData, worker);
+	iris_thread_cache_free (worker);
 }
 
 static void
@@ -133,6 +157,114 @@ iris_receiver_worker (gpointer data)
 	g_object_unref (worker->receiver);
 }
 
+static void
+iris_receiver_batch_worker_destroy_cb (gpointer data)
+{
+	IrisBatchWorkerData *batch = data;
+	guint                i;
+
+	if (!batch->executed)
+		if (g_atomic_int_dec_and_test (&batch->receiver->priv->active)) { };
+
+	for (i = 0; i < batch->n_messages; i++)
+		iris_message_unref (batch->messages[i]);
+
+	g_slice_free1 (BATCH_WORKER_SIZE (batch->n_messages), batch);
+}
+
+/* Runs a batch from iris_receiver_deliver_many(). The whole batch counts as
+ * one active message, and is only used for receivers with no arbiter so there
+ * is nobody to notify on completion.
+ */
+static void
+iris_receiver_batch_worker (gpointer data)
+{
+	IrisReceiverPrivate *priv;
+	IrisBatchWorkerData *batch;
+	guint                i;
+
+	g_return_if_fail (data != NULL);
+
+	batch = data;
+	priv = batch->receiver->priv;
+
+	g_object_ref (batch->receiver);
+
+	batch->executed = TRUE;
+
+	for (i = 0; i < batch->n_messages; i++) {
+		priv->callback (batch->messages[i], priv->data);
+
+		/* Drop the rest of the batch if a message destroyed the receiver */
+		if (g_atomic_pointer_get (&priv->port) == NULL)
+			break;
+	}
+
+	if (g_atomic_int_dec_and_test (&priv->active)) { }
+
+	g_object_unref (batch->receiver);
+}
+
+static void
+iris_receiver_drain_worker_destroy_cb (gpointer data)
+{
+	IrisDrainWorkerData *drain = data;
+	IrisMessage         *messages[IRIS_PORT_SPSC_BATCH];
+	guint                n, i;
+
+	if (!drain->executed) {
+		/* Unqueued by iris_receiver_destroy(). We are the only consumer
+		 * of the ring, so drop what it holds and clear the scheduled flag
+		 * along the way. */
+		while ((n = iris_port_spsc_pop (drain->port, messages,
+		                                G_N_ELEMENTS (messages))) > 0)
+			for (i = 0; i < n; i++)
+				iris_message_unref (messages[i]);
+
+		if (g_atomic_int_dec_and_test (&drain->receiver->priv->active)) { };
+	}
+
+	g_object_unref (drain->port);
+	g_slice_free (IrisDrainWorkerData, drain);
+}
+
+/* Drains the ring of a single producer port in batches. Only one drain is
+ * queued per port at a time, so messages are handled one after another in
+ * the order they were posted. Like a batch it counts as one active message.
+ */
+static void
+iris_receiver_drain_worker (gpointer data)
+{
+	IrisReceiverPrivate *priv;
+	IrisDrainWorkerData *drain;
+	IrisMessage         *messages[IRIS_PORT_SPSC_BATCH];
+	guint                n, i;
+
+	g_return_if_fail (data != NULL);
+
+	drain = data;
+	priv = drain->receiver->priv;
+
+	g_object_ref (drain->receiver);
+
+	drain->executed = TRUE;
+
+	while ((n = iris_port_spsc_pop (drain->port, messages,
+	                                G_N_ELEMENTS (messages))) > 0) {
+		for (i = 0; i < n; i++) {
+			/* Drop the rest if a message destroyed the receiver */
+			if (g_atomic_pointer_get (&priv->port) != NULL)
+				priv->callback (messages[i], priv->data);
+
+			iris_message_unref (messages[i]);
+		}
+	}
+
+	if (g_atomic_int_dec_and_test (&priv->active)) { }
+
+	g_object_unref (drain->receiver);
+}
+
 static IrisDeliveryStatus
 iris_receiver_deliver_real (IrisReceiver *receiver,
                             IrisMessage  *message)
@@ -233,15 +365,18 @@ _post_decision:
 		if (!priv->persistent)
 			status = IRIS_DELIVERY_ACCEPTED_REMOVE;
 
-		worker = g_slice_new0 (IrisWorkerData);
+		worker = iris_thread_cache_alloc (IRIS_THREAD_CACHE_WORKER_DATA,
+		                                  sizeof (IrisWorkerData));
 		worker->receiver = receiver;
 		worker->executed = FALSE;
 		worker->message = iris_message_ref_sink (message);
 
-		iris_scheduler_queue (priv->scheduler,
-		                      iris_receiver_worker,
-		                      worker,
-		                      iris_receiver_worker_destroy_cb);
+		iris_thread_work_init (&worker->work,
+		                       iris_receiver_worker,
+		                       worker,
+		                       iris_receiver_worker_destroy_cb);
+		worker->work.priority = priv->priority;
+		iris_scheduler_queue_work (priv->scheduler, &worker->work);
 	}
 
 	return status;
@@ -401,6 +536,7 @@ iris_receiver_init (IrisReceiver *receiver)
 	g_static_rec_mutex_init (&receiver->priv->mutex);
 	g_static_rec_mutex_init (&receiver->priv->destroy_mutex);
 	receiver->priv->persistent = TRUE;
+	receiver->priv->priority = IRIS_SCHEDULER_PRIORITY_NORMAL;
 }
 
 /*
@@ -421,6 +557,125 @@ iris_receiver_deliver (IrisReceiver *receiver,
 	return IRIS_RECEIVER_GET_CLASS (receiver)->deliver (receiver, message);
 }
 
+/*
+ * iris_receiver_deliver_many:
+ * @receiver: An #IrisReceiver
+ * @messages: An array of #IrisMessage
+ * @n_messages: The length of @messages
+ * @n_accepted: Location for the number of messages accepted
+ *
+ * Delivers messages in order until one is not accepted. A persistent receiver
+ * with no arbiter accepts the whole batch at once and runs it as a single
+ * work item in the scheduler. Used internally by #IrisPort.
+ *
+ * Return value: the status code for the last delivery attempted.
+ */
+IrisDeliveryStatus
+iris_receiver_deliver_many (IrisReceiver *receiver,
+                            IrisMessage **messages,
+                            guint         n_messages,
+                            guint        *n_accepted)
+{
+	IrisReceiverPrivate *priv;
+	IrisDeliveryStatus   status = IRIS_DELIVERY_ACCEPTED;
+	IrisBatchWorkerData *batch;
+	guint                i;
+
+	g_return_val_if_fail (IRIS_IS_RECEIVER (receiver), IRIS_DELIVERY_REMOVE);
+	g_return_val_if_fail (n_accepted != NULL, IRIS_DELIVERY_REMOVE);
+
+	priv = receiver->priv;
+
+	if (n_messages > 1 && iris_receiver_can_batch (receiver)) {
+		g_atomic_int_inc (&priv->active);
+
+		batch = g_slice_alloc (BATCH_WORKER_SIZE (n_messages));
+		batch->receiver = receiver;
+		batch->executed = FALSE;
+		batch->n_messages = n_messages;
+
+		for (i = 0; i < n_messages; i++)
+			batch->messages[i] = iris_message_ref_sink (messages[i]);
+
+		iris_thread_work_init (&batch->work,
+		                       iris_receiver_batch_worker,
+		                       batch,
+		                       iris_receiver_batch_worker_destroy_cb);
+		batch->work.priority = priv->priority;
+		iris_scheduler_queue_work (priv->scheduler, &batch->work);
+
+		*n_accepted = n_messages;
+		return IRIS_DELIVERY_ACCEPTED;
+	}
+
+	for (i = 0; i < n_messages; i++) {
+		status = iris_receiver_deliver (receiver, messages[i]);
+
+		if (status == IRIS_DELIVERY_ACCEPTED)
+			continue;
+
+		if (status == IRIS_DELIVERY_ACCEPTED_REMOVE)
+			i++;
+
+		break;
+	}
+
+	*n_accepted = i;
+	return status;
+}
+
+/*
+ * iris_receiver_can_batch:
+ * @receiver: An #IrisReceiver
+ *
+ * Checks whether @receiver accepts every message straight away, which is
+ * the case for a persistent receiver with no arbiter and no limit on active
+ * messages. Such a receiver can be handed work in batches.
+ *
+ * Return value: %TRUE if messages may be batched for @receiver
+ */
+gboolean
+iris_receiver_can_batch (IrisReceiver *receiver)
+{
+	IrisReceiverPrivate *priv = receiver->priv;
+
+	return IRIS_RECEIVER_GET_CLASS (receiver)->deliver == iris_receiver_deliver_real &&
+	       !priv->arbiter && !priv->max_active && priv->persistent;
+}
+
+/*
+ * iris_receiver_queue_drain:
+ * @receiver: An #IrisReceiver for which iris_receiver_can_batch() is %TRUE
+ * @port: An #IrisPort created with iris_port_new_spsc()
+ *
+ * Queues a work item in the receiver's scheduler that handles the messages
+ * in @port<!-- -->'s ring buffer until it is empty. The caller must have set
+ * the ring's scheduled flag. Used internally by #IrisPort.
+ */
+void
+iris_receiver_queue_drain (IrisReceiver *receiver,
+                           IrisPort     *port)
+{
+	IrisReceiverPrivate *priv;
+	IrisDrainWorkerData *drain;
+
+	priv = receiver->priv;
+
+	g_atomic_int_inc (&priv->active);
+
+	drain = g_slice_new (IrisDrainWorkerData);
+	drain->receiver = receiver;
+	drain->port = g_object_ref (port);
+	drain->executed = FALSE;
+
+	iris_thread_work_init (&drain->work,
+	                       iris_receiver_drain_worker,
+	                       drain,
+	                       iris_receiver_drain_worker_destroy_cb);
+	drain->work.priority = priv->priority;
+	iris_scheduler_queue_work (priv->scheduler, &drain->work);
+}
+
 /*
  * iris_receiver_resume:
  * @receiver: An #IrisReceiver
@@ -463,12 +718,21 @@ iris_receiver_worker_unqueue_cb (IrisScheduler *scheduler,
 	receiver = IRIS_RECEIVER (user_data);
 	priv = receiver->priv;
 
-	if (callback != iris_receiver_worker)
-		return TRUE;
+	if (callback == iris_receiver_worker) {
+		worker_data = data;
 
-	worker_data = data;
-
-	if (worker_data->receiver != receiver)
+		if (worker_data->receiver != receiver)
+			return TRUE;
+	}
+	else if (callback == iris_receiver_batch_worker) {
+		if (((IrisBatchWorkerData *)data)->receiver != receiver)
+			return TRUE;
+	}
+	else if (callback == iris_receiver_drain_worker) {
+		if (((IrisDrainWorkerData *)data)->receiver != receiver)
+			return TRUE;
+	}
+	else
 		return TRUE;
 
 	iris_scheduler_unqueue (scheduler, work_item);
@@ -580,3 +844,40 @@ iris_receiver_has_arbiter (IrisReceiver *receiver)
 
 	return g_atomic_pointer_get (&priv->arbiter) != NULL;
 }
+
+/**
+ * iris_receiver_set_priority:
+ * @receiver: An #IrisReceiver
+ * @priority: An #IrisSchedulerPriority
+ *
+ * Sets the priority of the work items which @receiver queues in its scheduler
+ * to handle messages, see iris_scheduler_queue_full(). The default is
+ * %IRIS_SCHEDULER_PRIORITY_NORMAL. A receiver whose messages control other
+ * work, like the one which handles the cancel messages of an #IrisTask, can
+ * be raised to %IRIS_SCHEDULER_PRIORITY_HIGH so that they are not stuck
+ * behind a backlog of bulk work.
+ */
+void
+iris_receiver_set_priority (IrisReceiver          *receiver,
+                            IrisSchedulerPriority  priority)
+{
+	g_return_if_fail (IRIS_IS_RECEIVER (receiver));
+
+	receiver->priv->priority = priority;
+}
+
+/**
+ * iris_receiver_get_priority:
+ * @receiver: An #IrisReceiver
+ *
+ * Retrieves the priority set with iris_receiver_set_priority().
+ *
+ * Return value: the #IrisSchedulerPriority of @receiver<!-- -->'s work items
+ */
+IrisSchedulerPriority
+iris_receiver_get_priority (IrisReceiver *receiver)
+{
+	g_return_val_if_fail (IRIS_IS_RECEIVER (receiver), IRIS_SCHEDULER_PRIORITY_NORMAL);
+
+	return receiver->priv->priority;
+}
@@ -49,6 +49,11 @@ GType          iris_receiver_get_type      (void) G_GNUC_CONST;
 void           iris_receiver_destroy       (IrisReceiver  *receiver,
                                             gboolean       in_message);
 
+void           iris_receiver_set_priority  (IrisReceiver          *receiver,
+                                            IrisSchedulerPriority  priority);
+IrisSchedulerPriority
+               iris_receiver_get_priority  (IrisReceiver          *receiver);
+
 G_END_DECLS
 
 #endif /* __IRIS_RECEIVER_H__ */
@@ -0,0 +1,55 @@
+/* iris-ringqueue-private.h
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 
+ * 02110-1301 USA
+ */
+
+#ifndef __IRIS_RINGQUEUE_PRIVATE_H__
+#define __IRIS_RINGQUEUE_PRIVATE_H__
+
+#include "iris-event-count.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+	volatile gint  seq;  /* Position this cell is ready for, see
+	                      * iris-ringqueue.c */
+	gpointer       data;
+} IrisRingQueueCell;
+
+struct _IrisRingQueuePrivate
+{
+	IrisRingQueueCell *cells;
+	guint              mask;
+
+	/* Producers and consumers each advance their own counter, so keep
+	 * them on separate cache lines.
+	 */
+	gchar              pad1[64];
+	volatile gint      enqueue_state; /* Next position << 1 | closed bit */
+	gchar              pad2[64];
+	volatile gint      dequeue_pos;
+	gchar              pad3[64];
+
+	IrisEventCount     not_empty;     /* Consumers blocked in pop */
+	IrisEventCount     not_full;      /* Producers blocked in push */
+};
+
+G_END_DECLS
+
+#endif /* __IRIS_RINGQUEUE_PRIVATE_H__ */
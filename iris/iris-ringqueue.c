@@ -0,0 +1,439 @@
+/* iris-ringqueue.c
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 
+ * 02110-1301 USA
+ */
+
+/* The ring follows Dmitry Vyukov's bounded MPMC queue. Every cell carries a
+ * sequence number saying which position it is ready for: a producer may fill
+ * the cell for position p when seq == p, and a consumer may empty it when
+ * seq == p + 1. Producers and consumers claim positions with a CAS on their
+ * own counter and never touch the other side's, so neither side ever waits
+ * for the other except when the ring is full or empty.
+ *
+ * The closed flag lives in the low bit of the enqueue counter so that
+ * iris_queue_try_pop_or_close() can close the queue in the same CAS that
+ * proves it is empty. Positions are therefore only 31 bits wide and are
+ * always compared with POS_DIFF().
+ */
+
+#include "iris-ringqueue.h"
+#include "iris-ringqueue-private.h"
+
+/**
+ * SECTION:iris-ringqueue
+ * @title: IrisRingQueue
+ * @short_description: A bounded lock-free queue
+ *
+ * #IrisRingQueue is a bounded queue backed by a fixed array. Pushing and
+ * popping do not take locks or allocate memory, and the items sit next to
+ * each other in memory.
+ *
+ * When the queue is full, iris_queue_push() blocks until a consumer makes
+ * room, which gives producers natural backpressure. Use
+ * iris_ringqueue_try_push() to fail instead. Consumers blocked in
+ * iris_queue_pop() sleep until an item arrives; they do not poll.
+ *
+ * Closing is supported just like #IrisQueue, see iris_queue_close().
+ */
+
+#define POS_DIFF(a,b)    (((gint)(((guint)(a) - (guint)(b)) << 1)) >> 1)
+#define STATE_POS(s)     ((guint)(s) >> 1)
+#define STATE_CLOSED(s)  ((s) & 1)
+
+typedef enum
+{
+	PUSH_OK,
+	PUSH_FULL,
+	PUSH_CLOSED
+} PushResult;
+
+static gboolean iris_ringqueue_real_push               (IrisQueue *queue,
+                                                        gpointer   data);
+static gpointer iris_ringqueue_real_pop                (IrisQueue *queue);
+static gpointer iris_ringqueue_real_try_pop            (IrisQueue *queue);
+static gpointer iris_ringqueue_real_timed_pop          (IrisQueue *queue,
+                                                        GTimeVal  *timeout);
+static gpointer iris_ringqueue_real_try_pop_or_close   (IrisQueue *queue);
+static gpointer iris_ringqueue_real_timed_pop_or_close (IrisQueue *queue,
+                                                        GTimeVal  *timeout);
+static void     iris_ringqueue_real_close              (IrisQueue *queue);
+static guint    iris_ringqueue_real_get_length         (IrisQueue *queue);
+static gboolean iris_ringqueue_real_is_closed          (IrisQueue *queue);
+
+G_DEFINE_TYPE (IrisRingQueue, iris_ringqueue, IRIS_TYPE_QUEUE)
+
+static void
+iris_ringqueue_finalize (GObject *object)
+{
+	IrisRingQueuePrivate *priv;
+
+	priv = IRIS_RINGQUEUE (object)->priv;
+
+	g_free (priv->cells);
+	iris_event_count_destroy (&priv->not_empty);
+	iris_event_count_destroy (&priv->not_full);
+
+	G_OBJECT_CLASS (iris_ringqueue_parent_class)->finalize (object);
+}
+
+static void
+iris_ringqueue_class_init (IrisRingQueueClass *klass)
+{
+	GObjectClass   *object_class;
+	IrisQueueClass *queue_class;
+
+	object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = iris_ringqueue_finalize;
+	g_type_class_add_private (object_class, sizeof (IrisRingQueuePrivate));
+
+	queue_class = IRIS_QUEUE_CLASS (klass);
+	queue_class->push = iris_ringqueue_real_push;
+	queue_class->push_priority = NULL; /* a ring keeps its order */
+	queue_class->pop = iris_ringqueue_real_pop;
+	queue_class->try_pop = iris_ringqueue_real_try_pop;
+	queue_class->timed_pop = iris_ringqueue_real_timed_pop;
+	queue_class->try_pop_or_close = iris_ringqueue_real_try_pop_or_close;
+	queue_class->timed_pop_or_close = iris_ringqueue_real_timed_pop_or_close;
+	queue_class->close = iris_ringqueue_real_close;
+	queue_class->get_length = iris_ringqueue_real_get_length;
+	queue_class->is_closed = iris_ringqueue_real_is_closed;
+}
+
+static void
+iris_ringqueue_init (IrisRingQueue *queue)
+{
+	queue->priv = G_TYPE_INSTANCE_GET_PRIVATE (queue,
+	                                           IRIS_TYPE_RINGQUEUE,
+	                                           IrisRingQueuePrivate);
+
+	queue->priv->enqueue_state = 0;
+	queue->priv->dequeue_pos = 0;
+	iris_event_count_init (&queue->priv->not_empty);
+	iris_event_count_init (&queue->priv->not_full);
+}
+
+/**
+ * iris_ringqueue_new:
+ * @size: the number of items the queue can hold
+ *
+ * Creates a new instance of #IrisRingQueue, a bounded lock-free queue.
+ * @size is rounded up to a power of two.
+ *
+ * Return value: the newly created #IrisRingQueue instance
+ */
+IrisQueue*
+iris_ringqueue_new (guint size)
+{
+	IrisRingQueue *queue;
+	guint          capacity = 2;
+	guint          i;
+
+	g_return_val_if_fail (size > 0 && size <= (1 << 30), NULL);
+
+	while (capacity < size)
+		capacity <<= 1;
+
+	queue = g_object_new (IRIS_TYPE_RINGQUEUE, NULL);
+	queue->priv->mask = capacity - 1;
+	queue->priv->cells = g_new (IrisRingQueueCell, capacity);
+
+	for (i = 0; i < capacity; i++) {
+		queue->priv->cells [i].seq = i;
+		queue->priv->cells [i].data = NULL;
+	}
+
+	return IRIS_QUEUE (queue);
+}
+
+static PushResult
+iris_ringqueue_push_internal (IrisRingQueuePrivate *priv,
+                              gpointer              data)
+{
+	IrisRingQueueCell *cell;
+	gint               state;
+	guint              pos;
+	gint               diff;
+
+	for (;;) {
+		state = g_atomic_int_get (&priv->enqueue_state);
+
+		if (STATE_CLOSED (state))
+			return PUSH_CLOSED;
+
+		pos = STATE_POS (state);
+		cell = &priv->cells [pos & priv->mask];
+		diff = POS_DIFF (g_atomic_int_get (&cell->seq), pos);
+
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange (&priv->enqueue_state,
+			                                       state, (pos + 1) << 1))
+				break;
+		}
+		else if (diff < 0)
+			/* The consumer a lap behind has not emptied the cell yet */
+			return PUSH_FULL;
+	}
+
+	cell->data = data;
+
+	/* seq == pos, publish the item to consumers. The add is a full barrier,
+	 * which iris_event_count_notify() relies on.
+	 */
+	g_atomic_int_add (&cell->seq, 1);
+
+	iris_event_count_notify (&priv->not_empty, FALSE);
+
+	return PUSH_OK;
+}
+
+static gpointer
+iris_ringqueue_pop_internal (IrisRingQueuePrivate *priv)
+{
+	IrisRingQueueCell *cell;
+	gpointer           data;
+	guint              pos;
+	gint               diff;
+
+	for (;;) {
+		pos = g_atomic_int_get (&priv->dequeue_pos);
+		cell = &priv->cells [pos & priv->mask];
+		diff = POS_DIFF (g_atomic_int_get (&cell->seq), pos + 1);
+
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange (&priv->dequeue_pos,
+			                                       pos, pos + 1))
+				break;
+		}
+		else if (diff < 0)
+			return NULL;
+	}
+
+	data = cell->data;
+	cell->data = NULL;
+
+	/* seq == pos + 1, hand the cell to the producer one lap ahead */
+	g_atomic_int_add (&cell->seq, priv->mask);
+
+	iris_event_count_notify (&priv->not_full, FALSE);
+
+	return data;
+}
+
+/* Pops an item, or closes the queue if it is empty. Returns NULL once the
+ * queue is closed and empty, including items whose push is still in
+ * progress.
+ */
+static gpointer
+iris_ringqueue_pop_or_close_internal (IrisRingQueuePrivate *priv)
+{
+	gpointer data;
+	gint     state;
+
+	for (;;) {
+		if ((data = iris_ringqueue_pop_internal (priv)) != NULL)
+			return data;
+
+		state = g_atomic_int_get (&priv->enqueue_state);
+
+		/* A producer has claimed a position but not filled it yet */
+		if (POS_DIFF (STATE_POS (state), g_atomic_int_get (&priv->dequeue_pos)) > 0)
+			continue;
+
+		if (STATE_CLOSED (state))
+			return NULL;
+
+		if (g_atomic_int_compare_and_exchange (&priv->enqueue_state,
+		                                       state, state | 1))
+		{
+			iris_event_count_notify (&priv->not_empty, TRUE);
+			iris_event_count_notify (&priv->not_full, TRUE);
+			return NULL;
+		}
+	}
+}
+
+static gboolean
+iris_ringqueue_real_push (IrisQueue *queue,
+                          gpointer   data)
+{
+	IrisRingQueuePrivate *priv;
+	PushResult            result;
+	gint                  key;
+
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	priv = IRIS_RINGQUEUE (queue)->priv;
+
+	while ((result = iris_ringqueue_push_internal (priv, data)) == PUSH_FULL) {
+		key = iris_event_count_prepare (&priv->not_full);
+
+		if ((result = iris_ringqueue_push_internal (priv, data)) != PUSH_FULL) {
+			iris_event_count_cancel (&priv->not_full);
+			break;
+		}
+
+		iris_event_count_wait (&priv->not_full, key, NULL);
+	}
+
+	return result == PUSH_OK;
+}
+
+/* Common code of the blocking pops. @timeout may be NULL to wait forever. */
+static gpointer
+iris_ringqueue_wait_pop (IrisQueue *queue,
+                         GTimeVal  *timeout,
+                         gboolean   close_on_timeout)
+{
+	IrisRingQueuePrivate *priv;
+	gpointer              data;
+	gint                  key;
+
+	priv = IRIS_RINGQUEUE (queue)->priv;
+
+	for (;;) {
+		if ((data = iris_ringqueue_pop_internal (priv)) != NULL)
+			return data;
+
+		key = iris_event_count_prepare (&priv->not_empty);
+
+		if ((data = iris_ringqueue_pop_internal (priv)) != NULL) {
+			iris_event_count_cancel (&priv->not_empty);
+			return data;
+		}
+
+		if (STATE_CLOSED (g_atomic_int_get (&priv->enqueue_state))) {
+			/* Drain items that were still being pushed when we closed */
+			iris_event_count_cancel (&priv->not_empty);
+			return iris_ringqueue_pop_or_close_internal (priv);
+		}
+
+		if (!iris_event_count_wait (&priv->not_empty, key, timeout)) {
+			if (close_on_timeout)
+				return iris_ringqueue_pop_or_close_internal (priv);
+			return iris_ringqueue_pop_internal (priv);
+		}
+	}
+}
+
+static gpointer
+iris_ringqueue_real_pop (IrisQueue *queue)
+{
+	return iris_ringqueue_wait_pop (queue, NULL, FALSE);
+}
+
+static gpointer
+iris_ringqueue_real_try_pop (IrisQueue *queue)
+{
+	return iris_ringqueue_pop_internal (IRIS_RINGQUEUE (queue)->priv);
+}
+
+static gpointer
+iris_ringqueue_real_timed_pop (IrisQueue *queue,
+                               GTimeVal  *timeout)
+{
+	g_return_val_if_fail (timeout != NULL, NULL);
+	return iris_ringqueue_wait_pop (queue, timeout, FALSE);
+}
+
+static gpointer
+iris_ringqueue_real_try_pop_or_close (IrisQueue *queue)
+{
+	return iris_ringqueue_pop_or_close_internal (IRIS_RINGQUEUE (queue)->priv);
+}
+
+static gpointer
+iris_ringqueue_real_timed_pop_or_close (IrisQueue *queue,
+                                        GTimeVal  *timeout)
+{
+	g_return_val_if_fail (timeout != NULL, NULL);
+	return iris_ringqueue_wait_pop (queue, timeout, TRUE);
+}
+
+static void
+iris_ringqueue_real_close (IrisQueue *queue)
+{
+	IrisRingQueuePrivate *priv;
+	gint                  state;
+
+	priv = IRIS_RINGQUEUE (queue)->priv;
+
+	do {
+		state = g_atomic_int_get (&priv->enqueue_state);
+		if (STATE_CLOSED (state))
+			return;
+	} while (!g_atomic_int_compare_and_exchange (&priv->enqueue_state,
+	                                             state, state | 1));
+
+	iris_event_count_notify (&priv->not_empty, TRUE);
+	iris_event_count_notify (&priv->not_full, TRUE);
+}
+
+static guint
+iris_ringqueue_real_get_length (IrisQueue *queue)
+{
+	IrisRingQueuePrivate *priv;
+	gint                  length;
+
+	priv = IRIS_RINGQUEUE (queue)->priv;
+
+	length = POS_DIFF (STATE_POS (g_atomic_int_get (&priv->enqueue_state)),
+	                   g_atomic_int_get (&priv->dequeue_pos));
+
+	return CLAMP (length, 0, (gint)priv->mask + 1);
+}
+
+static gboolean
+iris_ringqueue_real_is_closed (IrisQueue *queue)
+{
+	return STATE_CLOSED (g_atomic_int_get (&IRIS_RINGQUEUE (queue)->priv->enqueue_state));
+}
+
+/**
+ * iris_ringqueue_try_push:
+ * @queue: An #IrisRingQueue
+ * @data: a pointer to store that is not %NULL
+ *
+ * Pushes @data onto the queue without blocking.
+ *
+ * Return value: %TRUE if @data was pushed, %FALSE if the queue is full or
+ *               closed.
+ */
+gboolean
+iris_ringqueue_try_push (IrisRingQueue *queue,
+                         gpointer       data)
+{
+	g_return_val_if_fail (IRIS_IS_RINGQUEUE (queue), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	return iris_ringqueue_push_internal (queue->priv, data) == PUSH_OK;
+}
+
+/**
+ * iris_ringqueue_get_capacity:
+ * @queue: An #IrisRingQueue
+ *
+ * Retrieves the number of items @queue can hold.
+ *
+ * Return value: the capacity of @queue
+ */
+guint
+iris_ringqueue_get_capacity (IrisRingQueue *queue)
+{
+	g_return_val_if_fail (IRIS_IS_RINGQUEUE (queue), 0);
+	return queue->priv->mask + 1;
+}
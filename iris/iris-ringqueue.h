@@ -0,0 +1,61 @@
+/* iris-ringqueue.h
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 
+ * 02110-1301 USA
+ */
+
+#ifndef __IRIS_RINGQUEUE_H__
+#define __IRIS_RINGQUEUE_H__
+
+#include "iris-queue.h"
+
+G_BEGIN_DECLS
+
+#define IRIS_TYPE_RINGQUEUE            (iris_ringqueue_get_type ())
+#define IRIS_RINGQUEUE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), IRIS_TYPE_RINGQUEUE, IrisRingQueue))
+#define IRIS_RINGQUEUE_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), IRIS_TYPE_RINGQUEUE, IrisRingQueue const))
+#define IRIS_RINGQUEUE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  IRIS_TYPE_RINGQUEUE, IrisRingQueueClass))
+#define IRIS_IS_RINGQUEUE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), IRIS_TYPE_RINGQUEUE))
+#define IRIS_IS_RINGQUEUE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  IRIS_TYPE_RINGQUEUE))
+#define IRIS_RINGQUEUE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  IRIS_TYPE_RINGQUEUE, IrisRingQueueClass))
+
+typedef struct _IrisRingQueue        IrisRingQueue;
+typedef struct _IrisRingQueueClass   IrisRingQueueClass;
+typedef struct _IrisRingQueuePrivate IrisRingQueuePrivate;
+
+struct _IrisRingQueue
+{
+	IrisQueue parent;
+
+	/*< private >*/
+	IrisRingQueuePrivate *priv;
+};
+
+struct _IrisRingQueueClass
+{
+	IrisQueueClass parent_class;
+};
+
+GType      iris_ringqueue_get_type     (void) G_GNUC_CONST;
+IrisQueue* iris_ringqueue_new          (guint          size);
+gboolean   iris_ringqueue_try_push     (IrisRingQueue *queue,
+                                        gpointer       data);
+guint      iris_ringqueue_get_capacity (IrisRingQueue *queue);
+
+G_END_DECLS
+
+#endif /* __IRIS_RINGQUEUE_H__ */
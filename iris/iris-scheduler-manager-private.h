@@ -21,13 +21,45 @@
 #ifndef __IRIS_SCHEDULER_MANAGER_PRIVATE_H__
 #define __IRIS_SCHEDULER_MANAGER_PRIVATE_H__
 
+#include "iris-scheduler.h"
+
 G_BEGIN_DECLS
 
 void     iris_scheduler_manager_yield   (IrisThread *thread);
 
+/* Called by a transient thread leaving a scheduler that is still alive */
+void     iris_scheduler_manager_release (IrisScheduler *scheduler);
+
+/* Called by the leader thread with the result of the growth policy */
+void     iris_scheduler_manager_set_target (IrisScheduler *scheduler,
+                                            gint           target);
+gint     iris_scheduler_manager_get_ceiling (IrisScheduler *scheduler);
+gboolean iris_scheduler_manager_wants_fewer (IrisScheduler *scheduler);
+
+gboolean iris_scheduler_manager_enter_blocking (IrisScheduler *scheduler);
+void     iris_scheduler_manager_leave_blocking (IrisScheduler *scheduler);
+void     iris_scheduler_manager_lend           (IrisScheduler *scheduler);
+
+/* Called around a blocking region of a thread running CPU-bound work */
+void     iris_scheduler_manager_release_cpu    (void);
+void     iris_scheduler_manager_reclaim_cpu    (void);
+
+void     iris_scheduler_manager_queue_hinted (IrisScheduler       *scheduler,
+                                              IrisPerformanceHint  hint,
+                                              IrisCallback         func,
+                                              gpointer             data);
+
 /* Returns TRUE if thread may stop, FALSE if it is still needed */
 gboolean iris_scheduler_manager_destroy (IrisThread *thread);
 
+guint    iris_scheduler_manager_add_timeout    (IrisScheduler  *scheduler,
+                                                guint           interval,
+                                                gboolean        periodic,
+                                                IrisCallback    func,
+                                                gpointer        data,
+                                                GDestroyNotify  notify);
+gboolean iris_scheduler_manager_remove_timeout (guint           timeout_id);
+
 G_END_DECLS
 
 #endif /* __IRIS_SCHEDULER_MANAGER_PRIVATE_H__ */
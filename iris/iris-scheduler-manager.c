@@ -21,7 +21,12 @@
 #include <glib/gprintf.h>
 
 #include "iris-debug.h"
+#include "iris-gmainscheduler.h"
 #include "iris-scheduler-manager.h"
+#include "iris-scheduler-manager-private.h"
+#include "iris-scheduler-private.h"
+#include "iris-stack.h"
+#include "iris-thread-private.h"
 
 /**
  * SECTION:iris-scheduler-manager
@@ -31,62 +36,267 @@
  * The scheduler manager helps provide dynamic thread-management for
  * schedulers.  It also has some helpers for debugging complex threading
  * scenarios.
+ *
+ * The scheduler manager also owns the timer thread behind
+ * iris_scheduler_queue_timeout(), which is shared by all schedulers.
  */
 
-#define THREAD_KEY ("__iris_threads")
+/* How long a thread may sit in the free list before it is retired */
+#define IDLE_TIMEOUT_DEFAULT (5000)
+
+/* IrisThread.idle_state holds a generation in the high bits, which is
+ * bumped every time the thread becomes idle, and one of these.
+ */
+#define IDLE_BUSY            (0)
+#define IDLE_WAITING         (1)
+#define IDLE_RETIRED         (2)
+#define IDLE_STATUS_MASK     (3)
+#define IDLE_STATUS(s)       ((s) & IDLE_STATUS_MASK)
+#define IDLE_WITH_STATUS(s,t) (((s) & ~IDLE_STATUS_MASK) | (t))
+#define IDLE_NEXT(s,t)       ((gint)(((guint)(s) & ~IDLE_STATUS_MASK) + \
+                                     (IDLE_STATUS_MASK + 1)) | (t))
 
 typedef struct
 {
-	GList *free_list;
-	GList *all_list;
+	/* Idle threads. This is a lock-free stack so that threads going idle
+	 * and schedulers looking for threads don't serialize on a lock. A
+	 * thread that retires stays on the stack until it is popped, and the
+	 * popper frees it, see get_or_create_thread(). Each thread that
+	 * retires also sweeps the stack, see sweep_retired_threads_unlocked().
+	 */
+	IrisStack     *free_threads;
+	volatile gint  n_free;
+
+	/* Every thread that has not retired, for iris_scheduler_manager_print_stat().
+	 * Only changes when a thread is created or retires, under
+	 * G_LOCK (all_threads).
+	 */
+	GList         *all_list;
+
+	/* Idle threads are retired after idle_timeout milliseconds, unless that
+	 * would leave fewer than idle_reserve in the free list.
+	 */
+	volatile gint  idle_reserve;
+	volatile gint  idle_timeout;
+
+	volatile gint  n_created;
+	volatile gint  n_retired;
+
+	GTimer        *clock;         /* For IrisSchedulerRecord.last_grow */
+
+	/* Only n_cpu threads run CPU-bound work at once, the rest of it waits
+	 * here under G_LOCK (cpu_bound), see iris_scheduler_manager_queue_hinted().
+	 */
+	gint           n_cpu_bound;
+	GQueue        *cpu_bound_waiting;
+
+	/* Threads lent to schedulers beyond their max_threads while they block */
+	volatile gint  blocking_budget;
+	volatile gint  n_lent;
 } IrisSchedulerManager;
 
+/* Work queued with a performance hint */
+typedef struct
+{
+	IrisScheduler       *scheduler;
+	IrisPerformanceHint  hint;
+	IrisCallback         func;
+	gpointer             data;
+} IrisHintedWork;
+
 /* Singleton instance of our scheduler manager struct */
 static IrisSchedulerManager *singleton = NULL;
 
 /* Lock for syncrhonizing intitialization. */
 G_LOCK_DEFINE (singleton);
 
+G_LOCK_DEFINE_STATIC (all_threads);
+G_LOCK_DEFINE_STATIC (cpu_bound);
+
+/* Timeouts are kept in a hierarchical timing wheel: WHEEL_LEVELS levels of
+ * WHEEL_SIZE slots, where a slot on level n covers WHEEL_SIZE^n ticks.
+ * Adding and removing a timeout is O(1), and a timeout only moves down a
+ * level (a "cascade") when the level below wraps around, so the timer thread
+ * never looks at timeouts that are not close to expiring. Expired callbacks
+ * are queued on the timeout's scheduler, the timer thread never runs them.
+ */
+#define WHEEL_TICK_USECS (1000)
+#define WHEEL_BITS       (6)
+#define WHEEL_SIZE       (1 << WHEEL_BITS)
+#define WHEEL_MASK       (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS     (4)
+#define WHEEL_SPAN       (G_GUINT64_CONSTANT (1) << (WHEEL_BITS * WHEEL_LEVELS))
+#define WHEEL_NEVER      (G_MAXUINT64)
+
+typedef struct
+{
+	volatile gint   ref_count;
+	guint           id;
+
+	IrisScheduler  *scheduler;
+	IrisCallback    func;
+	gpointer        data;
+	GDestroyNotify  notify;
+
+	guint64         interval;   /* In ticks, 0 if the timeout fires once */
+	guint64         expires;    /* Tick at which to queue the callback   */
+	volatile gint   queued;     /* Set while the callback is queued      */
+
+	GQueue         *slot;       /* Slot holding us, or NULL              */
+	GList           link;
+} IrisTimeout;
+
+typedef struct
+{
+	GMutex     *mutex;
+	GCond      *cond;
+	GTimer     *clock;
+
+	guint64     now;            /* First tick not yet processed          */
+	guint64     wake;           /* Tick the timer thread is waiting for  */
+	guint       n_timeouts;     /* Timeouts in the wheel                 */
+
+	GHashTable *timeouts;       /* id -> IrisTimeout                     */
+	guint       next_id;
+
+	GQueue      slots[WHEEL_LEVELS][WHEEL_SIZE];
+} IrisTimingWheel;
+
+static IrisTimingWheel *wheel = NULL;
+
 void
 iris_scheduler_manager_yield (IrisThread *thread)
 {
 	/* It's up to the thread to call iris_scheduler_remove_thread() etc. */
 	g_return_if_fail (thread->scheduler == NULL);
 
-	G_LOCK (singleton);
-	singleton->free_list = g_list_prepend (singleton->free_list, thread);
-	G_UNLOCK (singleton);
+	/* Only we change our state while we are busy. Threads are popped from
+	 * the top, so the ones at the bottom have been idle longest and are the
+	 * first to be retired.
+	 */
+	g_atomic_int_set (&thread->idle_state,
+	                  IDLE_NEXT (g_atomic_int_get (&thread->idle_state),
+	                             IDLE_WAITING));
+	g_atomic_int_inc (&singleton->n_free);
+	iris_stack_push (singleton->free_threads, thread);
+}
+
+void
+iris_scheduler_manager_release (IrisScheduler *scheduler)
+{
+	g_atomic_int_add (&scheduler->priv->record.n_threads, -1);
+}
+
+static gint
+iris_scheduler_manager_get_clock (void)
+{
+	/* Wraps after 49 days, which only matters to the age of last_grow */
+	return (gint)(guint)(g_timer_elapsed (singleton->clock, NULL) * 1000);
+}
+
+/* Frees every retired thread on the free stack, keeping the order of the
+ * rest. It must be called under G_LOCK (all_threads), which is also held
+ * whenever a thread retires, so a thread cannot retire while we hold it off
+ * the stack and be missed.
+ */
+static void
+sweep_retired_threads_unlocked (void)
+{
+	IrisThread *thread;
+	GSList     *waiting = NULL,
+	           *iter;
+
+	/* Popped from the top down, so the list runs from the bottom up */
+	while ((thread = iris_stack_pop (singleton->free_threads)) != NULL) {
+		if (IDLE_STATUS (g_atomic_int_get (&thread->idle_state)) == IDLE_RETIRED)
+			iris_thread_free (thread);
+		else
+			waiting = g_slist_prepend (waiting, thread);
+	}
+
+	for (iter = waiting; iter; iter = iter->next)
+		iris_stack_push (singleton->free_threads, iter->data);
+
+	g_slist_free (waiting);
 }
 
 gboolean
 iris_scheduler_manager_destroy (IrisThread *thread)
 {
-	GList *node;
-	iris_debug_message (IRIS_DEBUG_SCHEDULER, "Destroying thread %lu", (gulong)thread);
+	gint     state;
+	gint     n_free;
+	gboolean retired;
 
-	G_LOCK (singleton);
-	/* Search for the thread in the free list; if it's not there, it has been
-	 * repurposed by gen_or_create_thread() after it decided to shut down and
-	 * we need to put it back into action
+	/* Take ourselves out of the count first, so that threads timing out
+	 * together don't all see the same count and dip below the reserve.
+	 */
+	do {
+		n_free = g_atomic_int_get (&singleton->n_free);
+		if (n_free <= g_atomic_int_get (&singleton->idle_reserve))
+			return FALSE;
+	} while (!g_atomic_int_compare_and_exchange (&singleton->n_free,
+	                                             n_free, n_free - 1));
+
+	/* If we are no longer waiting in the generation we went idle in, we
+	 * have been repurposed by get_or_create_thread() after we decided to
+	 * shut down, and we need to put ourselves back into action. Our
+	 * message is on its way.
 	 */
-	node = g_list_find (singleton->free_list, thread);
+	state = g_atomic_int_get (&thread->idle_state);
 
-	if (!node) {
-		G_UNLOCK (singleton);
+	G_LOCK (all_threads);
+
+	retired = IDLE_STATUS (state) == IDLE_WAITING &&
+	          g_atomic_int_compare_and_exchange (&thread->idle_state, state,
+	                                             IDLE_WITH_STATUS (state, IDLE_RETIRED));
+
+	if (retired) {
+		singleton->all_list = g_list_remove (singleton->all_list, thread);
+
+		/* Frees @thread too, unless get_or_create_thread() has it */
+		sweep_retired_threads_unlocked ();
+	}
+
+	G_UNLOCK (all_threads);
+
+	if (!retired) {
+		/* get_or_create_thread() has taken us out of the count itself */
+		g_atomic_int_inc (&singleton->n_free);
 		return FALSE;
 	}
 
-	singleton->free_list = g_list_remove (singleton->free_list, thread);
-	G_UNLOCK (singleton);
+	iris_debug_message (IRIS_DEBUG_SCHEDULER, "Destroying thread %lu", (gulong)thread);
+
+	g_atomic_int_inc (&singleton->n_retired);
+
+	return TRUE;
+}
+
+/* Claims an idle thread popped from the free stack. Fails if it retired
+ * while it was on the stack.
+ */
+static gboolean
+claim_thread (IrisThread *thread)
+{
+	gint state;
+
+	do {
+		state = g_atomic_int_get (&thread->idle_state);
+		if (IDLE_STATUS (state) != IDLE_WAITING)
+			return FALSE;
+	} while (!g_atomic_int_compare_and_exchange (&thread->idle_state, state,
+	                                             IDLE_WITH_STATUS (state, IDLE_BUSY)));
+
+	g_atomic_int_add (&singleton->n_free, -1);
 
 	return TRUE;
 }
 
 /**
- * get_or_create_thread_unlocked:
+ * get_or_create_thread:
  * @exclusive: if the thread should try to yield when done processing
  *
- * Tries to first retreive a thread from the free thread list.  If that
+ * Tries to first retreive a thread from the free thread stack.  If that
  * fails, then a new thread is created.  If @exclusive, then the thread
  * will stay attached to the scheduler for the life of the scheduler.
  *
@@ -95,28 +305,35 @@ iris_scheduler_manager_destroy (IrisThread *thread)
  * Return value: A re-purposed or new IrisThread
  */
 static IrisThread*
-get_or_create_thread_unlocked (gboolean exclusive)
-{
-	IrisThread *thread = NULL;
-
-	if (singleton->free_list) {
-		/* There is a possible race condition where we select a transient thread
-		 * for repurposing but meanwhile it has timed out and decided to shut
-		 * down. To avoid this iris_scheduler_manager_destroy() will check if
-		 * the thread shutting down is still in the free list and if not, will
-		 * return FALSE to tell the thread to carry on executing.
-		 */
-		thread = singleton->free_list->data;
-		singleton->free_list = g_list_remove (singleton->free_list,
-		                                      thread);
-	}
+get_or_create_thread (gboolean exclusive)
+{
+	IrisThread *thread;
+
+	/* There is a possible race condition where we pop an idle thread for
+	 * repurposing but meanwhile it has timed out and decided to shut down.
+	 * Whichever of us and iris_scheduler_manager_destroy() changes its
+	 * idle state first wins. If the thread has retired, it has exited
+	 * and left its IrisThread for us to free.
+	 */
+	while ((thread = iris_stack_pop (singleton->free_threads)) != NULL) {
+		if (G_LIKELY (claim_thread (thread)))
+			return thread;
 
-	if (!thread) {
-		if (!(thread = iris_thread_new (exclusive)))
-			return NULL;
-		singleton->all_list = g_list_prepend (singleton->all_list, thread);
+		/* Not while iris_scheduler_manager_print_stat() might see it */
+		G_LOCK (all_threads);
+		iris_thread_free (thread);
+		G_UNLOCK (all_threads);
 	}
 
+	if (!(thread = iris_thread_new (exclusive)))
+		return NULL;
+
+	G_LOCK (all_threads);
+	singleton->all_list = g_list_prepend (singleton->all_list, thread);
+	G_UNLOCK (all_threads);
+
+	g_atomic_int_inc (&singleton->n_created);
+
 	return thread;
 }
 
@@ -128,10 +345,21 @@ get_or_create_thread_unlocked (gboolean exclusive)
 static void
 iris_scheduler_manager_init (void)
 {
+	IrisSchedulerManager *manager;
+
 	G_LOCK (singleton);
 	if (G_LIKELY (!singleton)) {
 		iris_debug_init ();
-		singleton = g_slice_new0 (IrisSchedulerManager);
+		manager = g_slice_new0 (IrisSchedulerManager);
+		manager->free_threads = iris_stack_new ();
+		manager->idle_reserve = iris_scheduler_get_n_cpu ();
+		manager->idle_timeout = IDLE_TIMEOUT_DEFAULT;
+		manager->clock = g_timer_new ();
+		manager->cpu_bound_waiting = g_queue_new ();
+		manager->blocking_budget = iris_scheduler_get_n_cpu () * 4;
+
+		/* Others look at singleton without the lock */
+		g_atomic_pointer_set (&singleton, manager);
 	}
 	G_UNLOCK (singleton);
 }
@@ -166,21 +394,27 @@ iris_scheduler_manager_prepare (IrisScheduler *scheduler)
 		return;
 	}
 
+	g_atomic_int_add (&scheduler->priv->record.n_threads, min_threads);
+
+	/* Schedulers rely on us to serialize iris_scheduler_add_thread() */
 	G_LOCK (singleton);
 
 	for (i = 0; i < min_threads; i++) {
-		thread = get_or_create_thread_unlocked (TRUE);
+		thread = get_or_create_thread (TRUE);
 
-		/* Add proper error handling */
-		g_return_if_fail (thread != NULL);
+		if (G_UNLIKELY (thread == NULL)) {
+			/* Hand back the places we claimed but could not fill */
+			g_warning ("iris_scheduler_manager_prepare(): could only create "
+			           "%d of %d threads", i, min_threads);
+			g_atomic_int_add (&scheduler->priv->record.n_threads,
+			                  -(min_threads - i));
+			break;
+		}
 
 		thread->scheduler = scheduler;
 		iris_scheduler_add_thread (scheduler, thread, TRUE);
 	}
 
-	g_object_set_data (G_OBJECT (scheduler), THREAD_KEY,
-	                   GINT_TO_POINTER (min_threads));
-
 	G_UNLOCK (singleton);
 }
 
@@ -197,6 +431,83 @@ iris_scheduler_manager_unprepare (IrisScheduler *scheduler)
 {
 }
 
+/* The most threads @scheduler may have right now: its max_threads, plus
+ * any lent to it while some of its threads are blocked.
+ */
+gint
+iris_scheduler_manager_get_ceiling (IrisScheduler *scheduler)
+{
+	return iris_scheduler_get_max_threads (scheduler) +
+	       g_atomic_int_get (&scheduler->priv->record.n_lent);
+}
+
+/* Adds threads to @scheduler until it has @requested, or as many as it is
+ * allowed.
+ */
+static void
+iris_scheduler_manager_grow (IrisScheduler *scheduler,
+                             gint           requested)
+{
+	IrisSchedulerRecord *record;
+	IrisThread          *thread      = NULL;
+	gint                 n_threads   = 0;
+	gint                 n_new       = 0;
+	gint                 max_threads = 0;
+	gint                 i;
+
+	record = &scheduler->priv->record;
+	max_threads = iris_scheduler_manager_get_ceiling (scheduler);
+	requested = MIN (requested, max_threads);
+
+	/* Claim the places of the threads we are going to add, so that
+	 * concurrent requests don't overshoot max_threads.
+	 */
+	do {
+		n_threads = g_atomic_int_get (&record->n_threads);
+
+		if (n_threads >= max_threads) {
+			/* Cleared when a thread leaves, see
+			 * iris_scheduler_remove_thread()
+			 */
+			g_atomic_int_set (&scheduler->maxed, TRUE);
+			return;
+		}
+
+		n_new = requested - n_threads;
+
+		if (n_new <= 0)
+			return;
+	} while (!g_atomic_int_compare_and_exchange (&record->n_threads,
+	                                             n_threads,
+	                                             n_threads + n_new));
+
+	g_atomic_int_add (&record->n_pending, n_new);
+
+	/* Schedulers rely on us to serialize iris_scheduler_add_thread() */
+	G_LOCK (singleton);
+
+	for (i = 0; i < n_new; i++) {
+		thread = get_or_create_thread (FALSE);
+
+		if (G_UNLIKELY (thread == NULL)) {
+			/* Hand back the places we claimed but could not fill */
+			g_atomic_int_add (&record->n_pending, -(n_new - i));
+			g_atomic_int_add (&record->n_threads, -(n_new - i));
+			n_new = i;
+			break;
+		}
+
+		thread->scheduler = scheduler;
+		iris_scheduler_add_thread (scheduler, thread, FALSE);
+		g_atomic_int_add (&record->n_pending, -1);
+	}
+
+	G_UNLOCK (singleton);
+
+	g_atomic_int_add (&record->n_grown, n_new);
+	g_atomic_int_set (&record->last_grow, iris_scheduler_manager_get_clock ());
+}
+
 /**
  * iris_scheduler_manager_request:
  * @scheduler: An #IrisScheduler
@@ -212,14 +523,10 @@ iris_scheduler_manager_request (IrisScheduler *scheduler,
                                 guint          per_quantum,
                                 guint          total)
 {
-	IrisThread *thread      = NULL;
-	gint        requested   = 0;
-	guint       n_threads   = 0;
-	guint       max_threads = 0;
-	gint        i;
-
 	g_return_if_fail (scheduler != NULL);
 
+	g_atomic_int_inc (&scheduler->priv->record.n_requests);
+
 	/* Only continue if the scheduler is not maxed out */
 	if (g_atomic_int_get (&scheduler->maxed))
 		return;
@@ -227,29 +534,313 @@ iris_scheduler_manager_request (IrisScheduler *scheduler,
 	if (!per_quantum)
 		per_quantum = 1;
 
-	requested = MAX (total / per_quantum, 1);
-	max_threads = iris_scheduler_get_max_threads (scheduler);
-	requested = MIN (requested, max_threads);
+	iris_scheduler_manager_grow (scheduler, MAX (total / per_quantum, 1));
+}
 
-	G_LOCK (singleton);
+/* Called by the leader thread of @scheduler with the result of its growth
+ * policy. Transient threads beyond @target leave as soon as they are idle.
+ */
+void
+iris_scheduler_manager_set_target (IrisScheduler *scheduler,
+                                   gint           target)
+{
+	IrisSchedulerRecord *record;
+
+	record = &scheduler->priv->record;
+
+	target = CLAMP (target,
+	                iris_scheduler_get_min_threads (scheduler),
+	                iris_scheduler_manager_get_ceiling (scheduler));
+
+	g_atomic_int_set (&record->target, target);
+
+	if (target > g_atomic_int_get (&record->n_threads)) {
+		g_atomic_int_inc (&record->n_requests);
+		iris_scheduler_manager_grow (scheduler, target);
+	}
+}
+
+/* Called by a transient thread of @scheduler before it waits for work. If
+ * the scheduler has more threads than its growth policy wants, or than it
+ * may have now that its blocked threads are back, the thread should leave
+ * as soon as it runs out of work.
+ */
+gboolean
+iris_scheduler_manager_wants_fewer (IrisScheduler *scheduler)
+{
+	IrisSchedulerRecord *record = &scheduler->priv->record;
+	gint                 n_threads;
+
+	n_threads = g_atomic_int_get (&record->n_threads);
+
+	return (n_threads > g_atomic_int_get (&record->target) ||
+	        n_threads > iris_scheduler_manager_get_ceiling (scheduler));
+}
+
+/* Lends @scheduler another thread if work is waiting for one and some of
+ * its threads are blocked. Called when a thread starts blocking, and by
+ * iris_scheduler_queue() and friends while any are blocked, since the work
+ * the lent thread is for may not have been queued yet.
+ */
+void
+iris_scheduler_manager_lend (IrisScheduler *scheduler)
+{
+	IrisSchedulerRecord *record = &scheduler->priv->record;
+	gint                 n_threads,
+	                     backlog;
+
+	/* Queued work counts until it has run, so if there is more of it than
+	 * threads then something is waiting for a thread.
+	 */
+	n_threads = g_atomic_int_get (&record->n_threads);
+	backlog = g_atomic_int_get (&record->n_queued) -
+	          g_atomic_int_get (&record->n_completed);
+
+	if (backlog > n_threads)
+		iris_scheduler_manager_grow (scheduler, n_threads + 1);
+}
+
+/* Called by iris_thread_enter_blocking() on a thread of @scheduler before
+ * it does something that will block for a while. Raises the scheduler's
+ * ceiling by one, within the blocking budget, and lends it a thread
+ * straight away if work is waiting.
+ * Returns %TRUE if the ceiling was raised, in which case the thread must
+ * call iris_scheduler_manager_leave_blocking() once it is done.
+ */
+gboolean
+iris_scheduler_manager_enter_blocking (IrisScheduler *scheduler)
+{
+	IrisSchedulerRecord *record = &scheduler->priv->record;
+	gint                 n_lent;
+
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	/* Its threads all live in the main loop */
+	if (IRIS_IS_GMAINSCHEDULER (scheduler))
+		return FALSE;
+
+	do {
+		n_lent = g_atomic_int_get (&singleton->n_lent);
+
+		if (n_lent >= g_atomic_int_get (&singleton->blocking_budget))
+			return FALSE;
+	} while (!g_atomic_int_compare_and_exchange (&singleton->n_lent,
+	                                             n_lent, n_lent + 1));
+
+	if (g_atomic_int_exchange_and_add (&record->n_lent, 1) >= IRIS_SCHEDULER_MAX_LENT) {
+		g_atomic_int_add (&record->n_lent, -1);
+		g_atomic_int_add (&singleton->n_lent, -1);
+		return FALSE;
+	}
+
+	g_atomic_int_set (&scheduler->maxed, FALSE);
+	iris_scheduler_manager_lend (scheduler);
+
+	return TRUE;
+}
+
+/* Ends a blocking region started with iris_scheduler_manager_enter_blocking().
+ * A thread lent for it leaves once it runs out of work.
+ */
+void
+iris_scheduler_manager_leave_blocking (IrisScheduler *scheduler)
+{
+	g_atomic_int_add (&scheduler->priv->record.n_lent, -1);
+	g_atomic_int_add (&singleton->n_lent, -1);
+}
+
+static void iris_hinted_work_run (gpointer data);
 
-	n_threads = GPOINTER_TO_INT (
-		g_object_get_data (G_OBJECT (scheduler),
-		                   THREAD_KEY));
+/* Hands a CPU-bound slot to the next waiting work, if any. Called by
+ * iris_thread_enter_blocking() when the thread is running CPU-bound work,
+ * so that work which waits for other CPU-bound work, such as a process
+ * throttled by the process it forwards to, can't hold up what it is
+ * waiting for.
+ */
+void
+iris_scheduler_manager_release_cpu (void)
+{
+	IrisHintedWork *next;
+
+	G_LOCK (cpu_bound);
+	next = g_queue_pop_head (singleton->cpu_bound_waiting);
+	if (next == NULL)
+		singleton->n_cpu_bound--;
+	G_UNLOCK (cpu_bound);
 
-	if (n_threads < max_threads) {
-		for (i = n_threads; i < requested; i++) {
-			thread = get_or_create_thread_unlocked (FALSE);
-			thread->scheduler = scheduler;
-			iris_scheduler_add_thread (scheduler, thread, FALSE);
-			n_threads++;
+	if (next != NULL)
+		iris_scheduler_queue (next->scheduler, iris_hinted_work_run,
+		                      next, NULL);
+}
+
+/* Takes back the slot given up by iris_scheduler_manager_release_cpu().
+ * The thread is ready to run again, so it doesn't wait for a free slot;
+ * the processors are oversubscribed for a moment instead, until the next
+ * CPU-bound work finishes without handing its slot on.
+ */
+void
+iris_scheduler_manager_reclaim_cpu (void)
+{
+	G_LOCK (cpu_bound);
+	singleton->n_cpu_bound++;
+	G_UNLOCK (cpu_bound);
+}
+
+static void
+iris_hinted_work_run (gpointer data)
+{
+	IrisHintedWork *work = data;
+	IrisThread     *thread;
+	gboolean        was_cpu_bound = FALSE;
+
+	if (work->hint == IRIS_IO_BOUND) {
+		iris_thread_enter_blocking ();
+		work->func (work->data);
+		iris_thread_leave_blocking ();
+	}
+	else {
+		/* Let blocking regions in the work give up its slot */
+		if ((thread = iris_thread_get ()) != NULL) {
+			was_cpu_bound = thread->cpu_bound;
+			thread->cpu_bound = TRUE;
 		}
+
+		work->func (work->data);
+
+		if (thread != NULL)
+			thread->cpu_bound = was_cpu_bound;
+
+		iris_scheduler_manager_release_cpu ();
 	}
 
-	g_object_set_data (G_OBJECT (scheduler), THREAD_KEY,
-	                   GINT_TO_POINTER (n_threads));
+	g_slice_free (IrisHintedWork, work);
+}
 
-	G_UNLOCK (singleton);
+/* Queues @func on @scheduler like iris_scheduler_queue(), honouring @hint:
+ * CPU-bound work waits until fewer than one thread per processor is running
+ * CPU-bound work, and IO-bound work runs in a blocking region so that the
+ * scheduler can grow beyond max_threads, within the blocking budget, while
+ * it waits. The caller must keep @scheduler alive until @func has run.
+ */
+void
+iris_scheduler_manager_queue_hinted (IrisScheduler       *scheduler,
+                                     IrisPerformanceHint  hint,
+                                     IrisCallback         func,
+                                     gpointer             data)
+{
+	IrisHintedWork *work;
+
+	if (hint == IRIS_NO_HINT) {
+		iris_scheduler_queue (scheduler, func, data, NULL);
+		return;
+	}
+
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	work = g_slice_new (IrisHintedWork);
+	work->scheduler = scheduler;
+	work->hint = hint;
+	work->func = func;
+	work->data = data;
+
+	if (hint == IRIS_CPU_BOUND) {
+		G_LOCK (cpu_bound);
+		if (singleton->n_cpu_bound >= iris_scheduler_get_n_cpu ()) {
+			g_queue_push_tail (singleton->cpu_bound_waiting, work);
+			work = NULL;
+		}
+		else
+			singleton->n_cpu_bound++;
+		G_UNLOCK (cpu_bound);
+
+		if (work == NULL)
+			return;
+	}
+
+	iris_scheduler_queue (scheduler, iris_hinted_work_run, work, NULL);
+}
+
+/**
+ * iris_scheduler_manager_set_blocking_budget:
+ * @n_threads: the number of threads
+ *
+ * Sets how many threads, across all schedulers, may be lent to schedulers
+ * beyond their maximum number of threads while other threads of theirs are
+ * blocked, see iris_thread_enter_blocking(). No scheduler is lent more than
+ * 64 at once. The default is four times the number of processors.
+ */
+void
+iris_scheduler_manager_set_blocking_budget (guint n_threads)
+{
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	g_atomic_int_set (&singleton->blocking_budget, MIN (n_threads, G_MAXINT));
+}
+
+/**
+ * iris_scheduler_manager_get_blocking_budget:
+ *
+ * See iris_scheduler_manager_set_blocking_budget().
+ *
+ * Return value: the number of threads which may be lent to blocked
+ *               schedulers
+ */
+guint
+iris_scheduler_manager_get_blocking_budget (void)
+{
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	return g_atomic_int_get (&singleton->blocking_budget);
+}
+
+/**
+ * iris_scheduler_manager_get_stats:
+ * @scheduler: An #IrisScheduler
+ * @stats: An #IrisSchedulerManagerStats to fill in
+ *
+ * Gets a snapshot of the scheduler manager's accounting for @scheduler,
+ * which shows why it is or isn't growing. The fields are read one at a
+ * time without stopping the scheduler, so they need not be consistent
+ * with each other while it is busy.
+ */
+void
+iris_scheduler_manager_get_stats (IrisScheduler             *scheduler,
+                                  IrisSchedulerManagerStats *stats)
+{
+	IrisSchedulerRecord *record;
+	gint                 last_grow;
+
+	g_return_if_fail (IRIS_IS_SCHEDULER (scheduler));
+	g_return_if_fail (stats != NULL);
+
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	record = &scheduler->priv->record;
+
+	stats->n_threads = g_atomic_int_get (&record->n_threads);
+	stats->min_threads = iris_scheduler_get_min_threads (scheduler);
+	stats->max_threads = iris_scheduler_get_max_threads (scheduler);
+	stats->n_pending = g_atomic_int_get (&record->n_pending);
+	stats->n_requests = g_atomic_int_get (&record->n_requests);
+	stats->n_grown = g_atomic_int_get (&record->n_grown);
+	stats->n_lent = g_atomic_int_get (&record->n_lent);
+	stats->target = g_atomic_int_get (&record->target);
+	if (stats->target == G_MAXINT)
+		stats->target = -1;
+	stats->maxed = g_atomic_int_get (&scheduler->maxed);
+
+	last_grow = g_atomic_int_get (&record->last_grow);
+
+	if (last_grow == -1)
+		stats->last_grow = -1.0;
+	else
+		stats->last_grow = (guint)(iris_scheduler_manager_get_clock () -
+		                           last_grow) / 1000.0;
 }
 
 /**
@@ -267,13 +858,104 @@ iris_scheduler_manager_get_spare_thread_count ()
 	if (G_UNLIKELY (!singleton))
 		iris_scheduler_manager_init ();
 
-	G_LOCK (singleton);
-	spare_thread_count = g_list_length (singleton->free_list);
-	G_UNLOCK (singleton);
+	spare_thread_count = g_atomic_int_get (&singleton->n_free);
 
 	return spare_thread_count;
 }
 
+/**
+ * iris_scheduler_manager_set_idle_reserve:
+ * @n_threads: number of idle threads to keep
+ *
+ * Sets how many idle threads the scheduler manager keeps around for new
+ * schedulers and for schedulers that need extra threads. Threads beyond
+ * this that stay idle for longer than the idle timeout exit, see
+ * iris_scheduler_manager_set_idle_timeout(). The default is the number of
+ * processors.
+ */
+void
+iris_scheduler_manager_set_idle_reserve (guint n_threads)
+{
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	g_atomic_int_set (&singleton->idle_reserve, MIN (n_threads, G_MAXINT));
+}
+
+/**
+ * iris_scheduler_manager_get_idle_reserve:
+ *
+ * See iris_scheduler_manager_set_idle_reserve().
+ *
+ * Return value: the number of idle threads that are never retired
+ */
+guint
+iris_scheduler_manager_get_idle_reserve (void)
+{
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	return g_atomic_int_get (&singleton->idle_reserve);
+}
+
+/**
+ * iris_scheduler_manager_set_idle_timeout:
+ * @timeout: time in milliseconds
+ *
+ * Sets how long a thread which no scheduler is using waits for work
+ * before it exits, unless it is part of the idle reserve. The new timeout
+ * applies from the next time each thread becomes idle. The default is 5
+ * seconds.
+ */
+void
+iris_scheduler_manager_set_idle_timeout (guint timeout)
+{
+	g_return_if_fail (timeout > 0);
+
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	g_atomic_int_set (&singleton->idle_timeout, MIN (timeout, G_MAXINT));
+}
+
+/**
+ * iris_scheduler_manager_get_idle_timeout:
+ *
+ * See iris_scheduler_manager_set_idle_timeout().
+ *
+ * Return value: the time in milliseconds before idle threads are retired
+ */
+guint
+iris_scheduler_manager_get_idle_timeout (void)
+{
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	return g_atomic_int_get (&singleton->idle_timeout);
+}
+
+/**
+ * iris_scheduler_manager_get_thread_counts:
+ * @n_created: location for the number of threads created, or %NULL
+ * @n_retired: location for the number of threads retired, or %NULL
+ *
+ * Gets how many threads the scheduler manager has created and how many of
+ * them have since exited after being idle. The difference is the number of
+ * threads that currently exist.
+ */
+void
+iris_scheduler_manager_get_thread_counts (guint *n_created,
+                                          guint *n_retired)
+{
+	if (G_UNLIKELY (!singleton))
+		iris_scheduler_manager_init ();
+
+	if (n_created)
+		*n_created = g_atomic_int_get (&singleton->n_created);
+	if (n_retired)
+		*n_retired = g_atomic_int_get (&singleton->n_retired);
+}
+
 /**
  * iris_scheduler_manager_print_stat:
  *
@@ -293,12 +975,376 @@ iris_scheduler_manager_print_stat (void)
 		return;
 	}
 
-	G_LOCK (singleton);
+	G_LOCK (all_threads);
 
 	for (iter = singleton->all_list; iter; iter = iter->next)
 		iris_thread_print_stat (iter->data);
 
-	G_UNLOCK (singleton);
+	G_UNLOCK (all_threads);
+
+	g_fprintf (stderr,
+	           "\n    %d threads created, %d retired, %d idle\n",
+	           g_atomic_int_get (&singleton->n_created),
+	           g_atomic_int_get (&singleton->n_retired),
+	           g_atomic_int_get (&singleton->n_free));
 
 	g_fprintf (stderr, "\n");
 }
+
+static guint64
+wheel_get_ticks (void)
+{
+	return (guint64)(g_timer_elapsed (wheel->clock, NULL) * G_USEC_PER_SEC)
+	       / WHEEL_TICK_USECS;
+}
+
+static void
+iris_timeout_unref (gpointer data)
+{
+	IrisTimeout *timeout = data;
+
+	if (!g_atomic_int_dec_and_test (&timeout->ref_count))
+		return;
+
+	if (timeout->notify)
+		timeout->notify (timeout->data);
+
+	g_object_unref (timeout->scheduler);
+	g_slice_free (IrisTimeout, timeout);
+}
+
+static void
+iris_timeout_dispatch (gpointer data)
+{
+	IrisTimeout *timeout = data;
+
+	timeout->func (timeout->data);
+}
+
+/* Called once the queued callback has run or has been unqueued */
+static void
+iris_timeout_dispatch_done (gpointer data)
+{
+	IrisTimeout *timeout = data;
+
+	g_atomic_int_set (&timeout->queued, FALSE);
+	iris_timeout_unref (timeout);
+}
+
+/* Puts @timeout in the slot for its expiry time relative to wheel->now. A
+ * timeout further away than the wheel can represent goes in the last slot
+ * it can reach and is placed again when that slot is cascaded.
+ */
+static void
+wheel_insert_unlocked (IrisTimeout *timeout)
+{
+	guint64 expires;
+	guint64 delta;
+	guint   level;
+
+	expires = MAX (timeout->expires, wheel->now);
+	delta = expires - wheel->now;
+
+	if (delta >= WHEEL_SPAN) {
+		expires = wheel->now + WHEEL_SPAN - 1;
+		delta = WHEEL_SPAN - 1;
+	}
+
+	for (level = 0; delta >> (WHEEL_BITS * (level + 1)); level++);
+
+	timeout->slot = &wheel->slots[level]
+	                             [(expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	g_queue_push_tail_link (timeout->slot, &timeout->link);
+}
+
+static void
+wheel_remove_unlocked (IrisTimeout *timeout)
+{
+	g_queue_unlink (timeout->slot, &timeout->link);
+	timeout->slot = NULL;
+}
+
+/* Returns the first tick from wheel->now on at which a slot needs to be
+ * expired or cascaded, or WHEEL_NEVER if the wheel is empty.
+ */
+static guint64
+wheel_next_tick_unlocked (void)
+{
+	guint64 next = WHEEL_NEVER;
+	guint64 block;
+	guint   level, shift, i;
+
+	if (wheel->n_timeouts == 0)
+		return WHEEL_NEVER;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		shift = WHEEL_BITS * level;
+
+		for (i = 0; i <= WHEEL_SIZE; i++) {
+			block = (wheel->now >> shift) + i;
+
+			/* Blocks are cascaded on their first tick */
+			if ((block << shift) < wheel->now)
+				continue;
+
+			if (wheel->slots[level][block & WHEEL_MASK].head) {
+				next = MIN (next, block << shift);
+				break;
+			}
+		}
+	}
+
+	return next;
+}
+
+/* Processes @tick, which must not be past wheel_next_tick_unlocked().
+ * Expired timeouts are appended to @expired with a reference for the work
+ * item that will run them.
+ */
+static void
+wheel_advance_unlocked (guint64  tick,
+                        GQueue  *expired)
+{
+	IrisTimeout *timeout;
+	GQueue       cascade;
+	GQueue      *slot;
+	GList       *link;
+	guint        level, shift;
+
+	wheel->now = tick;
+
+	/* Move the timeouts in the block we have entered down a level */
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		shift = WHEEL_BITS * level;
+
+		if (tick & ((G_GUINT64_CONSTANT (1) << shift) - 1))
+			break;
+
+		slot = &wheel->slots[level][(tick >> shift) & WHEEL_MASK];
+		cascade = *slot;
+		g_queue_init (slot);
+
+		while ((link = g_queue_pop_head_link (&cascade)) != NULL)
+			wheel_insert_unlocked (link->data);
+	}
+
+	slot = &wheel->slots[0][tick & WHEEL_MASK];
+
+	while ((link = g_queue_pop_head_link (slot)) != NULL) {
+		timeout = link->data;
+		timeout->slot = NULL;
+
+		if (timeout->interval > 0) {
+			/* Don't pile up runs of a periodic callback behind a slow
+			 * scheduler, and don't try to catch up on missed ones.
+			 */
+			timeout->expires = MAX (timeout->expires + timeout->interval,
+			                        tick + 1);
+			wheel_insert_unlocked (timeout);
+
+			if (!g_atomic_int_compare_and_exchange (&timeout->queued,
+			                                        FALSE, TRUE))
+				continue;
+
+			g_atomic_int_inc (&timeout->ref_count);
+		}
+		else {
+			/* The wheel's reference passes to the work item */
+			g_hash_table_remove (wheel->timeouts,
+			                     GUINT_TO_POINTER (timeout->id));
+			wheel->n_timeouts--;
+		}
+
+		g_queue_push_tail (expired, timeout);
+	}
+
+	wheel->now = tick + 1;
+}
+
+static gpointer
+wheel_thread_func (gpointer data)
+{
+	IrisTimeout *timeout;
+	GQueue       expired = G_QUEUE_INIT;
+	GTimeVal     wake_time;
+	guint64      current;
+	guint64      next;
+
+	g_mutex_lock (wheel->mutex);
+
+	for (;;) {
+		current = wheel_get_ticks ();
+
+		while (wheel->now <= current) {
+			next = wheel_next_tick_unlocked ();
+
+			if (next > current) {
+				wheel->now = current + 1;
+				break;
+			}
+
+			wheel_advance_unlocked (next, &expired);
+		}
+
+		if (expired.head) {
+			/* Queueing may need the scheduler manager, don't hold our lock */
+			g_mutex_unlock (wheel->mutex);
+
+			while ((timeout = g_queue_pop_head (&expired)) != NULL)
+				iris_scheduler_queue (timeout->scheduler,
+				                      iris_timeout_dispatch,
+				                      timeout,
+				                      iris_timeout_dispatch_done);
+
+			g_mutex_lock (wheel->mutex);
+			continue;
+		}
+
+		wheel->wake = wheel_next_tick_unlocked ();
+
+		if (wheel->wake == WHEEL_NEVER)
+			g_cond_wait (wheel->cond, wheel->mutex);
+		else {
+			g_get_current_time (&wake_time);
+			g_time_val_add (&wake_time,
+			                (wheel->wake - current) * WHEEL_TICK_USECS);
+			g_cond_timed_wait (wheel->cond, wheel->mutex, &wake_time);
+		}
+
+		wheel->wake = WHEEL_NEVER;
+	}
+
+	return NULL;
+}
+
+static gpointer
+wheel_init (gpointer data)
+{
+	guint level, i;
+
+	wheel = g_slice_new0 (IrisTimingWheel);
+	wheel->mutex = g_mutex_new ();
+	wheel->cond = g_cond_new ();
+	wheel->clock = g_timer_new ();
+	wheel->now = 0;
+	wheel->wake = WHEEL_NEVER;
+	wheel->timeouts = g_hash_table_new (g_direct_hash, g_direct_equal);
+	wheel->next_id = 1;
+
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		for (i = 0; i < WHEEL_SIZE; i++)
+			g_queue_init (&wheel->slots[level][i]);
+
+	g_thread_create (wheel_thread_func, NULL, FALSE, NULL);
+
+	return NULL;
+}
+
+/**
+ * iris_scheduler_manager_add_timeout:
+ * @scheduler: An #IrisScheduler
+ * @interval: milliseconds until @func is queued
+ * @periodic: whether to queue @func every @interval milliseconds
+ * @func: An #IrisCallback
+ * @data: data for @func
+ * @notify: called with @data once the timeout is removed and not running
+ *
+ * Adds a timeout to the timing wheel. See iris_scheduler_queue_timeout().
+ *
+ * Return value: the id of the timeout, which is never 0
+ */
+guint
+iris_scheduler_manager_add_timeout (IrisScheduler  *scheduler,
+                                    guint           interval,
+                                    gboolean        periodic,
+                                    IrisCallback    func,
+                                    gpointer        data,
+                                    GDestroyNotify  notify)
+{
+	static GOnce  wheel_once = G_ONCE_INIT;
+	IrisTimeout  *timeout;
+	guint64       ticks;
+	guint         id;
+
+	g_once (&wheel_once, wheel_init, NULL);
+
+	ticks = (guint64)interval * 1000 / WHEEL_TICK_USECS;
+
+	timeout = g_slice_new0 (IrisTimeout);
+	timeout->ref_count = 1;
+	timeout->scheduler = g_object_ref (scheduler);
+	timeout->func = func;
+	timeout->data = data;
+	timeout->notify = notify;
+	timeout->interval = periodic ? MAX (ticks, 1) : 0;
+	timeout->queued = FALSE;
+	timeout->link.data = timeout;
+
+	g_mutex_lock (wheel->mutex);
+
+	/* The timer thread does not keep the clock up to date while the wheel
+	 * is empty.
+	 */
+	if (wheel->n_timeouts == 0)
+		wheel->now = wheel_get_ticks () + 1;
+
+	do
+		id = wheel->next_id++;
+	while (id == 0 ||
+	       g_hash_table_lookup (wheel->timeouts, GUINT_TO_POINTER (id)));
+
+	timeout->id = id;
+
+	/* Part of the current tick has already gone, so count from the next one
+	 * or the timeout could fire up to a tick early.
+	 */
+	timeout->expires = wheel_get_ticks () + 1 + MAX (ticks, 1);
+
+	g_hash_table_insert (wheel->timeouts, GUINT_TO_POINTER (id), timeout);
+	wheel_insert_unlocked (timeout);
+	wheel->n_timeouts++;
+
+	if (timeout->expires < wheel->wake)
+		g_cond_signal (wheel->cond);
+
+	g_mutex_unlock (wheel->mutex);
+
+	return id;
+}
+
+/**
+ * iris_scheduler_manager_remove_timeout:
+ * @timeout_id: id returned by iris_scheduler_manager_add_timeout()
+ *
+ * Removes a timeout from the timing wheel.
+ *
+ * Return value: %TRUE if the timeout was found and removed
+ */
+gboolean
+iris_scheduler_manager_remove_timeout (guint timeout_id)
+{
+	IrisTimeout *timeout;
+
+	if (G_UNLIKELY (!wheel))
+		return FALSE;
+
+	g_mutex_lock (wheel->mutex);
+
+	timeout = g_hash_table_lookup (wheel->timeouts,
+	                               GUINT_TO_POINTER (timeout_id));
+
+	if (!timeout) {
+		g_mutex_unlock (wheel->mutex);
+		return FALSE;
+	}
+
+	g_hash_table_remove (wheel->timeouts, GUINT_TO_POINTER (timeout_id));
+	wheel_remove_unlocked (timeout);
+	wheel->n_timeouts--;
+
+	g_mutex_unlock (wheel->mutex);
+
+	iris_timeout_unref (timeout);
+
+	return TRUE;
+}
@@ -27,6 +27,41 @@
 
 G_BEGIN_DECLS
 
+typedef struct _IrisSchedulerManagerStats IrisSchedulerManagerStats;
+
+/**
+ * IrisSchedulerManagerStats:
+ * @n_threads: threads working for the scheduler, including pending ones
+ * @min_threads: the scheduler's minimum number of threads
+ * @max_threads: the scheduler's maximum number of threads
+ * @n_pending: threads reserved for the scheduler but not yet added
+ * @n_requests: how many times the scheduler has asked for more threads
+ * @n_grown: how many threads those requests have added
+ * @n_lent: how many threads the scheduler may have beyond @max_threads
+ *   while some of its threads are blocked, see
+ *   iris_thread_enter_blocking()
+ * @target: how many threads the scheduler's #IrisGrowthPolicy last asked
+ *   for, or -1 if it has not been asked yet
+ * @maxed: whether the scheduler is at its maximum and has stopped asking
+ * @last_grow: seconds since the scheduler last grew, or -1 if it never has
+ *
+ * A snapshot of the scheduler manager's accounting for a scheduler, see
+ * iris_scheduler_manager_get_stats().
+ */
+struct _IrisSchedulerManagerStats
+{
+	gint     n_threads;
+	gint     min_threads;
+	gint     max_threads;
+	gint     n_pending;
+	gint     n_requests;
+	gint     n_grown;
+	gint     n_lent;
+	gint     target;
+	gboolean maxed;
+	gdouble  last_grow;
+};
+
 void iris_scheduler_manager_prepare                (IrisScheduler *scheduler);
 void iris_scheduler_manager_unprepare              (IrisScheduler *scheduler);
 void iris_scheduler_manager_request                (IrisScheduler *scheduler,
@@ -35,6 +70,17 @@ void iris_scheduler_manager_request                (IrisScheduler *scheduler,
 gint iris_scheduler_manager_get_spare_thread_count ();
 void iris_scheduler_manager_print_stat             (void);
 
+void  iris_scheduler_manager_set_idle_reserve      (guint          n_threads);
+guint iris_scheduler_manager_get_idle_reserve      (void);
+void  iris_scheduler_manager_set_idle_timeout      (guint          timeout);
+guint iris_scheduler_manager_get_idle_timeout      (void);
+void  iris_scheduler_manager_get_thread_counts     (guint         *n_created,
+                                                    guint         *n_retired);
+void  iris_scheduler_manager_set_blocking_budget  (guint          n_threads);
+guint iris_scheduler_manager_get_blocking_budget  (void);
+void  iris_scheduler_manager_get_stats             (IrisScheduler *scheduler,
+                                                    IrisSchedulerManagerStats *stats);
+
 G_END_DECLS
 
 #endif /* __IRIS_SCHEDULER_MANAGER_H__ */
@@ -25,6 +25,35 @@
 
 G_BEGIN_DECLS
 
+/* Highest CPU number accepted by iris_scheduler_set_affinity() */
+#define IRIS_SCHEDULER_MAX_CPU (1024)
+
+/* Most threads a scheduler can be lent beyond max_threads while some of its
+ * threads are blocked, see iris_scheduler_manager_enter_blocking(). Round
+ * robins are sized to leave room for them.
+ */
+#define IRIS_SCHEDULER_MAX_LENT (64)
+
+/* The scheduler manager's accounting for a scheduler, see
+ * iris_scheduler_manager_get_stats(). Only changed with atomic operations.
+ */
+typedef struct
+{
+	volatile gint n_threads;   /* Threads working for us, or on their way */
+	volatile gint n_pending;   /* Of those, ones not yet added            */
+	volatile gint n_requests;  /* Calls to iris_scheduler_manager_request() */
+	volatile gint n_grown;     /* Threads added by those requests         */
+	volatile gint last_grow;   /* Manager clock in ms at the last growth, *
+	                            * or -1                                    */
+	volatile gint target;      /* Threads the growth policy wants, extra *
+	                            * transient threads leave when idle        */
+	volatile gint n_lent;      /* Threads allowed beyond max_threads       */
+
+	/* Kept by the scheduler and its threads for the growth policy */
+	volatile gint n_queued;    /* Work items queued                       */
+	volatile gint n_completed; /* Work items finished or discarded        */
+} IrisSchedulerRecord;
+
 struct _IrisSchedulerPrivate
 {
 	GMutex      *mutex;        /* Synchronization for setting up the
@@ -54,10 +83,32 @@ struct _IrisSchedulerPrivate
 	guint             max_threads;
 	volatile gint     has_leader;
 	volatile gint     initialized;
+
+	GArray           *cpus;         /* CPUs to pin threads to, sorted by
+	                                 * node, or NULL to leave them free.
+	                                 */
+	volatile gint     next_cpu;     /* Index into cpus for the next thread */
+
+	IrisRRobin      **node_rrobin;  /* Per-thread queues grouped by the
+	                                 * node of their thread, only used
+	                                 * when cpus is set.
+	                                 */
+	guint             n_nodes;
+
+	IrisSchedulerRecord record;     /* Kept by the scheduler manager */
+
+	const IrisGrowthPolicy *growth_policy;  /* Consulted by the leader thread */
+
+	IrisQueueFactory  queue_factory;       /* Creates thread queues, or NULL */
+	gpointer          queue_factory_data;
 };
 
 IrisScheduler* iris_scheduler_new         (void);
 
+gboolean       iris_scheduler_bind_current_thread (gint cpu);
+
+IrisQueue*     iris_scheduler_create_queue (IrisScheduler *scheduler);
+
 G_END_DECLS
 
 #endif /* __IRIS_SCHEDULER_PRIVATE_H__ */
@@ -19,6 +19,10 @@
  */
 
 #ifdef LINUX
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
 #include <sys/sysinfo.h>
 #elif DARWIN
 #include <sys/param.h>
@@ -31,11 +35,13 @@
 #include <stdlib.h>
 
 #include "iris-debug.h"
+#include "iris-growth-policy.h"
 #include "iris-queue.h"
 #include "iris-rrobin.h"
 #include "iris-scheduler.h"
 #include "iris-scheduler-private.h"
 #include "iris-scheduler-manager.h"
+#include "iris-scheduler-manager-private.h"
 
 /**
  * SECTION:iris-scheduler
@@ -63,6 +69,12 @@
  * When destroyed, the scheduler will block until all of its threads have
  * worked through their queues.
  *
+ * On machines with several NUMA nodes, iris_scheduler_set_affinity() keeps
+ * the threads of a scheduler on a given set of CPUs. Each thread is pinned to
+ * one CPU from the set, filling up one node before moving on to the next, and
+ * work queued from a node is handed to a thread on the same node where
+ * possible so that its data stays in the local caches and memory.
+ *
  * The average user should not need to use the functions here; the #IrisTask
  * and #IrisProcess objects allow a higher-level way to schedule work
  * asynchronously.
@@ -180,7 +192,7 @@ iris_scheduler_queue_rrobin_cb (gpointer data,
 	/* If the queue is closed (meaning thread has finished) we will return
 	 * FALSE and the rrobin will call again with another queue
 	 */
-	return iris_queue_push (queue, thread_work);
+	return iris_queue_push_priority (queue, thread_work, thread_work->priority);
 }
 
 static void
@@ -189,15 +201,37 @@ iris_scheduler_queue_real (IrisScheduler  *scheduler,
                            gpointer        data,
                            GDestroyNotify  destroy_notify)
 {
-	IrisSchedulerPrivate *priv;
-	IrisThreadWork       *thread_work;
+	IrisThreadWork *thread_work;
 
 	g_return_if_fail (scheduler != NULL);
 	g_return_if_fail (func != NULL);
 
+	thread_work = iris_thread_work_new (func, data, destroy_notify);
+
+	IRIS_SCHEDULER_GET_CLASS (scheduler)->queue_work (scheduler, thread_work);
+}
+
+static void
+iris_scheduler_queue_work_real (IrisScheduler  *scheduler,
+                                IrisThreadWork *thread_work)
+{
+	IrisSchedulerPrivate *priv;
+
+	g_return_if_fail (scheduler != NULL);
+	g_return_if_fail (thread_work != NULL);
+
 	priv = scheduler->priv;
 
-	thread_work = iris_thread_work_new (func, data, destroy_notify);
+	/* Keep work on the node it was queued from, if we have threads there */
+	if (priv->node_rrobin != NULL) {
+		IrisRRobin *near;
+
+		near = priv->node_rrobin [iris_scheduler_get_current_node () % priv->n_nodes];
+
+		if (g_atomic_int_get (&near->count) > 0 &&
+		    iris_rrobin_apply (near, iris_scheduler_queue_rrobin_cb, thread_work))
+			return;
+	}
 
 	iris_rrobin_apply (priv->rrobin, iris_scheduler_queue_rrobin_cb, thread_work);
 }
@@ -260,7 +294,7 @@ iris_scheduler_foreach_rrobin_cb (IrisRRobin *rrobin,
 		                                   closure->user_data);
 
 		if (g_atomic_int_get (&thread_work->remove) == FALSE)
-			iris_queue_push (queue, thread_work);
+			iris_queue_push_priority (queue, thread_work, thread_work->priority);
 		else
 			iris_thread_work_free (thread_work);
 
@@ -330,18 +364,32 @@ iris_scheduler_add_thread_real (IrisScheduler  *scheduler,
 		/* we must be getting called from sched-manager-prepare,
 		 * so no need to lock our mutex as its already locked.
 		 */
-		max_threads = iris_scheduler_get_max_threads (scheduler);
+		max_threads = iris_scheduler_get_max_threads (scheduler) +
+		              IRIS_SCHEDULER_MAX_LENT;
 		priv->rrobin = iris_rrobin_new (max_threads);
+
+		if (priv->cpus != NULL) {
+			guint i;
+
+			priv->n_nodes = iris_scheduler_get_n_nodes ();
+			priv->node_rrobin = g_new (IrisRRobin*, priv->n_nodes);
+			for (i = 0; i < priv->n_nodes; i++)
+				priv->node_rrobin [i] = iris_rrobin_new (max_threads);
+		}
 	}
 
 	/* create the threads queue for the round robin */
-	queue = iris_queue_new ();
+	if (!(queue = iris_scheduler_create_queue (scheduler)))
+		queue = iris_queue_new ();
 	thread->user_data = queue;
 
 	/* add the item to the round robin */
 	if (!iris_rrobin_append (priv->rrobin, queue))
 		goto error;
 
+	if (priv->node_rrobin != NULL && thread->node >= 0)
+		iris_rrobin_append (priv->node_rrobin [thread->node % priv->n_nodes], queue);
+
 	/* FIXME: No synchronisation !!! */
 	priv->thread_list = g_list_prepend (priv->thread_list, thread);
 
@@ -378,6 +426,9 @@ iris_scheduler_remove_thread_real (IrisScheduler *scheduler,
 
 	iris_rrobin_remove (priv->rrobin, work_queue);
 
+	if (priv->node_rrobin != NULL && thread->node >= 0)
+		iris_rrobin_remove (priv->node_rrobin [thread->node % priv->n_nodes], work_queue);
+
 	thread->user_data = NULL;
 
 	priv->thread_list = g_list_remove (priv->thread_list, thread);
@@ -455,6 +506,17 @@ iris_scheduler_finalize (GObject *object)
 	if (priv->rrobin != NULL)
 		iris_rrobin_unref (priv->rrobin);
 
+	if (priv->node_rrobin != NULL) {
+		guint i;
+
+		for (i = 0; i < priv->n_nodes; i++)
+			iris_rrobin_unref (priv->node_rrobin [i]);
+		g_free (priv->node_rrobin);
+	}
+
+	if (priv->cpus != NULL)
+		g_array_free (priv->cpus, TRUE);
+
 	g_mutex_free (priv->mutex);
 
 	G_OBJECT_CLASS (iris_scheduler_parent_class)->finalize (object);
@@ -466,6 +528,7 @@ iris_scheduler_class_init (IrisSchedulerClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
 	klass->queue = iris_scheduler_queue_real;
+	klass->queue_work = iris_scheduler_queue_work_real;
 	klass->unqueue = iris_scheduler_unqueue_real;
 	klass->foreach = iris_scheduler_foreach_real;
 	klass->get_min_threads = iris_scheduler_get_min_threads_real;
@@ -497,6 +560,19 @@ iris_scheduler_init (IrisScheduler *scheduler)
 	scheduler->priv->min_threads = 0;
 	scheduler->priv->max_threads = 0;
 
+	scheduler->priv->cpus = NULL;
+	scheduler->priv->next_cpu = 0;
+	scheduler->priv->node_rrobin = NULL;
+	scheduler->priv->n_nodes = 0;
+
+	scheduler->priv->record.last_grow = -1;
+	scheduler->priv->record.target = G_MAXINT;
+
+	scheduler->priv->growth_policy = iris_growth_policy_get_adaptive ();
+
+	scheduler->priv->queue_factory = NULL;
+	scheduler->priv->queue_factory_data = NULL;
+
 	/* Actual init happens lazily from iris_scheduler_queue() */
 	scheduler->priv->initialized = FALSE;
 }
@@ -536,6 +612,338 @@ iris_scheduler_new_full (guint min_threads,
 	return scheduler;
 }
 
+static gboolean
+iris_scheduler_parse_cpu_list (const gchar *cpu_list,
+                               GArray      *cpus)
+{
+	const gchar *p = cpu_list;
+	gchar       *end;
+	guint64      first, last;
+	guint        cpu;
+
+	while (*p != '\0') {
+		first = g_ascii_strtoull (p, &end, 10);
+		if (end == p)
+			return FALSE;
+		p = end;
+		last = first;
+
+		if (*p == '-') {
+			p++;
+			last = g_ascii_strtoull (p, &end, 10);
+			if (end == p || last < first)
+				return FALSE;
+			p = end;
+		}
+
+		if (last >= IRIS_SCHEDULER_MAX_CPU)
+			return FALSE;
+
+		for (cpu = first; cpu <= last; cpu++)
+			g_array_append_val (cpus, cpu);
+
+		if (*p == ',')
+			p++;
+		else if (*p != '\0')
+			return FALSE;
+	}
+
+	return cpus->len > 0;
+}
+
+/* Formats a list of CPUs sorted by number as used by the kernel, e.g. "0-3,8" */
+static gchar*
+iris_scheduler_format_cpu_list (GArray *cpus)
+{
+	GString *str;
+	guint    first, last;
+	guint    i;
+
+	str = g_string_new (NULL);
+
+	for (i = 0; i < cpus->len; i++) {
+		first = last = g_array_index (cpus, guint, i);
+
+		while (i + 1 < cpus->len && g_array_index (cpus, guint, i + 1) == last + 1)
+			last = g_array_index (cpus, guint, ++i);
+
+		if (str->len > 0)
+			g_string_append_c (str, ',');
+
+		if (first == last)
+			g_string_append_printf (str, "%u", first);
+		else
+			g_string_append_printf (str, "%u-%u", first, last);
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+static gint
+iris_scheduler_compare_cpu (gconstpointer a,
+                            gconstpointer b)
+{
+	guint cpu_a = *(const guint *)a;
+	guint cpu_b = *(const guint *)b;
+
+	return (cpu_a > cpu_b) - (cpu_a < cpu_b);
+}
+
+static gint
+iris_scheduler_compare_cpu_by_node (gconstpointer a,
+                                    gconstpointer b)
+{
+	guint node_a = iris_scheduler_get_cpu_node (*(const guint *)a);
+	guint node_b = iris_scheduler_get_cpu_node (*(const guint *)b);
+
+	if (node_a != node_b)
+		return (node_a > node_b) - (node_a < node_b);
+
+	return iris_scheduler_compare_cpu (a, b);
+}
+
+/**
+ * iris_scheduler_set_affinity:
+ * @scheduler: An #IrisScheduler
+ * @cpu_list: the CPUs to run on, such as "0-3,8", or %NULL
+ *
+ * Pins the threads of @scheduler to the CPUs in @cpu_list, which uses the
+ * same format as the Linux kernel: CPU numbers and ranges separated by commas.
+ * Each thread is pinned to a single CPU, taking them node by node, so
+ * a scheduler with fewer threads than CPUs keeps them on as few NUMA nodes
+ * as possible. While the affinity is set, #IrisScheduler hands work to
+ * a thread on the same node as the caller if there is one, and
+ * #IrisWSScheduler threads steal from their own node first.
+ *
+ * iris_scheduler_get_node_cpus() gives the CPUs of a whole node. Passing
+ * %NULL lets the threads run anywhere again, which is the default.
+ *
+ * The affinity can only be changed before any work has been queued to
+ * @scheduler, and is ignored by schedulers which do not run work on
+ * #IrisThread<!-- -->s, such as #IrisGMainScheduler. Pinning is currently
+ * supported on Linux only. CPUs which are offline or outside the
+ * affinity of the process leave the thread unpinned.
+ *
+ * Return value: %TRUE if the affinity was set, %FALSE if @cpu_list could not
+ *               be parsed or @scheduler has already started.
+ */
+gboolean
+iris_scheduler_set_affinity (IrisScheduler *scheduler,
+                             const gchar   *cpu_list)
+{
+	IrisSchedulerPrivate *priv;
+	GArray               *cpus = NULL;
+	gboolean              result = FALSE;
+	guint                 i;
+
+	g_return_val_if_fail (IRIS_IS_SCHEDULER (scheduler), FALSE);
+
+	priv = scheduler->priv;
+
+	if (cpu_list != NULL) {
+		cpus = g_array_new (FALSE, FALSE, sizeof (guint));
+
+		if (!iris_scheduler_parse_cpu_list (cpu_list, cpus)) {
+			g_array_free (cpus, TRUE);
+			return FALSE;
+		}
+
+		g_array_sort (cpus, iris_scheduler_compare_cpu_by_node);
+
+		for (i = 1; i < cpus->len; i++)
+			if (g_array_index (cpus, guint, i) == g_array_index (cpus, guint, i - 1))
+				g_array_remove_index (cpus, i--);
+	}
+
+	g_mutex_lock (priv->mutex);
+
+	if (!g_atomic_int_get (&priv->initialized)) {
+		if (priv->cpus != NULL)
+			g_array_free (priv->cpus, TRUE);
+		priv->cpus = cpus;
+		cpus = NULL;
+		result = TRUE;
+	}
+
+	g_mutex_unlock (priv->mutex);
+
+	if (cpus != NULL)
+		g_array_free (cpus, TRUE);
+
+	return result;
+}
+
+/**
+ * iris_scheduler_get_affinity:
+ * @scheduler: An #IrisScheduler
+ *
+ * Retrieves the CPUs the threads of @scheduler are pinned to, as set with
+ * iris_scheduler_set_affinity().
+ *
+ * Return value: a newly allocated string such as "0-3,8", or %NULL if the
+ *               threads may run on any CPU. Free with g_free().
+ */
+gchar*
+iris_scheduler_get_affinity (IrisScheduler *scheduler)
+{
+	IrisSchedulerPrivate *priv;
+	GArray               *cpus;
+	gchar                *result = NULL;
+
+	g_return_val_if_fail (IRIS_IS_SCHEDULER (scheduler), NULL);
+
+	priv = scheduler->priv;
+
+	g_mutex_lock (priv->mutex);
+
+	if (priv->cpus != NULL) {
+		cpus = g_array_sized_new (FALSE, FALSE, sizeof (guint), priv->cpus->len);
+		g_array_append_vals (cpus, priv->cpus->data, priv->cpus->len);
+		g_array_sort (cpus, iris_scheduler_compare_cpu);
+		result = iris_scheduler_format_cpu_list (cpus);
+		g_array_free (cpus, TRUE);
+	}
+
+	g_mutex_unlock (priv->mutex);
+
+	return result;
+}
+
+/**
+ * iris_scheduler_set_growth_policy:
+ * @scheduler: An #IrisScheduler
+ * @policy: An #IrisGrowthPolicy, or %NULL for the default
+ *
+ * Sets how @scheduler decides to grow beyond its minimum number of
+ * threads and to shrink back, see #IrisGrowthPolicy. The default is
+ * iris_growth_policy_get_adaptive(). @policy must stay valid for as long
+ * as @scheduler exists.
+ *
+ * This must be called before any work is queued on @scheduler.
+ *
+ * Return value: %TRUE if the policy was set, %FALSE if @scheduler has
+ *               already started
+ */
+gboolean
+iris_scheduler_set_growth_policy (IrisScheduler          *scheduler,
+                                  const IrisGrowthPolicy *policy)
+{
+	IrisSchedulerPrivate *priv;
+	gboolean              result = FALSE;
+
+	g_return_val_if_fail (IRIS_IS_SCHEDULER (scheduler), FALSE);
+	g_return_val_if_fail (policy == NULL || policy->sample != NULL, FALSE);
+
+	priv = scheduler->priv;
+
+	if (policy == NULL)
+		policy = iris_growth_policy_get_adaptive ();
+
+	g_mutex_lock (priv->mutex);
+
+	if (!g_atomic_int_get (&priv->initialized)) {
+		priv->growth_policy = policy;
+		result = TRUE;
+	}
+
+	g_mutex_unlock (priv->mutex);
+
+	return result;
+}
+
+/**
+ * iris_scheduler_get_growth_policy:
+ * @scheduler: An #IrisScheduler
+ *
+ * Retrieves the growth policy of @scheduler, see
+ * iris_scheduler_set_growth_policy().
+ *
+ * Return value: the #IrisGrowthPolicy of @scheduler
+ */
+const IrisGrowthPolicy*
+iris_scheduler_get_growth_policy (IrisScheduler *scheduler)
+{
+	g_return_val_if_fail (IRIS_IS_SCHEDULER (scheduler), NULL);
+
+	return scheduler->priv->growth_policy;
+}
+
+/**
+ * iris_scheduler_set_queue_factory:
+ * @scheduler: An #IrisScheduler
+ * @factory: An #IrisQueueFactory, or %NULL for the default
+ * @user_data: data for @factory
+ *
+ * Sets the function which creates the queue of each thread of @scheduler,
+ * for example to use an #IrisRingQueue. By default #IrisScheduler uses
+ * #IrisQueue and #IrisLFScheduler uses #IrisLFQueue. The threads of an
+ * #IrisWSScheduler always have an #IrisWSQueue, so @factory creates the
+ * global queue they fall back to instead.
+ *
+ * This must be called before any work is queued on @scheduler.
+ *
+ * Return value: %TRUE if the factory was set, %FALSE if @scheduler has
+ *               already started
+ */
+gboolean
+iris_scheduler_set_queue_factory (IrisScheduler    *scheduler,
+                                  IrisQueueFactory  factory,
+                                  gpointer          user_data)
+{
+	IrisSchedulerPrivate *priv;
+	gboolean              result = FALSE;
+
+	g_return_val_if_fail (IRIS_IS_SCHEDULER (scheduler), FALSE);
+
+	priv = scheduler->priv;
+
+	g_mutex_lock (priv->mutex);
+
+	if (!g_atomic_int_get (&priv->initialized)) {
+		priv->queue_factory = factory;
+		priv->queue_factory_data = factory? user_data: NULL;
+		result = TRUE;
+	}
+
+	g_mutex_unlock (priv->mutex);
+
+	return result;
+}
+
+/* Creates a queue with the factory of @scheduler. Returns %NULL if there
+ * is none, so that the caller can fall back to its own kind of queue.
+ */
+IrisQueue*
+iris_scheduler_create_queue (IrisScheduler *scheduler)
+{
+	IrisSchedulerPrivate *priv = scheduler->priv;
+
+	if (G_LIKELY (priv->queue_factory == NULL))
+		return NULL;
+
+	return priv->queue_factory (priv->queue_factory_data);
+}
+
+/* Lazy initialization of the scheduler. By holding off until we
+ * need this, we attempt to reduce our total thread usage.
+ */
+static void
+iris_scheduler_prepare (IrisScheduler *scheduler)
+{
+	IrisSchedulerPrivate *priv;
+
+	priv = scheduler->priv;
+
+	if (G_UNLIKELY (!priv->initialized)) {
+		g_mutex_lock (priv->mutex);
+		if (G_LIKELY (!g_atomic_int_get (&priv->initialized))) {
+			iris_scheduler_manager_prepare (scheduler);
+			g_atomic_int_set (&priv->initialized, TRUE);
+		}
+		g_mutex_unlock (priv->mutex);
+	}
+}
+
 /**
  * iris_scheduler_queue:
  * @scheduler: An #IrisScheduler
@@ -564,26 +972,192 @@ iris_scheduler_queue (IrisScheduler  *scheduler,
                       gpointer        data,
                       GDestroyNotify  destroy_notify)
 {
-	IrisSchedulerPrivate *priv;
+	g_return_if_fail (scheduler != NULL);
+
+	iris_scheduler_prepare (scheduler);
+	g_atomic_int_inc (&scheduler->priv->record.n_queued);
+
+	IRIS_SCHEDULER_GET_CLASS (scheduler)->queue (scheduler, func, data, destroy_notify);
+	/* Some of our threads are blocked, see if this needs another */
+	if (G_UNLIKELY (g_atomic_int_get (&scheduler->priv->record.n_lent) > 0))
+		iris_scheduler_manager_lend (scheduler);
+}
+
+/**
+ * iris_scheduler_queue_full:
+ * @scheduler: An #IrisScheduler
+ * @priority: An #IrisSchedulerPriority
+ * @func: An #IrisCallback
+ * @data: data for @func
+ * @destroy_notify: an optional callback after execution to free data
+ *
+ * Like iris_scheduler_queue(), but @func is run before any work of a lower
+ * priority that is waiting in the same queue. This keeps urgent work, such
+ * as the messages which cancel an #IrisTask, from waiting behind a backlog
+ * of bulk work on a shared scheduler.
+ *
+ * Priorities are honoured by #IrisScheduler, #IrisLFScheduler,
+ * #IrisWSScheduler and #IrisGMainScheduler. Schedulers which only override
+ * the <function>queue</function> method ignore @priority.
+ */
+void
+iris_scheduler_queue_full (IrisScheduler         *scheduler,
+                           IrisSchedulerPriority  priority,
+                           IrisCallback           func,
+                           gpointer               data,
+                           GDestroyNotify         destroy_notify)
+{
+	IrisSchedulerClass *klass;
+	IrisThreadWork     *thread_work;
 
 	g_return_if_fail (scheduler != NULL);
+	g_return_if_fail (func != NULL);
 
-	priv = scheduler->priv;
+	iris_scheduler_prepare (scheduler);
+	g_atomic_int_inc (&scheduler->priv->record.n_queued);
 
-	/* Lazy initialization of the scheduler. By holding off until we
-	 * need this, we attempt to reduce our total thread usage.
-	 */
+	klass = IRIS_SCHEDULER_GET_CLASS (scheduler);
 
-	if (G_UNLIKELY (!priv->initialized)) {
-		g_mutex_lock (priv->mutex);
-		if (G_LIKELY (!g_atomic_int_get (&priv->initialized))) {
-			iris_scheduler_manager_prepare (scheduler);
-			g_atomic_int_set (&priv->initialized, TRUE);
-		}
-		g_mutex_unlock (priv->mutex);
+	if (G_UNLIKELY (klass->queue != iris_scheduler_queue_real &&
+	                klass->queue_work == iris_scheduler_queue_work_real))
+		klass->queue (scheduler, func, data, destroy_notify);
+	else {
+		thread_work = iris_thread_work_new (func, data, destroy_notify);
+		thread_work->priority = priority;
+
+		klass->queue_work (scheduler, thread_work);
 	}
 
-	IRIS_SCHEDULER_GET_CLASS (scheduler)->queue (scheduler, func, data, destroy_notify);
+	/* Some of our threads are blocked, see if this needs another */
+	if (G_UNLIKELY (g_atomic_int_get (&scheduler->priv->record.n_lent) > 0))
+		iris_scheduler_manager_lend (scheduler);
+}
+
+/**
+ * iris_scheduler_queue_work:
+ * @scheduler: An #IrisScheduler
+ * @thread_work: An #IrisThreadWork set up with iris_thread_work_init()
+ *
+ * Like iris_scheduler_queue(), but queues a work item which the caller has
+ * already set up, usually embedded in the data for the work. This avoids
+ * allocating an #IrisThreadWork for each item.
+ *
+ * The work is queued with the <structfield>priority</structfield> of
+ * @thread_work, see iris_scheduler_queue_full().
+ *
+ * Schedulers which only override the <function>queue</function> method are
+ * given the callback and data from @thread_work instead, and @thread_work
+ * itself is left unused.
+ */
+void
+iris_scheduler_queue_work (IrisScheduler  *scheduler,
+                           IrisThreadWork *thread_work)
+{
+	IrisSchedulerClass *klass;
+
+	g_return_if_fail (scheduler != NULL);
+	g_return_if_fail (thread_work != NULL);
+	g_return_if_fail (thread_work->callback != NULL);
+
+	iris_scheduler_prepare (scheduler);
+	g_atomic_int_inc (&scheduler->priv->record.n_queued);
+
+	klass = IRIS_SCHEDULER_GET_CLASS (scheduler);
+
+	if (G_UNLIKELY (klass->queue != iris_scheduler_queue_real &&
+	                klass->queue_work == iris_scheduler_queue_work_real))
+		klass->queue (scheduler, thread_work->callback, thread_work->data,
+		              thread_work->notify);
+	else
+		klass->queue_work (scheduler, thread_work);
+
+	if (G_UNLIKELY (g_atomic_int_get (&scheduler->priv->record.n_lent) > 0))
+		iris_scheduler_manager_lend (scheduler);
+}
+
+
+/**
+ * iris_scheduler_queue_timeout:
+ * @scheduler: An #IrisScheduler
+ * @interval: time in milliseconds before @func is queued
+ * @func: An #IrisCallback
+ * @data: data for @func
+ * @destroy_notify: an optional callback after execution to free data
+ *
+ * Queues @func on @scheduler once @interval milliseconds have passed. The
+ * timer is kept by the scheduler manager, so no thread of @scheduler is
+ * busy while waiting, and @func may still have to wait its turn in the
+ * queue after the timeout expires.
+ *
+ * This is a cheap way to coalesce work that does not need to happen every
+ * time something changes, for example sending progress updates.
+ *
+ * Return value: an id for iris_scheduler_remove_timeout(), which is never 0
+ */
+guint
+iris_scheduler_queue_timeout (IrisScheduler  *scheduler,
+                              guint           interval,
+                              IrisCallback    func,
+                              gpointer        data,
+                              GDestroyNotify  destroy_notify)
+{
+	g_return_val_if_fail (scheduler != NULL, 0);
+	g_return_val_if_fail (func != NULL, 0);
+
+	return iris_scheduler_manager_add_timeout (scheduler, interval, FALSE,
+	                                           func, data, destroy_notify);
+}
+
+/**
+ * iris_scheduler_queue_periodic:
+ * @scheduler: An #IrisScheduler
+ * @interval: time in milliseconds between each run of @func
+ * @func: An #IrisCallback
+ * @data: data for @func
+ * @destroy_notify: an optional callback to free data once the timeout is
+ *                  removed
+ *
+ * Like iris_scheduler_queue_timeout(), but @func is queued every @interval
+ * milliseconds until the timeout is removed with
+ * iris_scheduler_remove_timeout(). If @func is still waiting or running
+ * when the next interval expires, that run is skipped.
+ *
+ * @destroy_notify is called once the timeout has been removed and @func is
+ * no longer queued or running.
+ *
+ * Return value: an id for iris_scheduler_remove_timeout(), which is never 0
+ */
+guint
+iris_scheduler_queue_periodic (IrisScheduler  *scheduler,
+                               guint           interval,
+                               IrisCallback    func,
+                               gpointer        data,
+                               GDestroyNotify  destroy_notify)
+{
+	g_return_val_if_fail (scheduler != NULL, 0);
+	g_return_val_if_fail (func != NULL, 0);
+
+	return iris_scheduler_manager_add_timeout (scheduler, interval, TRUE,
+	                                           func, data, destroy_notify);
+}
+
+/**
+ * iris_scheduler_remove_timeout:
+ * @timeout_id: id returned by iris_scheduler_queue_timeout() or
+ *              iris_scheduler_queue_periodic()
+ *
+ * Removes a timeout so its callback is not queued again. A callback that
+ * has already been queued is not affected.
+ *
+ * Return value: %TRUE if the timeout was removed, %FALSE if it had already
+ *               expired or been removed
+ */
+gboolean
+iris_scheduler_remove_timeout (guint timeout_id)
+{
+	g_return_val_if_fail (timeout_id != 0, FALSE);
+
+	return iris_scheduler_manager_remove_timeout (timeout_id);
 }
 
 /**
@@ -684,6 +1258,30 @@ iris_scheduler_get_min_threads (IrisScheduler *scheduler)
 	return IRIS_SCHEDULER_GET_CLASS (scheduler)->get_min_threads (scheduler);
 }
 
+/* Picks the CPU @thread should run on while it works for @scheduler. The
+ * thread applies it itself once it starts managing our queue, see
+ * iris_scheduler_bind_current_thread().
+ */
+static void
+iris_scheduler_place_thread (IrisScheduler *scheduler,
+                             IrisThread    *thread)
+{
+	IrisSchedulerPrivate *priv;
+	guint                 index;
+
+	priv = scheduler->priv;
+
+	if (priv->cpus == NULL) {
+		thread->cpu = -1;
+		thread->node = -1;
+		return;
+	}
+
+	index = g_atomic_int_exchange_and_add (&priv->next_cpu, 1);
+	thread->cpu = g_array_index (priv->cpus, guint, index % priv->cpus->len);
+	thread->node = iris_scheduler_get_cpu_node (thread->cpu);
+}
+
 /**
  * iris_scheduler_add_thread:
  * @scheduler: An #IrisScheduler
@@ -700,6 +1298,8 @@ iris_scheduler_add_thread (IrisScheduler *scheduler,
                            IrisThread    *thread,
                            gboolean       exclusive)
 {
+	iris_scheduler_place_thread (scheduler, thread);
+
 	IRIS_SCHEDULER_GET_CLASS (scheduler)->add_thread (scheduler, thread, exclusive);
 }
 
@@ -758,3 +1358,200 @@ iris_scheduler_get_n_cpu (void)
 	}
 	return n_cpu;
 }
+
+/* NUMA topology of the machine, read once from sysfs */
+typedef struct
+{
+	guint   n_nodes;
+	GArray *cpu_node;  /* Node of each CPU, indexed by CPU number */
+} IrisTopology;
+
+static gpointer
+iris_scheduler_topology_init (gpointer data)
+{
+	IrisTopology *topology;
+	guint         node = 0;
+
+	topology = g_new0 (IrisTopology, 1);
+	topology->cpu_node = g_array_new (FALSE, TRUE, sizeof (guint));
+
+#ifdef LINUX
+	/* Nodes are numbered from zero without gaps on the machines we know of */
+	for (node = 0; ; node++) {
+		GArray *cpus;
+		gchar  *path;
+		gchar  *contents = NULL;
+		guint   cpu;
+		guint   i;
+
+		path = g_strdup_printf ("/sys/devices/system/node/node%u/cpulist", node);
+		g_file_get_contents (path, &contents, NULL, NULL);
+		g_free (path);
+
+		if (contents == NULL)
+			break;
+
+		cpus = g_array_new (FALSE, FALSE, sizeof (guint));
+
+		if (iris_scheduler_parse_cpu_list (g_strstrip (contents), cpus)) {
+			for (i = 0; i < cpus->len; i++) {
+				cpu = g_array_index (cpus, guint, i);
+				if (cpu >= topology->cpu_node->len)
+					g_array_set_size (topology->cpu_node, cpu + 1);
+				g_array_index (topology->cpu_node, guint, cpu) = node;
+			}
+		}
+
+		g_array_free (cpus, TRUE);
+		g_free (contents);
+	}
+#endif
+
+	topology->n_nodes = MAX (node, 1);
+
+	return topology;
+}
+
+static IrisTopology*
+iris_scheduler_get_topology (void)
+{
+	static GOnce topology_once = G_ONCE_INIT;
+
+	return g_once (&topology_once, iris_scheduler_topology_init, NULL);
+}
+
+/**
+ * iris_scheduler_get_n_nodes:
+ *
+ * Returns the number of NUMA nodes in the system, which is usually the number
+ * of processor sockets. Systems which do not report their NUMA topology
+ * are treated as a single node.
+ *
+ * Return value: the number of NUMA nodes, at least 1.
+ */
+guint
+iris_scheduler_get_n_nodes (void)
+{
+	return iris_scheduler_get_topology ()->n_nodes;
+}
+
+/**
+ * iris_scheduler_get_cpu_node:
+ * @cpu: a CPU number
+ *
+ * Looks up the NUMA node that @cpu belongs to.
+ *
+ * Return value: the node of @cpu, or 0 if it is not known.
+ */
+guint
+iris_scheduler_get_cpu_node (guint cpu)
+{
+	IrisTopology *topology = iris_scheduler_get_topology ();
+
+	if (cpu >= topology->cpu_node->len)
+		return 0;
+
+	return g_array_index (topology->cpu_node, guint, cpu);
+}
+
+/**
+ * iris_scheduler_get_current_node:
+ *
+ * Returns the NUMA node of the CPU the calling thread is running on. Unless
+ * the thread is pinned, this can change at any time, so the result should
+ * only be used as a hint.
+ *
+ * Return value: the node the caller is running on, or 0 if it is not known.
+ */
+guint
+iris_scheduler_get_current_node (void)
+{
+	IrisThread *thread;
+
+	/* Our own threads know where they were put */
+	thread = iris_thread_get ();
+	if (thread != NULL && thread->bound_cpu >= 0)
+		return iris_scheduler_get_cpu_node (thread->bound_cpu);
+
+#ifdef LINUX
+	{
+		gint cpu = sched_getcpu ();
+		if (cpu >= 0)
+			return iris_scheduler_get_cpu_node (cpu);
+	}
+#endif
+
+	return 0;
+}
+
+/**
+ * iris_scheduler_get_node_cpus:
+ * @node: a NUMA node
+ *
+ * Describes the CPUs of @node in the format taken by
+ * iris_scheduler_set_affinity(), so that a scheduler can be kept on
+ * a single node.
+ *
+ * Return value: a newly allocated string such as "0-3,8", or %NULL if the
+ *               CPUs of @node are not known. Free with g_free().
+ */
+gchar*
+iris_scheduler_get_node_cpus (guint node)
+{
+	IrisTopology *topology = iris_scheduler_get_topology ();
+	GArray       *cpus;
+	gchar        *result = NULL;
+	guint         cpu;
+
+	cpus = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	for (cpu = 0; cpu < topology->cpu_node->len; cpu++)
+		if (g_array_index (topology->cpu_node, guint, cpu) == node)
+			g_array_append_val (cpus, cpu);
+
+	if (cpus->len > 0)
+		result = iris_scheduler_format_cpu_list (cpus);
+
+	g_array_free (cpus, TRUE);
+
+	return result;
+}
+
+/* Pins the calling thread to @cpu, or lets it run anywhere it could before
+ * we first pinned a thread if @cpu is -1. Returns %FALSE if the system
+ * refused, or does not support pinning.
+ */
+gboolean
+iris_scheduler_bind_current_thread (gint cpu)
+{
+#ifdef LINUX
+	static gsize      initial_once = 0;
+	static cpu_set_t  initial_set;
+	cpu_set_t         set;
+
+	if (g_once_init_enter (&initial_once)) {
+		/* No thread has been pinned by us yet, so this is the affinity
+		 * of the process.
+		 */
+		if (sched_getaffinity (0, sizeof (initial_set), &initial_set) != 0) {
+			guint i;
+
+			CPU_ZERO (&initial_set);
+			for (i = 0; i < iris_scheduler_get_n_cpu (); i++)
+				CPU_SET (i, &initial_set);
+		}
+		g_once_init_leave (&initial_once, 1);
+	}
+
+	if (cpu < 0) {
+		set = initial_set;
+	} else {
+		CPU_ZERO (&set);
+		CPU_SET (cpu, &set);
+	}
+
+	return sched_setaffinity (0, sizeof (set), &set) == 0;
+#else
+	return FALSE;
+#endif
+}
@@ -59,6 +59,43 @@ typedef struct _IrisSchedulerClass   IrisSchedulerClass;
 typedef struct _IrisSchedulerPrivate IrisSchedulerPrivate;
 typedef struct _IrisThread           IrisThread;
 typedef struct _IrisThreadWork       IrisThreadWork;
+typedef struct _IrisGrowthPolicy     IrisGrowthPolicy;
+
+/**
+ * IrisSchedulerPriority:
+ * @IRIS_SCHEDULER_PRIORITY_HIGH: urgent work, such as the messages which
+ *   control an #IrisTask
+ * @IRIS_SCHEDULER_PRIORITY_NORMAL: the priority of iris_scheduler_queue()
+ * @IRIS_SCHEDULER_PRIORITY_LOW: work which can wait for everything else
+ *
+ * Priorities for iris_scheduler_queue_full(). A worker thread always takes
+ * work of a higher priority from its queue first, but does not interrupt
+ * work which is already running.
+ */
+typedef enum
+{
+	IRIS_SCHEDULER_PRIORITY_HIGH   = -1,
+	IRIS_SCHEDULER_PRIORITY_NORMAL = 0,
+	IRIS_SCHEDULER_PRIORITY_LOW    = 1
+} IrisSchedulerPriority;
+
+/**
+ * IrisPerformanceHint:
+ * @IRIS_NO_HINT: nothing is known about the work
+ * @IRIS_CPU_BOUND: the work keeps a processor busy, so running more of it
+ *   at once than there are processors only slows it down
+ * @IRIS_IO_BOUND: the work mostly waits, for example on files or the
+ *   network, so running more of it at once than there are threads helps
+ *
+ * Tells the scheduler manager whether more threads would help some work,
+ * see iris_task_set_performance_hint().
+ */
+typedef enum
+{
+	IRIS_NO_HINT,
+	IRIS_CPU_BOUND,
+	IRIS_IO_BOUND
+} IrisPerformanceHint;
 
 /**
  * IrisCallback
@@ -68,6 +105,17 @@ typedef struct _IrisThreadWork       IrisThreadWork;
  */
 typedef void   (*IrisCallback)       (gpointer data);
 
+/**
+ * IrisQueueFactory:
+ * @user_data: user data passed to iris_scheduler_set_queue_factory()
+ *
+ * Creates the queue which a thread of a scheduler takes its work from, see
+ * iris_scheduler_set_queue_factory().
+ *
+ * Returns: a new #IrisQueue
+ */
+typedef IrisQueue* (*IrisQueueFactory) (gpointer user_data);
+
 /**
  * IrisSchedulerForeachFunc:
  * @scheduler: the #IrisScheduler executing the foreach
@@ -125,8 +173,26 @@ struct _IrisSchedulerClass
 
 	/* Private */
 	void    (*iterate)       (IrisScheduler  *scheduler);
+
+	void    (*queue_work)    (IrisScheduler  *scheduler,
+	                          IrisThreadWork *thread_work);
 };
 
+/**
+ * IRIS_BLOCKING:
+ * @statement: a statement which may block
+ *
+ * Runs @statement between iris_thread_enter_blocking() and
+ * iris_thread_leave_blocking(), for example
+ * <literal>IRIS_BLOCKING (n_read = read (fd, buffer, length));</literal>
+ */
+#define IRIS_BLOCKING(statement)                                        \
+	G_STMT_START {                                                  \
+		iris_thread_enter_blocking ();                          \
+		statement;                                              \
+		iris_thread_leave_blocking ();                          \
+	} G_STMT_END
+
 struct _IrisThread
 {
 	gpointer       user_data;
@@ -149,6 +215,21 @@ struct _IrisThread
 	GMutex                  *mutex;      /* Mutex for changing thread  *
 	                                      * state. e.g. active queue.  */
 	IrisQueue               *active;     /* Active processing queue, or NULL if idle */
+	gint                     cpu;        /* CPU the scheduler placed   *
+	                                      * us on, or -1               */
+	gint                     node;       /* NUMA node of cpu, or -1    */
+	gint                     bound_cpu;  /* CPU we are pinned to, only *
+	                                      * touched by the thread      */
+	volatile gint            idle_state; /* Generation and state in    *
+	                                      * the scheduler manager's    *
+	                                      * free threads              */
+	gint                     blocking;   /* Depth of blocking regions, *
+	                                      * only touched by the thread */
+	IrisScheduler           *lent_to;    /* Scheduler lent a thread    *
+	                                      * while we block, or NULL    */
+	gboolean                 cpu_bound;  /* Running CPU-bound work,    *
+	                                      * whose slot is given up     *
+	                                      * while we block             */
 };
 
 struct _IrisThreadWork
@@ -160,6 +241,14 @@ struct _IrisThreadWork
 	/* FIXME: would be nice to make these flags, but need to stay atomic */
 	volatile gint     taken;
 	volatile gint     remove;
+
+	/* Set by iris_thread_work_init(), in which case the work is part of a
+	 * larger structure that @notify is responsible for releasing.
+	 */
+	gboolean          embedded;
+
+	/* An #IrisSchedulerPriority, normal unless set before queueing */
+	gint              priority;
 };
 
 IrisScheduler*  iris_get_default_control_scheduler (void);
@@ -174,13 +263,44 @@ IrisScheduler*  iris_scheduler_new             (void);
 IrisScheduler*  iris_scheduler_new_full        (guint           min_threads,
                                                 guint           max_threads);
 
+gboolean        iris_scheduler_set_affinity    (IrisScheduler  *scheduler,
+                                                const gchar    *cpu_list);
+gchar*          iris_scheduler_get_affinity    (IrisScheduler  *scheduler);
+
 gint            iris_scheduler_get_min_threads (IrisScheduler  *scheduler);
 gint            iris_scheduler_get_max_threads (IrisScheduler  *scheduler);
 
+gboolean        iris_scheduler_set_growth_policy (IrisScheduler          *scheduler,
+                                                  const IrisGrowthPolicy *policy);
+const IrisGrowthPolicy*
+                iris_scheduler_get_growth_policy (IrisScheduler          *scheduler);
+
+gboolean        iris_scheduler_set_queue_factory (IrisScheduler          *scheduler,
+                                                  IrisQueueFactory        factory,
+                                                  gpointer                user_data);
+
 void            iris_scheduler_queue           (IrisScheduler  *scheduler,
                                                 IrisCallback    func,
                                                 gpointer        data,
                                                 GDestroyNotify  destroy_notify);
+void            iris_scheduler_queue_full      (IrisScheduler  *scheduler,
+                                                IrisSchedulerPriority priority,
+                                                IrisCallback    func,
+                                                gpointer        data,
+                                                GDestroyNotify  destroy_notify);
+void            iris_scheduler_queue_work      (IrisScheduler  *scheduler,
+                                                IrisThreadWork *thread_work);
+guint           iris_scheduler_queue_timeout   (IrisScheduler  *scheduler,
+                                                guint           interval,
+                                                IrisCallback    func,
+                                                gpointer        data,
+                                                GDestroyNotify  destroy_notify);
+guint           iris_scheduler_queue_periodic  (IrisScheduler  *scheduler,
+                                                guint           interval,
+                                                IrisCallback    func,
+                                                gpointer        data,
+                                                GDestroyNotify  destroy_notify);
+gboolean        iris_scheduler_remove_timeout  (guint           timeout_id);
 gboolean        iris_scheduler_unqueue         (IrisScheduler  *scheduler,
                                                 gpointer        work_item);
 void            iris_scheduler_foreach         (IrisScheduler            *scheduler,
@@ -202,13 +322,23 @@ void            iris_thread_manage             (IrisThread *thread,
                                                 gboolean    leader);
 void            iris_thread_shutdown           (IrisThread *thread);
 void            iris_thread_print_stat         (IrisThread *thread);
+void            iris_thread_enter_blocking     (void);
+void            iris_thread_leave_blocking     (void);
 IrisThreadWork* iris_thread_work_new           (IrisCallback    callback,
                                                 gpointer        data,
                                                 GDestroyNotify  destroy_notify);
+void            iris_thread_work_init          (IrisThreadWork *thread_work,
+                                                IrisCallback    callback,
+                                                gpointer        data,
+                                                GDestroyNotify  destroy_notify);
 void            iris_thread_work_free          (IrisThreadWork *thread_work);
 void            iris_thread_work_run           (IrisThreadWork *thread_work);
 
 guint           iris_scheduler_get_n_cpu       ();
+guint           iris_scheduler_get_n_nodes     (void);
+guint           iris_scheduler_get_cpu_node    (guint           cpu);
+guint           iris_scheduler_get_current_node (void);
+gchar*          iris_scheduler_get_node_cpus   (guint           node);
 
 G_END_DECLS
 
@@ -18,30 +18,25 @@
  * 02110-1301 USA
  */
 
+#include "iris-atomics.h"
 #include "iris-stack.h"
 #include "iris-stack-private.h"
-#include "gstamppointer.h"
 
 /**
  * SECTION:iris-stack
  * @title: IrisStack
  * @short_description: A lock-free stack
  *
- * #IrisStack is a lock-free stack implementation.  It is not currently
- * guaranteed to be fully correct.  This is due to the classical ABA
- * problem with many lock-free data structures.  For more information
- * on ABA, see the wikipedia page at
- * <ulink url="http://en.wikipedia.org/wiki/ABA_problem">ABA_problem</ulink>.
- *
- * We do try to greatly reduce the potential of this happening.  This is done
- * by aligning the destination of our internal pointers to sizeof(void*)
- * which leaves us the two lower bits to repurpose as a counter stamp.  This
- * makes the pointer different on every compare-and-swap operation allowing
- * us to fail and retry the operation.  As you might have guessed, if the
- * ABA problem happens 4 times within the pre-emption time of the first
- * thread, the problem can still exist.
+ * #IrisStack is a lock-free stack implementation.
  *
- * You can typically solve this with an indirection node.
+ * Lock-free stacks are prone to the classical ABA problem.  For more
+ * information on ABA, see the wikipedia page at
+ * <ulink url="http://en.wikipedia.org/wiki/ABA_problem">ABA_problem</ulink>.
+ * #IrisStack avoids it by keeping a full word counter next to the head
+ * pointer and swapping both with a double-width compare-and-swap.  The
+ * counter changes on every push and pop, so a thread that was pre-empted
+ * between reading the head and swapping it will fail and retry even if
+ * the same link has made its way back to the top of the stack.
  */
 
 static void iris_stack_free (IrisStack *stack);
@@ -128,20 +123,20 @@ void
 iris_stack_push (IrisStack *stack,
                  gpointer   data)
 {
-	IrisLink *link;
+	GStampPair  old;
+	IrisLink   *link;
 
 	g_return_if_fail (stack != NULL);
 
 	link = iris_free_list_get (stack->free_list);
-
-	link = G_STAMP_POINTER_INCREMENT (link);
-	G_STAMP_POINTER_GET_LINK (link)->data = data;
+	link->data = data;
 
 	do {
-		G_STAMP_POINTER_GET_LINK (link)->next = stack->head->next;
-	} while (!g_atomic_pointer_compare_and_exchange ((gpointer*)&stack->head->next,
-	                                                 G_STAMP_POINTER_GET_LINK (link)->next,
-	                                                 link));
+		G_STAMP_PAIR_LOAD (&stack->head->next, &old);
+		link->next.pointer = old.pointer;
+	} while (!iris_atomics_compare_and_exchange_pair (&stack->head->next,
+	                                                  old.pointer, old.stamp,
+	                                                  link));
 }
 
 /**
@@ -156,20 +151,22 @@ iris_stack_push (IrisStack *stack,
 gpointer
 iris_stack_pop (IrisStack *stack)
 {
-	IrisLink *link;
-	gpointer  result = NULL;
+	GStampPair  old;
+	IrisLink   *link;
+	gpointer    result = NULL;
 
 	g_return_val_if_fail (stack != NULL, NULL);
 
 	do {
-		link = stack->head->next;
+		G_STAMP_PAIR_LOAD (&stack->head->next, &old);
+		link = old.pointer;
 		if (link == NULL)
 			return NULL;
-	} while (!g_atomic_pointer_compare_and_exchange ((gpointer*)&stack->head->next,
-	                                                 link,
-	                                                 G_STAMP_POINTER_GET_LINK (link)->next));
+	} while (!iris_atomics_compare_and_exchange_pair (&stack->head->next,
+	                                                  old.pointer, old.stamp,
+	                                                  link->next.pointer));
 
-	result = G_STAMP_POINTER_GET_LINK (link)->data;
+	result = link->data;
 	iris_free_list_put (stack->free_list, link);
 
 	return result;
@@ -187,12 +184,9 @@ _try_swap:
 	if (!g_atomic_pointer_compare_and_exchange ((gpointer*)&stack->head, link, NULL))
 		goto _try_swap;
 
-	link = G_STAMP_POINTER_GET_POINTER (link);
-
 	while (link) {
-		tmp = G_STAMP_POINTER_GET_POINTER (link->next);
-		if (link)
-			g_slice_free (IrisLink, link);
+		tmp = link->next.pointer;
+		g_slice_free (IrisLink, link);
 		link = tmp;
 	}
 
@@ -86,6 +86,7 @@ struct _IrisTaskPrivate
 	              *work_scheduler;
 
 	IrisProgressMode progress_mode;
+	IrisPerformanceHint performance_hint;
 
 	GMutex        *mutex;         /* Mutex for result/error */
 	GValue         result;        /* Current task result */
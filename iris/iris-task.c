@@ -24,6 +24,7 @@
 #include "iris-debug.h"
 #include "iris-gmainscheduler.h"
 #include "iris-receiver-private.h"
+#include "iris-scheduler-manager-private.h"
 #include "iris-task.h"
 #include "iris-task-private.h"
 
@@ -443,6 +444,59 @@ iris_task_get_progress_mode (IrisTask *task)
 	return priv->progress_mode;
 }
 
+/**
+ * iris_task_set_performance_hint:
+ * @task: An #IrisTask
+ * @hint: An #IrisPerformanceHint
+ *
+ * Tells the scheduler manager what the work function of @task spends its
+ * time doing. This can only be set before iris_task_run() is called.
+ *
+ * Work hinted as %IRIS_CPU_BOUND waits its turn when there are already as
+ * many threads running CPU-bound work as there are processors, across all
+ * schedulers, rather than competing with it for processors. An
+ * #IrisProcess hinted this way also never uses more threads than there are
+ * processors, whatever iris_process_set_max_parallelism() allows. Work
+ * hinted this way which has to wait for other CPU-bound work should do so
+ * in a blocking region, see iris_thread_enter_blocking(), which gives up
+ * its processor until the region ends; otherwise the work it waits for may
+ * never get one. An #IrisProcess throttled by the process it forwards to
+ * already waits this way.
+ *
+ * Work hinted as %IRIS_IO_BOUND runs in a blocking region, as if it
+ * called iris_thread_enter_blocking(), so the work scheduler may be lent
+ * threads beyond its maximum while it runs and other work is not held up
+ * waiting for it.
+ *
+ * For an #IrisProcess, the hint applies to the work function, and so to
+ * every work item.
+ */
+void
+iris_task_set_performance_hint (IrisTask            *task,
+                                IrisPerformanceHint  hint)
+{
+	g_return_if_fail (IRIS_IS_TASK (task));
+	g_return_if_fail (FLAG_IS_OFF (task, IRIS_TASK_FLAG_STARTED));
+
+	task->priv->performance_hint = hint;
+}
+
+/**
+ * iris_task_get_performance_hint:
+ * @task: An #IrisTask
+ *
+ * See iris_task_set_performance_hint().
+ *
+ * Return value: the #IrisPerformanceHint of @task
+ */
+IrisPerformanceHint
+iris_task_get_performance_hint (IrisTask *task)
+{
+	g_return_val_if_fail (IRIS_IS_TASK (task), IRIS_NO_HINT);
+
+	return task->priv->performance_hint;
+}
+
 /**
  * iris_task_add_callback:
  * @task: An #IrisTask
@@ -1054,10 +1108,11 @@ iris_task_progress_callbacks (IrisTask *task)
 
 	if (G_UNLIKELY (task->priv->context)) {
 		scheduler = IRIS_SCHEDULER (task->priv->context_sched);
-		iris_scheduler_queue (scheduler,
-		                      (IrisCallback)iris_task_progress_callbacks_main,
-		                      task,
-		                      NULL);
+		iris_scheduler_queue_full (scheduler,
+		                           IRIS_SCHEDULER_PRIORITY_HIGH,
+		                           (IrisCallback)iris_task_progress_callbacks_main,
+		                           task,
+		                           NULL);
 	}
 	else {
 		RUN_NEXT_HANDLER (task);
@@ -1118,10 +1173,11 @@ iris_task_complete_async_result (IrisTask *task)
 
 	if (priv->context) {
 		/* Queue into the main context */
-		iris_scheduler_queue (IRIS_SCHEDULER (priv->context_sched),
-		                      (IrisCallback)g_simple_async_result_complete,
-		                      priv->async_result,
-		                      g_object_unref);
+		iris_scheduler_queue_full (IRIS_SCHEDULER (priv->context_sched),
+		                           IRIS_SCHEDULER_PRIORITY_HIGH,
+		                           (IrisCallback)g_simple_async_result_complete,
+		                           priv->async_result,
+		                           g_object_unref);
 	}
 	else {
 		g_simple_async_result_complete ((GSimpleAsyncResult*)priv->async_result);
@@ -1143,10 +1199,10 @@ iris_task_schedule (IrisTask *task)
 	DISABLE_FLAG (task, IRIS_TASK_FLAG_NEED_EXECUTE);
 	ENABLE_FLAG (task, IRIS_TASK_FLAG_WORK_ACTIVE);
 
-	iris_scheduler_queue (g_atomic_pointer_get (&priv->work_scheduler),
-	                      (IrisCallback)iris_task_execute,
-	                      task,
-	                      NULL);
+	iris_scheduler_manager_queue_hinted (g_atomic_pointer_get (&priv->work_scheduler),
+	                                     priv->performance_hint,
+	                                     (IrisCallback)iris_task_execute,
+	                                     task);
 }
 
 static void
@@ -1877,6 +1933,9 @@ iris_task_constructed (GObject *object)
 	                                       task,
 	                                       NULL);
 
+	/* Control messages such as cancel must not wait behind bulk work */
+	iris_receiver_set_priority (priv->receiver, IRIS_SCHEDULER_PRIORITY_HIGH);
+
 	iris_arbiter_coordinate (priv->receiver, NULL, NULL);
 }
 
@@ -2050,6 +2109,7 @@ iris_task_init (IrisTask *task)
 	priv->work_scheduler = NULL;
 
 	priv->progress_mode = IRIS_PROGRESS_ACTIVITY_ONLY;
+	priv->performance_hint = IRIS_NO_HINT;
 
 	priv->mutex = g_mutex_new ();
 
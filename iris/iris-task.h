@@ -204,6 +204,11 @@ void          iris_task_set_progress_mode     (IrisTask            *task,
 
 IrisProgressMode iris_task_get_progress_mode  (IrisTask            *task);
 
+void          iris_task_set_performance_hint  (IrisTask            *task,
+                                               IrisPerformanceHint  hint);
+IrisPerformanceHint
+              iris_task_get_performance_hint  (IrisTask            *task);
+
 void          iris_task_add_callback          (IrisTask            *task,
                                                IrisTaskFunc         callback,
                                                gpointer             user_data,
@@ -0,0 +1,52 @@
+/* iris-thread-private.h
+ *
+ * Copyright (C) 2009 Christian Hergert <chris@dronelabs.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA
+ * 02110-1301 USA
+ */
+
+#ifndef __IRIS_THREAD_PRIVATE_H__
+#define __IRIS_THREAD_PRIVATE_H__
+
+#include <glib.h>
+
+#include "iris-scheduler.h"
+
+G_BEGIN_DECLS
+
+/* Objects which are allocated on every message delivery. Each #IrisThread
+ * keeps a small magazine of free blocks of each type, see
+ * iris_thread_cache_alloc().
+ */
+typedef enum
+{
+	IRIS_THREAD_CACHE_MESSAGE,
+	IRIS_THREAD_CACHE_THREAD_WORK,
+	IRIS_THREAD_CACHE_WORKER_DATA,
+	IRIS_THREAD_CACHE_LAST
+} IrisThreadCacheType;
+
+gpointer iris_thread_cache_alloc (IrisThreadCacheType type, gsize size);
+void     iris_thread_cache_free  (gpointer mem);
+
+/* For benchmarks: while disabled every block comes from GSlice */
+void     iris_thread_cache_set_enabled (gboolean enabled);
+
+void     iris_thread_free        (IrisThread *thread);
+
+G_END_DECLS
+
+#endif /* __IRIS_THREAD_PRIVATE_H__ */
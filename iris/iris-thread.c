@@ -28,10 +28,13 @@
 #endif
 
 #include "iris-debug.h"
+#include "iris-growth-policy.h"
 #include "iris-message.h"
 #include "iris-queue.h"
 #include "iris-scheduler-manager.h"
 #include "iris-scheduler-manager-private.h"
+#include "iris-scheduler-private.h"
+#include "iris-thread-private.h"
 #include "iris-util.h"
 
 /**
@@ -45,8 +48,63 @@
 
 #define MSG_MANAGE            (1)
 #define MSG_SHUTDOWN          (2)
-#define QUANTUM_USECS         (G_USEC_PER_SEC / 1)
 #define POP_WAIT_TIMEOUT      (G_USEC_PER_SEC * 2)
+#define SHRINK_WAIT_TIMEOUT   (G_USEC_PER_SEC / 50)
+#define CACHE_MAGAZINE_SIZE   (64)
+#define CACHE_CLOSED          ((IrisThreadCacheItem*)GINT_TO_POINTER (1))
+#define CPU_UNKNOWN           (-2)
+
+typedef struct _IrisThreadCache     IrisThreadCache;
+typedef struct _IrisThreadCacheItem IrisThreadCacheItem;
+
+/* Header in front of every block handed out by iris_thread_cache_alloc().
+ * @next is only used while the block sits on its owner's return list.
+ */
+struct _IrisThreadCacheItem
+{
+	IrisThreadCache     *owner;
+	IrisThreadCacheItem *next;
+	guint                type;
+	guint                size;
+};
+
+/* The header rounded up to a multiple of two pointers, so that blocks are
+ * aligned as well as those from g_slice_alloc().
+ */
+#define CACHE_HEADER_SIZE \
+	((sizeof (IrisThreadCacheItem) + 2 * sizeof (gpointer) - 1) & \
+	 ~(2 * sizeof (gpointer) - 1))
+
+/* What iris_thread_new() allocates. The cache is only used by the thread
+ * itself, so it stays out of the public struct.
+ */
+typedef struct
+{
+	IrisThread       thread;
+	IrisThreadCache *cache;
+} IrisThreadReal;
+
+#define IRIS_THREAD_REAL(t) ((IrisThreadReal *)(t))
+
+static volatile gint cache_disabled = FALSE;
+
+struct _IrisThreadCache
+{
+	/* Only ever touched by the owning thread */
+	IrisThreadCacheItem *magazines[IRIS_THREAD_CACHE_LAST][CACHE_MAGAZINE_SIZE];
+	guint                n_cached[IRIS_THREAD_CACHE_LAST];
+
+	/* Blocks freed by other threads. They are pushed one at a time and
+	 * taken all at once by the owner, so there is no ABA problem. Set to
+	 * CACHE_CLOSED when the owning thread exits.
+	 */
+	IrisThreadCacheItem * volatile returned;
+
+	/* Blocks handed out and not yet back in a magazine, plus one held by
+	 * the owning thread until it exits.
+	 */
+	volatile gint        ref_count;
+};
 
 #if LINUX
 __thread IrisThread* my_thread = NULL;
@@ -58,13 +116,93 @@ static pthread_once_t my_thread_once = PTHREAD_ONCE_INIT;
 static pthread_key_t my_thread;
 #endif
 
-static gboolean
-timeout_elapsed (GTimeVal *start,
-                 GTimeVal *end)
+/* Caches of threads which are not IrisThreads, such as the main thread
+ * posting to a port. They hold at most CACHE_MAGAZINE_SIZE blocks of each
+ * type, plus whatever other threads have freed since the owner last
+ * allocated, which is bounded by what the owner allocated itself. The
+ * cache is closed by the GStaticPrivate destroy notify when a GThread
+ * exits; threads created outside of GLib never run it and keep their
+ * cached blocks until the process exits.
+ */
+static GStaticPrivate foreign_cache = G_STATIC_PRIVATE_INIT;
+
+static void iris_thread_cache_close (IrisThreadCache *cache);
+
+/* What the leader thread has seen since it last consulted the growth
+ * policy of its scheduler.
+ */
+typedef struct
+{
+	const IrisGrowthPolicy *policy;
+	gpointer                state;
+	GTimer                 *timer;
+	gdouble                 interval;     /* Seconds between samples      */
+	gdouble                 last_sample;
+	gdouble                 busy;         /* Seconds spent running work   */
+	gint                    n_run;
+	gint                    n_queued;     /* Scheduler counters at the    *
+	                                       * last sample                 */
+	gint                    n_completed;
+} IrisThreadGrowth;
+
+static void
+iris_thread_growth_init (IrisThreadGrowth *growth,
+                         IrisScheduler    *scheduler)
 {
-	GTimeVal end_by = *start;
-	g_time_val_add (&end_by, QUANTUM_USECS);
-	return (g_time_val_compare (&end_by, end) == 1);
+	IrisSchedulerRecord *record = &scheduler->priv->record;
+
+	growth->policy = scheduler->priv->growth_policy;
+	growth->state = growth->policy->create?
+	                growth->policy->create (scheduler): NULL;
+	growth->timer = g_timer_new ();
+	growth->interval = growth->policy->interval / 1000.0;
+	growth->last_sample = 0.0;
+	growth->busy = 0.0;
+	growth->n_run = 0;
+	growth->n_queued = g_atomic_int_get (&record->n_queued);
+	growth->n_completed = g_atomic_int_get (&record->n_completed);
+}
+
+static void
+iris_thread_growth_destroy (IrisThreadGrowth *growth)
+{
+	if (growth->policy->destroy)
+		growth->policy->destroy (growth->state);
+	g_timer_destroy (growth->timer);
+}
+
+static void
+iris_thread_growth_sample (IrisThreadGrowth *growth,
+                           IrisScheduler    *scheduler,
+                           gdouble           now)
+{
+	IrisSchedulerRecord *record = &scheduler->priv->record;
+	IrisGrowthSample     sample;
+	gint                 n_queued,
+	                     n_completed,
+	                     target;
+
+	n_queued = g_atomic_int_get (&record->n_queued);
+	n_completed = g_atomic_int_get (&record->n_completed);
+
+	sample.elapsed = now - growth->last_sample;
+	sample.n_arrived = n_queued - growth->n_queued;
+	sample.n_completed = n_completed - growth->n_completed;
+	sample.n_backlog = MAX (n_queued - n_completed, 0);
+	sample.n_run = growth->n_run;
+	sample.busy = growth->busy;
+	sample.n_threads = g_atomic_int_get (&record->n_threads);
+	sample.min_threads = iris_scheduler_get_min_threads (scheduler);
+	sample.max_threads = iris_scheduler_manager_get_ceiling (scheduler);
+
+	target = growth->policy->sample (growth->state, &sample);
+	iris_scheduler_manager_set_target (scheduler, target);
+
+	growth->last_sample = now;
+	growth->busy = 0.0;
+	growth->n_run = 0;
+	growth->n_queued = n_queued;
+	growth->n_completed = n_completed;
 }
 
 static void
@@ -72,29 +210,28 @@ iris_thread_worker_exclusive (IrisThread  *thread,
                               IrisQueue   *queue,
                               gboolean     leader)
 {
-	GTimeVal        tv_now      = {0,0};
-	GTimeVal        tv_req      = {0,0};
-	IrisThreadWork *thread_work = NULL;
-	gint            per_quanta = 0;      /* Completed items within the
-	                                      * last quanta. */
-	guint           queued      = 0;     /* Items left in the queue at */
-	gboolean        has_resized = FALSE;
-	gboolean        remove_work;
+	IrisScheduler    *scheduler   = thread->scheduler;
+	IrisThreadWork   *thread_work = NULL;
+	IrisThreadGrowth  growth;
+	gdouble           started,
+	                  now         = 0.0;
+	gboolean          remove_work;
 
 	iris_debug (IRIS_DEBUG_THREAD);
 
-	g_get_current_time (&tv_now);
-	g_get_current_time (&tv_req);
-	queued = iris_queue_get_length (queue);
-
 	/* Since our thread is in exclusive mode, we are responsible for
 	 * asking the scheduler manager to add or remove threads based
-	 * on the demand of our work queue.
+	 * on the demand of our work queue, as the scheduler's growth
+	 * policy sees it.
 	 *
-	 * If the scheduler has maxed out the number of threads it is
-	 * allowed, then we will not ask the scheduler to add more
-	 * threads and rebalance.
+	 * If the scheduler cannot grow then there is nothing to decide.
 	 */
+	if (leader && iris_scheduler_get_min_threads (scheduler) ==
+	              iris_scheduler_get_max_threads (scheduler))
+		leader = FALSE;
+
+	if (leader)
+		iris_thread_growth_init (&growth, scheduler);
 
 get_next_item:
 
@@ -113,16 +250,28 @@ get_next_item:
 			remove_work = g_atomic_int_get (&thread_work->remove);
 
 		if (!remove_work) {
-			iris_thread_work_run (thread_work);
-			per_quanta++;
+			if (G_UNLIKELY (leader)) {
+				started = g_timer_elapsed (growth.timer, NULL);
+				iris_thread_work_run (thread_work);
+				now = g_timer_elapsed (growth.timer, NULL);
+
+				growth.busy += now - started;
+				growth.n_run++;
+			}
+			else
+				iris_thread_work_run (thread_work);
 		}
 
 		iris_thread_work_free (thread_work);
+		g_atomic_int_inc (&scheduler->priv->record.n_completed);
 	}
 	else {
 		/* Queue is closed, so scheduler is finalizing. The scheduler will be
 		 * waiting until we set thread->scheduler to NULL.
 		 */
+		if (leader)
+			iris_thread_growth_destroy (&growth);
+
 		g_atomic_pointer_set (&thread->scheduler, NULL);
 		iris_scheduler_manager_yield (thread);
 		return;
@@ -131,37 +280,8 @@ get_next_item:
 	if (remove_work)
 		goto get_next_item;
 
-	if (G_UNLIKELY (!thread->scheduler->maxed && leader)) {
-		g_get_current_time (&tv_now);
-
-		if (G_UNLIKELY (timeout_elapsed (&tv_now, &tv_req))) {
-			/* We check to see if we have a bunch more work to do
-			 * or a potential edge case where we are processing about
-			 * the same speed as the pusher, but it creates enough
-			 * contention where we dont speed up. This is because
-			 * some schedulers will round-robin or steal.  And unless
-			 * we look to add another thread even though we have nothing
-			 * in the queue, we know there are more coming.
-			 */
-			queued = iris_queue_get_length (queue);
-			if (queued == 0 && !has_resized) {
-				queued = per_quanta * 2;
-				has_resized = TRUE;
-			}
-
-			if (per_quanta < queued) {
-				/* make sure we are not maxed before asking */
-				if (!g_atomic_int_get (&thread->scheduler->maxed))
-					iris_scheduler_manager_request (thread->scheduler,
-									per_quanta,
-									queued);
-			}
-
-			per_quanta = 0;
-			tv_req = tv_now;
-			g_time_val_add (&tv_req, QUANTUM_USECS);
-		}
-	}
+	if (G_UNLIKELY (leader && now - growth.last_sample >= growth.interval))
+		iris_thread_growth_sample (&growth, scheduler, now);
 
 	goto get_next_item;
 }
@@ -170,9 +290,11 @@ static void
 iris_thread_worker_transient (IrisThread  *thread,
                               IrisQueue   *queue)
 {
-	IrisThreadWork *thread_work = NULL;
-	GTimeVal        tv_timeout = {0,0};
-	gboolean        remove_work;
+	IrisScheduler       *scheduler   = thread->scheduler;
+	IrisSchedulerRecord *record      = &scheduler->priv->record;
+	IrisThreadWork      *thread_work = NULL;
+	GTimeVal             tv_timeout = {0,0};
+	gboolean             remove_work;
 
 	iris_debug (IRIS_DEBUG_THREAD);
 
@@ -185,7 +307,15 @@ iris_thread_worker_transient (IrisThread  *thread,
 
 	do {
 		g_get_current_time (&tv_timeout);
-		g_time_val_add (&tv_timeout, POP_WAIT_TIMEOUT);
+
+		/* If the scheduler has more threads than its growth policy
+		 * wants, or a blocked thread we were lent for has come back,
+		 * leave as soon as our queue runs dry.
+		 */
+		if (G_UNLIKELY (iris_scheduler_manager_wants_fewer (scheduler)))
+			g_time_val_add (&tv_timeout, SHRINK_WAIT_TIMEOUT);
+		else
+			g_time_val_add (&tv_timeout, POP_WAIT_TIMEOUT);
 
 		thread_work = iris_queue_timed_pop_or_close (queue, &tv_timeout);
 		if (thread_work != NULL) {
@@ -201,13 +331,18 @@ iris_thread_worker_transient (IrisThread  *thread,
 				iris_thread_work_run (thread_work);
 
 			iris_thread_work_free (thread_work);
+			g_atomic_int_inc (&record->n_completed);
 		}
 	} while (thread_work != NULL);
 
 	/* Remove the thread from the scheduler (if it's not already removed us due
 	 * to being in finalization), and yield our thread back to the scheduler manager */
-	if (g_atomic_int_get (&thread->scheduler->in_finalize) == FALSE)
-		iris_scheduler_remove_thread (thread->scheduler, thread);
+	if (g_atomic_int_get (&scheduler->in_finalize) == FALSE) {
+		iris_scheduler_remove_thread (scheduler, thread);
+
+		/* So the scheduler can grow again if the work comes back */
+		iris_scheduler_manager_release (scheduler);
+	}
 	g_atomic_pointer_set (&thread->scheduler, NULL);
 
 	iris_scheduler_manager_yield (thread);
@@ -221,6 +356,16 @@ iris_thread_handle_manage (IrisThread  *thread,
 {
 	g_return_if_fail (queue != NULL);
 
+	/* Move to wherever the scheduler placed us, or run free again if we
+	 * were pinned by our last scheduler and this one does not care.
+	 */
+	if (thread->cpu != thread->bound_cpu) {
+		if (iris_scheduler_bind_current_thread (thread->cpu))
+			thread->bound_cpu = thread->cpu;
+		else
+			thread->bound_cpu = CPU_UNKNOWN;
+	}
+
 	g_mutex_lock (thread->mutex);
 	thread->active = g_object_ref (queue);
 	g_mutex_unlock (thread->mutex);
@@ -246,8 +391,10 @@ iris_thread_handle_shutdown (IrisThread *thread)
 static gpointer
 iris_thread_worker (IrisThread *thread)
 {
-	IrisMessage *message;
-	GTimeVal     timeout = {0,0};
+	IrisMessage     *message;
+	IrisThreadCache *cache;
+	GTimeVal         timeout = {0,0};
+	guint            idle_timeout;
 
 	g_return_val_if_fail (thread != NULL, NULL);
 	g_return_val_if_fail (thread->queue != NULL, NULL);
@@ -264,38 +411,49 @@ iris_thread_worker (IrisThread *thread)
 	iris_debug (IRIS_DEBUG_THREAD);
 
 next_message:
-	if (thread->exclusive) {
-		message = g_async_queue_pop (thread->queue);
-	}
-	else {
-		/* If we do not get any schedulers to work for within our
-		 * timeout period, we can safely shutdown. */
-		g_get_current_time (&timeout);
-		g_time_val_add (&timeout, G_USEC_PER_SEC * 5);
-		message = g_async_queue_timed_pop (thread->queue, &timeout);
-
-		if (!message) {
-			/* Make sure that the manager removes us from the free thread list.
-			 * The manager can return FALSE to prevent shutdown if it has
-			 * decided to give us new work.
-			 */
-			if (!iris_scheduler_manager_destroy (thread))
-				goto next_message;
-
-			/* make sure nothing was added while we
-			 * removed ourselves */
-			message = g_async_queue_try_pop (thread->queue);
-		}
-	}
+	/* We only get here while we are not working for a scheduler, either
+	 * new or in the scheduler manager's free list. If we do not get any
+	 * schedulers to work for within the idle timeout, we can safely
+	 * shutdown. This applies to exclusive threads too, whose scheduler has
+	 * gone away.
+	 */
+	idle_timeout = iris_scheduler_manager_get_idle_timeout ();
+	g_get_current_time (&timeout);
+	timeout.tv_sec += idle_timeout / 1000;
+	g_time_val_add (&timeout, (idle_timeout % 1000) * 1000);
+	message = g_async_queue_timed_pop (thread->queue, &timeout);
+
+	if (!message) {
+		/* Make sure that the manager removes us from the free thread list.
+		 * The manager can return FALSE to prevent shutdown if it has
+		 * decided to give us new work, or to keep us in reserve.
+		 */
+		cache = IRIS_THREAD_REAL (thread)->cache;
+
+		if (!iris_scheduler_manager_destroy (thread))
+			goto next_message;
+
+		/* Whoever pops us from the free threads frees @thread, possibly
+		 * already, so don't touch it again.
+		 */
+		iris_thread_cache_close (cache);
+
+#if LINUX
+		my_thread = NULL;
+#elif defined(WIN32)
+		TlsSetValue (my_thread, NULL);
+#else
+		pthread_setspecific (my_thread, NULL);
+#endif
 
-	if (!message)
 		return NULL;
+	}
 
 	switch (message->what) {
 	case MSG_MANAGE: {
-		IrisQueue *queue = iris_message_get_pointer (message, "queue");
-		gboolean exclusive = iris_message_get_boolean (message, "exclusive");
-		gboolean leader = iris_message_get_boolean (message, "leader");
+		IrisQueue *queue = iris_message_get_pointer_q (message, IRIS_MESSAGE_KEY ("queue"));
+		gboolean exclusive = iris_message_get_boolean_q (message, IRIS_MESSAGE_KEY ("exclusive"));
+		gboolean leader = iris_message_get_boolean_q (message, IRIS_MESSAGE_KEY ("leader"));
 		iris_message_unref (message);
 
 		iris_thread_handle_manage (thread, queue, exclusive, leader);
@@ -313,6 +471,218 @@ next_message:
 	goto next_message;
 }
 
+static IrisThreadCache*
+iris_thread_cache_new (void)
+{
+	IrisThreadCache *cache;
+
+	cache = g_new0 (IrisThreadCache, 1);
+	cache->ref_count = 1;
+
+	return cache;
+}
+
+static void
+iris_thread_cache_unref (IrisThreadCache *cache)
+{
+	if (g_atomic_int_dec_and_test (&cache->ref_count))
+		g_free (cache);
+}
+
+static void
+iris_thread_cache_slice_free (IrisThreadCacheItem *item)
+{
+	g_slice_free1 (CACHE_HEADER_SIZE + item->size, item);
+}
+
+/* Keeps @item for reuse by the owning thread, which must be the caller */
+static void
+iris_thread_cache_put (IrisThreadCache     *cache,
+                       IrisThreadCacheItem *item)
+{
+	if (G_LIKELY (cache->n_cached[item->type] < CACHE_MAGAZINE_SIZE))
+		cache->magazines[item->type][cache->n_cached[item->type]++] = item;
+	else
+		iris_thread_cache_slice_free (item);
+
+	/* The owning thread still holds a reference */
+	g_atomic_int_add (&cache->ref_count, -1);
+}
+
+/* Atomically replaces the return list of @cache with @replacement and
+ * returns what was on it.
+ */
+static IrisThreadCacheItem*
+iris_thread_cache_take_returned (IrisThreadCache     *cache,
+                                 IrisThreadCacheItem *replacement)
+{
+	IrisThreadCacheItem *head;
+
+	do {
+		head = g_atomic_pointer_get (&cache->returned);
+		if (head == CACHE_CLOSED)
+			return NULL;
+	} while (!g_atomic_pointer_compare_and_exchange ((gpointer*)&cache->returned,
+	                                                 head, replacement));
+
+	return head;
+}
+
+static void
+iris_thread_cache_reclaim (IrisThreadCache *cache)
+{
+	IrisThreadCacheItem *item, *next;
+
+	if (G_LIKELY (g_atomic_pointer_get (&cache->returned) == NULL))
+		return;
+
+	for (item = iris_thread_cache_take_returned (cache, NULL); item; item = next) {
+		next = item->next;
+		iris_thread_cache_put (cache, item);
+	}
+}
+
+/* Called by the owning thread as it exits. Blocks still in use elsewhere
+ * go back to GSlice when they are freed, and the last one out frees the
+ * cache itself.
+ */
+static void
+iris_thread_cache_close (IrisThreadCache *cache)
+{
+	IrisThreadCacheItem *item, *next;
+	guint                type;
+
+	for (item = iris_thread_cache_take_returned (cache, CACHE_CLOSED); item; item = next) {
+		next = item->next;
+		iris_thread_cache_slice_free (item);
+		g_atomic_int_add (&cache->ref_count, -1);
+	}
+
+	for (type = 0; type < IRIS_THREAD_CACHE_LAST; type++)
+		while (cache->n_cached[type] > 0)
+			iris_thread_cache_slice_free (cache->magazines[type][--cache->n_cached[type]]);
+
+	iris_thread_cache_unref (cache);
+}
+
+static IrisThreadCache*
+iris_thread_cache_get (void)
+{
+	IrisThread      *thread;
+	IrisThreadCache *cache;
+
+	if (G_LIKELY ((thread = iris_thread_get ()) != NULL))
+		return IRIS_THREAD_REAL (thread)->cache;
+
+	if (G_UNLIKELY (!(cache = g_static_private_get (&foreign_cache)))) {
+		cache = iris_thread_cache_new ();
+		g_static_private_set (&foreign_cache, cache,
+		                      (GDestroyNotify)iris_thread_cache_close);
+	}
+
+	return cache;
+}
+
+/**
+ * iris_thread_cache_alloc:
+ * @type: the kind of object being allocated
+ * @size: the size of the object, which must be the same for every @type
+ *
+ * Allocates a block of @size bytes from the calling thread's cache, falling
+ * back to GSlice when the cache is empty. This avoids the locking in GSlice
+ * when blocks are passed between threads. The block is not cleared.
+ *
+ * Return value: a block which must be freed with iris_thread_cache_free()
+ */
+gpointer
+iris_thread_cache_alloc (IrisThreadCacheType type,
+                         gsize               size)
+{
+	IrisThreadCache     *cache;
+	IrisThreadCacheItem *item = NULL;
+
+	g_return_val_if_fail (type < IRIS_THREAD_CACHE_LAST, NULL);
+
+	cache = iris_thread_cache_get ();
+
+	if (G_UNLIKELY (cache->n_cached[type] == 0))
+		iris_thread_cache_reclaim (cache);
+
+	if (G_LIKELY (cache->n_cached[type] > 0 &&
+	              !g_atomic_int_get (&cache_disabled))) {
+		item = cache->magazines[type][--cache->n_cached[type]];
+		g_assert (item->size == size);
+	}
+	else {
+		item = g_slice_alloc (CACHE_HEADER_SIZE + size);
+		item->type = type;
+		item->size = size;
+	}
+
+	item->owner = cache;
+	g_atomic_int_inc (&cache->ref_count);
+
+	return (gchar *)item + CACHE_HEADER_SIZE;
+}
+
+/**
+ * iris_thread_cache_free:
+ * @mem: a block allocated with iris_thread_cache_alloc()
+ *
+ * Frees @mem. If it came from the calling thread's cache it is kept there
+ * for reuse; blocks from other threads are handed back to their owner
+ * through a lock-free return list.
+ */
+void
+iris_thread_cache_free (gpointer mem)
+{
+	IrisThreadCacheItem *item;
+	IrisThreadCache     *owner;
+	IrisThreadCacheItem *head;
+
+	if (G_UNLIKELY (!mem))
+		return;
+
+	item = (IrisThreadCacheItem *)((gchar *)mem - CACHE_HEADER_SIZE);
+	owner = item->owner;
+
+	if (G_UNLIKELY (g_atomic_int_get (&cache_disabled))) {
+		iris_thread_cache_slice_free (item);
+		iris_thread_cache_unref (owner);
+		return;
+	}
+
+	if (owner == iris_thread_cache_get ()) {
+		iris_thread_cache_put (owner, item);
+		return;
+	}
+
+	do {
+		head = g_atomic_pointer_get (&owner->returned);
+		if (head == CACHE_CLOSED) {
+			iris_thread_cache_slice_free (item);
+			iris_thread_cache_unref (owner);
+			return;
+		}
+		item->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange ((gpointer*)&owner->returned,
+	                                                 head, item));
+}
+
+/*
+ * iris_thread_cache_set_enabled:
+ * @enabled: %FALSE to bypass the caches
+ *
+ * Makes iris_thread_cache_alloc() and iris_thread_cache_free() go straight
+ * to GSlice, so benchmarks can compare against it. Blocks already cached
+ * stay where they are.
+ */
+void
+iris_thread_cache_set_enabled (gboolean enabled)
+{
+	g_atomic_int_set (&cache_disabled, !enabled);
+}
+
 GType
 iris_thread_get_type (void)
 {
@@ -364,10 +734,23 @@ iris_thread_new (gboolean exclusive)
 	pthread_once (&my_thread_once, _pthread_init);
 #endif
 
-	thread = g_slice_new0 (IrisThread);
+	thread = (IrisThread *)g_slice_new0 (IrisThreadReal);
+	IRIS_THREAD_REAL (thread)->cache = iris_thread_cache_new ();
 	thread->exclusive = exclusive;
 	thread->queue = g_async_queue_new ();
 	thread->mutex = g_mutex_new ();
+	thread->cpu = -1;
+	thread->node = -1;
+	thread->idle_state = 0;
+	thread->blocking = 0;
+	thread->lent_to = NULL;
+	thread->cpu_bound = FALSE;
+
+	/* We inherit the affinity of whoever created us, which may be a pinned
+	 * thread, so always set it the first time.
+	 */
+	thread->bound_cpu = CPU_UNKNOWN;
+
 	thread->thread  = g_thread_create_full ((GThreadFunc)iris_thread_worker,
 	                                        thread,
 	                                        0,     /* stack size    */
@@ -380,6 +763,23 @@ iris_thread_new (gboolean exclusive)
 	return thread;
 }
 
+/**
+ * iris_thread_free:
+ * @thread: An #IrisThread whose thread has exited
+ *
+ * Frees what is left of an #IrisThread once its thread has retired, see
+ * iris_scheduler_manager_destroy().
+ */
+void
+iris_thread_free (IrisThread *thread)
+{
+	g_return_if_fail (thread != NULL);
+
+	g_async_queue_unref (thread->queue);
+	g_mutex_free (thread->mutex);
+	g_slice_free (IrisThreadReal, IRIS_THREAD_REAL (thread));
+}
+
 /**
  * iris_thread_get:
  *
@@ -399,6 +799,72 @@ iris_thread_get (void)
 #endif
 }
 
+/**
+ * iris_thread_enter_blocking:
+ *
+ * Tells the scheduler of the current thread that the thread is about to
+ * block for a while, for example on file IO, a socket or a lock held by
+ * slow work. So that the scheduler keeps as many threads working as it
+ * was, the scheduler manager may lend it another thread until
+ * iris_thread_leave_blocking() is called, even beyond its maximum number
+ * of threads. Lent threads come from a budget shared by all schedulers,
+ * see iris_scheduler_manager_set_blocking_budget(), and leave as soon as
+ * they run out of work once the blocked thread is back.
+ *
+ * A thread running work hinted as %IRIS_CPU_BOUND also gives up its
+ * processor to other CPU-bound work for the length of the region.
+ *
+ * Blocking regions may be nested, only the outermost one is lent a
+ * thread. Outside of an #IrisThread this does nothing. See also
+ * IRIS_BLOCKING().
+ */
+void
+iris_thread_enter_blocking (void)
+{
+	IrisThread    *thread;
+	IrisScheduler *scheduler;
+
+	if (!(thread = iris_thread_get ()))
+		return;
+
+	if (thread->blocking++ > 0)
+		return;
+
+	if (thread->cpu_bound)
+		iris_scheduler_manager_release_cpu ();
+
+	scheduler = g_atomic_pointer_get (&thread->scheduler);
+	if (scheduler != NULL && iris_scheduler_manager_enter_blocking (scheduler))
+		thread->lent_to = scheduler;
+}
+
+/**
+ * iris_thread_leave_blocking:
+ *
+ * Ends a blocking region started with iris_thread_enter_blocking().
+ */
+void
+iris_thread_leave_blocking (void)
+{
+	IrisThread *thread;
+
+	if (!(thread = iris_thread_get ()))
+		return;
+
+	g_return_if_fail (thread->blocking > 0);
+
+	if (--thread->blocking > 0)
+		return;
+
+	if (thread->lent_to != NULL) {
+		iris_scheduler_manager_leave_blocking (thread->lent_to);
+		thread->lent_to = NULL;
+	}
+
+	if (thread->cpu_bound)
+		iris_scheduler_manager_reclaim_cpu ();
+}
+
 /**
  * iris_thread_manage:
  * @thread: An #IrisThread
@@ -430,11 +896,10 @@ iris_thread_manage (IrisThread    *thread,
 
 	iris_debug (IRIS_DEBUG_THREAD);
 
-	message = iris_message_new_items (MSG_MANAGE,
-	                                  "exclusive", G_TYPE_BOOLEAN, exclusive,
-	                                  "queue", G_TYPE_POINTER, queue,
-	                                  "leader", G_TYPE_BOOLEAN, leader,
-	                                  NULL);
+	message = iris_message_new (MSG_MANAGE);
+	iris_message_set_boolean_q (message, IRIS_MESSAGE_KEY ("exclusive"), exclusive);
+	iris_message_set_pointer_q (message, IRIS_MESSAGE_KEY ("queue"), queue);
+	iris_message_set_boolean_q (message, IRIS_MESSAGE_KEY ("leader"), leader);
 	iris_message_ref_sink (message);
 	g_async_queue_push (thread->queue, message);
 }
@@ -505,16 +970,55 @@ iris_thread_work_new (IrisCallback   callback,
 {
 	IrisThreadWork *thread_work;
 
-	thread_work = g_slice_new (IrisThreadWork);
+	thread_work = iris_thread_cache_alloc (IRIS_THREAD_CACHE_THREAD_WORK,
+	                                       sizeof (IrisThreadWork));
 	thread_work->callback = callback;
 	thread_work->data = data;
 	thread_work->notify = destroy_notify;
 	thread_work->taken = FALSE;
 	thread_work->remove = FALSE;
+	thread_work->embedded = FALSE;
+	thread_work->priority = IRIS_SCHEDULER_PRIORITY_NORMAL;
 
 	return thread_work;
 }
 
+/**
+ * iris_thread_work_init:
+ * @thread_work: An #IrisThreadWork embedded in a larger structure
+ * @callback: An #IrisCallback
+ * @data: user supplied data
+ * @destroy_notify: callback to free @data, and the structure containing
+ *   @thread_work
+ *
+ * Initializes an #IrisThreadWork which was allocated by the caller, usually
+ * as part of the structure passed as @data. This lets work be queued with
+ * iris_scheduler_queue_work() without a separate allocation.
+ * iris_thread_work_free() will call @destroy_notify but not free
+ * @thread_work itself, which must not be used after @destroy_notify has
+ * been called.
+ *
+ * The work has the normal priority. To queue it with another
+ * #IrisSchedulerPriority, set the <structfield>priority</structfield> of
+ * @thread_work before queueing it.
+ */
+void
+iris_thread_work_init (IrisThreadWork *thread_work,
+                       IrisCallback    callback,
+                       gpointer        data,
+                       GDestroyNotify  destroy_notify)
+{
+	g_return_if_fail (thread_work != NULL);
+
+	thread_work->callback = callback;
+	thread_work->data = data;
+	thread_work->notify = destroy_notify;
+	thread_work->taken = FALSE;
+	thread_work->remove = FALSE;
+	thread_work->embedded = TRUE;
+	thread_work->priority = IRIS_SCHEDULER_PRIORITY_NORMAL;
+}
+
 /**
  * iris_thread_work_run:
  * @thread_work: An #IrisThreadWork
@@ -540,12 +1044,16 @@ iris_thread_work_run (IrisThreadWork *thread_work)
 void
 iris_thread_work_free (IrisThreadWork *thread_work)
 {
+	gboolean embedded = thread_work->embedded;
+
 	thread_work->callback = NULL;
 
+	/* An embedded work item is released along with its data */
 	if (thread_work->notify != NULL)
 		thread_work->notify (thread_work->data);
 
-	g_slice_free (IrisThreadWork, thread_work);
+	if (!embedded)
+		iris_thread_cache_free (thread_work);
 }
 
 /**
@@ -25,21 +25,55 @@
 
 #include "iris-queue.h"
 #include "iris-rrobin.h"
+#include "iris-wsqueue.h"
 
 G_BEGIN_DECLS
 
+typedef struct _IrisWSQueueArray IrisWSQueueArray;
+
+/* How a queue that runs dry picks its victims and how much it takes */
+typedef enum
+{
+	IRIS_WSQUEUE_STEAL_ROUND_ROBIN, /* Next peer in turn, one item      */
+	IRIS_WSQUEUE_STEAL_RANDOM,      /* Random peer, one item            */
+	IRIS_WSQUEUE_STEAL_HALF         /* Random peer, up to half its items */
+} IrisWSQueueSteal;
+
+struct _IrisWSQueueArray
+{
+	IrisWSQueueArray *next;     /* Link in the list of retired arrays */
+	gint              epoch;    /* Thief epoch when it was retired */
+	gint              log_size;
+	gint              mask;
+	gpointer          items[1];
+};
+
 struct _IrisWSQueuePrivate
 {
-	IrisQueue     *global;
-	IrisRRobin    *rrobin;
-	gint           mask;
-	GMutex        *mutex;
-	volatile gint  head_idx;
-	volatile gint  tail_idx;
-	gpointer      *items;
-	gulong         length;
+	IrisQueue        *global;
+	IrisRRobin       *rrobin;
+	IrisRRobin       *near;      /* Peers on our NUMA node, or NULL */
+
+	volatile gint     top;       /* Next item to steal, advanced by CAS */
+	volatile gint     bottom;    /* Next free slot, only the owner writes */
+
+	IrisWSQueueArray *array;     /* Circular buffer, replaced on resize */
+	IrisWSQueueArray *retired;   /* Replaced buffers, owner only */
+	volatile gint     epoch;     /* Advanced by the owner, see reclaim */
+	volatile gint     n_thieves[2]; /* Thieves inside iris_wsqueue_try_steal(),
+	                                 * by the parity of their epoch */
+
+	IrisWSQueueSteal  steal;      /* Victim selection, owner only */
+	guint32           rand_state;
+	guint             next_victim;
 };
 
+void iris_wsqueue_set_near_peers   (IrisWSQueue      *queue,
+                                    IrisRRobin       *near);
+
+/* For benchmarks: the strategy used by queues created from now on */
+void iris_wsqueue_set_default_steal (IrisWSQueueSteal  steal);
+
 G_END_DECLS
 
 #endif /* __IRIS_WSQUEUE_PRIVATE_H__ */
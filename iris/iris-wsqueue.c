@@ -22,22 +22,18 @@
  * entry on Work Stealing Queues as well as Nir Shavit's research on the subject.
  *
  * http://www.bluebytesoftware.com/blog/PermaLink,guid,1665653b-b5f3-49b4-8144-cfbc5e8c632b.aspx
+ *
+ * The deque itself follows "Dynamic Circular Work-Stealing Deque" by David
+ * Chase and Yossi Lev: the owner pushes and pops at the bottom without any
+ * locks, thieves take from the top with a compare-and-swap, and the only
+ * contended operation is taking the very last item.
  */
 
 #include <string.h>
-#include <sys/time.h>
-#include <time.h>
-
-#ifdef WIN32
-#include <windows.h>
-#else
-#include <pthread.h>
-#include <sys/errno.h>
-#endif
 
 #include "iris-wsqueue.h"
 #include "iris-wsqueue-private.h"
-#include "gstamppointer.h"
+#include "iris-queue-private.h"
 
 /**
  * SECTION:iris-wsqueue
@@ -63,58 +59,106 @@ static gpointer iris_wsqueue_real_timed_pop  (IrisQueue *queue,
                                               GTimeVal  *timeout);
 static guint    iris_wsqueue_real_get_length (IrisQueue *queue);
 
-#define WSQUEUE_DEFAULT_SIZE 32
+#define WSQUEUE_DEFAULT_LOG_SIZE 5
+
+G_DEFINE_TYPE (IrisWSQueue, iris_wsqueue, IRIS_TYPE_QUEUE)
+
+static volatile gint default_steal = IRIS_WSQUEUE_STEAL_HALF;
+
+/* Indexes are compared through their difference so that they can safely
+ * wrap around.
+ */
+#define WSQUEUE_SIZE(b,t) ((gint)((guint)(b) - (guint)(t)))
 
-struct StealInfo
+static IrisWSQueueArray*
+iris_wsqueue_array_new (gint log_size)
 {
-	IrisQueue *queue;
-	gpointer   result;
-};
+	IrisWSQueueArray *array;
+	gint              size = 1 << log_size;
 
-G_DEFINE_TYPE (IrisWSQueue, iris_wsqueue, IRIS_TYPE_QUEUE)
+	array = g_malloc0 (G_STRUCT_OFFSET (IrisWSQueueArray, items) +
+	                   size * sizeof (gpointer));
+	array->mask = size - 1;
+	array->log_size = log_size;
 
-#if DARWIN
-static gboolean
-timeout_passed (const struct timespec *timeout)
+	return array;
+}
+
+static IrisWSQueueArray*
+iris_wsqueue_array_copy (IrisWSQueueArray *array,
+                         gint              log_size,
+                         gint              bottom,
+                         gint              top)
 {
-	struct timeval tv;
+	IrisWSQueueArray *new_array;
+	guint             i;
 
-	gettimeofday (&tv, NULL);
+	new_array = iris_wsqueue_array_new (log_size);
 
-	if (tv.tv_sec > timeout->tv_sec)
-		return TRUE;
-	else if ((tv.tv_sec == timeout->tv_sec) && (tv.tv_usec >= (timeout->tv_nsec / 1000000)))
-		return TRUE;
+	for (i = top; i != (guint)bottom; i++)
+		new_array->items [i & new_array->mask] = array->items [i & array->mask];
 
-	return FALSE;
+	return new_array;
 }
 
-static gint
-pthread_mutex_timedlock (pthread_mutex_t       *mutex,
-                         const struct timespec *abs_timeout)
+/* Frees the arrays that were replaced by a resize. A thief may still be
+ * reading from an old array, so reclaiming is done by epoch: thieves count
+ * themselves in n_thieves[epoch & 1] for the epoch they entered in, and the
+ * owner only moves to the next epoch once nobody is left from the one
+ * before. An array retired during epoch E was replaced before any thief of
+ * epoch E + 1 registered, so once the owner reaches E + 2 nobody can be
+ * reading it. Steals are short, so the list stays bounded even when thieves
+ * never stop coming.
+ */
+static void
+iris_wsqueue_reclaim (IrisWSQueuePrivate *priv)
 {
-	gint result;
+	IrisWSQueueArray **link;
+	IrisWSQueueArray  *array;
+	gint               epoch;
+	gint               i;
 
-	do {
-		result = pthread_mutex_trylock (mutex);
-		if (result == EBUSY) {
-			struct timespec ts;
-			ts.tv_sec = 0;
-			ts.tv_nsec = 10000000;
-
-			/* Sleep for 10,000,000 nanoseconds before trying again. */
-			int status = -1;
-			while (status == -1)
-				status = nanosleep (&ts, &ts);
-		}
-		else
+	/* Two steps are enough to free everything when no thief is around */
+	for (i = 0; i < 2 && priv->retired != NULL; i++) {
+		epoch = priv->epoch;
+
+		if (g_atomic_int_get (&priv->n_thieves [(epoch + 1) & 1]) != 0)
 			break;
+
+		g_atomic_int_set (&priv->epoch, epoch + 1);
+
+		link = &priv->retired;
+		while ((array = *link) != NULL) {
+			if (epoch - array->epoch >= 1) {
+				*link = array->next;
+				g_free (array);
+			}
+			else
+				link = &array->next;
+		}
 	}
-	while (result != 0 && !timeout_passed (abs_timeout));
+}
 
-	return result;
+/* Owner only: swap in a new array and retire the old one */
+static void
+iris_wsqueue_replace_array (IrisWSQueuePrivate *priv,
+                            IrisWSQueueArray   *new_array)
+{
+	IrisWSQueueArray *old_array = priv->array;
+
+	/* compare_and_exchange gives us the full barrier we need before the
+	 * array is tagged with the current epoch.
+	 */
+	if (!g_atomic_pointer_compare_and_exchange ((gpointer *)&priv->array,
+	                                            old_array, new_array))
+		g_warn_if_reached ();
+
+	old_array->epoch = g_atomic_int_get (&priv->epoch);
+	old_array->next = priv->retired;
+	priv->retired = old_array;
+
+	iris_wsqueue_reclaim (priv);
 }
-#endif
 
 static void
 iris_wsqueue_finalize (GObject *object)
@@ -125,7 +169,12 @@ iris_wsqueue_finalize (GObject *object)
 
 	g_object_unref (priv->global);
 	iris_rrobin_unref (priv->rrobin);
-	g_free (priv->items);
+	if (priv->near != NULL)
+		iris_rrobin_unref (priv->near);
+
+	g_warn_if_fail (priv->n_thieves [0] == 0 && priv->n_thieves [1] == 0);
+	iris_wsqueue_reclaim (priv);
+	g_free (priv->array);
 
 	G_OBJECT_CLASS (iris_wsqueue_parent_class)->finalize (object);
 }
@@ -142,6 +191,7 @@ iris_wsqueue_class_init (IrisWSQueueClass *klass)
 
 	queue_class = IRIS_QUEUE_CLASS (klass);
 	queue_class->push = iris_wsqueue_real_push;
+	queue_class->push_priority = NULL;
 	queue_class->pop = iris_wsqueue_real_pop;
 	queue_class->try_pop = iris_wsqueue_real_try_pop;
 	queue_class->timed_pop = iris_wsqueue_real_timed_pop;
@@ -155,12 +205,22 @@ iris_wsqueue_init (IrisWSQueue *queue)
 	                                           IRIS_TYPE_WSQUEUE,
 	                                           IrisWSQueuePrivate);
 
-	queue->priv->mask = WSQUEUE_DEFAULT_SIZE - 1;
-	queue->priv->mutex = g_mutex_new ();
-	queue->priv->length = WSQUEUE_DEFAULT_SIZE;
-	queue->priv->items = g_malloc0 (sizeof (gpointer) * WSQUEUE_DEFAULT_SIZE);
-	queue->priv->head_idx = 0;
-	queue->priv->tail_idx = 0;
+	queue->priv->array = iris_wsqueue_array_new (WSQUEUE_DEFAULT_LOG_SIZE);
+	queue->priv->retired = NULL;
+	queue->priv->top = 0;
+	queue->priv->bottom = 0;
+	queue->priv->epoch = 0;
+	queue->priv->n_thieves [0] = 0;
+	queue->priv->n_thieves [1] = 0;
+	queue->priv->near = NULL;
+
+	queue->priv->steal = g_atomic_int_get (&default_steal);
+	queue->priv->next_victim = 0;
+
+	/* Any non-zero seed will do, but it should differ between queues */
+	queue->priv->rand_state = GPOINTER_TO_UINT (queue) ^ g_random_int ();
+	if (queue->priv->rand_state == 0)
+		queue->priv->rand_state = 1;
 }
 
 IrisQueue*
@@ -179,6 +239,24 @@ iris_wsqueue_new (IrisQueue  *global,
 	return IRIS_QUEUE (queue);
 }
 
+/* Sets the queues of the threads on our NUMA node, which are tried before
+ * the rest when we run out of work. Must be called before the queue is
+ * handed to its thread.
+ */
+void
+iris_wsqueue_set_near_peers (IrisWSQueue *queue,
+                             IrisRRobin  *near)
+{
+	g_return_if_fail (IRIS_IS_WSQUEUE (queue));
+
+	if (near != NULL)
+		iris_rrobin_ref (near);
+	if (queue->priv->near != NULL)
+		iris_rrobin_unref (queue->priv->near);
+
+	queue->priv->near = near;
+}
+
 static gboolean
 iris_wsqueue_real_push (IrisQueue *queue,
                         gpointer   data)
@@ -188,20 +266,72 @@ iris_wsqueue_real_push (IrisQueue *queue,
 }
 
 
-static gboolean
-iris_wsqueue_pop_cb (IrisRRobin *rrobin,
-                     gpointer    data,
-                     gpointer    user_data)
+/* Owner only: xorshift, so picking a victim needs no shared state */
+static guint32
+iris_wsqueue_random (IrisWSQueuePrivate *priv)
 {
-	struct StealInfo *steal    = user_data;
-	IrisWSQueue      *neighbor = data;
+	guint32 x = priv->rand_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return priv->rand_state = x;
+}
 
-	if (G_LIKELY (steal->queue != data)) {
-		if ((steal->result = iris_wsqueue_try_steal (neighbor, 0)) != NULL)
-			return FALSE;
+/* Owner only: look for work in the queues of @rrobin. Unless the queue
+ * takes its victims in turn, it starts from a random one so that idle
+ * threads do not all gang up on the same victim.
+ */
+static gpointer
+iris_wsqueue_steal_from (IrisWSQueue *queue,
+                         IrisRRobin  *rrobin)
+{
+	IrisWSQueuePrivate *priv = queue->priv;
+	gpointer            victim;
+	gpointer            result;
+	gint                start;
+	gint                i;
+
+	if (g_atomic_int_get (&rrobin->count) < 2)
+		return NULL;
+
+	if (priv->steal == IRIS_WSQUEUE_STEAL_ROUND_ROBIN)
+		start = priv->next_victim++ % rrobin->size;
+	else
+		start = iris_wsqueue_random (priv) % rrobin->size;
+
+	for (i = 0; i < rrobin->size; i++) {
+		victim = g_atomic_pointer_get (&rrobin->data [(start + i) % rrobin->size]);
+
+		if (victim == NULL || victim == queue)
+			continue;
+
+		if (priv->steal == IRIS_WSQUEUE_STEAL_HALF)
+			result = iris_wsqueue_steal_several (victim, queue);
+		else
+			result = iris_wsqueue_try_steal (victim, 0);
+
+		if (result != NULL)
+			return result;
 	}
 
-	return TRUE;
+	return NULL;
+}
+
+/* Owner only: steal from our own NUMA node first, where the data of the
+ * stolen work is more likely to be in a shared cache, then from anyone.
+ */
+static gpointer
+iris_wsqueue_steal_from_peers (IrisWSQueue *queue)
+{
+	gpointer result;
+
+	if (queue->priv->near != NULL &&
+	    (result = iris_wsqueue_steal_from (queue, queue->priv->near)) != NULL)
+		return result;
+
+	return iris_wsqueue_steal_from (queue, queue->priv->rrobin);
 }
 
 static gpointer
@@ -245,20 +375,18 @@ iris_wsqueue_real_timed_pop (IrisQueue *queue,
 	 */
 
 	IrisWSQueuePrivate *priv;
-	struct StealInfo    steal;
+	gpointer            result;
 
 	g_return_val_if_fail (queue != NULL, NULL);
 	g_return_val_if_fail (timeout != NULL, NULL);
 
 	priv = IRIS_WSQUEUE (queue)->priv;
-	steal.queue = queue;
-	steal.result = NULL;
 
 	/* We check 3 different queues to retrieve an item through the
 	 * public pop interface. First we try to pop locally from our
-	 * local queue. Then we check the global queue. If neither of
-	 * those have yielded an item, we will try to steal from one
-	 * of our neighbors.
+	 * local queue, unless the global queue holds urgent work. Then
+	 * we check the global queue. If neither of those have yielded
+	 * an item, we will try to steal from one of our neighbors.
 	 *
 	 * However, so we do not get blocked on the global queue if there
 	 * are no items available and we can steal, we look through all
@@ -268,24 +396,23 @@ iris_wsqueue_real_timed_pop (IrisQueue *queue,
 
 	/* Round One */
 
-	if (NULL != (steal.result = iris_wsqueue_local_pop (IRIS_WSQUEUE (queue))))
-		return steal.result;
-	else if (NULL != (steal.result = iris_queue_try_pop (priv->global)))
-		return steal.result;
+	if (G_UNLIKELY (IRIS_QUEUE_HAS_URGENT (priv->global)) &&
+	    NULL != (result = iris_queue_try_pop (priv->global)))
+		return result;
 
-	iris_rrobin_foreach (priv->rrobin, iris_wsqueue_pop_cb, &steal);
-
-	if (steal.result)
-		return steal.result;
+	if (NULL != (result = iris_wsqueue_local_pop (IRIS_WSQUEUE (queue))))
+		return result;
+	else if (NULL != (result = iris_queue_try_pop (priv->global)))
+		return result;
+	else if (NULL != (result = iris_wsqueue_steal_from_peers (IRIS_WSQUEUE (queue))))
+		return result;
 
 	/* Round Two */
 
-	if (NULL != (steal.result = iris_queue_timed_pop (priv->global, timeout)))
-		return steal.result;
-
-	iris_rrobin_foreach (priv->rrobin, iris_wsqueue_pop_cb, &steal);
+	if (NULL != (result = iris_queue_timed_pop (priv->global, timeout)))
+		return result;
 
-	return steal.result;
+	return iris_wsqueue_steal_from_peers (IRIS_WSQUEUE (queue));
 }
 
 static guint
@@ -297,7 +424,8 @@ iris_wsqueue_real_get_length (IrisQueue *queue)
 
 	priv = IRIS_WSQUEUE (queue)->priv;
 
-	return (priv->tail_idx - priv->head_idx);
+	return MAX (0, WSQUEUE_SIZE (g_atomic_int_get (&priv->bottom),
+	                             g_atomic_int_get (&priv->top)));
 }
 
 
@@ -316,60 +444,28 @@ iris_wsqueue_local_push (IrisWSQueue *queue,
                          gpointer     data)
 {
 	IrisWSQueuePrivate *priv;
-	gpointer           *old_items;
-	gpointer           *new_items;
-	gint                tail;
-	gint                head;
-	gint                count;
+	IrisWSQueueArray   *array;
+	gint                bottom;
+	gint                top;
 
 	g_return_if_fail (queue != NULL);
 
 	priv = queue->priv;
-	tail = priv->tail_idx;
+	bottom = priv->bottom;
+	top = g_atomic_int_get (&priv->top);
+	array = priv->array;
 
-	if (tail < (priv->head_idx + priv->mask)) {
-		/* local push fast path */
-		priv->items [tail & priv->mask] = data;
-		g_atomic_int_set (&priv->tail_idx, tail + 1);
+	if (WSQUEUE_SIZE (bottom, top) >= array->mask) {
+		/* Full, double the array. Thieves can keep stealing from the old
+		 * array meanwhile; items are at the same index in both.
+		 */
+		array = iris_wsqueue_array_copy (array, array->log_size + 1,
+		                                 bottom, top);
+		iris_wsqueue_replace_array (priv, array);
 	}
-	else {
-		/* slow path, must resize the array */
-		g_mutex_lock (priv->mutex);
-
-		head = priv->head_idx;
-		count = priv->tail_idx - priv->head_idx;
-		old_items = priv->items;
-
-		if (count >= priv->mask) {
-			/* double the array size */
-			new_items = g_malloc0 (sizeof (gpointer) * (priv->length << 1));
-
-			/* copy the existing items over */
-			memcpy (new_items,
-			        old_items,
-			        priv->length * sizeof (gpointer));
-
-			/* assign the new array */
-			priv->items = new_items;
-			priv->head_idx = 0;
-			priv->tail_idx = tail = count;
-			priv->mask = (priv->mask << 1) | 1;
-			priv->length = priv->length << 1;
-
-			/* FIXME: Free old_items safely (can't really be done)
-			 *   or save the buffer to a list for periodic GC.
-			 *   However, as Shapor mentioned, leaking this will
-			 *   only account for a total of 2x the largest growth
-			 *   which may not be a problem anyway.
-			 */
-			/* g_free (old_items); */
-		}
 
-		priv->items [tail & priv->mask] = data;
-		priv->tail_idx = tail + 1;
-
-		g_mutex_unlock (priv->mutex);
-	}
+	array->items [bottom & array->mask] = data;
+	g_atomic_int_set (&priv->bottom, bottom + 1);
 }
 
 /**
@@ -385,37 +481,47 @@ gpointer
 iris_wsqueue_local_pop (IrisWSQueue *queue)
 {
 	IrisWSQueuePrivate *priv;
-	gpointer            result = NULL;
-	gint                tail;
+	IrisWSQueueArray   *array;
+	gpointer            result;
+	gint                bottom;
+	gint                top;
+	gint                size;
 
 	g_return_val_if_fail (queue != NULL, NULL);
 
 	priv = queue->priv;
-	tail = priv->tail_idx;
+	array = priv->array;
+
+	/* Claim the bottom item before looking at top. The add is a full
+	 * barrier, so a thief cannot take the same item without us noticing.
+	 */
+	bottom = g_atomic_int_exchange_and_add (&priv->bottom, -1) - 1;
+	top = g_atomic_int_get (&priv->top);
+	size = WSQUEUE_SIZE (bottom, top);
+
+	if (size < 0) {
+		/* Empty. Shrink back to the default size while we are idle. */
+		g_atomic_int_set (&priv->bottom, top);
+
+		if (array->log_size > WSQUEUE_DEFAULT_LOG_SIZE)
+			iris_wsqueue_replace_array (priv,
+				iris_wsqueue_array_new (WSQUEUE_DEFAULT_LOG_SIZE));
+		else
+			iris_wsqueue_reclaim (priv);
 
-	if (priv->head_idx >= tail)
 		return NULL;
+	}
 
-	tail -= 1;
-	g_atomic_int_set (&priv->tail_idx, tail);
+	result = array->items [bottom & array->mask];
 
-	if (priv->head_idx <= tail)
-		result = priv->items [tail & priv->mask];
-	else {
-		g_mutex_lock (priv->mutex);
+	if (size > 0)
+		return result;
 
-		if (priv->head_idx <= tail) {
-			/* item is still available */
-			result = priv->items [tail & priv->mask];
-		}
-		else {
-			/* we lost the race, restore the tail */
-			priv->tail_idx = tail + 1;
-			result = NULL;
-		}
+	/* Last item, race the thieves for it */
+	if (!g_atomic_int_compare_and_exchange (&priv->top, top, top + 1))
+		result = NULL;
 
-		g_mutex_unlock (priv->mutex);
-	}
+	g_atomic_int_set (&priv->bottom, top + 1);
 
 	return result;
 }
@@ -423,10 +529,10 @@ iris_wsqueue_local_pop (IrisWSQueue *queue)
 /**
  * iris_wsqueue_try_steal:
  * @queue: An #IrisWSQueue
- * @timeout: timeout in millseconds
+ * @timeout: unused, stealing never blocks
  *
- * Tries to steal an item from the #IrisWSQueue within the timeout
- * specified.
+ * Tries to steal the oldest item from the #IrisWSQueue. This is safe to call
+ * from any thread.
  *
  * Return value: A gpointer or %NULL if no items were available.
  */
@@ -435,48 +541,105 @@ iris_wsqueue_try_steal (IrisWSQueue *queue,
                         guint        timeout)
 {
 	IrisWSQueuePrivate *priv;
-	gboolean            taken  = FALSE;
+	IrisWSQueueArray   *array;
 	gpointer            result = NULL;
-	gint                head;
-
-	#ifdef WIN32
-	DWORD    wait_result;
-	#else
-	GTimeVal tv          = {0,0};
-	#endif
+	volatile gint      *n_thieves;
+	gint                epoch;
+	gint                bottom;
+	gint                top;
 
 	g_return_val_if_fail (queue != NULL, NULL);
 
 	priv = queue->priv;
 
-	/* GMutex does not export timedlock, so for now we will use
-	 * the non-portable pthread call directly.
+	/* Keep the owner from freeing the array we are about to read. If the
+	 * epoch moved on while we registered, the owner may not have seen us.
 	 */
-	#ifdef WIN32
-	/* pthread_mutex_timedlock returns 0 on success */
-	wait_result = WaitForSingleObject (
-	              (CRITICAL_SECTION *)priv->mutex,
-	              timeout);
-	taken = (wait_result != WAIT_OBJECT_0);
-	#else
-	g_get_current_time (&tv);
-	g_time_val_add (&tv, (G_USEC_PER_SEC / 1000) * timeout);
+	for (;;) {
+		epoch = g_atomic_int_get (&priv->epoch);
+		n_thieves = &priv->n_thieves [epoch & 1];
+		g_atomic_int_inc (n_thieves);
+
+		if (G_LIKELY (g_atomic_int_get (&priv->epoch) == epoch))
+			break;
 
-	taken = pthread_mutex_timedlock (
-			(pthread_mutex_t*)priv->mutex,
-			(struct timespec*)&tv);
-	#endif
+		g_atomic_int_add (n_thieves, -1);
+	}
 
-	head = priv->head_idx;
-	g_atomic_int_set (&priv->head_idx, head + 1);
+	do {
+		top = g_atomic_int_get (&priv->top);
+		bottom = g_atomic_int_get (&priv->bottom);
 
-	if (head < priv->tail_idx)
-		result = priv->items [head & priv->mask];
-	else
-		priv->head_idx = head;
+		if (WSQUEUE_SIZE (bottom, top) <= 0) {
+			result = NULL;
+			break;
+		}
 
-	if (taken)
-		g_mutex_unlock (priv->mutex);
+		array = g_atomic_pointer_get (&priv->array);
+		result = array->items [top & array->mask];
+
+		/* Lost to another thief or the owner, look again */
+	} while (!g_atomic_int_compare_and_exchange (&priv->top, top, top + 1));
+
+	g_atomic_int_add (n_thieves, -1);
 
 	return result;
 }
+
+/**
+ * iris_wsqueue_steal_several:
+ * @queue: An #IrisWSQueue to steal from
+ * @thief: The #IrisWSQueue owned by the calling thread
+ *
+ * Steals up to half of the items in @queue. The oldest item is returned and
+ * the rest are pushed onto @thief, so a thread that runs dry does not have
+ * to go looking for a victim again for every item. This must only be called
+ * from the thread that owns @thief.
+ *
+ * This is not a batch steal: every item is taken with its own
+ * iris_wsqueue_try_steal(), so other thieves and the owner may get some of
+ * them in between.
+ *
+ * Return value: A gpointer or %NULL if no items were available.
+ */
+gpointer
+iris_wsqueue_steal_several (IrisWSQueue *queue,
+                            IrisWSQueue *thief)
+{
+	gpointer result;
+	gpointer item;
+	gint     n_items;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+	g_return_val_if_fail (thief != NULL, NULL);
+
+	if ((result = iris_wsqueue_try_steal (queue, 0)) == NULL)
+		return NULL;
+
+	/* The owner pops from the bottom without a CAS unless it is taking the
+	 * last item, so moving top over several items at once is not safe.
+	 * Take the rest one at a time instead.
+	 */
+	n_items = iris_queue_get_length (IRIS_QUEUE (queue)) / 2;
+
+	while (n_items-- > 0) {
+		if ((item = iris_wsqueue_try_steal (queue, 0)) == NULL)
+			break;
+		iris_wsqueue_local_push (thief, item);
+	}
+
+	return result;
+}
+
+/*
+ * iris_wsqueue_set_default_steal:
+ * @steal: how queues pick their victims
+ *
+ * Sets the stealing strategy of the queues created from now on, so that
+ * benchmarks can compare them. Existing queues keep theirs.
+ */
+void
+iris_wsqueue_set_default_steal (IrisWSQueueSteal steal)
+{
+	g_atomic_int_set (&default_steal, steal);
+}
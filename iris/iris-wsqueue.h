@@ -51,14 +51,16 @@ struct _IrisWSQueueClass
 	IrisQueueClass parent_class;
 };
 
-GType        iris_wsqueue_get_type   (void) G_GNUC_CONST;
-IrisQueue*   iris_wsqueue_new        (IrisQueue   *global,
-                                      IrisRRobin  *peers);
-gpointer     iris_wsqueue_try_steal  (IrisWSQueue *queue,
-                                      guint        timeout);
-void         iris_wsqueue_local_push (IrisWSQueue *queue,
-                                      gpointer     data);
-gpointer     iris_wsqueue_local_pop  (IrisWSQueue *queue);
+GType        iris_wsqueue_get_type      (void) G_GNUC_CONST;
+IrisQueue*   iris_wsqueue_new           (IrisQueue   *global,
+                                         IrisRRobin  *peers);
+gpointer     iris_wsqueue_try_steal     (IrisWSQueue *queue,
+                                         guint        timeout);
+gpointer     iris_wsqueue_steal_several (IrisWSQueue *queue,
+                                         IrisWSQueue *thief);
+void         iris_wsqueue_local_push    (IrisWSQueue *queue,
+                                         gpointer     data);
+gpointer     iris_wsqueue_local_pop     (IrisWSQueue *queue);
 
 G_END_DECLS
 
@@ -25,6 +25,7 @@
 #include "iris-scheduler-manager.h"
 #include "iris-wsscheduler.h"
 #include "iris-wsqueue.h"
+#include "iris-wsqueue-private.h"
 
 /**
  * SECTION:iris-wsscheduler
@@ -40,7 +41,9 @@
  * it will be put into a private queue for the running thread.
  *
  * To prevent thread-starvation, if a thread runs out of work items it will
- * try to steal work from other threads.
+ * try to steal work from other threads. When the scheduler has an affinity
+ * set with iris_scheduler_set_affinity(), threads steal from the other threads
+ * on their own NUMA node before looking further afield.
  *
  * <warning><para>
  * #IrisWSScheduler is experimental code and may not run correctly. Do
@@ -64,37 +67,47 @@ struct _IrisWSSchedulerPrivate
 	                            * the scheduler.
 	                            */
 
+	gboolean      queue_ready;   /* Global queue replaced by the one from
+	                            * the queue factory, if any
+	                            */
+
 	volatile gint has_leader;  /* Is there a leader thread */
+
+	IrisRRobin  **node_rrobin; /* Per-thread queues grouped by NUMA node,
+	                            * stolen from first by threads on the
+	                            * same node. Only used with an affinity.
+	                            */
+	guint         n_nodes;
 };
 
 G_DEFINE_TYPE (IrisWSScheduler, iris_wsscheduler, IRIS_TYPE_SCHEDULER)
 
 static void
-iris_wsscheduler_queue_real (IrisScheduler  *scheduler,
-                             IrisCallback    func,
-                             gpointer        data,
-                             GDestroyNotify  destroy_notify)
+iris_wsscheduler_queue_work_real (IrisScheduler  *scheduler,
+                                  IrisThreadWork *thread_work)
 {
 	IrisWSSchedulerPrivate *priv;
 	IrisThread             *thread;
-	IrisThreadWork         *thread_work;
 
 	g_return_if_fail (scheduler != NULL);
-	g_return_if_fail (func != NULL);
+	g_return_if_fail (thread_work != NULL);
 
 	priv = IRIS_WSSCHEDULER (scheduler)->priv;
 
 	thread = iris_thread_get ();
-	thread_work = iris_thread_work_new (func, data, destroy_notify);
 
 	/* If the current thread is an iris-thread and it is a member of our
 	 * scheduler, then we will queue it to its own lock-free queue.  This
 	 * helps keep cpu cache hits up as well since the local thread will already
 	 * have the associated data hot.  However, we need to make sure the thread
 	 * will take this item sooner so its own work doesn't invalidate cache.
+	 *
+	 * Work with a priority goes to the global queue, which orders it and
+	 * is checked first while it holds urgent work.
 	 */
 
-	if (thread &&
+	if (thread_work->priority == IRIS_SCHEDULER_PRIORITY_NORMAL &&
+	    thread &&
 	    thread->scheduler == scheduler &&
 	    iris_thread_is_working (thread))
 	{
@@ -102,7 +115,7 @@ iris_wsscheduler_queue_real (IrisScheduler  *scheduler,
 		return;
 	}
 
-	iris_queue_push (priv->queue, thread_work);
+	iris_queue_push_priority (priv->queue, thread_work, thread_work->priority);
 }
 
 
@@ -135,7 +148,7 @@ iris_wsscheduler_foreach_rrobin_cb (IrisRRobin *rrobin,
 		                                   closure->user_data);
 
 		if (g_atomic_int_get (&thread_work->remove) == FALSE)
-			iris_queue_push (queue, thread_work);
+			iris_queue_push_priority (queue, thread_work, thread_work->priority);
 		else
 			iris_thread_work_free (thread_work);
 
@@ -188,6 +201,8 @@ iris_wsscheduler_remove_thread_real (IrisScheduler *scheduler,
 	thread->user_data = NULL;
 
 	iris_rrobin_remove (priv->rrobin, queue);
+	if (priv->node_rrobin != NULL && thread->node >= 0)
+		iris_rrobin_remove (priv->node_rrobin [thread->node % priv->n_nodes], queue);
 	g_object_unref (queue);
 }
 
@@ -204,6 +219,18 @@ iris_wsscheduler_add_thread_real (IrisScheduler  *scheduler,
 
 	priv = IRIS_WSSCHEDULER (scheduler)->priv;
 
+	/* The first thread is added before any work has been queued, so the
+	 * global queue is still empty and can be swapped for one from the
+	 * queue factory.
+	 */
+	if (G_UNLIKELY (!priv->queue_ready)) {
+		if ((queue = iris_scheduler_create_queue (scheduler)) != NULL) {
+			g_object_unref (priv->queue);
+			priv->queue = queue;
+		}
+		priv->queue_ready = TRUE;
+	}
+
 	/* create the threads queue for the round robin */
 	queue = iris_wsqueue_new (priv->queue, priv->rrobin);
 	thread->user_data = queue;
@@ -212,6 +239,26 @@ iris_wsscheduler_add_thread_real (IrisScheduler  *scheduler,
 	if (!iris_rrobin_append (priv->rrobin, queue))
 		goto error;
 
+	/* and to the one for its node, if the thread has been pinned. We are
+	 * called with the scheduler manager locked, so there is no race here.
+	 */
+	if (thread->node >= 0) {
+		IrisRRobin *near;
+
+		if (G_UNLIKELY (priv->node_rrobin == NULL)) {
+			guint i;
+
+			priv->n_nodes = iris_scheduler_get_n_nodes ();
+			priv->node_rrobin = g_new (IrisRRobin*, priv->n_nodes);
+			for (i = 0; i < priv->n_nodes; i++)
+				priv->node_rrobin [i] = iris_rrobin_new (priv->rrobin->size);
+		}
+
+		near = priv->node_rrobin [thread->node % priv->n_nodes];
+		iris_wsqueue_set_near_peers (IRIS_WSQUEUE (queue), near);
+		iris_rrobin_append (near, queue);
+	}
+
 	/* check if this thread is the leader */
 	leader = g_atomic_int_compare_and_exchange (&priv->has_leader, FALSE, TRUE);
 
@@ -231,6 +278,14 @@ iris_wsscheduler_finalize (GObject *object)
 
 	priv = IRIS_WSSCHEDULER (object)->priv;
 
+	if (priv->node_rrobin != NULL) {
+		guint i;
+
+		for (i = 0; i < priv->n_nodes; i++)
+			iris_rrobin_unref (priv->node_rrobin [i]);
+		g_free (priv->node_rrobin);
+	}
+
 	g_mutex_free (priv->mutex);
 
 	G_OBJECT_CLASS (iris_wsscheduler_parent_class)->finalize (object);
@@ -242,7 +297,7 @@ iris_wsscheduler_class_init (IrisWSSchedulerClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	IrisSchedulerClass *sched_class = IRIS_SCHEDULER_CLASS (klass);
 
-	sched_class->queue = iris_wsscheduler_queue_real;
+	sched_class->queue_work = iris_wsscheduler_queue_work_real;
 	sched_class->foreach = iris_wsscheduler_foreach_real;
 	sched_class->add_thread = iris_wsscheduler_add_thread_real;
 	sched_class->remove_thread = iris_wsscheduler_remove_thread_real;
@@ -262,14 +317,17 @@ iris_wsscheduler_init (IrisWSScheduler *scheduler)
 
 	scheduler->priv->mutex = g_mutex_new ();
 	scheduler->priv->queue = iris_queue_new ();
+	scheduler->priv->queue_ready = FALSE;
 	scheduler->priv->has_leader = FALSE;
+	scheduler->priv->node_rrobin = NULL;
+	scheduler->priv->n_nodes = 0;
 
 	/* FIXME: This is technically broken since it gets modified
 	 *   after we call it.
 	 */
 
 	max_threads = iris_scheduler_get_max_threads (IRIS_SCHEDULER (scheduler));
-	scheduler->priv->rrobin = iris_rrobin_new (max_threads);
+	scheduler->priv->rrobin = iris_rrobin_new (max_threads + IRIS_SCHEDULER_MAX_LENT);
 }
 
 /**
@@ -27,6 +27,7 @@
 #include "iris-queue.h"
 #include "iris-lfqueue.h"
 #include "iris-wsqueue.h"
+#include "iris-ringqueue.h"
 #include "iris-rrobin.h"
 #include "iris-stack.h"
 
@@ -36,6 +37,7 @@
 #include "iris-lfscheduler.h"
 #include "iris-wsscheduler.h"
 #include "iris-scheduler-manager.h"
+#include "iris-growth-policy.h"
 
 /* message passing and arbitration */
 #include "iris-message.h"
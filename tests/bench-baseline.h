@@ -0,0 +1,102 @@
+/* Benchmarks of the lock-free containers run the same loop twice, once on
+ * the container itself and once on a GQueue behind a single mutex, which
+ * is what the container replaces. A BenchTarget hides which of the two is
+ * in use.
+ *
+ * Items are pushed at one end. bench_target_pop() takes them from the same
+ * end for a LIFO container and from the other end otherwise, and
+ * bench_target_steal() always takes from the other end.
+ */
+
+#include <string.h>
+
+typedef void     (*BenchPushFunc) (gpointer container, gpointer item);
+typedef gpointer (*BenchPopFunc)  (gpointer container);
+
+typedef struct
+{
+	gboolean       locked;
+	gboolean       lifo;
+
+	/* The lock-free container and how to use it */
+	gpointer       container;
+	BenchPushFunc  push;
+	BenchPopFunc   pop;
+	BenchPopFunc   steal;
+
+	/* The baseline, only used if @locked */
+	GMutex        *mutex;
+	GQueue         queue;
+} BenchTarget;
+
+static void
+bench_target_init (BenchTarget *target,
+                   gboolean     locked,
+                   gboolean     lifo,
+                   gpointer     container)
+{
+	memset (target, 0, sizeof (BenchTarget));
+
+	target->locked = locked;
+	target->lifo = lifo;
+	target->container = container;
+
+	if (locked) {
+		target->mutex = g_mutex_new ();
+		g_queue_init (&target->queue);
+	}
+}
+
+static void
+bench_target_destroy (BenchTarget *target)
+{
+	if (target->mutex != NULL) {
+		g_mutex_free (target->mutex);
+		g_list_free (target->queue.head);
+	}
+}
+
+static void
+bench_target_push (BenchTarget *target,
+                   gpointer     item)
+{
+	if (!target->locked) {
+		target->push (target->container, item);
+		return;
+	}
+
+	g_mutex_lock (target->mutex);
+	g_queue_push_tail (&target->queue, item);
+	g_mutex_unlock (target->mutex);
+}
+
+static gpointer
+bench_target_pop (BenchTarget *target)
+{
+	gpointer item;
+
+	if (!target->locked)
+		return target->pop (target->container);
+
+	g_mutex_lock (target->mutex);
+	item = target->lifo ? g_queue_pop_tail (&target->queue)
+	                    : g_queue_pop_head (&target->queue);
+	g_mutex_unlock (target->mutex);
+
+	return item;
+}
+
+static G_GNUC_UNUSED gpointer
+bench_target_steal (BenchTarget *target)
+{
+	gpointer item;
+
+	if (!target->locked)
+		return target->steal (target->container);
+
+	g_mutex_lock (target->mutex);
+	item = g_queue_pop_head (&target->queue);
+	g_mutex_unlock (target->mutex);
+
+	return item;
+}
@@ -7,7 +7,7 @@ test1 (void)
 	IrisFreeList *free_list = iris_free_list_new ();
 	g_assert (free_list != NULL);
 	g_assert (free_list->head != NULL);
-	g_assert (free_list->head->next == NULL);
+	g_assert (free_list->head->next.pointer == NULL);
 }
 
 static void
@@ -39,7 +39,7 @@ test4 (void)
 	IrisFreeList *free_list = iris_free_list_new ();
 	g_assert (free_list != NULL);
 	g_assert (free_list->head != NULL);
-	g_assert (free_list->head->next == NULL);
+	g_assert (free_list->head->next.pointer == NULL);
 	iris_free_list_free (free_list);
 }
 
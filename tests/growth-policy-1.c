@@ -0,0 +1,286 @@
+#include <iris.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+fill_sample (IrisGrowthSample *sample,
+             gdouble           elapsed,
+             gint              n_arrived,
+             gint              n_backlog,
+             gdouble           service_time,
+             gint              n_threads)
+{
+	memset (sample, 0, sizeof (IrisGrowthSample));
+	sample->elapsed = elapsed;
+	sample->n_arrived = n_arrived;
+	sample->n_completed = n_arrived;
+	sample->n_backlog = n_backlog;
+	sample->n_run = 1;
+	sample->busy = service_time;
+	sample->n_threads = n_threads;
+	sample->min_threads = 1;
+	sample->max_threads = 16;
+}
+
+/* adaptive: asks for arrival rate * service time threads plus headroom,
+ * more for a backlog, and only shrinks after holding off.
+ */
+static void
+adaptive (void)
+{
+	const IrisGrowthPolicy *policy;
+	IrisGrowthSample        sample;
+	gpointer                state;
+	gint                    target, i;
+
+	policy = iris_growth_policy_get_adaptive ();
+	g_assert (policy->sample != NULL);
+	state = policy->create (NULL);
+
+	/* 1000 items/s taking 4ms each need 4 threads, and 5 with headroom */
+	fill_sample (&sample, 0.01, 10, 0, 0.004, 1);
+	target = policy->sample (state, &sample);
+	g_assert_cmpint (target, ==, 5);
+
+	/* A backlog of 100 needs 4 more to clear in 0.1s */
+	fill_sample (&sample, 0.01, 10, 100, 0.004, 5);
+	target = policy->sample (state, &sample);
+	g_assert_cmpint (target, ==, 9);
+
+	/* The backlog is gone, but we don't shrink straight away */
+	for (i = 0; i < 40; i++) {
+		fill_sample (&sample, 0.01, 0, 0, 0.004, 9);
+		target = policy->sample (state, &sample);
+		g_assert_cmpint (target, ==, 9);
+	}
+
+	for (i = 0; i < 200; i++) {
+		fill_sample (&sample, 0.01, 0, 0, 0.004, target);
+		target = policy->sample (state, &sample);
+	}
+	g_assert_cmpint (target, ==, 1);
+
+	/* Growth is immediate */
+	fill_sample (&sample, 0.01, 10, 100, 0.004, 1);
+	target = policy->sample (state, &sample);
+	g_assert_cmpint (target, >, 1);
+
+	policy->destroy (state);
+}
+
+/* quantum: grows by the ratio of backlog to what the leader got through,
+ * and never asks for fewer threads.
+ */
+static void
+quantum (void)
+{
+	const IrisGrowthPolicy *policy;
+	IrisGrowthSample        sample;
+	gpointer                state;
+
+	policy = iris_growth_policy_get_quantum ();
+	state = policy->create (NULL);
+
+	fill_sample (&sample, 1.0, 2, 10, 0.5, 1);
+	sample.n_run = 2;
+	g_assert_cmpint (policy->sample (state, &sample), ==, 5);
+
+	/* Once, an empty queue is taken to mean more is coming */
+	fill_sample (&sample, 1.0, 2, 0, 0.5, 1);
+	sample.n_run = 2;
+	g_assert_cmpint (policy->sample (state, &sample), ==, 2);
+	g_assert_cmpint (policy->sample (state, &sample), ==, 1);
+
+	fill_sample (&sample, 1.0, 0, 0, 0.5, 4);
+	g_assert_cmpint (policy->sample (state, &sample), ==, 4);
+
+	policy->destroy (state);
+}
+
+/* set policy: only before the scheduler starts */
+static void
+set_policy_cb (gpointer data)
+{
+	g_atomic_int_set ((gint *)data, TRUE);
+}
+
+static void
+set_policy (void)
+{
+	IrisScheduler *scheduler;
+	volatile gint  done = FALSE;
+
+	scheduler = iris_scheduler_new_full (1, 4);
+	g_assert (iris_scheduler_get_growth_policy (scheduler) ==
+	          iris_growth_policy_get_adaptive ());
+
+	g_assert (iris_scheduler_set_growth_policy (scheduler,
+	                                            iris_growth_policy_get_quantum ()));
+	g_assert (iris_scheduler_get_growth_policy (scheduler) ==
+	          iris_growth_policy_get_quantum ());
+
+	iris_scheduler_queue (scheduler, set_policy_cb, (gpointer)&done, NULL);
+	while (!g_atomic_int_get (&done))
+		g_thread_yield ();
+
+	g_assert (!iris_scheduler_set_growth_policy (scheduler, NULL));
+	g_assert (iris_scheduler_get_growth_policy (scheduler) ==
+	          iris_growth_policy_get_quantum ());
+
+	g_object_unref (scheduler);
+}
+
+/* load benchmark: replays steady and bursty arrivals of work which
+ * blocks for a while, and reports how long items wait in the queue with
+ * each growth policy.
+ */
+typedef struct
+{
+	const gchar *name;
+	gint         burst_size;   /* Items queued at once   */
+	gint         period;       /* Milliseconds per burst */
+} LoadPattern;
+
+typedef struct
+{
+	GTimer        *clock;
+	gdouble       *latencies;
+	gulong         service;    /* Microseconds per item  */
+	volatile gint  n_done;
+} LoadRun;
+
+typedef struct
+{
+	LoadRun *run;
+	gdouble  queued;
+	gint     index;
+} LoadItem;
+
+static void
+load_item_cb (gpointer data)
+{
+	LoadItem *item = data;
+	LoadRun  *run = item->run;
+
+	run->latencies[item->index] = g_timer_elapsed (run->clock, NULL) - item->queued;
+	g_usleep (run->service);
+
+	g_slice_free (LoadItem, item);
+	g_atomic_int_inc (&run->n_done);
+}
+
+static gint
+compare_double (gconstpointer a,
+                gconstpointer b)
+{
+	gdouble x = *(const gdouble *)a,
+	        y = *(const gdouble *)b;
+
+	return (x > y) - (x < y);
+}
+
+static gdouble
+percentile (gdouble *sorted,
+            gint     n,
+            gdouble  fraction)
+{
+	return sorted [(gint)(fraction * (n - 1))];
+}
+
+static void
+load_replay (const IrisGrowthPolicy *policy,
+             const LoadPattern      *pattern,
+             gint                    n_bursts)
+{
+	IrisScheduler            *scheduler;
+	IrisSchedulerManagerStats stats;
+	LoadRun                   run;
+	LoadItem                 *item;
+	gdouble                   delay;
+	gint                      n_items = n_bursts * pattern->burst_size,
+	                          i, j;
+
+	scheduler = iris_scheduler_new_full (1, 16);
+	iris_scheduler_set_growth_policy (scheduler, policy);
+
+	run.clock = g_timer_new ();
+	run.latencies = g_new0 (gdouble, n_items);
+	run.service = 2000;
+	run.n_done = 0;
+
+	for (i = 0; i < n_bursts; i++) {
+		delay = i * pattern->period / 1000.0 - g_timer_elapsed (run.clock, NULL);
+		if (delay > 0)
+			g_usleep (delay * G_USEC_PER_SEC);
+
+		for (j = 0; j < pattern->burst_size; j++) {
+			item = g_slice_new (LoadItem);
+			item->run = &run;
+			item->index = i * pattern->burst_size + j;
+			item->queued = g_timer_elapsed (run.clock, NULL);
+			iris_scheduler_queue (scheduler, load_item_cb, item, NULL);
+		}
+	}
+
+	while (g_atomic_int_get (&run.n_done) < n_items)
+		g_usleep (1000);
+
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+
+	qsort (run.latencies, n_items, sizeof (gdouble), compare_double);
+
+	g_test_message ("%-8s %-6s queue latency p50 %6.1fms p90 %6.1fms "
+	                "p99 %6.1fms, %d threads added",
+	                policy->name, pattern->name,
+	                percentile (run.latencies, n_items, 0.5) * 1000,
+	                percentile (run.latencies, n_items, 0.9) * 1000,
+	                percentile (run.latencies, n_items, 0.99) * 1000,
+	                stats.n_grown);
+
+	g_test_minimized_result (percentile (run.latencies, n_items, 0.99),
+	                         "p99 queue latency of %s work with the %s "
+	                         "policy", pattern->name, policy->name);
+
+	g_object_unref (scheduler);
+	g_free (run.latencies);
+	g_timer_destroy (run.clock);
+}
+
+static void
+load_benchmark (void)
+{
+	/* Both average 500 items/s of 2ms each, so one thread could keep up
+	 * with the steady stream.
+	 */
+	static const LoadPattern patterns[] = {
+		{ "steady", 1, 2 },
+		{ "bursty", 50, 100 }
+	};
+	const IrisGrowthPolicy *policies[2];
+	gint                    duration = g_test_perf () ? 10 : 1,
+	                        i, j;
+
+	policies[0] = iris_growth_policy_get_adaptive ();
+	policies[1] = iris_growth_policy_get_quantum ();
+
+	for (i = 0; i < G_N_ELEMENTS (policies); i++)
+		for (j = 0; j < G_N_ELEMENTS (patterns); j++)
+			load_replay (policies[i], &patterns[j],
+			             duration * 1000 / patterns[j].period);
+}
+
+gint
+main (int   argc,
+      char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+	g_thread_init (NULL);
+
+	g_test_add_func ("/growth-policy/adaptive", adaptive);
+	g_test_add_func ("/growth-policy/quantum", quantum);
+	g_test_add_func ("/growth-policy/set policy", set_policy);
+	g_test_add_func ("/growth-policy/load benchmark", load_benchmark);
+
+	return g_test_run ();
+}
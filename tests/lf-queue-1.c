@@ -1,5 +1,8 @@
 #include <iris.h>
 #include <iris/iris-lfqueue-private.h>
+#include <iris/iris-atomics.h>
+
+#include "bench-baseline.h"
 
 static void
 test1 (void)
@@ -9,7 +12,7 @@ test1 (void)
 	g_assert (queue);
 	g_assert (IRIS_IS_LFQUEUE (queue));
 	g_assert (IRIS_LFQUEUE (queue)->priv->head);
-	g_assert (!IRIS_LFQUEUE (queue)->priv->head->next);
+	g_assert (!((IrisLink*)IRIS_LFQUEUE (queue)->priv->head->pointer)->next.pointer);
 }
 
 static void
@@ -36,7 +39,7 @@ test4 (void)
 	IrisQueue *queue = iris_lfqueue_new ();
 	g_assert (queue != NULL);
 	g_assert (((IrisLFQueue*)queue)->priv->head != NULL);
-	g_assert (((IrisLFQueue*)queue)->priv->head->next == NULL);
+	g_assert (((IrisLink*)((IrisLFQueue*)queue)->priv->head->pointer)->next.pointer == NULL);
 	g_object_unref (queue);
 }
 
@@ -73,6 +76,258 @@ test9 (void)
 	g_assert_cmpint (IRIS_TYPE_LFQUEUE, !=, G_TYPE_INVALID);
 }
 
+static void
+test_timed_pop_timeout (void)
+{
+	IrisQueue *queue = iris_lfqueue_new ();
+	GTimeVal   tv;
+	GTimer    *timer;
+
+	timer = g_timer_new ();
+	g_get_current_time (&tv);
+	g_time_val_add (&tv, G_USEC_PER_SEC / 20);
+
+	g_assert (iris_queue_timed_pop (queue, &tv) == NULL);
+	g_assert_cmpfloat (g_timer_elapsed (timer, NULL), >=, 0.04);
+
+	g_timer_destroy (timer);
+	g_object_unref (queue);
+}
+
+/* ping pong: measure how long it takes to wake a thread that is parked in
+ * iris_queue_pop(). Each side waits for the other to go to sleep before it
+ * sends, so every hop includes a wakeup.
+ */
+#define PING_PONG_ROUNDS    200
+#define PING_PONG_GOAL_USEC 50
+
+static IrisQueue *ping_queue,
+                 *pong_queue;
+
+static gpointer
+ping_pong_thread (gpointer data)
+{
+	gpointer item;
+
+	while ((item = iris_queue_pop (ping_queue)) != GINT_TO_POINTER (-1))
+		iris_queue_push (pong_queue, item);
+
+	return NULL;
+}
+
+static void
+test_ping_pong (void)
+{
+	GThread *thread;
+	GTimer  *timer;
+	gdouble  total = 0;
+	gdouble  hop_usec;
+	gint     i;
+
+	ping_queue = iris_lfqueue_new ();
+	pong_queue = iris_lfqueue_new ();
+	thread = g_thread_create (ping_pong_thread, NULL, TRUE, NULL);
+	timer = g_timer_new ();
+
+	for (i = 1; i <= PING_PONG_ROUNDS; i++) {
+		/* Long enough for the other thread to stop spinning and park */
+		g_usleep (200);
+
+		g_timer_start (timer);
+		iris_queue_push (ping_queue, GINT_TO_POINTER (i));
+		g_assert_cmpint (GPOINTER_TO_INT (iris_queue_pop (pong_queue)), ==, i);
+		total += g_timer_elapsed (timer, NULL);
+	}
+
+	iris_queue_push (ping_queue, GINT_TO_POINTER (-1));
+	g_thread_join (thread);
+
+	hop_usec = total / PING_PONG_ROUNDS / 2 * G_USEC_PER_SEC;
+	g_test_minimized_result (hop_usec, "Wakeup latency %.1f usec (goal %d usec)",
+	                         hop_usec, PING_PONG_GOAL_USEC);
+
+	/* The goal only holds on a quiet machine, so it is enforced in
+	 * performance runs. The old queue slept in 10ms steps; parking should
+	 * be far below that even on a busy machine.
+	 */
+	if (g_test_perf ())
+		g_assert_cmpfloat (hop_usec, <, PING_PONG_GOAL_USEC);
+	else
+		g_assert_cmpfloat (hop_usec, <, 1000);
+
+	g_timer_destroy (timer);
+	g_object_unref (ping_queue);
+	g_object_unref (pong_queue);
+}
+
+/* aba: threads keep taking items and putting them back.  Links cycle
+ * through the free list and back into the queue while other threads still
+ * hold stale copies of the head, the tail or a next pointer.
+ */
+
+#define ABA_ITEMS 64
+
+static BenchTarget    aba_target;
+static volatile gint  aba_go;
+
+static gpointer
+aba_thread (gpointer data)
+{
+	gpointer item;
+	gint     i;
+
+	while (!g_atomic_int_get (&aba_go))
+		g_thread_yield ();
+
+	for (i = 0; i < (g_test_perf () ? 1000000 : 50000); i++)
+		if ((item = bench_target_pop (&aba_target)) != NULL)
+			bench_target_push (&aba_target, item);
+
+	return NULL;
+}
+
+static gdouble
+aba_run (gboolean locked,
+         gint     n_threads)
+{
+	GThread  *threads[64];
+	GTimer   *timer;
+	gboolean  seen[ABA_ITEMS] = { FALSE, };
+	gpointer  item;
+	gdouble   elapsed;
+	gint      i;
+
+	bench_target_init (&aba_target, locked, FALSE, iris_lfqueue_new ());
+	aba_target.push = (BenchPushFunc)iris_queue_push;
+	aba_target.pop = (BenchPopFunc)iris_queue_try_pop;
+	aba_go = FALSE;
+
+	for (i = 1; i <= ABA_ITEMS; i++)
+		bench_target_push (&aba_target, GINT_TO_POINTER (i));
+
+	for (i = 0; i < n_threads; i++)
+		threads[i] = g_thread_create (aba_thread, NULL, TRUE, NULL);
+
+	timer = g_timer_new ();
+	g_atomic_int_set (&aba_go, TRUE);
+	for (i = 0; i < n_threads; i++)
+		g_thread_join (threads[i]);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	/* Every item must still be queued exactly once */
+	if (!locked)
+		g_assert_cmpint (iris_queue_get_length (aba_target.container), ==, ABA_ITEMS);
+	for (i = 0; i < ABA_ITEMS; i++) {
+		item = bench_target_pop (&aba_target);
+		g_assert (item != NULL);
+		g_assert (!seen[GPOINTER_TO_INT (item) - 1]);
+		seen[GPOINTER_TO_INT (item) - 1] = TRUE;
+	}
+	g_assert (bench_target_pop (&aba_target) == NULL);
+
+	g_timer_destroy (timer);
+	bench_target_destroy (&aba_target);
+	g_object_unref (aba_target.container);
+
+	return elapsed;
+}
+
+static void
+test_aba (void)
+{
+	gint    max_threads = g_test_perf () ? 64 : 8;
+	gdouble lockfree_time;
+	gdouble locked_time;
+	gint    n_threads;
+
+	for (n_threads = 2; n_threads <= max_threads; n_threads *= 2) {
+		locked_time = aba_run (TRUE, n_threads);
+		lockfree_time = aba_run (FALSE, n_threads);
+
+		g_test_message ("%d threads: locked %.3fs, lock-free %.3fs",
+		                n_threads, locked_time, lockfree_time);
+	}
+
+	g_test_minimized_result (lockfree_time,
+	                         "IrisLFQueue ABA stress at %d threads",
+	                         max_threads);
+}
+
+/* aba replay: the interleaving that breaks a plain pointer swap in
+ * iris_queue_try_pop(), forced from a single thread. A stale pop reads the
+ * head (the dummy link) and its next link. Meanwhile both links are popped
+ * to the free list, reused by two pushes and popped again, which leaves
+ * the old dummy at the head once more. Swapping in the stale next link
+ * would make a link from the free list the head, so only the stamp can
+ * make the swap fail.
+ */
+static void
+test_aba_replay (void)
+{
+	IrisQueue  *queue;
+	GStampPair *lane_head;
+	GStampPair  old;
+	IrisLink   *old_next;
+
+	queue = iris_lfqueue_new ();
+	lane_head = IRIS_LFQUEUE (queue)->priv->head[IRIS_LFQUEUE_LANE (0)];
+
+	iris_queue_push (queue, GINT_TO_POINTER (1));
+	iris_queue_push (queue, GINT_TO_POINTER (2));
+
+	/* The stale pop loads the head, like iris_queue_try_pop() */
+	G_STAMP_PAIR_LOAD (lane_head, &old);
+	old_next = ((IrisLink*)old.pointer)->next.pointer;
+
+	/* The free list is LIFO, so after two pops and two pushes the old
+	 * dummy is back at the head.
+	 */
+	g_assert_cmpint (GPOINTER_TO_INT (iris_queue_try_pop (queue)), ==, 1);
+	g_assert_cmpint (GPOINTER_TO_INT (iris_queue_try_pop (queue)), ==, 2);
+	iris_queue_push (queue, GINT_TO_POINTER (3));
+	iris_queue_push (queue, GINT_TO_POINTER (4));
+	g_assert_cmpint (GPOINTER_TO_INT (iris_queue_try_pop (queue)), ==, 3);
+	g_assert_cmpint (GPOINTER_TO_INT (iris_queue_try_pop (queue)), ==, 4);
+	g_assert (lane_head->pointer == old.pointer);
+
+	g_assert (!iris_atomics_compare_and_exchange_pair (lane_head,
+	                                                   old.pointer, old.stamp,
+	                                                   old_next));
+
+	g_assert (iris_queue_try_pop (queue) == NULL);
+	iris_queue_push (queue, GINT_TO_POINTER (5));
+	g_assert_cmpint (GPOINTER_TO_INT (iris_queue_try_pop (queue)), ==, 5);
+	g_assert_cmpuint (iris_queue_get_length (queue), ==, 0);
+
+	g_object_unref (queue);
+}
+
+static void
+test_priority (void)
+{
+	gint       items[6];
+	IrisQueue *queue = iris_lfqueue_new ();
+
+	iris_queue_push_priority (queue, &items[4], 1);
+	iris_queue_push (queue, &items[2]);
+	iris_queue_push_priority (queue, &items[0], -1);
+	iris_queue_push_priority (queue, &items[5], 1);
+	iris_queue_push (queue, &items[3]);
+	iris_queue_push_priority (queue, &items[1], -1);
+
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 6);
+
+	g_assert (iris_queue_pop (queue) == &items[0]);
+	g_assert (iris_queue_pop (queue) == &items[1]);
+	g_assert (iris_queue_pop (queue) == &items[2]);
+	g_assert (iris_queue_pop (queue) == &items[3]);
+	g_assert (iris_queue_pop (queue) == &items[4]);
+	g_assert (iris_queue_pop (queue) == &items[5]);
+	g_assert (iris_queue_try_pop (queue) == NULL);
+
+	g_object_unref (queue);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -88,6 +343,11 @@ main (int   argc,
 	g_test_add_func ("/lfqueue/push_pop_empty", test5);
 	g_test_add_func ("/lfqueue/length", test6);
 	g_test_add_func ("/lfqueue/get_type", test9);
+	g_test_add_func ("/lfqueue/timed_pop timeout", test_timed_pop_timeout);
+	g_test_add_func ("/lfqueue/ping pong", test_ping_pong);
+	g_test_add_func ("/lfqueue/aba", test_aba);
+	g_test_add_func ("/lfqueue/aba replay", test_aba_replay);
+	g_test_add_func ("/lfqueue/priority", test_priority);
 
 	return g_test_run ();
 }
@@ -388,6 +388,172 @@ million_create (void)
 	g_free (msg);
 }
 
+static GQuark
+quark_key (void)
+{
+	return IRIS_MESSAGE_KEY ("quark-key");
+}
+
+static void
+quark_keys (void)
+{
+	IrisMessage *msg;
+
+	/* The key is interned once and cached per call site */
+	g_assert_cmpuint (quark_key (), ==, g_quark_from_string ("quark-key"));
+	g_assert_cmpuint (quark_key (), ==, quark_key ());
+
+	msg = iris_message_new (1);
+	iris_message_set_int_q (msg, quark_key (), 42);
+	iris_message_set_string_q (msg, IRIS_MESSAGE_KEY ("name"), "iris");
+
+	/* Both kinds of accessor see the same items */
+	g_assert (iris_message_contains_q (msg, quark_key ()));
+	g_assert_cmpint (iris_message_get_int (msg, "quark-key"), ==, 42);
+	g_assert_cmpstr (iris_message_get_string_q (msg, g_quark_from_string ("name")), ==, "iris");
+
+	iris_message_set_int (msg, "quark-key", 43);
+	g_assert_cmpint (iris_message_get_int_q (msg, quark_key ()), ==, 43);
+	g_assert_cmpint (iris_message_count_names (msg), ==, 2);
+
+	iris_message_ref_sink (msg);
+	iris_message_unref (msg);
+}
+
+/* The representation IrisMessage used before items were stored inline:
+ * one GHashTable per message with duplicated string keys and a slice
+ * allocated GValue per item. Kept here to compare against.
+ */
+static void
+hash_value_free (gpointer data)
+{
+	g_value_unset (data);
+	g_slice_free (GValue, data);
+}
+
+static void
+hash_set_int (GHashTable  *items,
+              const gchar *name,
+              gint         value)
+{
+	GValue *real_value = g_slice_new0 (GValue);
+	g_value_init (real_value, G_TYPE_INT);
+	g_value_set_int (real_value, value);
+	g_hash_table_insert (items, g_strdup (name), real_value);
+}
+
+static const gchar *perf_keys[] = { "thread", "queue", "leader" };
+
+static gdouble
+perf_hash_messages (gint iterations)
+{
+	GTimer     *timer;
+	GHashTable *items;
+	gint        i, j, sum = 0;
+	gdouble     elapsed;
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < iterations; i++) {
+		items = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                               g_free, hash_value_free);
+		for (j = 0; j < G_N_ELEMENTS (perf_keys); j++)
+			hash_set_int (items, perf_keys[j], i + j);
+		for (j = 0; j < G_N_ELEMENTS (perf_keys); j++)
+			sum += g_value_get_int (g_hash_table_lookup (items, perf_keys[j]));
+		g_hash_table_unref (items);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_assert_cmpint (sum, !=, 0);
+	return elapsed;
+}
+
+static gdouble
+perf_compact_messages (gint iterations)
+{
+	GTimer      *timer;
+	IrisMessage *msg;
+	gint         i, j, sum = 0;
+	gdouble      elapsed;
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < iterations; i++) {
+		msg = iris_message_new (1);
+		for (j = 0; j < G_N_ELEMENTS (perf_keys); j++)
+			iris_message_set_int (msg, perf_keys[j], i + j);
+		for (j = 0; j < G_N_ELEMENTS (perf_keys); j++)
+			sum += iris_message_get_int (msg, perf_keys[j]);
+		iris_message_ref_sink (msg);
+		iris_message_unref (msg);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_assert_cmpint (sum, !=, 0);
+	return elapsed;
+}
+
+/* new/set/get/unref throughput of a three item message, which is what
+ * iris_thread_manage() sends for every thread hand-off.
+ */
+static void
+perf_small_items (void)
+{
+	gint    iterations = g_test_perf () ? 1000000 : 10000;
+	gdouble hash_time, compact_time;
+
+	hash_time = perf_hash_messages (iterations);
+	compact_time = perf_compact_messages (iterations);
+
+	g_test_message ("hashtable: %.0f messages/s, inline: %.0f messages/s",
+	                iterations / hash_time, iterations / compact_time);
+	g_test_maximized_result (iterations / compact_time,
+	                         "%.0f messages/s", iterations / compact_time);
+}
+
+/* Items past the inline slots must still be stored and copied correctly. */
+#define MANY_ITEMS 16
+
+static void
+many_items (void)
+{
+	IrisMessage *msg, *copy;
+	gchar        name[16];
+	gint         i;
+
+	msg = iris_message_new (1);
+
+	for (i = 0; i < MANY_ITEMS; i++) {
+		g_snprintf (name, sizeof (name), "item-%d", i);
+		iris_message_set_int (msg, name, i);
+	}
+
+	/* Overwriting an item must not add a new one */
+	iris_message_set_int (msg, "item-0", 100);
+	iris_message_set_string (msg, "item-15", "spilled");
+
+	g_assert_cmpint (iris_message_count_names (msg), ==, MANY_ITEMS);
+	g_assert (!iris_message_contains (msg, "item-never-set"));
+
+	copy = iris_message_copy (msg);
+	iris_message_ref_sink (msg);
+	iris_message_unref (msg);
+
+	g_assert_cmpint (iris_message_count_names (copy), ==, MANY_ITEMS);
+	g_assert_cmpint (iris_message_get_int (copy, "item-0"), ==, 100);
+	g_assert_cmpint (iris_message_get_int (copy, "item-7"), ==, 7);
+	g_assert_cmpint (iris_message_get_int (copy, "item-8"), ==, 8);
+	g_assert_cmpstr (iris_message_get_string (copy, "item-15"), ==, "spilled");
+
+	iris_message_ref_sink (copy);
+	iris_message_unref (copy);
+}
+
 gint
 main (int   argc,
       char *argv[])
@@ -419,6 +585,9 @@ main (int   argc,
 	g_test_add_func ("/message/pointer destruction", test_pointer_destruction);
 	g_test_add_func ("/message/value destruction", test_value_destruction);
 	g_test_add_func ("/message/million_create", million_create);
+	g_test_add_func ("/message/many_items", many_items);
+	g_test_add_func ("/message/quark_keys", quark_keys);
+	g_test_add_func ("/message/perf small items", perf_small_items);
 
 	return g_test_run ();
 }
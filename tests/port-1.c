@@ -223,6 +223,235 @@ test_finalize_queue ()
 	}
 }
 
+#define POST_MANY_BATCH 64
+
+static void
+post_many_cb (IrisMessage *message,
+              gpointer     data)
+{
+	gint *next = data;
+
+	/* The batch is handled by a single work item, so order is kept */
+	g_assert_cmpint (message->what, ==, *next);
+	g_atomic_int_inc (next);
+}
+
+/* post many: a batch posted to a plain receiver is delivered in order, and a
+ * batch posted to a paused port is queued.
+ */
+static void
+test_post_many (void)
+{
+	IrisScheduler *scheduler;
+	IrisReceiver  *receiver;
+	IrisPort      *port;
+	IrisMessage   *messages[POST_MANY_BATCH];
+	gint           next = 0;
+	gint           counter = 0;
+	gint           i;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+	port = iris_port_new ();
+	receiver = iris_arbiter_receive (scheduler, port, post_many_cb, &next, NULL);
+
+	for (i = 0; i < POST_MANY_BATCH; i++)
+		messages[i] = iris_message_new (i);
+	iris_port_post_many (port, messages, POST_MANY_BATCH);
+
+	while (g_atomic_int_get (&next) < POST_MANY_BATCH)
+		g_thread_yield ();
+
+	iris_receiver_destroy (receiver, FALSE);
+	g_object_unref (port);
+
+	/* A blocking receiver sees the first message then detaches, so the whole
+	 * batch is queued in the port.
+	 */
+	port = iris_port_new ();
+	receiver = mock_callback_receiver_new (G_CALLBACK (queue1_cb), &counter);
+	iris_port_set_receiver (port, receiver);
+	mock_callback_receiver_block (MOCK_CALLBACK_RECEIVER (receiver));
+
+	for (i = 0; i < POST_MANY_BATCH; i++)
+		messages[i] = iris_message_new (i);
+	iris_port_post_many (port, messages, POST_MANY_BATCH);
+
+	g_assert_cmpint (counter, ==, 1);
+	g_assert_cmpint (iris_port_get_queue_length (port), ==, POST_MANY_BATCH);
+
+	/* A second batch is queued behind the first */
+	for (i = 0; i < POST_MANY_BATCH; i++)
+		messages[i] = iris_message_new (i);
+	iris_port_post_many (port, messages, POST_MANY_BATCH);
+
+	g_assert_cmpint (counter, ==, 1);
+	g_assert_cmpint (iris_port_get_queue_length (port), ==, POST_MANY_BATCH * 2);
+
+	g_object_unref (port);
+}
+
+/* spsc: a single producer port delivers every message, in order, and never
+ * runs the handler twice at once. The benchmark compares it with the usual
+ * way of getting those guarantees, an exclusive receiver on a regular port.
+ */
+
+typedef struct
+{
+	volatile gint next;
+	volatile gint running;
+} SpscState;
+
+static void
+spsc_cb (IrisMessage *message,
+         gpointer     data)
+{
+	SpscState *state = data;
+
+	g_assert (g_atomic_int_compare_and_exchange (&state->running, FALSE, TRUE));
+	g_assert_cmpint (message->what, ==, state->next);
+	g_atomic_int_inc (&state->next);
+	g_atomic_int_set (&state->running, FALSE);
+}
+
+static IrisReceiver *
+spsc_receiver_new (IrisScheduler *scheduler,
+                   IrisPort      *port,
+                   gboolean       spsc,
+                   SpscState     *state)
+{
+	IrisReceiver *receiver;
+
+	receiver = iris_arbiter_receive (scheduler, port, spsc_cb, state, NULL);
+	if (!spsc)
+		iris_arbiter_coordinate (receiver, NULL, NULL);
+
+	return receiver;
+}
+
+static void
+test_spsc (void)
+{
+	IrisScheduler *scheduler;
+	IrisReceiver  *receiver;
+	IrisPort      *port;
+	IrisMessage   *messages[POST_MANY_BATCH];
+	SpscState      state = { 0, FALSE };
+	gint           i, j;
+
+	scheduler = iris_scheduler_new_full (4, 4);
+	port = iris_port_new_spsc ();
+	receiver = spsc_receiver_new (scheduler, port, TRUE, &state);
+
+	for (i = 0; i < ITER_COUNT / 10; i++)
+		iris_port_post (port, iris_message_new (i));
+
+	for (; i < ITER_COUNT / 5; i += POST_MANY_BATCH) {
+		for (j = 0; j < POST_MANY_BATCH; j++)
+			messages[j] = iris_message_new (i + j);
+		iris_port_post_many (port, messages, POST_MANY_BATCH);
+	}
+
+	while (g_atomic_int_get (&state.next) < i)
+		g_thread_yield ();
+
+	g_assert_cmpint (iris_port_get_queue_length (port), ==, 0);
+
+	iris_receiver_destroy (receiver, FALSE);
+	g_object_unref (port);
+}
+
+/* Messages posted before the receiver is connected are queued in the port;
+ * they must still come out ahead of the ring, one at a time. */
+static void
+test_spsc_backlog (void)
+{
+	IrisScheduler *scheduler;
+	IrisReceiver  *receiver;
+	IrisPort      *port;
+	SpscState      state = { 0, FALSE };
+	gint           i;
+
+	scheduler = iris_scheduler_new_full (4, 4);
+	port = iris_port_new_spsc ();
+
+	for (i = 0; i < ITER_COUNT / 10; i++)
+		iris_port_post (port, iris_message_new (i));
+
+	receiver = spsc_receiver_new (scheduler, port, TRUE, &state);
+
+	for (; i < ITER_COUNT / 5; i++)
+		iris_port_post (port, iris_message_new (i));
+
+	while (g_atomic_int_get (&state.next) < i)
+		g_thread_yield ();
+
+	g_assert_cmpint (iris_port_get_queue_length (port), ==, 0);
+
+	iris_receiver_destroy (receiver, FALSE);
+	g_object_unref (port);
+}
+
+static void
+spsc_bench_run (IrisScheduler *scheduler,
+                gboolean       spsc,
+                gdouble       *throughput,
+                gdouble       *latency)
+{
+	IrisReceiver *receiver;
+	IrisPort     *port;
+	GTimer       *timer;
+	SpscState     state = { 0, FALSE };
+	gint          n_messages = g_test_perf () ? ITER_COUNT : ITER_COUNT / 10;
+	gint          i;
+
+	port = spsc ? iris_port_new_spsc () : iris_port_new ();
+	receiver = spsc_receiver_new (scheduler, port, spsc, &state);
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_messages; i++)
+		iris_port_post (port, iris_message_new (i));
+	while (g_atomic_int_get (&state.next) < n_messages)
+		g_thread_yield ();
+
+	*throughput = n_messages / g_timer_elapsed (timer, NULL);
+
+	/* Round trips of one message at a time */
+	g_timer_start (timer);
+	for (i = 0; i < SHORT_ITER_COUNT * 10; i++) {
+		iris_port_post (port, iris_message_new (n_messages + i));
+		while (g_atomic_int_get (&state.next) <= n_messages + i)
+			g_thread_yield ();
+	}
+
+	*latency = g_timer_elapsed (timer, NULL) / (SHORT_ITER_COUNT * 10)
+	           * G_USEC_PER_SEC;
+
+	g_timer_destroy (timer);
+	iris_receiver_destroy (receiver, FALSE);
+	g_object_unref (port);
+}
+
+static void
+test_spsc_benchmark (void)
+{
+	IrisScheduler *scheduler;
+	gdouble        throughput, latency;
+	gdouble        spsc_throughput, spsc_latency;
+
+	scheduler = iris_scheduler_new_full (4, 4);
+
+	spsc_bench_run (scheduler, FALSE, &throughput, &latency);
+	spsc_bench_run (scheduler, TRUE, &spsc_throughput, &spsc_latency);
+
+	g_test_message ("exclusive receiver: %.0f messages/s, %.1f usec latency",
+	                throughput, latency);
+	g_test_message ("single producer port: %.0f messages/s, %.1f usec latency",
+	                spsc_throughput, spsc_latency);
+
+	g_test_maximized_result (spsc_throughput,
+	                         "Messages/s through a single producer port");
+}
+
 gint
 main (int   argc,
       char *argv[])
@@ -239,6 +468,10 @@ main (int   argc,
 	g_test_add_func ("/port/queue2", queue2);
 	g_test_add_func ("/port/flush1", flush1);
 	g_test_add_func ("/port/finalize queue", test_finalize_queue);
+	g_test_add_func ("/port/post many", test_post_many);
+	g_test_add_func ("/port/spsc", test_spsc);
+	g_test_add_func ("/port/spsc backlog", test_spsc_backlog);
+	g_test_add_func ("/port/spsc benchmark", test_spsc_benchmark);
 
 	return g_test_run ();
 }
@@ -0,0 +1,116 @@
+/* port-2: posting allocations. This has a binary of its own because counting
+ * allocations means replacing the allocator for the whole program.
+ */
+
+#include <iris.h>
+#include <stdlib.h>
+
+#define ITER_COUNT 1000000
+
+/* Allocation counting, see main() */
+static volatile gint n_allocations = 0;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+	g_atomic_int_inc (&n_allocations);
+	return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,
+                  gsize    n_bytes)
+{
+	if (mem == NULL)
+		g_atomic_int_inc (&n_allocations);
+	return realloc (mem, n_bytes);
+}
+
+static GMemVTable counting_vtable = {
+	counting_malloc, counting_realloc, free, NULL, NULL, NULL
+};
+
+/* g_mem_set_vtable() does nothing since GLib 2.46 */
+static gboolean vtable_honoured = FALSE;
+
+#define ALLOC_BATCH 32
+
+static void
+post_allocations_cb (IrisMessage *message,
+                     gpointer     data)
+{
+	g_atomic_int_inc ((gint *)data);
+}
+
+/* post allocations: once the caches are warm, posting to a receiver without
+ * an arbiter should not allocate at all. The batches are kept small so the
+ * number of messages in flight stays bounded.
+ */
+static void
+test_post_allocations (void)
+{
+	IrisScheduler *scheduler;
+	IrisReceiver  *receiver;
+	IrisPort      *port;
+	IrisMessage   *message;
+	gint           counter = 0;
+	gint           n_posts = 0;
+	gint           start_allocations = 0;
+	gint           i;
+
+	if (!vtable_honoured) {
+		g_test_message ("skipped: the allocator vtable is not honoured "
+		                "by this GLib, allocations cannot be counted");
+		return;
+	}
+
+	scheduler = iris_scheduler_new_full (2, 2);
+	port = iris_port_new ();
+	receiver = iris_arbiter_receive (scheduler, port, post_allocations_cb,
+	                                 &counter, NULL);
+
+	message = iris_message_ref_sink (iris_message_new (1));
+
+	while (n_posts < ITER_COUNT) {
+		/* Let the first batches warm up the caches */
+		if (n_posts == ALLOC_BATCH * 16)
+			start_allocations = g_atomic_int_get (&n_allocations);
+
+		for (i = 0; i < ALLOC_BATCH; i++)
+			iris_port_post (port, message);
+		n_posts += ALLOC_BATCH;
+
+		while (g_atomic_int_get (&counter) < n_posts)
+			g_thread_yield ();
+	}
+
+	g_assert_cmpint (g_atomic_int_get (&n_allocations) - start_allocations,
+	                 ==, 0);
+
+	iris_receiver_destroy (receiver, FALSE);
+	g_assert_cmpint (message->ref_count, ==, 1);
+	iris_message_unref (message);
+	g_object_unref (port);
+}
+
+gint
+main (int   argc,
+      char *argv[])
+{
+	/* Count every allocation; G_SLICE=always-malloc makes GSlice go through
+	 * the vtable too.
+	 */
+	g_mem_set_vtable (&counting_vtable);
+	g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+	g_free (g_malloc (1));
+	vtable_honoured = g_atomic_int_get (&n_allocations) > 0;
+
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+	g_thread_init (NULL);
+
+	g_test_add_func ("/port/post allocations", test_post_allocations);
+
+	return g_test_run ();
+}
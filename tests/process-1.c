@@ -22,6 +22,10 @@
  
 #include <iris.h>
 
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
+
 #include "iris/iris-process-private.h"
 #include "iris/iris-receiver-private.h"
 
@@ -121,6 +125,91 @@ recursive_counter_callback (IrisProcess *process,
 	(*counter_address) ++;
 }
 
+static void
+batch_counter_callback (IrisProcess  *process,
+                        IrisMessage **work_items,
+                        guint         n_items,
+                        gpointer      user_data)
+{
+	gint *max_seen = user_data;
+	gint *counter_address;
+	guint i;
+
+	for (i=0; i < n_items; i++) {
+		counter_address = iris_message_get_pointer (work_items[i], "counter");
+		g_atomic_int_inc (counter_address);
+	}
+
+	if (n_items > *max_seen)
+		*max_seen = n_items;
+}
+
+typedef struct {
+	volatile gint counter;
+	volatile gint running;
+	volatile gint max_running;
+} ParallelState;
+
+static void
+parallel_callback (IrisProcess *process,
+                   IrisMessage *work_item,
+                   gpointer     user_data)
+{
+	ParallelState *state = user_data;
+	gint           running, max_running;
+
+	running = g_atomic_int_exchange_and_add (&state->running, 1) + 1;
+
+	do
+		max_running = g_atomic_int_get (&state->max_running);
+	while (running > max_running &&
+	       !g_atomic_int_compare_and_exchange (&state->max_running,
+	                                           max_running, running));
+
+	/* Long enough for the other worker to start on a loaded machine */
+	g_usleep (50000);
+
+	g_atomic_int_inc (&state->counter);
+	g_atomic_int_add (&state->running, -1);
+}
+
+static void
+jitter_forward_callback (IrisProcess *process,
+                         IrisMessage *work_item,
+                         gpointer     user_data)
+{
+	g_usleep (g_random_int_range (0, 5000));
+	iris_process_forward (process, work_item);
+}
+
+static void
+record_order_callback (IrisProcess *process,
+                       IrisMessage *work_item,
+                       gpointer     user_data)
+{
+	GArray *order = user_data;
+	gint    index = iris_message_get_int (work_item, "index");
+
+	/* Ordering leaves nothing behind in the message */
+	g_assert_cmpint (iris_message_count_names (work_item), ==, 1);
+
+	g_array_append_val (order, index);
+}
+
+static void
+slow_max_queue_callback (IrisProcess *process,
+                         IrisMessage *work_item,
+                         gpointer     user_data)
+{
+	gint *max_queue_length = user_data;
+	gint  queue_length = iris_process_get_queue_length (process);
+
+	if (queue_length > *max_queue_length)
+		*max_queue_length = queue_length;
+
+	g_usleep (1000);
+}
+
 static void
 time_waster_callback (IrisProcess *process,
                       IrisMessage *work_item,
@@ -433,6 +522,355 @@ titles (void)
 }
 
 
+/* batched: every item is processed, and the batches grow with the queue */
+static void
+test_batched (void)
+{
+	IrisProcess *process;
+	gint         counter = 0,
+	             max_seen = 0,
+	             processed_items,
+	             total_items;
+
+	process = iris_process_new_batched (batch_counter_callback, 16, &max_seen, NULL);
+	g_object_ref (process);
+
+	/* Queue everything first so the process sees a deep queue */
+	enqueue_counter_work (process, &counter, 200);
+	while (iris_queue_get_length (process->priv->work_queue) < 200)
+		g_thread_yield ();
+
+	iris_process_run (process);
+
+	while (! iris_process_is_finished (process))
+		g_thread_yield ();
+
+	g_assert_cmpint (counter, ==, 200);
+	g_assert_cmpint (max_seen, >, 1);
+	g_assert_cmpint (max_seen, <=, 16);
+
+	iris_process_get_status (process, &processed_items, &total_items);
+	g_assert_cmpint (processed_items, ==, 200);
+	g_assert_cmpint (total_items, ==, 200);
+
+	g_object_unref (process);
+}
+
+/* parallel: work is shared between threads, and completion is only signalled
+ * once every worker is done. The work scheduler has two threads whatever the
+ * machine, and every item sleeps, so the workers overlap even on one CPU.
+ */
+static void
+test_parallel (void)
+{
+	IrisScheduler *scheduler;
+	IrisProcess   *process;
+	ParallelState  state = { 0, 0, 0 };
+	gint           i;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+
+	process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (process, parallel_callback, &state, NULL);
+	iris_process_set_max_parallelism (process, 4);
+	g_object_ref (process);
+
+	/* Queue everything first so the first worker asks for help straight away */
+	for (i=0; i < 20; i++)
+		iris_process_enqueue (process, iris_message_new (0));
+	iris_process_close (process);
+	while (iris_queue_get_length (process->priv->work_queue) < 20)
+		g_thread_yield ();
+
+	iris_process_run (process);
+
+	while (! iris_process_is_finished (process))
+		g_thread_yield ();
+
+	/* Never more workers than the scheduler has threads */
+	g_assert_cmpint (state.counter, ==, 20);
+	g_assert_cmpint (state.running, ==, 0);
+	g_assert_cmpint (state.max_running, <=, 2);
+	g_assert_cmpint (state.max_running, >, 1);
+
+	g_object_unref (process);
+	g_object_unref (scheduler);
+}
+
+/* ordered: a parallel process still forwards in enqueue order */
+static void
+test_ordered (void)
+{
+	IrisProcess *head_process, *tail_process;
+	GArray      *order;
+	gint         i;
+
+	order = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	head_process = iris_process_new (jitter_forward_callback, NULL, NULL);
+	tail_process = iris_process_new (record_order_callback, order, NULL);
+	iris_process_set_max_parallelism (head_process, 4);
+	iris_process_set_ordered (head_process, TRUE, 8);
+	iris_process_connect (head_process, tail_process);
+	g_object_ref (tail_process);
+
+	iris_process_run (head_process);
+
+	for (i=0; i < 100; i++)
+		iris_process_enqueue (head_process,
+		                      iris_message_new_items (0, "index", G_TYPE_INT, i,
+		                                              NULL));
+	iris_process_close (head_process);
+
+	while (! iris_process_is_finished (tail_process))
+		g_thread_yield ();
+
+	g_assert_cmpint (order->len, ==, 100);
+	for (i=0; i < 100; i++)
+		g_assert_cmpint (g_array_index (order, gint, i), ==, i);
+
+	g_object_unref (tail_process);
+	g_array_free (order, TRUE);
+}
+
+/* ordered shared: the same work items go through two ordered processes, and
+ * each keeps its own order.
+ */
+static void
+test_ordered_shared (void)
+{
+	IrisProcess *head_processes[2],
+	            *tail_processes[2];
+	IrisMessage *work_item;
+	GArray      *orders[2];
+	gint         i, j;
+
+	for (j=0; j < 2; j++) {
+		orders[j] = g_array_new (FALSE, FALSE, sizeof (gint));
+		head_processes[j] = iris_process_new (jitter_forward_callback, NULL, NULL);
+		tail_processes[j] = iris_process_new (record_order_callback, orders[j], NULL);
+		iris_process_set_max_parallelism (head_processes[j], 4);
+		iris_process_set_ordered (head_processes[j], TRUE, 8);
+		iris_process_connect (head_processes[j], tail_processes[j]);
+		g_object_ref (tail_processes[j]);
+
+		iris_process_run (head_processes[j]);
+	}
+
+	for (i=0; i < 100; i++) {
+		work_item = iris_message_new_items (0, "index", G_TYPE_INT, i, NULL);
+		iris_message_ref_sink (work_item);
+		iris_process_enqueue (head_processes[0], work_item);
+		iris_process_enqueue (head_processes[1], work_item);
+		iris_message_unref (work_item);
+	}
+
+	for (j=0; j < 2; j++) {
+		iris_process_close (head_processes[j]);
+
+		while (! iris_process_is_finished (tail_processes[j]))
+			g_thread_yield ();
+
+		g_assert_cmpint (orders[j]->len, ==, 100);
+		for (i=0; i < 100; i++)
+			g_assert_cmpint (g_array_index (orders[j], gint, i), ==, i);
+
+		g_object_unref (tail_processes[j]);
+		g_array_free (orders[j], TRUE);
+	}
+}
+
+/* ordered throttled: an ordered process shares its threads with a sink that
+ * holds it back. A worker forwarding to the sink must not stop the others
+ * from giving their thread to the sink.
+ */
+static void
+test_ordered_throttled (void)
+{
+	IrisScheduler *scheduler;
+	IrisProcess   *head_process, *tail_process;
+	gint           max_queue_length = 0,
+	               i;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+
+	head_process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (head_process, jitter_forward_callback, NULL, NULL);
+	tail_process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (tail_process, slow_max_queue_callback,
+	                       &max_queue_length, NULL);
+	iris_process_set_max_parallelism (head_process, 4);
+	iris_process_set_ordered (head_process, TRUE, 8);
+	iris_process_set_queue_limit (tail_process, 2, 1);
+	iris_process_connect (head_process, tail_process);
+	g_object_ref (tail_process);
+
+	iris_process_run (head_process);
+
+	for (i=0; i < 100; i++)
+		iris_process_enqueue (head_process, iris_message_new (0));
+	iris_process_close (head_process);
+
+	while (! iris_process_is_finished (tail_process))
+		g_thread_yield ();
+
+	/* At worst the head releases a whole reorder window of output at once
+	 * as the tail reaches its limit, with one more item in flight.
+	 */
+	g_assert_cmpint (max_queue_length, <=, 2 + 8 + 1);
+
+	g_object_unref (tail_process);
+	g_object_unref (scheduler);
+}
+
+/* queue limit: a fast source is held back by a slow sink */
+static void
+test_queue_limit (void)
+{
+	IrisProcess *head_process, *tail_process;
+	gint         max_queue_length = 0,
+	             processed_items,
+	             total_items,
+	             i;
+	guint        n_throttled;
+	gdouble      throttled_time;
+
+	head_process = iris_process_new (push_next_func, NULL, NULL);
+	tail_process = iris_process_new (slow_max_queue_callback,
+	                                 &max_queue_length, NULL);
+	iris_process_set_queue_limit (tail_process, 10, 5);
+	iris_process_connect (head_process, tail_process);
+	g_object_ref (tail_process);
+
+	/* Work forwarded before the tail is running is not throttled */
+	iris_process_run (head_process);
+	while (! iris_process_is_executing (tail_process))
+		wait_control_messages (tail_process);
+
+	for (i=0; i < 200; i++)
+		iris_process_enqueue (head_process, iris_message_new (0));
+	iris_process_close (head_process);
+
+	while (! iris_process_is_finished (tail_process))
+		g_thread_yield ();
+
+	iris_process_get_status (tail_process, &processed_items, &total_items);
+	g_assert_cmpint (processed_items, ==, 200);
+
+	/* The head process can have one more item in flight when the limit is
+	 * reached.
+	 */
+	g_assert_cmpint (max_queue_length, <=, 11);
+
+	iris_process_get_throttle_stats (tail_process, &n_throttled, &throttled_time);
+	g_assert_cmpint (n_throttled, >, 0);
+	g_assert_cmpfloat (throttled_time, >, 0.0);
+
+	if (g_test_perf ())
+		g_test_message ("Throttled %u times for %.3fs", n_throttled,
+		                throttled_time);
+
+	g_object_unref (tail_process);
+}
+
+/* queue limit shared thread: a throttled source gives up the thread it
+ * shares with its sink, rather than waiting on it for the sink to drain.
+ */
+static void
+test_queue_limit_shared_thread (void)
+{
+	IrisScheduler *scheduler;
+	IrisProcess   *head_process, *tail_process;
+	gint           max_queue_length = 0,
+	               processed_items,
+	               total_items,
+	               i;
+	guint          n_throttled;
+
+	scheduler = iris_scheduler_new_full (1, 1);
+
+	head_process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (head_process, push_next_func, NULL, NULL);
+	tail_process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (tail_process, slow_max_queue_callback,
+	                       &max_queue_length, NULL);
+	iris_process_set_queue_limit (tail_process, 2, 1);
+	iris_process_connect (head_process, tail_process);
+	g_object_ref (tail_process);
+
+	iris_process_run (head_process);
+	while (! iris_process_is_executing (tail_process))
+		wait_control_messages (tail_process);
+
+	for (i=0; i < 50; i++)
+		iris_process_enqueue (head_process, iris_message_new (0));
+	iris_process_close (head_process);
+
+	while (! iris_process_is_finished (tail_process))
+		g_thread_yield ();
+
+	iris_process_get_status (tail_process, &processed_items, &total_items);
+	g_assert_cmpint (processed_items, ==, 50);
+	g_assert_cmpint (max_queue_length, <=, 3);
+
+	iris_process_get_throttle_stats (tail_process, &n_throttled, NULL);
+	g_assert_cmpint (n_throttled, >, 0);
+
+	g_object_unref (tail_process);
+	g_object_unref (scheduler);
+}
+
+/* cpu bound throttled: a CPU-bound process throttled by the CPU-bound
+ * process it forwards to gives up its processor while it waits, otherwise
+ * with every processor taken by the head the sink would never run.
+ */
+static void
+test_cpu_bound_throttled (void)
+{
+	IrisScheduler *scheduler;
+	IrisProcess   *head_process, *tail_process;
+	gint           n_cpu = iris_scheduler_get_n_cpu (),
+	               max_queue_length = 0,
+	               processed_items,
+	               total_items,
+	               i;
+
+	/* Enough threads that only the processor slots can run out */
+	scheduler = iris_scheduler_new_full (n_cpu + 2, n_cpu + 2);
+
+	head_process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (head_process, jitter_forward_callback, NULL, NULL);
+	tail_process = g_object_new (IRIS_TYPE_PROCESS, "work-scheduler", scheduler, NULL);
+	iris_process_set_func (tail_process, slow_max_queue_callback,
+	                       &max_queue_length, NULL);
+	iris_task_set_performance_hint (IRIS_TASK (head_process), IRIS_CPU_BOUND);
+	iris_task_set_performance_hint (IRIS_TASK (tail_process), IRIS_CPU_BOUND);
+	iris_process_set_max_parallelism (head_process, n_cpu);
+	iris_process_set_queue_limit (tail_process, 2, 1);
+	iris_process_connect (head_process, tail_process);
+	g_object_ref (tail_process);
+
+	iris_process_run (head_process);
+
+	for (i=0; i < n_cpu * 20; i++)
+		iris_process_enqueue (head_process, iris_message_new (0));
+	iris_process_close (head_process);
+
+	while (! iris_process_is_finished (tail_process))
+		g_thread_yield ();
+
+	iris_process_get_status (tail_process, &processed_items, &total_items);
+	g_assert_cmpint (processed_items, ==, n_cpu * 20);
+
+	/* Each of the head's n_cpu workers can have one more item in flight
+	 * when the limit is reached, before it parks.
+	 */
+	g_assert_cmpint (max_queue_length, <=, 2 + n_cpu);
+
+	g_object_unref (tail_process);
+	g_object_unref (scheduler);
+}
+
 static void
 recurse_1 (void)
 {
@@ -862,6 +1300,57 @@ test_output_estimates_cancel (void)
 	g_object_unref (process_2);
 }
 
+#ifdef G_OS_UNIX
+static gdouble
+get_cpu_time (void)
+{
+	struct rusage usage;
+
+	getrusage (RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+	       usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+/* idle: an open process with no work should not burn CPU while it waits, and
+ * should still wake up promptly when work arrives.
+ */
+static void
+test_idle (void)
+{
+	IrisProcess *process;
+	gint         counter = 0;
+	gdouble      cpu_time;
+
+	process = iris_process_new (counter_callback, NULL, NULL);
+	g_object_add_weak_pointer (G_OBJECT (process), (gpointer *)&process);
+
+	iris_process_run (process);
+	while (! iris_process_is_executing (process))
+		wait_control_messages (process);
+
+	/* Let the work function find out it has nothing to do */
+	g_usleep (G_USEC_PER_SEC / 10);
+
+	cpu_time = get_cpu_time ();
+	g_usleep (G_USEC_PER_SEC / 2);
+	cpu_time = get_cpu_time () - cpu_time;
+
+	if (g_test_perf ())
+		g_test_minimized_result (cpu_time, "CPU time of idle process: %.4fs in 0.5s",
+		                         cpu_time);
+
+	/* Spinning through the scheduler used a whole core */
+	g_assert_cmpfloat (cpu_time, <, 0.1);
+
+	enqueue_counter_work (process, &counter, 50);
+
+	while (process != NULL)
+		g_thread_yield ();
+
+	g_assert_cmpint (counter, ==, 50);
+}
+#endif
+
 int main(int argc, char *argv[]) {
 	g_type_init ();
 	g_test_init (&argc, &argv, NULL);
@@ -876,6 +1365,19 @@ int main(int argc, char *argv[]) {
 	g_test_add_func ("/process/cancel - execution 3", test_cancel_execution_3);
 
 	g_test_add_func ("/process/titles", titles);
+	g_test_add_func ("/process/batched", test_batched);
+	g_test_add_func_repeated ("/process/parallel", 5, test_parallel);
+	g_test_add_func_repeated ("/process/ordered", 5, test_ordered);
+	g_test_add_func_repeated ("/process/ordered shared", 5, test_ordered_shared);
+	g_test_add_func_repeated ("/process/ordered throttled", 5, test_ordered_throttled);
+	g_test_add_func ("/process/queue limit", test_queue_limit);
+	g_test_add_func ("/process/queue limit shared thread",
+	                 test_queue_limit_shared_thread);
+	g_test_add_func ("/process/cpu bound throttled", test_cpu_bound_throttled);
+
+#ifdef G_OS_UNIX
+	g_test_add_func ("/process/idle", test_idle);
+#endif
 
 	g_test_add_func ("/process/recurse 1", recurse_1);
 	g_test_add_func_repeated ("/process/chaining 1", 50, chaining_1);
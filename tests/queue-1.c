@@ -8,7 +8,7 @@ test1 (void)
 {
 	IrisQueue *queue = iris_queue_new ();
 	g_assert (queue != NULL);
-	g_assert (queue->priv->q != NULL);
+	g_assert (queue->priv->mutex != NULL);
 }
 
 static void
@@ -209,6 +209,47 @@ test_timed_pop_or_close (void)
 	g_object_unref (queue);
 }
 
+/* priority: urgent items first, low priority items last, and each in order.
+ * Close tokens must still come after everything.
+ */
+static void
+test_priority (void)
+{
+	gint       items[9];
+	IrisQueue *queue = iris_queue_new ();
+
+	iris_queue_push_priority (queue, &items[6], 1);
+	iris_queue_push (queue, &items[3]);
+	iris_queue_push_priority (queue, &items[0], -1);
+	iris_queue_push (queue, &items[4]);
+	iris_queue_push_priority (queue, &items[7], 1);
+	iris_queue_push_priority (queue, &items[1], -1);
+	iris_queue_push_priority (queue, &items[5], 0);
+	iris_queue_push_priority (queue, &items[8], 1);
+
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 8);
+
+	g_assert (iris_queue_pop (queue) == &items[0]);
+	g_assert (iris_queue_pop (queue) == &items[1]);
+
+	/* an urgent item pushed now still goes before the normal ones */
+	iris_queue_push_priority (queue, &items[2], -1);
+
+	g_assert (iris_queue_pop (queue) == &items[2]);
+	g_assert (iris_queue_pop (queue) == &items[3]);
+	g_assert (iris_queue_pop (queue) == &items[4]);
+	g_assert (iris_queue_pop (queue) == &items[5]);
+	g_assert (iris_queue_pop (queue) == &items[6]);
+
+	iris_queue_close (queue);
+
+	g_assert (iris_queue_pop (queue) == &items[7]);
+	g_assert (iris_queue_pop (queue) == &items[8]);
+	g_assert (iris_queue_pop (queue) == NULL);
+
+	g_object_unref (queue);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -229,6 +270,7 @@ main (int   argc,
 	g_test_add_func ("/queue/pop() closed 2", test_pop_closed_2);
 	g_test_add_func ("/queue/try_pop_or_close()", test_try_pop_or_close);
 	g_test_add_func ("/queue/timed_pop_or_close()", test_timed_pop_or_close);
+	g_test_add_func ("/queue/priority", test_priority);
 
 	return g_test_run ();
 }
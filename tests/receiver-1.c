@@ -4,6 +4,7 @@
 #include <iris/iris-arbiter-private.h>
 #include <iris/iris-receiver-private.h>
 #include <iris/iris-scheduler-private.h>
+#include <iris/iris-thread-private.h>
 
 #include "mocks/mock-scheduler.h"
 
@@ -44,6 +45,8 @@ new_full1 (void)
 
 	g_assert (iris_receiver_has_arbiter (receiver));
 	g_assert (receiver->priv->scheduler == scheduler);
+	g_assert_cmpint (iris_receiver_get_priority (receiver), ==,
+	                 IRIS_SCHEDULER_PRIORITY_NORMAL);
 }
 
 static void
@@ -160,6 +163,76 @@ test_destroy_from_message (void)
 	g_object_unref (scheduler);
 }
 
+#define ROUND_TRIPS 100000
+
+typedef struct
+{
+	IrisPort      *port;
+	volatile gint  count;
+} RoundTrip;
+
+/* Each message posts the next one from within the handler, so every round
+ * trip allocates its message, thread work and worker data on a scheduler
+ * thread.
+ */
+static void
+round_trip_cb (IrisMessage *message,
+               gpointer     data)
+{
+	RoundTrip *state = data;
+
+	if (g_atomic_int_exchange_and_add (&state->count, 1) + 1 < ROUND_TRIPS)
+		iris_port_post (state->port, iris_message_new (1));
+}
+
+static gdouble
+round_trip_run (void)
+{
+	IrisScheduler *scheduler;
+	IrisReceiver  *receiver;
+	RoundTrip      state = { NULL, 0 };
+	GTimer        *timer;
+	gdouble        elapsed;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+	state.port = iris_port_new ();
+	receiver = iris_arbiter_receive (scheduler, state.port, round_trip_cb,
+	                                 &state, NULL);
+
+	timer = g_timer_new ();
+	iris_port_post (state.port, iris_message_new (1));
+
+	while (g_atomic_int_get (&state.count) < ROUND_TRIPS)
+		g_thread_yield ();
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	iris_receiver_destroy (receiver, FALSE);
+	g_object_unref (state.port);
+	g_object_unref (scheduler);
+
+	return ROUND_TRIPS / elapsed;
+}
+
+/* Compares the per-thread caches with allocating everything from GSlice */
+static void
+perf_round_trip (void)
+{
+	gdouble slice_rate, cached_rate;
+
+	iris_thread_cache_set_enabled (FALSE);
+	slice_rate = round_trip_run ();
+	iris_thread_cache_set_enabled (TRUE);
+	cached_rate = round_trip_run ();
+
+	g_test_message ("%.0f round trips/s with GSlice, %.0f with the thread "
+	                "caches", slice_rate, cached_rate);
+
+	g_test_maximized_result (cached_rate, "%.0f post->handle round trips/s",
+	                         cached_rate);
+}
+
 gint
 main (int   argc,
       char *argv[])
@@ -174,6 +247,7 @@ main (int   argc,
 	g_test_add_func ("/receiver/many_message_delivered1", many_message_delivered1);
 	g_test_add_func ("/receiver/destroy()", test_destroy);
 	g_test_add_func ("/receiver/destroy() from message", test_destroy_from_message);
+	g_test_add_func ("/receiver/perf round trip", perf_round_trip);
 
 	return g_test_run ();
 }
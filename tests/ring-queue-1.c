@@ -0,0 +1,278 @@
+#include <iris.h>
+#include <iris/iris-ringqueue-private.h>
+
+static void
+test_new (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (100);
+
+	g_assert (queue != NULL);
+	g_assert (IRIS_IS_RINGQUEUE (queue));
+	g_assert_cmpint (iris_ringqueue_get_capacity (IRIS_RINGQUEUE (queue)), ==, 128);
+	g_assert (iris_queue_try_pop (queue) == NULL);
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 0);
+
+	g_object_unref (queue);
+}
+
+static void
+test_push_pop (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (4);
+	gint       i;
+
+	/* Go round the ring many times to cover wrapping */
+	for (i = 1; i < 1000; i++) {
+		g_assert (iris_queue_push (queue, GINT_TO_POINTER (i)));
+		g_assert (iris_queue_push (queue, GINT_TO_POINTER (-i)));
+		g_assert_cmpint (iris_queue_get_length (queue), ==, 2);
+		g_assert_cmpint (GPOINTER_TO_INT (iris_queue_pop (queue)), ==, i);
+		g_assert_cmpint (GPOINTER_TO_INT (iris_queue_try_pop (queue)), ==, -i);
+	}
+
+	g_assert (iris_queue_try_pop (queue) == NULL);
+	g_object_unref (queue);
+}
+
+static void
+test_full (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (4);
+	gint       i;
+
+	for (i = 1; i <= 4; i++)
+		g_assert (iris_ringqueue_try_push (IRIS_RINGQUEUE (queue), GINT_TO_POINTER (i)));
+
+	g_assert (!iris_ringqueue_try_push (IRIS_RINGQUEUE (queue), GINT_TO_POINTER (5)));
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 4);
+
+	g_assert_cmpint (GPOINTER_TO_INT (iris_queue_pop (queue)), ==, 1);
+	g_assert (iris_ringqueue_try_push (IRIS_RINGQUEUE (queue), GINT_TO_POINTER (5)));
+
+	for (i = 2; i <= 5; i++)
+		g_assert_cmpint (GPOINTER_TO_INT (iris_queue_pop (queue)), ==, i);
+
+	g_object_unref (queue);
+}
+
+static gpointer
+slow_consumer (gpointer data)
+{
+	IrisQueue *queue = data;
+	gint       sum = 0;
+	gint       item;
+
+	while ((item = GPOINTER_TO_INT (iris_queue_pop (queue))) != 0) {
+		g_usleep (100);
+		sum += item;
+	}
+
+	return GINT_TO_POINTER (sum);
+}
+
+/* backpressure: pushing to a full queue waits for the consumer */
+static void
+test_backpressure (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (2);
+	GThread   *thread;
+	gint       sum = 0;
+	gint       i;
+
+	thread = g_thread_create (slow_consumer, queue, TRUE, NULL);
+
+	for (i = 1; i <= 200; i++) {
+		g_assert (iris_queue_push (queue, GINT_TO_POINTER (i)));
+		g_assert_cmpint (iris_queue_get_length (queue), <=, 2);
+		sum += i;
+	}
+
+	iris_queue_close (queue);
+	g_assert_cmpint (GPOINTER_TO_INT (g_thread_join (thread)), ==, sum);
+
+	g_object_unref (queue);
+}
+
+static void
+test_pop_closed (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (8);
+	gint       i;
+
+	g_assert (iris_queue_is_closed (queue) == FALSE);
+	g_assert (iris_queue_push (queue, &i));
+
+	iris_queue_close (queue);
+	g_assert (iris_queue_is_closed (queue) == TRUE);
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 1);
+
+	g_assert (iris_queue_push (queue, &i) == FALSE);
+	g_assert (iris_ringqueue_try_push (IRIS_RINGQUEUE (queue), &i) == FALSE);
+
+	g_assert (iris_queue_pop (queue) == &i);
+	g_assert (iris_queue_pop (queue) == NULL);
+
+	g_object_unref (queue);
+}
+
+/* pop() closed wakeup: threads blocked in pop() return NULL on close */
+static void
+test_pop_closed_wakeup (void)
+{
+	IrisQueue *queue;
+	GThread   *thread[4];
+	gint       i, j, items_received;
+	gpointer   ptr;
+
+	for (i = 0; i < 50; i++) {
+		queue = iris_ringqueue_new (8);
+
+		for (j = 0; j < 4; j++)
+			thread[j] = g_thread_create ((GThreadFunc)iris_queue_pop, queue, TRUE, NULL);
+
+		iris_queue_push (queue, &i);
+		iris_queue_push (queue, &i);
+		iris_queue_close (queue);
+
+		items_received = 0;
+		for (j = 0; j < 4; j++) {
+			ptr = g_thread_join (thread[j]);
+			if (ptr == &i)
+				items_received ++;
+			else
+				g_assert (ptr == NULL);
+		}
+
+		g_assert_cmpint (items_received, ==, 2);
+		g_object_unref (queue);
+	}
+}
+
+static void
+test_try_pop_or_close (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (8);
+	gint       i;
+
+	iris_queue_push (queue, &i);
+
+	g_assert (iris_queue_try_pop_or_close (queue) == &i);
+	g_assert (iris_queue_is_closed (queue) == FALSE);
+
+	g_assert (iris_queue_try_pop_or_close (queue) == NULL);
+	g_assert (iris_queue_is_closed (queue) == TRUE);
+	g_assert (iris_queue_push (queue, &i) == FALSE);
+
+	g_object_unref (queue);
+}
+
+static void
+test_timed_pop_or_close (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (8);
+	GTimeVal   timeout;
+	gint       i;
+
+	iris_queue_push (queue, &i);
+
+	g_get_current_time (&timeout);
+	g_time_val_add (&timeout, 100000);
+
+	g_assert (iris_queue_timed_pop_or_close (queue, &timeout) == &i);
+	g_assert (iris_queue_is_closed (queue) == FALSE);
+
+	g_assert (iris_queue_timed_pop_or_close (queue, &timeout) == NULL);
+	g_assert (iris_queue_is_closed (queue) == TRUE);
+
+	g_object_unref (queue);
+}
+
+/* mpmc: every item pushed by several producers is popped exactly once */
+#define MPMC_THREADS 4
+#define MPMC_ITEMS   100000
+
+static volatile gint mpmc_sum;
+
+static gpointer
+mpmc_producer (gpointer data)
+{
+	gint i;
+
+	for (i = 1; i <= MPMC_ITEMS; i++)
+		iris_queue_push (data, GINT_TO_POINTER (i));
+
+	return NULL;
+}
+
+static gpointer
+mpmc_consumer (gpointer data)
+{
+	gpointer item;
+
+	while ((item = iris_queue_pop (data)) != NULL)
+		g_atomic_int_add (&mpmc_sum, GPOINTER_TO_INT (item) & 0xff);
+
+	return NULL;
+}
+
+static void
+test_mpmc (void)
+{
+	IrisQueue *queue = iris_ringqueue_new (64);
+	GThread   *producers[MPMC_THREADS];
+	GThread   *consumers[MPMC_THREADS];
+	gint       expected = 0;
+	gint       i;
+
+	mpmc_sum = 0;
+
+	for (i = 1; i <= MPMC_ITEMS; i++)
+		expected += i & 0xff;
+	expected *= MPMC_THREADS;
+
+	for (i = 0; i < MPMC_THREADS; i++) {
+		consumers[i] = g_thread_create (mpmc_consumer, queue, TRUE, NULL);
+		producers[i] = g_thread_create (mpmc_producer, queue, TRUE, NULL);
+	}
+
+	for (i = 0; i < MPMC_THREADS; i++)
+		g_thread_join (producers[i]);
+
+	iris_queue_close (queue);
+
+	for (i = 0; i < MPMC_THREADS; i++)
+		g_thread_join (consumers[i]);
+
+	g_assert_cmpint (mpmc_sum, ==, expected);
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 0);
+
+	g_object_unref (queue);
+}
+
+static void
+test_get_type (void)
+{
+	g_assert_cmpint (IRIS_TYPE_RINGQUEUE, !=, G_TYPE_INVALID);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+	g_thread_init (NULL);
+
+	g_test_add_func ("/ringqueue/new", test_new);
+	g_test_add_func ("/ringqueue/push_pop", test_push_pop);
+	g_test_add_func ("/ringqueue/full", test_full);
+	g_test_add_func ("/ringqueue/backpressure", test_backpressure);
+	g_test_add_func ("/ringqueue/pop() closed", test_pop_closed);
+	g_test_add_func ("/ringqueue/pop() closed wakeup", test_pop_closed_wakeup);
+	g_test_add_func ("/ringqueue/try_pop_or_close()", test_try_pop_or_close);
+	g_test_add_func ("/ringqueue/timed_pop_or_close()", test_timed_pop_or_close);
+	g_test_add_func ("/ringqueue/mpmc", test_mpmc);
+	g_test_add_func ("/ringqueue/get_type", test_get_type);
+
+	return g_test_run ();
+}
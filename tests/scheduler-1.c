@@ -1,4 +1,5 @@
 #include <iris.h>
+#include <iris/iris-wsqueue-private.h>
 #include <string.h>
 
 static void
@@ -65,6 +66,56 @@ test_queue (void)
 	}
 }
 
+/* queue factory: work runs through the queues made by the factory, here
+ * rings small enough to fill up, with each kind of scheduler.
+ */
+#define RING_SIZE 8
+
+static volatile gint n_rings;
+
+static IrisQueue*
+ring_queue_factory (gpointer user_data)
+{
+	g_atomic_int_inc (&n_rings);
+	return iris_ringqueue_new (GPOINTER_TO_UINT (user_data));
+}
+
+static void
+test_queue_factory (void)
+{
+	IrisScheduler *schedulers[3];
+	gint           i, j;
+
+	schedulers[0] = iris_scheduler_new_full (2, 2);
+	schedulers[1] = iris_lfscheduler_new_full (2, 2);
+	schedulers[2] = iris_wsscheduler_new_full (2, 2);
+
+	for (j = 0; j < G_N_ELEMENTS (schedulers); j++) {
+		counter = 0;
+		n_rings = 0;
+		memset (exec_flag, 0, WORK_COUNT * sizeof(gint));
+
+		g_assert (iris_scheduler_set_queue_factory (schedulers[j],
+		                                            ring_queue_factory,
+		                                            GUINT_TO_POINTER (RING_SIZE)));
+
+		for (i = 0; i < WORK_COUNT; i++)
+			iris_scheduler_queue (schedulers[j], work_register_cb,
+			                      GINT_TO_POINTER (i), NULL);
+
+		g_assert (!iris_scheduler_set_queue_factory (schedulers[j], NULL, NULL));
+		g_assert_cmpint (g_atomic_int_get (&n_rings), >=, 1);
+
+		while (g_atomic_int_get (&counter) < WORK_COUNT)
+			g_usleep (1000);
+
+		for (i = 0; i < WORK_COUNT; i++)
+			g_assert (exec_flag[i]);
+
+		g_object_unref (schedulers[j]);
+	}
+}
+
 /* finalize: test threads are released to the scheduler */
 static void
 test_finalize (void)
@@ -72,6 +123,7 @@ test_finalize (void)
 	IrisScheduler *scheduler;
 	int            i, n_threads,
 	               spare_threads;
+	guint          n_retired, n_retired_before;
 
 	for (n_threads=1; n_threads<20; n_threads++) {
 		scheduler = iris_scheduler_new_full (n_threads, n_threads);
@@ -80,16 +132,349 @@ test_finalize (void)
 			iris_scheduler_queue (scheduler, (IrisCallback)g_usleep, GINT_TO_POINTER (500), NULL);
 
 		spare_threads = iris_scheduler_manager_get_spare_thread_count ();
+		iris_scheduler_manager_get_thread_counts (NULL, &n_retired_before);
 
 		g_object_unref (scheduler);
 
-		/* Wait for thread to yield itself back (or hang if it doesn't) */
-		while (iris_scheduler_manager_get_spare_thread_count () !=
-		       spare_threads + n_threads)
+		/* Wait for thread to yield itself back (or hang if it doesn't).
+		 * Spare threads beyond the idle reserve may retire meanwhile.
+		 */
+		for (;;) {
+			iris_scheduler_manager_get_thread_counts (NULL, &n_retired);
+
+			if (iris_scheduler_manager_get_spare_thread_count () +
+			    (n_retired - n_retired_before) ==
+			    spare_threads + n_threads)
+				break;
+
 			g_thread_yield ();
+		}
+	}
+}
+
+/* fork join: recursive divide and conquer, like examples/recursive.c. Every
+ * node queues its two children from inside the scheduler, which is the case
+ * work-stealing is meant for.
+ */
+typedef struct
+{
+	IrisScheduler *scheduler;
+	volatile gint  n_leaves;
+} ForkJoin;
+
+static ForkJoin fork_join;
+
+static void
+fork_join_cb (gpointer data)
+{
+	gint depth = GPOINTER_TO_INT (data);
+
+	if (depth == 0) {
+		g_atomic_int_inc (&fork_join.n_leaves);
+		return;
+	}
+
+	iris_scheduler_queue (fork_join.scheduler, fork_join_cb,
+	                      GINT_TO_POINTER (depth - 1), NULL);
+	iris_scheduler_queue (fork_join.scheduler, fork_join_cb,
+	                      GINT_TO_POINTER (depth - 1), NULL);
+}
+
+static gdouble
+fork_join_run (IrisScheduler *scheduler,
+               gint           depth)
+{
+	GTimer  *timer;
+	gdouble  elapsed;
+
+	fork_join.scheduler = scheduler;
+	fork_join.n_leaves = 0;
+
+	timer = g_timer_new ();
+
+	iris_scheduler_queue (scheduler, fork_join_cb, GINT_TO_POINTER (depth), NULL);
+
+	while (g_atomic_int_get (&fork_join.n_leaves) < (1 << depth))
+		g_thread_yield ();
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_object_unref (scheduler);
+
+	return elapsed;
+}
+
+static void
+test_fork_join (void)
+{
+	gint    depth = g_test_perf () ? 20 : 12;
+	guint   n_threads = iris_scheduler_get_n_cpu ();
+	gdouble ws_time[3];
+	gdouble lf_time;
+	gdouble time;
+
+	time = fork_join_run (iris_scheduler_new_full (n_threads, n_threads), depth);
+	lf_time = fork_join_run (iris_lfscheduler_new_full (n_threads, n_threads), depth);
+
+	/* IrisWSScheduler with each way of picking victims */
+	iris_wsqueue_set_default_steal (IRIS_WSQUEUE_STEAL_ROUND_ROBIN);
+	ws_time[0] = fork_join_run (iris_wsscheduler_new_full (n_threads, n_threads), depth);
+	iris_wsqueue_set_default_steal (IRIS_WSQUEUE_STEAL_RANDOM);
+	ws_time[1] = fork_join_run (iris_wsscheduler_new_full (n_threads, n_threads), depth);
+	iris_wsqueue_set_default_steal (IRIS_WSQUEUE_STEAL_HALF);
+	ws_time[2] = fork_join_run (iris_wsscheduler_new_full (n_threads, n_threads), depth);
+
+	g_test_message ("%d leaves on %u threads: IrisScheduler %.0f/s, "
+	                "IrisLFScheduler %.0f/s",
+	                1 << depth, n_threads, (1 << depth) / time,
+	                (1 << depth) / lf_time);
+	g_test_message ("IrisWSScheduler: round-robin %.0f/s, random %.0f/s, "
+	                "steal half %.0f/s",
+	                (1 << depth) / ws_time[0], (1 << depth) / ws_time[1],
+	                (1 << depth) / ws_time[2]);
+
+	g_test_maximized_result ((1 << depth) / ws_time[2],
+	                         "Fork/join leaves/s with IrisWSScheduler");
+}
+
+/* affinity: the cpu list is parsed, normalised and only taken before the
+ * scheduler starts.
+ */
+static void
+test_affinity (void)
+{
+	IrisScheduler *scheduler;
+	gchar         *affinity;
+	gchar         *node_cpus;
+	guint          node;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+	g_assert (iris_scheduler_get_affinity (scheduler) == NULL);
+
+	g_assert (iris_scheduler_set_affinity (scheduler, "3,0-1,2,8"));
+	affinity = iris_scheduler_get_affinity (scheduler);
+	g_assert_cmpstr (affinity, ==, "0-3,8");
+	g_free (affinity);
+
+	g_assert (!iris_scheduler_set_affinity (scheduler, ""));
+	g_assert (!iris_scheduler_set_affinity (scheduler, "1-"));
+	g_assert (!iris_scheduler_set_affinity (scheduler, "3-1"));
+	g_assert (!iris_scheduler_set_affinity (scheduler, "0;1"));
+	g_assert (!iris_scheduler_set_affinity (scheduler, "100000"));
+
+	g_assert (iris_scheduler_set_affinity (scheduler, NULL));
+	g_assert (iris_scheduler_get_affinity (scheduler) == NULL);
+
+	g_assert (iris_scheduler_set_affinity (scheduler, "0"));
+	iris_scheduler_queue (scheduler, (IrisCallback)g_usleep, GINT_TO_POINTER (500), NULL);
+	g_assert (!iris_scheduler_set_affinity (scheduler, "1"));
+
+	affinity = iris_scheduler_get_affinity (scheduler);
+	g_assert_cmpstr (affinity, ==, "0");
+	g_free (affinity);
+
+	g_object_unref (scheduler);
+
+	g_assert_cmpuint (iris_scheduler_get_n_nodes (), >=, 1);
+	g_assert_cmpuint (iris_scheduler_get_current_node (), <, iris_scheduler_get_n_nodes ());
+
+	for (node = 0; node < iris_scheduler_get_n_nodes (); node++) {
+		node_cpus = iris_scheduler_get_node_cpus (node);
+		if (node_cpus != NULL) {
+			scheduler = iris_scheduler_new ();
+			g_assert (iris_scheduler_set_affinity (scheduler, node_cpus));
+			g_object_unref (scheduler);
+		}
+		g_free (node_cpus);
 	}
 }
 
+/* affinity benchmark: fork/join again, counting the work items which run on
+ * a different NUMA node from the one that queued them. With the threads
+ * pinned, children should stay on the node of their parent.
+ */
+#define AFFINITY_DATA(depth,node) GINT_TO_POINTER (((node) << 8) | (depth))
+
+typedef struct
+{
+	IrisScheduler *scheduler;
+	volatile gint  n_items;
+	volatile gint  n_cross_node;
+} Affinity;
+
+static Affinity affinity_run;
+
+static void
+affinity_cb (gpointer data)
+{
+	gint  depth = GPOINTER_TO_INT (data) & 0xff;
+	guint parent_node = GPOINTER_TO_INT (data) >> 8;
+	guint node = iris_scheduler_get_current_node ();
+
+	if (node != parent_node)
+		g_atomic_int_inc (&affinity_run.n_cross_node);
+
+	if (depth > 0) {
+		iris_scheduler_queue (affinity_run.scheduler, affinity_cb,
+		                      AFFINITY_DATA (depth - 1, node), NULL);
+		iris_scheduler_queue (affinity_run.scheduler, affinity_cb,
+		                      AFFINITY_DATA (depth - 1, node), NULL);
+	}
+
+	g_atomic_int_inc (&affinity_run.n_items);
+}
+
+static gdouble
+affinity_run_cross_node (IrisScheduler *scheduler,
+                         gint           depth)
+{
+	gint n_items = (1 << (depth + 1)) - 1;
+
+	affinity_run.scheduler = scheduler;
+	affinity_run.n_items = 0;
+	affinity_run.n_cross_node = 0;
+
+	iris_scheduler_queue (scheduler, affinity_cb,
+	                      AFFINITY_DATA (depth, iris_scheduler_get_current_node ()),
+	                      NULL);
+
+	while (g_atomic_int_get (&affinity_run.n_items) < n_items)
+		g_thread_yield ();
+
+	g_object_unref (scheduler);
+
+	return (gdouble)affinity_run.n_cross_node / n_items;
+}
+
+static void
+test_affinity_benchmark (void)
+{
+	IrisScheduler *scheduler;
+	GString       *cpus;
+	gchar         *node_cpus;
+	gint           depth = g_test_perf () ? 18 : 12;
+	guint          n_threads = iris_scheduler_get_n_cpu ();
+	guint          node;
+	gdouble        free_cross;
+	gdouble        pinned_cross;
+
+	/* Every CPU we know of, so the threads fill one node at a time */
+	cpus = g_string_new (NULL);
+	for (node = 0; node < iris_scheduler_get_n_nodes (); node++) {
+		if ((node_cpus = iris_scheduler_get_node_cpus (node)) != NULL)
+			g_string_append_printf (cpus, "%s%s", cpus->len ? "," : "", node_cpus);
+		g_free (node_cpus);
+	}
+	if (cpus->len == 0)
+		g_string_printf (cpus, "0-%u", n_threads - 1);
+
+	free_cross = affinity_run_cross_node (iris_scheduler_new_full (n_threads, n_threads),
+	                                      depth);
+
+	scheduler = iris_scheduler_new_full (n_threads, n_threads);
+	g_assert (iris_scheduler_set_affinity (scheduler, cpus->str));
+	pinned_cross = affinity_run_cross_node (scheduler, depth);
+
+	g_test_message ("%u nodes, %u threads: %.1f%% of work crossed nodes "
+	                "unpinned, %.1f%% pinned to %s",
+	                iris_scheduler_get_n_nodes (), n_threads,
+	                free_cross * 100.0, pinned_cross * 100.0, cpus->str);
+
+	g_test_minimized_result (pinned_cross * 100.0,
+	                         "%% of work run on another node with pinned threads");
+
+	g_string_free (cpus, TRUE);
+}
+
+/* timeout: one-shot timeouts run once and not early, removed ones never run
+ * and periodic ones run until they are removed.
+ */
+typedef struct
+{
+	GTimer        *timer;
+	gdouble        elapsed;
+	volatile gint  runs;
+	volatile gint  freed;
+} Timeout;
+
+static void
+timeout_cb (gpointer data)
+{
+	Timeout *timeout = data;
+
+	if (g_atomic_int_exchange_and_add (&timeout->runs, 1) == 0)
+		timeout->elapsed = g_timer_elapsed (timeout->timer, NULL);
+}
+
+static void
+timeout_free_cb (gpointer data)
+{
+	Timeout *timeout = data;
+
+	g_atomic_int_inc (&timeout->freed);
+}
+
+static void
+test_timeout (void)
+{
+	IrisScheduler *scheduler;
+	Timeout        once = { 0 },
+	               removed = { 0 },
+	               periodic = { 0 };
+	guint          removed_id,
+	               periodic_id;
+	gint           runs;
+
+	scheduler = iris_scheduler_new ();
+
+	once.timer = g_timer_new ();
+	removed.timer = g_timer_new ();
+	periodic.timer = g_timer_new ();
+
+	iris_scheduler_queue_timeout (scheduler, 50, timeout_cb, &once,
+	                              timeout_free_cb);
+	removed_id = iris_scheduler_queue_timeout (scheduler, 50, timeout_cb,
+	                                           &removed, timeout_free_cb);
+	periodic_id = iris_scheduler_queue_periodic (scheduler, 10, timeout_cb,
+	                                             &periodic, timeout_free_cb);
+	g_assert_cmpuint (removed_id, !=, periodic_id);
+
+	g_assert (iris_scheduler_remove_timeout (removed_id));
+	g_assert (!iris_scheduler_remove_timeout (removed_id));
+	g_assert_cmpint (g_atomic_int_get (&removed.freed), ==, 1);
+
+	while (g_atomic_int_get (&once.freed) == 0)
+		g_thread_yield ();
+
+	g_assert_cmpint (once.runs, ==, 1);
+	g_assert_cmpfloat (once.elapsed, >=, 0.050);
+
+	while (g_atomic_int_get (&periodic.runs) < 3)
+		g_thread_yield ();
+
+	g_assert (iris_scheduler_remove_timeout (periodic_id));
+
+	while (g_atomic_int_get (&periodic.freed) == 0)
+		g_thread_yield ();
+
+	runs = g_atomic_int_get (&periodic.runs);
+	g_usleep (50000);
+	g_assert_cmpint (g_atomic_int_get (&periodic.runs), ==, runs);
+	g_assert_cmpint (periodic.freed, ==, 1);
+
+	g_assert_cmpint (removed.runs, ==, 0);
+	g_assert_cmpint (once.freed, ==, 1);
+
+	g_test_message ("50ms timeout ran after %.1fms, first 10ms period after "
+	                "%.1fms", once.elapsed * 1000, periodic.elapsed * 1000);
+
+	g_timer_destroy (once.timer);
+	g_timer_destroy (removed.timer);
+	g_timer_destroy (periodic.timer);
+	g_object_unref (scheduler);
+}
+
 gint
 main (int   argc,
       char *argv[])
@@ -102,7 +487,17 @@ main (int   argc,
 
 	g_test_add_func ("/scheduler/queue()", test_queue);
 
+	g_test_add_func ("/scheduler/queue factory", test_queue_factory);
+
 	g_test_add_func ("/scheduler/finalize", test_finalize);
 
+	g_test_add_func ("/scheduler/fork join", test_fork_join);
+
+	g_test_add_func ("/scheduler/affinity", test_affinity);
+
+	g_test_add_func ("/scheduler/affinity benchmark", test_affinity_benchmark);
+
+	g_test_add_func ("/scheduler/timeout", test_timeout);
+
 	return g_test_run ();
 }
@@ -48,6 +48,196 @@ main_context1 (void)
 	g_assert (counter == 100);
 }
 
+/* retire: idle threads beyond the reserve exit after the idle timeout and
+ * are counted.
+ */
+static void
+retire (void)
+{
+	IrisScheduler *scheduler;
+	guint          n_created, n_retired,
+	               n_created_before, n_retired_before,
+	               idle_reserve, idle_timeout;
+	gint           i;
+
+	idle_reserve = iris_scheduler_manager_get_idle_reserve ();
+	idle_timeout = iris_scheduler_manager_get_idle_timeout ();
+
+	iris_scheduler_manager_get_thread_counts (&n_created_before,
+	                                          &n_retired_before);
+
+	iris_scheduler_manager_set_idle_reserve (1);
+	iris_scheduler_manager_set_idle_timeout (100);
+
+	scheduler = iris_scheduler_new_full (4, 4);
+
+	for (i = 0; i < 100; i++)
+		iris_scheduler_queue (scheduler, (IrisCallback)g_usleep,
+		                      GINT_TO_POINTER (100), NULL);
+
+	g_object_unref (scheduler);
+
+	while (iris_scheduler_manager_get_spare_thread_count () > 1)
+		g_usleep (G_USEC_PER_SEC / 100);
+
+	iris_scheduler_manager_get_thread_counts (&n_created, &n_retired);
+
+	g_assert_cmpuint (n_created - n_created_before, <=, 4);
+	g_assert_cmpuint (n_retired, >=, n_retired_before + 3);
+	g_assert_cmpuint (n_retired, <=, n_created);
+
+	/* The reserve is kept */
+	g_usleep (G_USEC_PER_SEC / 2);
+	g_assert_cmpint (iris_scheduler_manager_get_spare_thread_count (), ==, 1);
+
+	iris_scheduler_manager_set_idle_reserve (idle_reserve);
+	iris_scheduler_manager_set_idle_timeout (idle_timeout);
+}
+
+/* stats: the manager's accounting follows prepare and request, and stops
+ * growing at max_threads.
+ */
+static void
+stats_cb (gpointer data)
+{
+	g_atomic_int_set ((gint *)data, TRUE);
+}
+
+static void
+stats (void)
+{
+	IrisScheduler             *scheduler;
+	IrisSchedulerManagerStats  stats;
+	volatile gint              done = FALSE;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_threads, ==, 0);
+	g_assert_cmpint (stats.n_grown, ==, 0);
+	g_assert (stats.last_grow < 0);
+
+	/* Prepared lazily */
+	iris_scheduler_queue (scheduler, stats_cb, (gpointer)&done, NULL);
+	while (!g_atomic_int_get (&done))
+		g_thread_yield ();
+
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_threads, ==, 2);
+	g_assert_cmpint (stats.min_threads, ==, 2);
+	g_assert_cmpint (stats.max_threads, ==, 2);
+	g_assert_cmpint (stats.n_pending, ==, 0);
+
+	iris_scheduler_manager_request (scheduler, 1, 10);
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_threads, ==, 2);
+	g_assert_cmpint (stats.n_grown, ==, 0);
+	g_assert_cmpint (stats.n_requests, >=, 1);
+	g_assert (stats.maxed);
+
+	g_object_unref (scheduler);
+
+	scheduler = iris_scheduler_new_full (1, 3);
+
+	done = FALSE;
+	iris_scheduler_queue (scheduler, stats_cb, (gpointer)&done, NULL);
+	while (!g_atomic_int_get (&done))
+		g_thread_yield ();
+
+	iris_scheduler_manager_request (scheduler, 1, 2);
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_threads, ==, 2);
+	g_assert_cmpint (stats.n_grown, ==, 1);
+	g_assert (!stats.maxed);
+	g_assert (stats.last_grow >= 0);
+
+	iris_scheduler_manager_request (scheduler, 1, 100);
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_threads, ==, 3);
+	g_assert_cmpint (stats.n_grown, ==, 2);
+	g_assert_cmpint (stats.n_pending, ==, 0);
+
+	iris_scheduler_manager_request (scheduler, 1, 100);
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_threads, ==, 3);
+	g_assert_cmpint (stats.n_requests, >=, 3);
+	g_assert (stats.maxed);
+
+	g_object_unref (scheduler);
+}
+
+/* churn benchmark: many threads creating and dropping schedulers at once,
+ * each of which claims a thread from the scheduler manager and gives it
+ * back.
+ */
+static void
+churn_cb (gpointer data)
+{
+	g_atomic_int_set ((gint *)data, TRUE);
+}
+
+static gpointer
+churn_thread (gpointer data)
+{
+	IrisScheduler *scheduler;
+	volatile gint  done;
+	gint           n_rounds = GPOINTER_TO_INT (data),
+	               i;
+
+	for (i = 0; i < n_rounds; i++) {
+		done = FALSE;
+
+		scheduler = iris_scheduler_new_full (1, 1);
+		iris_scheduler_queue (scheduler, churn_cb, (gpointer)&done, NULL);
+
+		while (!g_atomic_int_get (&done))
+			g_thread_yield ();
+
+		g_object_unref (scheduler);
+	}
+
+	return NULL;
+}
+
+static void
+churn_benchmark (void)
+{
+	GThread **threads;
+	GTimer   *timer;
+	gdouble   elapsed;
+	guint     n_created, n_created_before;
+	gint      n_threads = g_test_perf () ? 256 : 16,
+	          n_rounds = g_test_perf () ? 200 : 20,
+	          i;
+
+	iris_scheduler_manager_get_thread_counts (&n_created_before, NULL);
+
+	threads = g_new (GThread *, n_threads);
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_threads; i++)
+		threads[i] = g_thread_create (churn_thread, GINT_TO_POINTER (n_rounds),
+		                              TRUE, NULL);
+
+	for (i = 0; i < n_threads; i++)
+		g_thread_join (threads[i]);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	iris_scheduler_manager_get_thread_counts (&n_created, NULL);
+
+	g_test_message ("%d threads churning: %.0f schedulers/s, %u threads "
+	                "created for %d schedulers", n_threads,
+	                n_threads * n_rounds / elapsed,
+	                n_created - n_created_before, n_threads * n_rounds);
+
+	g_test_maximized_result (n_threads * n_rounds / elapsed,
+	                         "Schedulers created and freed per second by %d "
+	                         "threads", n_threads);
+
+	g_timer_destroy (timer);
+	g_free (threads);
+}
+
 gint
 main (int   argc,
       char *argv[])
@@ -57,6 +247,9 @@ main (int   argc,
 	g_thread_init (NULL);
 
 	g_test_add_func ("/scheduler-manager/main_context1", main_context1);
+	g_test_add_func ("/scheduler-manager/retire", retire);
+	g_test_add_func ("/scheduler-manager/stats", stats);
+	g_test_add_func ("/scheduler-manager/churn benchmark", churn_benchmark);
 
 	return g_test_run ();
 }
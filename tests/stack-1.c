@@ -1,5 +1,8 @@
 #include <iris.h>
 #include <iris/iris-stack-private.h>
+#include <iris/iris-atomics.h>
+
+#include "bench-baseline.h"
 
 static void
 test1 (void)
@@ -7,7 +10,7 @@ test1 (void)
 	IrisStack *stack = iris_stack_new ();
 	g_assert (stack != NULL);
 	g_assert (stack->head != NULL);
-	g_assert (stack->head->next == NULL);
+	g_assert (stack->head->next.pointer == NULL);
 }
 
 static void
@@ -34,7 +37,7 @@ test4 (void)
 	IrisStack *stack = iris_stack_new ();
 	g_assert (stack != NULL);
 	g_assert (stack->head != NULL);
-	g_assert (stack->head->next == NULL);
+	g_assert (stack->head->next.pointer == NULL);
 	iris_stack_unref (stack);
 }
 
@@ -44,7 +47,7 @@ test5 (void)
 	IrisStack *stack = iris_stack_new ();
 	g_assert (stack != NULL);
 	g_assert (stack->head != NULL);
-	g_assert (stack->head->next == NULL);
+	g_assert (stack->head->next.pointer == NULL);
 	g_assert_cmpint (stack->ref_count, ==, 1);
 	stack = iris_stack_ref (stack);
 	g_assert_cmpint (stack->ref_count, ==, 2);
@@ -59,6 +62,141 @@ test6 (void)
 	g_assert_cmpint (IRIS_TYPE_STACK, !=, G_TYPE_INVALID);
 }
 
+/* aba: threads pop a few items and push them back, so links are recycled
+ * through the free list while other threads hold stale copies of the head.
+ * With a 2 bit stamp this loses or duplicates items within seconds.
+ */
+
+#define ABA_ITEMS 64
+
+static BenchTarget    aba_target;
+static volatile gint  aba_go;
+
+static gpointer
+aba_thread (gpointer data)
+{
+	gpointer items[3];
+	gint     i, j, n;
+
+	while (!g_atomic_int_get (&aba_go))
+		g_thread_yield ();
+
+	for (i = 0; i < (g_test_perf () ? 1000000 : 50000); i++) {
+		for (n = 0; n < G_N_ELEMENTS (items); n++)
+			if ((items[n] = bench_target_pop (&aba_target)) == NULL)
+				break;
+		for (j = 0; j < n; j++)
+			bench_target_push (&aba_target, items[j]);
+	}
+
+	return NULL;
+}
+
+static gdouble
+aba_run (gboolean locked,
+         gint     n_threads)
+{
+	GThread  *threads[64];
+	GTimer   *timer;
+	gboolean  seen[ABA_ITEMS] = { FALSE, };
+	gpointer  item;
+	gdouble   elapsed;
+	gint      i;
+
+	bench_target_init (&aba_target, locked, TRUE, iris_stack_new ());
+	aba_target.push = (BenchPushFunc)iris_stack_push;
+	aba_target.pop = (BenchPopFunc)iris_stack_pop;
+	aba_go = FALSE;
+
+	for (i = 1; i <= ABA_ITEMS; i++)
+		bench_target_push (&aba_target, GINT_TO_POINTER (i));
+
+	for (i = 0; i < n_threads; i++)
+		threads[i] = g_thread_create (aba_thread, NULL, TRUE, NULL);
+
+	timer = g_timer_new ();
+	g_atomic_int_set (&aba_go, TRUE);
+	for (i = 0; i < n_threads; i++)
+		g_thread_join (threads[i]);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	/* Every item must still be on the stack exactly once */
+	for (i = 0; i < ABA_ITEMS; i++) {
+		item = bench_target_pop (&aba_target);
+		g_assert (item != NULL);
+		g_assert (!seen[GPOINTER_TO_INT (item) - 1]);
+		seen[GPOINTER_TO_INT (item) - 1] = TRUE;
+	}
+	g_assert (bench_target_pop (&aba_target) == NULL);
+
+	g_timer_destroy (timer);
+	bench_target_destroy (&aba_target);
+	iris_stack_unref (aba_target.container);
+
+	return elapsed;
+}
+
+static void
+test_aba (void)
+{
+	gint    max_threads = g_test_perf () ? 64 : 8;
+	gdouble lockfree_time;
+	gdouble locked_time;
+	gint    n_threads;
+
+	for (n_threads = 2; n_threads <= max_threads; n_threads *= 2) {
+		locked_time = aba_run (TRUE, n_threads);
+		lockfree_time = aba_run (FALSE, n_threads);
+
+		g_test_message ("%d threads: locked %.3fs, lock-free %.3fs",
+		                n_threads, locked_time, lockfree_time);
+	}
+
+	g_test_minimized_result (lockfree_time,
+	                         "IrisStack ABA stress at %d threads",
+	                         max_threads);
+}
+
+/* aba replay: the interleaving that breaks a plain pointer swap in
+ * iris_stack_pop(), forced from a single thread. A stale pop reads the head
+ * and its next link, then the head is popped and its link is reused by a
+ * push before the stale pop swaps. The head is the same link again, so only
+ * the stamp can make the swap fail.
+ */
+static void
+test_aba_replay (void)
+{
+	IrisStack  *stack;
+	GStampPair  old;
+	IrisLink   *old_next;
+
+	stack = iris_stack_new ();
+	iris_stack_push (stack, GINT_TO_POINTER (3));
+	iris_stack_push (stack, GINT_TO_POINTER (2));
+	iris_stack_push (stack, GINT_TO_POINTER (1));
+
+	/* The stale pop loads the head, like iris_stack_pop() */
+	G_STAMP_PAIR_LOAD (&stack->head->next, &old);
+	old_next = ((IrisLink*)old.pointer)->next.pointer;
+
+	/* Meanwhile 1 is popped and its link comes back from the free list */
+	g_assert_cmpint (GPOINTER_TO_INT (iris_stack_pop (stack)), ==, 1);
+	iris_stack_push (stack, GINT_TO_POINTER (4));
+	g_assert (stack->head->next.pointer == old.pointer);
+
+	/* Swapping in the stale next link would lose 4 */
+	g_assert (!iris_atomics_compare_and_exchange_pair (&stack->head->next,
+	                                                   old.pointer, old.stamp,
+	                                                   old_next));
+
+	g_assert_cmpint (GPOINTER_TO_INT (iris_stack_pop (stack)), ==, 4);
+	g_assert_cmpint (GPOINTER_TO_INT (iris_stack_pop (stack)), ==, 2);
+	g_assert_cmpint (GPOINTER_TO_INT (iris_stack_pop (stack)), ==, 3);
+	g_assert (iris_stack_pop (stack) == NULL);
+
+	iris_stack_unref (stack);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -73,6 +211,8 @@ main (int   argc,
 	g_test_add_func ("/stack/unref", test4);
 	g_test_add_func ("/stack/ref-unref", test5);
 	g_test_add_func ("/stack/get_type", test6);
+	g_test_add_func ("/stack/aba", test_aba);
+	g_test_add_func ("/stack/aba replay", test_aba_replay);
 
 	return g_test_run ();
 }
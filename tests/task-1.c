@@ -764,6 +764,198 @@ test28 (void)
 	g_object_unref (t4);
 }
 
+/* cancel latency: the control messages of a task share a scheduler with a
+ * backlog of bulk work, as they do with the default schedulers when the
+ * control and work schedulers are set to the same one. The cancel should
+ * not have to wait for the backlog.
+ */
+#define BACKLOG_ITEMS 1000
+
+static gdouble
+cancel_latency_run (IrisSchedulerPriority priority)
+{
+	IrisScheduler *scheduler;
+	IrisTask      *task;
+	GTimer        *timer;
+	gdouble        latency;
+	gint           i;
+
+	scheduler = iris_scheduler_new_full (2, 2);
+	task = iris_task_new_full (NULL, NULL, NULL, FALSE, scheduler, scheduler, NULL);
+	g_assert_cmpint (iris_receiver_get_priority (task->priv->receiver), ==,
+	                 IRIS_SCHEDULER_PRIORITY_HIGH);
+	iris_receiver_set_priority (task->priv->receiver, priority);
+
+	for (i = 0; i < BACKLOG_ITEMS; i++)
+		iris_scheduler_queue (scheduler, (IrisCallback)g_usleep,
+		                      GINT_TO_POINTER (1000), NULL);
+
+	timer = g_timer_new ();
+	iris_task_cancel (task);
+
+	while (!iris_task_is_cancelled (task))
+		g_thread_yield ();
+
+	latency = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	wait_task_messages (task);
+	g_object_unref (task);
+	g_object_unref (scheduler);
+
+	return latency;
+}
+
+static void
+test_cancel_latency (void)
+{
+	gdouble high_latency;
+	gdouble normal_latency;
+
+	high_latency = cancel_latency_run (IRIS_SCHEDULER_PRIORITY_HIGH);
+	normal_latency = cancel_latency_run (IRIS_SCHEDULER_PRIORITY_NORMAL);
+
+	g_test_message ("cancel behind %d queued items: %.2fms at high priority, "
+	                "%.2fms at normal priority", BACKLOG_ITEMS,
+	                high_latency * 1000, normal_latency * 1000);
+
+	g_assert_cmpfloat (high_latency, <, normal_latency / 4);
+
+	g_test_minimized_result (high_latency * 1000,
+	                         "Cancel latency in ms with a saturated scheduler");
+}
+
+/* performance hints: CPU-bound tasks never run on more threads than there
+ * are processors, however many threads the scheduler has, while IO-bound
+ * tasks run on more threads than the scheduler's maximum.
+ */
+typedef struct
+{
+	volatile gint running;
+	volatile gint max_running;
+	gulong        duration;    /* Microseconds per task */
+	gboolean      sleep;
+} HintState;
+
+static void
+hint_cb (IrisTask *task,
+         gpointer  user_data)
+{
+	HintState *state = user_data;
+	GTimer    *timer;
+	gint       running,
+	           max_running;
+
+	running = g_atomic_int_exchange_and_add (&state->running, 1) + 1;
+	do {
+		max_running = g_atomic_int_get (&state->max_running);
+	} while (running > max_running &&
+	         !g_atomic_int_compare_and_exchange (&state->max_running,
+	                                             max_running, running));
+
+	if (state->sleep)
+		g_usleep (state->duration);
+	else {
+		timer = g_timer_new ();
+		while (g_timer_elapsed (timer, NULL) * G_USEC_PER_SEC < state->duration);
+		g_timer_destroy (timer);
+	}
+
+	g_atomic_int_add (&state->running, -1);
+}
+
+static gint
+hint_run (IrisScheduler       *scheduler,
+          IrisPerformanceHint  hint,
+          gint                 n_tasks,
+          gulong               duration,
+          gboolean             sleep)
+{
+	IrisScheduler  *control_scheduler;
+	IrisTask      **tasks;
+	HintState       state = { 0, 0, duration, sleep };
+	gint            i;
+
+	control_scheduler = iris_scheduler_new_full (1, 2);
+	tasks = g_new (IrisTask*, n_tasks);
+
+	for (i = 0; i < n_tasks; i++) {
+		tasks[i] = iris_task_new_full (hint_cb, &state, NULL, FALSE,
+		                               control_scheduler, scheduler, NULL);
+		iris_task_set_performance_hint (tasks[i], hint);
+		g_assert_cmpint (iris_task_get_performance_hint (tasks[i]), ==, hint);
+		g_object_ref (tasks[i]);
+	}
+
+	for (i = 0; i < n_tasks; i++)
+		iris_task_run (tasks[i]);
+
+	for (i = 0; i < n_tasks; i++) {
+		while (!iris_task_is_finished (tasks[i]))
+			g_usleep (1000);
+
+		wait_task_messages (tasks[i]);
+		g_object_unref (tasks[i]);
+	}
+
+	g_assert_cmpint (state.running, ==, 0);
+
+	g_free (tasks);
+	g_object_unref (control_scheduler);
+
+	return state.max_running;
+}
+
+static void
+test_cpu_bound (void)
+{
+	IrisScheduler *scheduler;
+	gint           n_cpu = iris_scheduler_get_n_cpu (),
+	               n_tasks = n_cpu * 2 + 2,
+	               max_running;
+
+	scheduler = iris_scheduler_new_full (n_tasks, n_tasks);
+
+	max_running = hint_run (scheduler, IRIS_CPU_BOUND, n_tasks, 20000, FALSE);
+	g_test_message ("%d CPU-bound tasks on %d threads and %d processors ran "
+	                "%d at once", n_tasks, n_tasks, n_cpu, max_running);
+	g_assert_cmpint (max_running, <=, n_cpu);
+
+	max_running = hint_run (scheduler, IRIS_NO_HINT, n_tasks, 20000, FALSE);
+	g_test_message ("without the hint they ran %d at once", max_running);
+
+	g_object_unref (scheduler);
+}
+
+static void
+test_io_bound (void)
+{
+	IrisScheduler             *scheduler;
+	IrisSchedulerManagerStats  stats;
+	guint                      budget;
+	gint                       max_running;
+
+	budget = iris_scheduler_manager_get_blocking_budget ();
+	iris_scheduler_manager_set_blocking_budget (4);
+
+	/* Work queued from outside a work-stealing scheduler can be taken by
+	 * any of its threads, including those lent to it.
+	 */
+	scheduler = iris_wsscheduler_new_full (1, 1);
+
+	max_running = hint_run (scheduler, IRIS_IO_BOUND, 8, 100000, TRUE);
+	g_test_message ("8 IO-bound tasks on a scheduler of 1 thread ran %d "
+	                "at once", max_running);
+	g_assert_cmpint (max_running, >, 1);
+	g_assert_cmpint (max_running, <=, 5);
+
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_lent, ==, 0);
+
+	g_object_unref (scheduler);
+	iris_scheduler_manager_set_blocking_budget (budget);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -793,6 +985,9 @@ main (int   argc,
 	g_test_add_func ("/task/cancel in execution", test_cancel_execution);
 	g_test_add_func ("/task/cancel in callbacks", test_cancel_callbacks);
 	g_test_add_func ("/task/cancel in finished", test_cancel_finished);
+	g_test_add_func ("/task/cancel latency", test_cancel_latency);
+	g_test_add_func ("/task/cpu bound", test_cpu_bound);
+	g_test_add_func ("/task/io bound", test_io_bound);
 	g_test_add_func ("/task/dep-clean-finish1", test21);
 	g_test_add_func ("/task/all_of1", test25);
 	g_test_add_func ("/task/dep ownership", test_dep_ownership);
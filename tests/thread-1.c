@@ -1,4 +1,8 @@
 #include <iris.h>
+#include <iris/iris-message-private.h>
+#include <iris/iris-thread-private.h>
+
+#define CACHE_N_BLOCKS 16
 
 static void
 test1 (void)
@@ -6,6 +10,211 @@ test1 (void)
 	g_assert_cmpint (IRIS_TYPE_THREAD, !=, G_TYPE_INVALID);
 }
 
+typedef struct
+{
+	gpointer      blocks[CACHE_N_BLOCKS];
+	volatile gint done;
+	gint          reused;
+} CacheTest;
+
+static void
+cache_alloc_cb (gpointer data)
+{
+	CacheTest *test = data;
+	gint       i;
+
+	for (i = 0; i < CACHE_N_BLOCKS; i++)
+		test->blocks[i] = iris_thread_cache_alloc (IRIS_THREAD_CACHE_MESSAGE,
+		                                           sizeof (IrisMessageReal));
+
+	g_atomic_int_set (&test->done, TRUE);
+}
+
+static void
+cache_realloc_cb (gpointer data)
+{
+	CacheTest *test = data;
+	gpointer   blocks[CACHE_N_BLOCKS];
+	gint       i, j;
+
+	for (i = 0; i < CACHE_N_BLOCKS; i++) {
+		blocks[i] = iris_thread_cache_alloc (IRIS_THREAD_CACHE_MESSAGE,
+		                                     sizeof (IrisMessageReal));
+		for (j = 0; j < CACHE_N_BLOCKS; j++)
+			if (blocks[i] == test->blocks[j])
+				test->reused++;
+	}
+
+	for (i = 0; i < CACHE_N_BLOCKS; i++)
+		iris_thread_cache_free (blocks[i]);
+
+	g_atomic_int_set (&test->done, TRUE);
+}
+
+static void
+wait_done (CacheTest *test)
+{
+	while (!g_atomic_int_get (&test->done))
+		g_usleep (1000);
+	test->done = FALSE;
+}
+
+/* Blocks freed outside the thread which allocated them must find their way
+ * back to it.
+ */
+static void
+test_cache_return (void)
+{
+	IrisScheduler *scheduler;
+	CacheTest      test = { { NULL }, FALSE, 0 };
+	gpointer       block;
+	gint           i;
+
+	scheduler = iris_scheduler_new_full (1, 1);
+
+	iris_scheduler_queue (scheduler, cache_alloc_cb, &test, NULL);
+	wait_done (&test);
+
+	for (i = 0; i < CACHE_N_BLOCKS; i++)
+		iris_thread_cache_free (test.blocks[i]);
+
+	iris_scheduler_queue (scheduler, cache_realloc_cb, &test, NULL);
+	wait_done (&test);
+
+	g_assert_cmpint (test.reused, ==, CACHE_N_BLOCKS);
+
+	/* Threads other than IrisThreads get a cache of their own */
+	block = iris_thread_cache_alloc (IRIS_THREAD_CACHE_MESSAGE,
+	                                 sizeof (IrisMessageReal));
+	g_assert (block != NULL);
+	iris_thread_cache_free (block);
+
+	g_object_unref (scheduler);
+}
+
+/* Sleeping work in a blocking region is lent threads, so that the
+ * scheduler keeps as many threads working as it has, and the lent threads
+ * go once it is done.
+ */
+#define BLOCKING_ITEMS 16
+#define BLOCKING_SLEEP 50000
+
+typedef struct
+{
+	gboolean      annotate;
+	volatile gint running;
+	volatile gint max_running;
+	volatile gint done;
+} BlockingTest;
+
+static void
+blocking_cb (gpointer data)
+{
+	BlockingTest *test = data;
+	gint          running,
+	              max_running;
+
+	running = g_atomic_int_exchange_and_add (&test->running, 1) + 1;
+	do {
+		max_running = g_atomic_int_get (&test->max_running);
+	} while (running > max_running &&
+	         !g_atomic_int_compare_and_exchange (&test->max_running,
+	                                             max_running, running));
+
+	if (test->annotate) {
+		/* Only the outermost region counts */
+		iris_thread_enter_blocking ();
+		IRIS_BLOCKING (g_usleep (BLOCKING_SLEEP));
+		iris_thread_leave_blocking ();
+	}
+	else
+		g_usleep (BLOCKING_SLEEP);
+
+	g_atomic_int_add (&test->running, -1);
+	g_atomic_int_inc (&test->done);
+}
+
+static gdouble
+blocking_run (gboolean  annotate,
+              gint     *max_running)
+{
+	IrisScheduler             *scheduler;
+	IrisSchedulerManagerStats  stats;
+	BlockingTest               test = { annotate, 0, 0, 0 };
+	GTimer                    *timer;
+	gdouble                    elapsed;
+	gint                       i;
+
+	/* Work queued from outside a work-stealing scheduler can be taken by
+	 * any of its threads, including those lent to it.
+	 */
+	scheduler = iris_wsscheduler_new_full (2, 2);
+	timer = g_timer_new ();
+
+	for (i = 0; i < BLOCKING_ITEMS; i++)
+		iris_scheduler_queue (scheduler, blocking_cb, &test, NULL);
+
+	while (g_atomic_int_get (&test.done) < BLOCKING_ITEMS)
+		g_usleep (1000);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	iris_scheduler_manager_get_stats (scheduler, &stats);
+	g_assert_cmpint (stats.n_lent, ==, 0);
+
+	/* Lent threads leave soon after they run out of work */
+	g_timer_start (timer);
+	while (stats.n_threads > 2) {
+		g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 5.0);
+		g_usleep (1000);
+		iris_scheduler_manager_get_stats (scheduler, &stats);
+	}
+
+	g_timer_destroy (timer);
+	g_object_unref (scheduler);
+
+	*max_running = test.max_running;
+
+	return elapsed;
+}
+
+static void
+test_blocking (void)
+{
+	guint   budget;
+	gdouble plain_time,
+	        blocking_time;
+	gint    plain_running,
+	        blocking_running;
+
+	/* Nothing to lend outside of an IrisThread */
+	iris_thread_enter_blocking ();
+	iris_thread_leave_blocking ();
+
+	budget = iris_scheduler_manager_get_blocking_budget ();
+	iris_scheduler_manager_set_blocking_budget (6);
+
+	plain_time = blocking_run (FALSE, &plain_running);
+	blocking_time = blocking_run (TRUE, &blocking_running);
+
+	iris_scheduler_manager_set_blocking_budget (budget);
+
+	g_test_message ("%d items sleeping %dms on 2 threads: %.0fms with %d at "
+	                "once, %.0fms with %d at once in blocking regions",
+	                BLOCKING_ITEMS, BLOCKING_SLEEP / 1000,
+	                plain_time * 1000, plain_running,
+	                blocking_time * 1000, blocking_running);
+
+	g_assert_cmpint (plain_running, <=, 2);
+	g_assert_cmpint (blocking_running, >, 2);
+	g_assert_cmpint (blocking_running, <=, 2 + 6);
+	g_assert_cmpfloat (blocking_time, <, plain_time);
+
+	g_test_maximized_result (BLOCKING_ITEMS / blocking_time,
+	                         "Sleeping items per second on 2 threads in "
+	                         "blocking regions");
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -15,6 +224,8 @@ main (int   argc,
 	g_thread_init (NULL);
 
 	g_test_add_func ("/thread/get-type", test1);
+	g_test_add_func ("/thread/cache return", test_cache_return);
+	g_test_add_func ("/thread/blocking", test_blocking);
 
 	return g_test_run ();
 }
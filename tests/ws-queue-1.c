@@ -1,6 +1,8 @@
 #include <iris.h>
 #include <iris/iris-wsqueue-private.h>
 
+#include "bench-baseline.h"
+
 static void
 test1 (void)
 {
@@ -107,6 +109,277 @@ test10 (void)
 	g_assert_cmpint (IRIS_TYPE_WSQUEUE, !=, G_TYPE_INVALID);
 }
 
+/* Steal contention benchmark. One owner pushes and pops locally while the
+ * other threads steal. The baseline is a deque behind a single mutex, which
+ * is what every steal used to pay for.
+ */
+
+typedef struct
+{
+	BenchTarget    target;
+	gint           n_items;
+	volatile gint  n_taken;
+	guint64        sum;        /* Under sum_mutex */
+	GMutex        *sum_mutex;
+	volatile gint  n_ready;
+	volatile gint  go;
+} StealBench;
+
+static gpointer
+bench_try_steal (gpointer queue)
+{
+	return iris_wsqueue_try_steal (queue, 0);
+}
+
+/* Each thread sums what it takes in @sum, and adds it to the total once it
+ * is done, see bench_add_sum().
+ */
+static void
+bench_consumed (StealBench *bench,
+                gpointer    item,
+                guint64    *sum)
+{
+	*sum += GPOINTER_TO_INT (item);
+	g_atomic_int_inc (&bench->n_taken);
+}
+
+static void
+bench_add_sum (StealBench *bench,
+               guint64     sum)
+{
+	g_mutex_lock (bench->sum_mutex);
+	bench->sum += sum;
+	g_mutex_unlock (bench->sum_mutex);
+}
+
+static gpointer
+bench_thief (gpointer data)
+{
+	StealBench *bench = data;
+	gpointer    item;
+	guint64     sum = 0;
+
+	g_atomic_int_inc (&bench->n_ready);
+	while (!g_atomic_int_get (&bench->go))
+		g_thread_yield ();
+
+	while (g_atomic_int_get (&bench->n_taken) < bench->n_items) {
+		if ((item = bench_target_steal (&bench->target)) != NULL)
+			bench_consumed (bench, item, &sum);
+	}
+
+	bench_add_sum (bench, sum);
+
+	return NULL;
+}
+
+static gdouble
+bench_run (gboolean locked,
+           gint     n_threads,
+           gint     n_items)
+{
+	StealBench   bench = { { 0, }, };
+	GThread    **thieves;
+	GTimer      *timer;
+	gpointer     item;
+	gdouble      elapsed;
+	guint64      expected = 0,
+	             sum = 0;
+	gint         i;
+
+	bench_target_init (&bench.target, locked, TRUE,
+	                   iris_wsqueue_new (iris_queue_new (), iris_rrobin_new (1)));
+	bench.target.push = (BenchPushFunc)iris_wsqueue_local_push;
+	bench.target.pop = (BenchPopFunc)iris_wsqueue_local_pop;
+	bench.target.steal = bench_try_steal;
+	bench.n_items = n_items;
+	bench.sum_mutex = g_mutex_new ();
+
+	thieves = g_new0 (GThread*, n_threads - 1);
+	for (i = 0; i < n_threads - 1; i++)
+		thieves[i] = g_thread_create (bench_thief, &bench, TRUE, NULL);
+	while (g_atomic_int_get (&bench.n_ready) < n_threads - 1)
+		g_thread_yield ();
+
+	timer = g_timer_new ();
+	g_atomic_int_set (&bench.go, TRUE);
+
+	/* The owner pops one item for every few it pushes, like a worker
+	 * spawning subtasks.
+	 */
+	for (i = 1; i <= n_items; i++) {
+		bench_target_push (&bench.target, GINT_TO_POINTER (i));
+		expected += i;
+
+		if ((i & 3) == 0 && (item = bench_target_pop (&bench.target)) != NULL)
+			bench_consumed (&bench, item, &sum);
+	}
+
+	while (g_atomic_int_get (&bench.n_taken) < n_items)
+		if ((item = bench_target_pop (&bench.target)) != NULL)
+			bench_consumed (&bench, item, &sum);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	for (i = 0; i < n_threads - 1; i++)
+		g_thread_join (thieves[i]);
+	bench_add_sum (&bench, sum);
+
+	/* Every item must have been taken exactly once */
+	g_assert_cmpint (bench.n_taken, ==, n_items);
+	g_assert_cmpuint (bench.sum, ==, expected);
+
+	bench_target_destroy (&bench.target);
+	g_object_unref (bench.target.container);
+
+	g_mutex_free (bench.sum_mutex);
+	g_timer_destroy (timer);
+	g_free (thieves);
+
+	return elapsed;
+}
+
+static void
+test_steal_contention (void)
+{
+	gint    max_threads = g_test_perf () ? 64 : 4;
+	gint    n_items = g_test_perf () ? 1000000 : 20000;
+	gdouble lockfree_time;
+	gdouble locked_time;
+	gint    n_threads;
+
+	for (n_threads = 2; n_threads <= max_threads; n_threads *= 2) {
+		locked_time = bench_run (TRUE, n_threads, n_items);
+		lockfree_time = bench_run (FALSE, n_threads, n_items);
+
+		g_test_message ("%d threads: locked %.0f items/s, "
+		                "lock-free %.0f items/s",
+		                n_threads, n_items / locked_time,
+		                n_items / lockfree_time);
+	}
+
+	g_test_maximized_result (n_items / lockfree_time,
+	                         "Items/s stolen from IrisWSQueue at %d threads",
+	                         max_threads);
+}
+
+/* resize: growing keeps every item in order, and the queue shrinks back
+ * once idle.
+ */
+static void
+test_resize (void)
+{
+	IrisQueue *queue;
+	gint       i;
+
+	queue = iris_wsqueue_new (iris_queue_new (), iris_rrobin_new (1));
+
+	for (i = 1; i <= 1000; i++)
+		iris_wsqueue_local_push (IRIS_WSQUEUE (queue), GINT_TO_POINTER (i));
+	g_assert_cmpint (iris_queue_get_length (queue), ==, 1000);
+
+	g_assert_cmpint (GPOINTER_TO_INT (iris_wsqueue_try_steal (IRIS_WSQUEUE (queue), 0)), ==, 1);
+	for (i = 1000; i > 1; i--)
+		g_assert_cmpint (GPOINTER_TO_INT (iris_wsqueue_local_pop (IRIS_WSQUEUE (queue))), ==, i);
+
+	g_assert (iris_wsqueue_local_pop (IRIS_WSQUEUE (queue)) == NULL);
+	g_assert_cmpint (IRIS_WSQUEUE (queue)->priv->array->mask, ==, 31);
+	g_assert (IRIS_WSQUEUE (queue)->priv->retired == NULL);
+
+	g_object_unref (queue);
+}
+
+/* resize concurrent: the owner grows the queue while thieves are stealing
+ * from it, so they may still be reading the arrays it replaces. Every item
+ * is taken exactly once, and the old arrays are freed once the thieves are
+ * gone. The first burst is pushed before the thieves start, so the queue
+ * is known to have grown whatever the timing.
+ */
+#define RESIZE_ITEMS   20000
+#define RESIZE_THIEVES 3
+
+typedef struct
+{
+	IrisWSQueue   *queue;
+	volatile gint *seen;
+	volatile gint  n_taken;
+	volatile gint  go;
+} ResizeTest;
+
+static void
+resize_taken (ResizeTest *test,
+              gpointer    item)
+{
+	g_atomic_int_inc (&test->seen [GPOINTER_TO_INT (item) - 1]);
+	g_atomic_int_inc (&test->n_taken);
+}
+
+static gpointer
+resize_thief (gpointer data)
+{
+	ResizeTest *test = data;
+	gpointer    item;
+
+	while (!g_atomic_int_get (&test->go))
+		g_thread_yield ();
+
+	while (g_atomic_int_get (&test->n_taken) < RESIZE_ITEMS)
+		if ((item = iris_wsqueue_try_steal (test->queue, 0)) != NULL)
+			resize_taken (test, item);
+
+	return NULL;
+}
+
+static void
+test_resize_concurrent (void)
+{
+	ResizeTest  test = { NULL, NULL, 0, FALSE };
+	GThread    *thieves[RESIZE_THIEVES];
+	gpointer    item;
+	gint        i;
+
+	test.queue = IRIS_WSQUEUE (iris_wsqueue_new (iris_queue_new (),
+	                                             iris_rrobin_new (1)));
+	test.seen = g_new0 (gint, RESIZE_ITEMS);
+
+	for (i = 0; i < RESIZE_THIEVES; i++)
+		thieves[i] = g_thread_create (resize_thief, &test, TRUE, NULL);
+
+	/* Push in bursts, so that the queue keeps growing and draining */
+	for (i = 1; i <= RESIZE_ITEMS; i++) {
+		iris_wsqueue_local_push (test.queue, GINT_TO_POINTER (i));
+
+		if (i == 1000) {
+			g_assert_cmpint (test.queue->priv->array->mask, >, 31);
+			g_atomic_int_set (&test.go, TRUE);
+		}
+
+		if ((i % 1000) == 0)
+			while ((item = iris_wsqueue_local_pop (test.queue)) != NULL)
+				resize_taken (&test, item);
+	}
+
+	while (g_atomic_int_get (&test.n_taken) < RESIZE_ITEMS)
+		if ((item = iris_wsqueue_local_pop (test.queue)) != NULL)
+			resize_taken (&test, item);
+
+	for (i = 0; i < RESIZE_THIEVES; i++)
+		g_thread_join (thieves[i]);
+
+	for (i = 0; i < RESIZE_ITEMS; i++)
+		g_assert_cmpint (test.seen [i], ==, 1);
+
+	/* With the thieves gone, the next pop on the empty queue shrinks it
+	 * and frees everything that was retired.
+	 */
+	g_assert (iris_wsqueue_local_pop (test.queue) == NULL);
+	g_assert_cmpint (test.queue->priv->array->mask, ==, 31);
+	g_assert (test.queue->priv->retired == NULL);
+
+	g_free ((gpointer)test.seen);
+	g_object_unref (test.queue);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -123,6 +396,9 @@ main (int   argc,
 	g_test_add_func ("/wsqueue/timed_pop1", test8);
 	g_test_add_func ("/wsqueue/many_push1", test9);
 	g_test_add_func ("/wsqueue/get_type", test10);
+	g_test_add_func ("/wsqueue/resize", test_resize);
+	g_test_add_func ("/wsqueue/resize concurrent", test_resize_concurrent);
+	g_test_add_func ("/wsqueue/steal contention", test_steal_contention);
 
 	return g_test_run ();
 }